@@ -24,6 +24,10 @@
 # To avoid premature client exits, please ensure giving a long
 # wave file as the script's first parameter.
 #
+# The number of clients defaults to 30 and can be changed through the
+# MAX_CLIENTS environment variable, e.g. MAX_CLIENTS=120 to see how the
+# memory pool behaves with many low latency clients.
+#
 
 _bold="\x1B[1m"
 _error="\x1B[1;31m"
@@ -57,7 +61,7 @@ GNUPLOT_SCRIPT=${SCRIPTS_DIR}/plot_memory_usage.gp
 OUTPUT_FILE=${BENCHMARKS_DIR}/memory-usage-`date -Iseconds`.txt
 SYMLINK_LATEST_OUTPUT_FILE=${BENCHMARKS_DIR}/memory-usage-LATEST.txt
 
-MAX_CLIENTS=30
+MAX_CLIENTS=${MAX_CLIENTS:-30}
 
 [ -e "$PA" ] || error "$PA does not exist. Compile PulseAudio tree first."
 [ -x "$PA" ] || error "$PA cannot be executed"
@@ -86,6 +86,7 @@ static const pa_daemon_conf default_conf = {
     .remixing_use_all_sink_channels = true,
     .disable_lfe_remixing = true,
     .lfe_crossover_freq = 0,
+    .float_mixing = false,
     .config_file = NULL,
     .use_pid_file = true,
     .system_instance = false,
@@ -96,15 +97,19 @@ static const pa_daemon_conf default_conf = {
     .disable_shm = false,
     .disable_memfd = false,
     .lock_memory = false,
+    .shm_huge_pages = false,
+    .shm_prefault = false,
     .deferred_volume = true,
     .default_n_fragments = 4,
     .default_fragment_size_msec = 25,
     .deferred_volume_safety_margin_usec = 8000,
     .deferred_volume_extra_delay_usec = 0,
+    .render_worker_threads = 0,
     .default_sample_spec = { .format = PA_SAMPLE_S16NE, .rate = 44100, .channels = 2 },
     .alternate_sample_rate = 48000,
     .default_channel_map = { .channels = 2, .map = { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
-    .shm_size = 0
+    .shm_size = 0,
+    .shm_max_segments = 0
 #ifdef HAVE_SYS_RESOURCE_H
    ,.rlimit_fsize = { .value = 0, .is_set = false },
     .rlimit_data = { .value = 0, .is_set = false },
@@ -536,6 +541,7 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
         { "scache-idle-time",           pa_config_parse_int,      &c->scache_idle_time, NULL },
         { "realtime-priority",          parse_rtprio,             c, NULL },
+        { "render-worker-threads",      pa_config_parse_unsigned, &c->render_worker_threads, NULL },
         { "dl-search-path",             pa_config_parse_string,   &c->dl_search_path, NULL },
         { "default-script-file",        pa_config_parse_string,   &c->default_script_file, NULL },
         { "log-target",                 parse_log_target,         c, NULL },
@@ -562,8 +568,12 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "disable-lfe-remixing",       pa_config_parse_bool,     &c->disable_lfe_remixing, NULL },
         { "enable-lfe-remixing",        pa_config_parse_not_bool, &c->disable_lfe_remixing, NULL },
         { "lfe-crossover-freq",         pa_config_parse_unsigned, &c->lfe_crossover_freq, NULL },
+        { "enable-float-mixing",        pa_config_parse_bool,     &c->float_mixing, NULL },
         { "load-default-script-file",   pa_config_parse_bool,     &c->load_default_script_file, NULL },
         { "shm-size-bytes",             pa_config_parse_size,     &c->shm_size, NULL },
+        { "shm-max-segments",           pa_config_parse_unsigned, &c->shm_max_segments, NULL },
+        { "shm-huge-pages",             pa_config_parse_bool,     &c->shm_huge_pages, NULL },
+        { "shm-prefault",               pa_config_parse_bool,     &c->shm_prefault, NULL },
         { "log-meta",                   pa_config_parse_bool,     &c->log_meta, NULL },
         { "log-time",                   pa_config_parse_bool,     &c->log_time, NULL },
         { "log-backtrace",              pa_config_parse_unsigned, &c->log_backtrace, NULL },
@@ -733,6 +743,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "nice-level = %i\n", c->nice_level);
     pa_strbuf_printf(s, "realtime-scheduling = %s\n", pa_yes_no(c->realtime_scheduling));
     pa_strbuf_printf(s, "realtime-priority = %i\n", c->realtime_priority);
+    pa_strbuf_printf(s, "render-worker-threads = %u\n", c->render_worker_threads);
     pa_strbuf_printf(s, "allow-module-loading = %s\n", pa_yes_no(!c->disallow_module_loading));
     pa_strbuf_printf(s, "allow-exit = %s\n", pa_yes_no(!c->disallow_exit));
     pa_strbuf_printf(s, "use-pid-file = %s\n", pa_yes_no(c->use_pid_file));
@@ -757,6 +768,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "remixing-use-all-sink-channels = %s\n", pa_yes_no(c->remixing_use_all_sink_channels));
     pa_strbuf_printf(s, "enable-lfe-remixing = %s\n", pa_yes_no(!c->disable_lfe_remixing));
     pa_strbuf_printf(s, "lfe-crossover-freq = %u\n", c->lfe_crossover_freq);
+    pa_strbuf_printf(s, "enable-float-mixing = %s\n", pa_yes_no(c->float_mixing));
     pa_strbuf_printf(s, "default-sample-format = %s\n", pa_sample_format_to_string(c->default_sample_spec.format));
     pa_strbuf_printf(s, "default-sample-rate = %u\n", c->default_sample_spec.rate);
     pa_strbuf_printf(s, "alternate-sample-rate = %u\n", c->alternate_sample_rate);
@@ -768,6 +780,9 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "deferred-volume-safety-margin-usec = %u\n", c->deferred_volume_safety_margin_usec);
     pa_strbuf_printf(s, "deferred-volume-extra-delay-usec = %d\n", c->deferred_volume_extra_delay_usec);
     pa_strbuf_printf(s, "shm-size-bytes = %lu\n", (unsigned long) c->shm_size);
+    pa_strbuf_printf(s, "shm-max-segments = %u\n", c->shm_max_segments);
+    pa_strbuf_printf(s, "shm-huge-pages = %s\n", pa_yes_no(c->shm_huge_pages));
+    pa_strbuf_printf(s, "shm-prefault = %s\n", pa_yes_no(c->shm_prefault));
     pa_strbuf_printf(s, "log-meta = %s\n", pa_yes_no(c->log_meta));
     pa_strbuf_printf(s, "log-time = %s\n", pa_yes_no(c->log_time));
     pa_strbuf_printf(s, "log-backtrace = %u\n", c->log_backtrace);
@@ -71,12 +71,15 @@ typedef struct pa_daemon_conf {
         disable_remixing,
         remixing_use_all_sink_channels,
         disable_lfe_remixing,
+        float_mixing,
         load_default_script_file,
         disallow_exit,
         log_meta,
         log_time,
         flat_volumes,
         lock_memory,
+        shm_huge_pages,
+        shm_prefault,
         deferred_volume;
     pa_server_type_t local_server_type;
     int exit_idle_time,
@@ -130,11 +133,13 @@ typedef struct pa_daemon_conf {
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
+    unsigned render_worker_threads;
     unsigned lfe_crossover_freq;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
     size_t shm_size;
+    unsigned shm_max_segments;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
@@ -1025,6 +1025,17 @@ int main(int argc, char *argv[]) {
         goto finish;
     }
 
+    c->shm_max_segments = conf->shm_max_segments;
+    if (conf->shm_max_segments > 0)
+        pa_mempool_set_max_segments(c->mempool, conf->shm_max_segments);
+
+    /* Prefault only after asking for huge pages, so that we get them */
+    if (conf->shm_huge_pages)
+        pa_mempool_set_huge_pages(c->mempool, true);
+
+    if (conf->shm_prefault)
+        pa_mempool_prefault(c->mempool);
+
     c->default_sample_spec = conf->default_sample_spec;
     c->alternate_sample_rate = conf->alternate_sample_rate;
     c->default_channel_map = conf->default_channel_map;
@@ -1038,10 +1049,12 @@ int main(int argc, char *argv[]) {
     c->resample_method = conf->resample_method;
     c->realtime_priority = conf->realtime_priority;
     c->realtime_scheduling = conf->realtime_scheduling;
+    c->render_worker_threads = conf->render_worker_threads;
     c->avoid_resampling = conf->avoid_resampling;
     c->disable_remixing = conf->disable_remixing;
     c->remixing_use_all_sink_channels = conf->remixing_use_all_sink_channels;
     c->disable_lfe_remixing = conf->disable_lfe_remixing;
+    c->float_mixing = conf->float_mixing;
     c->deferred_volume = conf->deferred_volume;
     c->running_as_daemon = conf->daemonize;
     c->disallow_exit = conf->disallow_exit;
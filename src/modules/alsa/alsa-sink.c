@@ -46,6 +46,7 @@
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/thread.h>
@@ -135,6 +136,14 @@ struct userdata {
 
     pa_memchunk memchunk;
 
+    /* The format the device is opened with. If the sink mixes in float
+     * instead, everything is converted once when written to the device,
+     * and frame_size and all byte counts refer to the sink's format. */
+    pa_sample_format_t hw_format;
+    size_t hw_frame_size;
+    pa_convert_func_t convert_from_float;
+    void *convert_buf;
+
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
 
@@ -646,17 +655,26 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
 
             /* We assume a single interleaved memory buffer */
             pa_assert((areas[0].first >> 3) == 0);
-            pa_assert((areas[0].step >> 3) == u->frame_size);
+            pa_assert((areas[0].step >> 3) == u->hw_frame_size);
 
-            p = (uint8_t*) areas[0].addr + (offset * u->frame_size);
+            p = (uint8_t*) areas[0].addr + (offset * u->hw_frame_size);
 
             written = frames * u->frame_size;
-            chunk.memblock = pa_memblock_new_fixed(u->core->mempool, p, written, true);
-            chunk.length = pa_memblock_get_length(chunk.memblock);
-            chunk.index = 0;
 
-            pa_sink_render_into_full(u->sink, &chunk);
-            pa_memblock_unref_fixed(chunk.memblock);
+            if (u->convert_from_float) {
+                /* Mix in float, then convert straight into the buffer */
+                pa_sink_render_full(u->sink, written, &chunk);
+                u->convert_from_float(frames * u->sink->sample_spec.channels, pa_memblock_acquire_chunk(&chunk), p);
+                pa_memblock_release(chunk.memblock);
+                pa_memblock_unref(chunk.memblock);
+            } else {
+                chunk.memblock = pa_memblock_new_fixed(u->core->mempool, p, written, true);
+                chunk.length = pa_memblock_get_length(chunk.memblock);
+                chunk.index = 0;
+
+                pa_sink_render_into_full(u->sink, &chunk);
+                pa_memblock_unref_fixed(chunk.memblock);
+            }
 
             if (PA_UNLIKELY((sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames)) < 0)) {
 
@@ -802,8 +820,14 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
             if (frames > (snd_pcm_sframes_t) (n_bytes/u->frame_size))
                 frames = (snd_pcm_sframes_t) (n_bytes/u->frame_size);
 
-            p = pa_memblock_acquire(u->memchunk.memblock);
-            frames = snd_pcm_writei(u->pcm_handle, (const uint8_t*) p + u->memchunk.index, (snd_pcm_uframes_t) frames);
+            p = pa_memblock_acquire_chunk(&u->memchunk);
+
+            if (u->convert_from_float) {
+                u->convert_from_float((unsigned) frames * u->sink->sample_spec.channels, p, u->convert_buf);
+                p = u->convert_buf;
+            }
+
+            frames = snd_pcm_writei(u->pcm_handle, p, (snd_pcm_uframes_t) frames);
             pa_memblock_release(u->memchunk.memblock);
 
             if (PA_UNLIKELY(frames < 0)) {
@@ -1110,6 +1134,7 @@ static int unsuspend(struct userdata *u) {
     }
 
     ss = u->sink->sample_spec;
+    ss.format = u->hw_format;
     period_size = u->fragment_size / u->frame_size;
     buffer_size = u->hwbuf_size / u->frame_size;
     b = u->use_mmap;
@@ -1125,7 +1150,9 @@ static int unsuspend(struct userdata *u) {
         goto fail;
     }
 
-    if (!pa_sample_spec_equal(&ss, &u->sink->sample_spec)) {
+    if (ss.format != u->hw_format ||
+        ss.rate != u->sink->sample_spec.rate ||
+        ss.channels != u->sink->sample_spec.channels) {
         pa_log_warn("Resume failed, couldn't restore original sample settings.");
         goto fail;
     }
@@ -2347,6 +2374,20 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     /* ALSA might tweak the sample spec, so recalculate the frame size */
     frame_size = pa_frame_size(&ss);
 
+    u->hw_format = ss.format;
+    u->hw_frame_size = frame_size;
+
+    /* Passthrough data has to reach the device untouched, so don't mix
+     * in float on devices that support it */
+    if (m->core->float_mixing && !set_formats && ss.format != PA_SAMPLE_FLOAT32NE) {
+        pa_log_info("Mixing in %s, converting to %s for the device.",
+                    pa_sample_format_to_string(PA_SAMPLE_FLOAT32NE), pa_sample_format_to_string(ss.format));
+
+        pa_assert_se(u->convert_from_float = pa_get_convert_from_float32ne_function(ss.format));
+        ss.format = PA_SAMPLE_FLOAT32NE;
+        frame_size = pa_frame_size(&ss);
+    }
+
     if (!u->ucm_context)
         find_mixer(u, mapping, pa_modargs_get_value(ma, "control", NULL), ignore_dB);
 
@@ -2443,6 +2484,8 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
 
     u->frame_size = frame_size;
     u->frames_per_block = pa_mempool_block_size_max(m->core->mempool) / frame_size;
+    if (u->convert_from_float)
+        u->convert_buf = pa_xmalloc(u->frames_per_block * u->hw_frame_size);
     u->fragment_size = frag_size = (size_t) (period_frames * frame_size);
     u->hwbuf_size = buffer_size = (size_t) (buffer_frames * frame_size);
     pa_cvolume_mute(&u->hardware_volume, u->sink->sample_spec.channels);
@@ -2618,6 +2661,7 @@ static void userdata_free(struct userdata *u) {
     reserve_done(u);
     monitor_done(u);
 
+    pa_xfree(u->convert_buf);
     pa_xfree(u->device_name);
     pa_xfree(u->control_device);
     pa_xfree(u->paths_dir);
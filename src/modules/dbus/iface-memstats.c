@@ -27,6 +27,7 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/dbus-util.h>
 #include <pulsecore/protocol-dbus.h>
+#include <pulsecore/resampler.h>
 
 #include "iface-memstats.h"
 
@@ -37,6 +38,9 @@ static void handle_get_current_memblocks_size(DBusConnection *conn, DBusMessage
 static void handle_get_accumulated_memblocks(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_get_accumulated_memblocks_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
 static void handle_get_sample_cache_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_resampler_cache_size(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_resampler_cache_hits(DBusConnection *conn, DBusMessage *msg, void *userdata);
+static void handle_get_resampler_cache_misses(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
 static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata);
 
@@ -52,6 +56,9 @@ enum property_handler_index {
     PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS,
     PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS_SIZE,
     PROPERTY_HANDLER_SAMPLE_CACHE_SIZE,
+    PROPERTY_HANDLER_RESAMPLER_CACHE_SIZE,
+    PROPERTY_HANDLER_RESAMPLER_CACHE_HITS,
+    PROPERTY_HANDLER_RESAMPLER_CACHE_MISSES,
     PROPERTY_HANDLER_MAX
 };
 
@@ -60,7 +67,10 @@ static pa_dbus_property_handler property_handlers[PROPERTY_HANDLER_MAX] = {
     [PROPERTY_HANDLER_CURRENT_MEMBLOCKS_SIZE]     = { .property_name = "CurrentMemblocksSize",     .type = "u", .get_cb = handle_get_current_memblocks_size,     .set_cb = NULL },
     [PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS]      = { .property_name = "AccumulatedMemblocks",     .type = "u", .get_cb = handle_get_accumulated_memblocks,      .set_cb = NULL },
     [PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS_SIZE] = { .property_name = "AccumulatedMemblocksSize", .type = "u", .get_cb = handle_get_accumulated_memblocks_size, .set_cb = NULL },
-    [PROPERTY_HANDLER_SAMPLE_CACHE_SIZE]          = { .property_name = "SampleCacheSize",          .type = "u", .get_cb = handle_get_sample_cache_size,          .set_cb = NULL }
+    [PROPERTY_HANDLER_SAMPLE_CACHE_SIZE]          = { .property_name = "SampleCacheSize",          .type = "u", .get_cb = handle_get_sample_cache_size,          .set_cb = NULL },
+    [PROPERTY_HANDLER_RESAMPLER_CACHE_SIZE]       = { .property_name = "ResamplerCacheSize",       .type = "u", .get_cb = handle_get_resampler_cache_size,       .set_cb = NULL },
+    [PROPERTY_HANDLER_RESAMPLER_CACHE_HITS]       = { .property_name = "ResamplerCacheHits",       .type = "u", .get_cb = handle_get_resampler_cache_hits,       .set_cb = NULL },
+    [PROPERTY_HANDLER_RESAMPLER_CACHE_MISSES]     = { .property_name = "ResamplerCacheMisses",     .type = "u", .get_cb = handle_get_resampler_cache_misses,     .set_cb = NULL }
 };
 
 static pa_dbus_interface_info memstats_interface_info = {
@@ -151,6 +161,54 @@ static void handle_get_sample_cache_size(DBusConnection *conn, DBusMessage *msg,
     pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &sample_cache_size);
 }
 
+static void handle_get_resampler_cache_size(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    pa_resampler_cache_stat stat;
+    dbus_uint32_t resampler_cache_size;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    pa_resampler_cache_get_stat(&stat);
+
+    resampler_cache_size = stat.size;
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &resampler_cache_size);
+}
+
+static void handle_get_resampler_cache_hits(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    pa_resampler_cache_stat stat;
+    dbus_uint32_t resampler_cache_hits;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    pa_resampler_cache_get_stat(&stat);
+
+    resampler_cache_hits = stat.n_hits;
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &resampler_cache_hits);
+}
+
+static void handle_get_resampler_cache_misses(DBusConnection *conn, DBusMessage *msg, void *userdata) {
+    pa_dbusiface_memstats *m = userdata;
+    pa_resampler_cache_stat stat;
+    dbus_uint32_t resampler_cache_misses;
+
+    pa_assert(conn);
+    pa_assert(msg);
+    pa_assert(m);
+
+    pa_resampler_cache_get_stat(&stat);
+
+    resampler_cache_misses = stat.n_misses;
+
+    pa_dbus_send_basic_variant_reply(conn, msg, DBUS_TYPE_UINT32, &resampler_cache_misses);
+}
+
 static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdata) {
     pa_dbusiface_memstats *m = userdata;
     const pa_mempool_stat *stat;
@@ -159,6 +217,10 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     dbus_uint32_t accumulated_memblocks;
     dbus_uint32_t accumulated_memblocks_size;
     dbus_uint32_t sample_cache_size;
+    pa_resampler_cache_stat resampler_stat;
+    dbus_uint32_t resampler_cache_size;
+    dbus_uint32_t resampler_cache_hits;
+    dbus_uint32_t resampler_cache_misses;
     DBusMessage *reply = NULL;
     DBusMessageIter msg_iter;
     DBusMessageIter dict_iter;
@@ -175,6 +237,11 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     accumulated_memblocks_size = pa_atomic_load(&stat->accumulated_size);
     sample_cache_size = pa_scache_total_size(m->core);
 
+    pa_resampler_cache_get_stat(&resampler_stat);
+    resampler_cache_size = resampler_stat.size;
+    resampler_cache_hits = resampler_stat.n_hits;
+    resampler_cache_misses = resampler_stat.n_misses;
+
     pa_assert_se((reply = dbus_message_new_method_return(msg)));
 
     dbus_message_iter_init_append(reply, &msg_iter);
@@ -185,6 +252,9 @@ static void handle_get_all(DBusConnection *conn, DBusMessage *msg, void *userdat
     pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS].property_name, DBUS_TYPE_UINT32, &accumulated_memblocks);
     pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_ACCUMULATED_MEMBLOCKS_SIZE].property_name, DBUS_TYPE_UINT32, &accumulated_memblocks_size);
     pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_SAMPLE_CACHE_SIZE].property_name, DBUS_TYPE_UINT32, &sample_cache_size);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_RESAMPLER_CACHE_SIZE].property_name, DBUS_TYPE_UINT32, &resampler_cache_size);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_RESAMPLER_CACHE_HITS].property_name, DBUS_TYPE_UINT32, &resampler_cache_hits);
+    pa_dbus_append_basic_variant_dict_entry(&dict_iter, property_handlers[PROPERTY_HANDLER_RESAMPLER_CACHE_MISSES].property_name, DBUS_TYPE_UINT32, &resampler_cache_misses);
 
     pa_assert_se(dbus_message_iter_close_container(&msg_iter, &dict_iter));
 
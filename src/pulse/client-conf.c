@@ -67,6 +67,7 @@ static const pa_client_conf default_conf = {
     .disable_shm = false,
     .disable_memfd = false,
     .shm_size = 0,
+    .srbchannel_size = 0,
     .auto_connect_localhost = false,
     .auto_connect_display = false
 };
@@ -144,6 +145,7 @@ void pa_client_conf_load(pa_client_conf *c, bool load_from_x11, bool load_from_e
         { "enable-shm",             pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "enable-memfd",           pa_config_parse_not_bool, &c->disable_memfd, NULL },
         { "shm-size-bytes",         pa_config_parse_size,     &c->shm_size, NULL },
+        { "srbchannel-size-bytes",  pa_config_parse_size,     &c->srbchannel_size, NULL },
         { "auto-connect-localhost", pa_config_parse_bool,     &c->auto_connect_localhost, NULL },
         { "auto-connect-display",   pa_config_parse_bool,     &c->auto_connect_display, NULL },
         { NULL,                     NULL,                     NULL, NULL },
@@ -39,6 +39,7 @@ typedef struct pa_client_conf {
     char *cookie_file_from_client_conf;
     bool autospawn, disable_shm, disable_memfd, auto_connect_localhost, auto_connect_display;
     size_t shm_size;
+    size_t srbchannel_size;
 } pa_client_conf;
 
 /* Create a new configuration data object and reset it to defaults */
@@ -192,6 +192,8 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
         }
     }
 
+    pa_mempool_set_grow_mainloop(c->mempool, mainloop);
+
     return c;
 }
 
@@ -259,8 +261,10 @@ static void context_free(pa_context *c) {
     if (c->playback_streams)
         pa_hashmap_free(c->playback_streams);
 
-    if (c->mempool)
+    if (c->mempool) {
+        pa_mempool_set_grow_mainloop(c->mempool, NULL);
         pa_mempool_unref(c->mempool);
+    }
 
     if (c->conf)
         pa_client_conf_free(c->conf);
@@ -546,6 +550,8 @@ static void setup_complete_callback(pa_pdispatch *pd, uint32_t command, uint32_t
                     const char *reason;
 
                     pa_pstream_enable_memfd(c->pstream);
+                    if (c->version >= 33)
+                        pa_pstream_enable_memfd_shmid_ack(c->pstream);
                     if (pa_mempool_is_memfd_backed(c->mempool))
                         if (pa_pstream_register_memfd_mempool(c->pstream, c->mempool, &reason))
                             pa_log("Failed to regester memfd mempool. Reason: %s", reason);
@@ -595,6 +601,19 @@ finish:
     pa_context_unref(c);
 }
 
+/* The log2 of the srbchannel ringbuffer size to ask for, placed in the
+ * version tag. Sizes are rounded up to the next power of two. */
+static uint32_t srbchannel_size_flag(size_t size) {
+    unsigned l;
+
+    if (size == 0)
+        return 0;
+
+    l = pa_ulog2(pa_make_power_of_two((unsigned) PA_MIN(size, (size_t) 1 << 30)));
+
+    return ((uint32_t) l << PA_PROTOCOL_FLAG_SRBCHANNEL_SIZE_SHIFT) & PA_PROTOCOL_FLAG_SRBCHANNEL_SIZE_MASK;
+}
+
 static void setup_context(pa_context *c, pa_iochannel *io) {
     uint8_t cookie[PA_NATIVE_COOKIE_LENGTH];
     pa_tagstruct *t;
@@ -628,9 +647,11 @@ static void setup_context(pa_context *c, pa_iochannel *io) {
 
     /* Starting with protocol version 13 we use the MSB of the version
      * tag for informing the other side if we could do SHM or not.
-     * Starting from version 31, second MSB is used to flag memfd support. */
+     * Starting from version 31, second MSB is used to flag memfd support.
+     * Starting from version 33, bits 16-20 ask for a srbchannel size. */
     pa_tagstruct_putu32(t, PA_PROTOCOL_VERSION | (c->do_shm ? PA_PROTOCOL_FLAG_SHM : 0) |
-                        (c->memfd_on_local ? PA_PROTOCOL_FLAG_MEMFD: 0));
+                        (c->memfd_on_local ? PA_PROTOCOL_FLAG_MEMFD: 0) |
+                        srbchannel_size_flag(c->conf->srbchannel_size));
     pa_tagstruct_put_arbitrary(t, cookie, sizeof(cookie));
 
 #ifdef HAVE_CREDS
@@ -1547,7 +1568,7 @@ static void pa_command_register_memfd_shmid(pa_pdispatch *pd, uint32_t command,
     pa_assert(c);
     pa_assert(PA_REFCNT_VALUE(c) >= 1);
 
-    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, t))
+    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, tag, t))
         pa_context_fail(c, PA_ERR_PROTOCOL);
 }
 
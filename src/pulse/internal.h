@@ -55,6 +55,10 @@
 #define PA_PROTOCOL_FLAG_SHM 0x80000000U
 #define PA_PROTOCOL_FLAG_MEMFD 0x40000000U
 
+/* The log2 of the srbchannel ringbuffer size a client asks for, or 0 */
+#define PA_PROTOCOL_FLAG_SRBCHANNEL_SIZE_MASK 0x001F0000U
+#define PA_PROTOCOL_FLAG_SRBCHANNEL_SIZE_SHIFT 16
+
 struct pa_context {
     PA_REFCNT_DECLARE;
 
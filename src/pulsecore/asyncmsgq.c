@@ -92,7 +92,7 @@ static void asyncmsgq_free(pa_asyncmsgq *a) {
         if (i->free_cb)
             i->free_cb(i->userdata);
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
+        if (PA_STATIC_FLIST_PUSH(asyncmsgq, i) < 0)
             pa_xfree(i);
     }
 
@@ -119,7 +119,7 @@ void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const vo
     struct asyncmsgq_item *i;
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(asyncmsgq))))
+    if (!(i = PA_STATIC_FLIST_POP(asyncmsgq)))
         i = pa_xnew(struct asyncmsgq_item, 1);
 
     i->code = code;
@@ -157,7 +157,7 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
     } else
         pa_memchunk_reset(&i.memchunk);
 
-    if (!(i.semaphore = pa_flist_pop(PA_STATIC_FLIST_GET(semaphores))))
+    if (!(i.semaphore = PA_STATIC_FLIST_POP(semaphores)))
         i.semaphore = pa_semaphore_new(0);
 
     /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
@@ -167,7 +167,7 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
 
     pa_semaphore_wait(i.semaphore);
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(semaphores), i.semaphore) < 0)
+    if (PA_STATIC_FLIST_PUSH(semaphores, i.semaphore) < 0)
         pa_semaphore_free(i.semaphore);
 
     return i.ret;
@@ -227,7 +227,7 @@ void pa_asyncmsgq_done(pa_asyncmsgq *a, int ret) {
         if (a->current->memchunk.memblock)
             pa_memblock_unref(a->current->memchunk.memblock);
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), a->current) < 0)
+        if (PA_STATIC_FLIST_PUSH(asyncmsgq, a->current) < 0)
             pa_xfree(a->current);
     }
 
@@ -56,6 +56,7 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/modinfo.h>
 #include <pulsecore/dynarray.h>
+#include <pulsecore/resampler.h>
 
 #include "cli-command.h"
 
@@ -343,6 +344,7 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
     char cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     char bytes[PA_BYTES_SNPRINT_MAX];
     const pa_mempool_stat *mstat;
+    pa_resampler_cache_stat rstat;
     unsigned k;
 
     static const char* const type_table[PA_MEMBLOCK_TYPE_MAX] = {
@@ -380,6 +382,13 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
+    pa_resampler_cache_get_stat(&rstat);
+
+    pa_strbuf_printf(buf, "Resampler filter tables currently cached: %u, size: %s, %u unused, %u hits/%u misses.\n",
+                     rstat.n_entries,
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) rstat.size),
+                     rstat.n_unused, rstat.n_hits, rstat.n_misses);
+
     pa_strbuf_printf(buf, "Default sample spec: %s\n",
                      pa_sample_spec_snprint(ss, sizeof(ss), &c->default_sample_spec));
 
@@ -398,6 +407,28 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
                          (unsigned) pa_atomic_load(&mstat->n_allocated_by_type[k]),
                          (unsigned) pa_atomic_load(&mstat->n_accumulated_by_type[k]));
 
+    for (k = 0; k < PA_MEMPOOL_CLASSES_MAX; k++) {
+        size_t slot_size;
+        unsigned n_slots;
+
+        if (pa_mempool_get_class(c->mempool, k, &slot_size, &n_slots) < 0)
+            break;
+
+        pa_strbuf_printf(buf,
+                         "Memory pool slots of size %s: %u allocated/%u accumulated of %u, %u times full.\n",
+                         pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) slot_size),
+                         (unsigned) pa_atomic_load(&mstat->n_allocated_by_class[k]),
+                         (unsigned) pa_atomic_load(&mstat->n_accumulated_by_class[k]),
+                         n_slots,
+                         (unsigned) pa_atomic_load(&mstat->n_class_full[k]));
+    }
+
+    pa_strbuf_printf(buf, "Memory pool segments: %u (huge pages requested for %u), %u times full, %u blocks allocated outside the pool.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_segments),
+                     (unsigned) pa_atomic_load(&mstat->n_huge_pages_requested),
+                     (unsigned) pa_atomic_load(&mstat->n_pool_full),
+                     (unsigned) pa_atomic_load(&mstat->n_malloc_fallback));
+
     return 0;
 }
 
@@ -36,6 +36,7 @@
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -127,6 +128,8 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     c->mempool = pool;
     c->shm_size = shm_size;
+    c->shm_max_segments = 0;
+    pa_mempool_set_grow_mainloop(c->mempool, m);
     pa_silence_cache_init(&c->silence_cache);
 
     c->exit_event = NULL;
@@ -141,11 +144,14 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->running_as_daemon = false;
     c->realtime_scheduling = false;
     c->realtime_priority = 5;
+    c->render_worker_threads = 0;
+    c->render_workers = NULL;
     c->disable_remixing = false;
     c->remixing_use_all_sink_channels = true;
     c->disable_lfe_remixing = true;
     c->lfe_crossover_freq = 0;
     c->deferred_volume = true;
+    c->float_mixing = false;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
@@ -217,7 +223,12 @@ static void core_free(pa_object *o) {
     pa_xfree(c->configured_default_source);
     pa_xfree(c->configured_default_sink);
 
+    if (c->render_workers)
+        pa_worker_pool_free(c->render_workers);
+
     pa_silence_cache_done(&c->silence_cache);
+    pa_resampler_cache_flush();
+    pa_mempool_set_grow_mainloop(c->mempool, NULL);
     pa_mempool_unref(c->mempool);
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
@@ -459,6 +470,23 @@ int pa_core_exit(pa_core *c, bool force, int retval) {
     return 0;
 }
 
+pa_worker_pool *pa_core_get_render_workers(pa_core *c) {
+    pa_assert(c);
+
+    if (c->render_worker_threads <= 0)
+        return NULL;
+
+    /* Don't try again for every new sink if this failed once */
+    if (!c->render_workers &&
+        !(c->render_workers = pa_worker_pool_new("render-worker", c->render_worker_threads,
+                                                 c->realtime_scheduling, c->realtime_priority))) {
+        pa_log_warn("Failed to start render workers, sinks will peek their inputs by themselves.");
+        c->render_worker_threads = 0;
+    }
+
+    return c->render_workers;
+}
+
 void pa_core_maybe_vacuum(pa_core *c) {
     pa_assert(c);
 
@@ -53,6 +53,7 @@ typedef enum pa_suspend_cause {
 #include <pulsecore/source.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/msgobject.h>
+#include <pulsecore/worker-pool.h>
 
 typedef enum pa_server_type {
     PA_SERVER_TYPE_UNSET,
@@ -205,6 +206,10 @@ struct pa_core {
      * or PA daemon defaults (~ 64 MiB). */
     size_t shm_size;
 
+    /* How many segments the daemon's pools may grow to, 0 for the
+     * default. Applies to the per-client pools as well. */
+    unsigned shm_max_segments;
+
     pa_silence_cache silence_cache;
 
     pa_time_event *exit_event;
@@ -222,10 +227,16 @@ struct pa_core {
     bool remixing_use_all_sink_channels:1;
     bool disable_lfe_remixing:1;
     bool deferred_volume:1;
+    bool float_mixing:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
 
+    /* Helper threads shared by all sinks for preparing their inputs,
+     * created on first use. See pa_core_get_render_workers(). */
+    unsigned render_worker_threads;
+    pa_worker_pool *render_workers;
+
     pa_server_type_t server_type;
     pa_cpu_info cpu_info;
 
@@ -265,6 +276,9 @@ int pa_core_exit(pa_core *c, bool force, int retval);
 
 void pa_core_maybe_vacuum(pa_core *c);
 
+/* Returns NULL if render_worker_threads is 0 */
+pa_worker_pool *pa_core_get_render_workers(pa_core *c);
+
 /* wrapper for c->mainloop->time_*() RT time events */
 pa_time_event* pa_core_rttime_new(pa_core *c, pa_usec_t usec, pa_time_event_cb_t cb, void *userdata);
 void pa_core_rttime_restart(pa_core *c, pa_time_event *e, pa_usec_t usec);
@@ -32,6 +32,21 @@
 
 #include "cpu-x86.h"
 
+#if (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H)
+/* Check that the OS saves and restores the SSE and AVX register state */
+static bool os_supports_avx(void) {
+    uint32_t eax, edx;
+
+    __asm__ __volatile__ (
+        " xgetbv                        \n\t"
+        : "=a" (eax), "=d" (edx)
+        : "c" (0)
+    );
+
+    return (eax & 0x6) == 0x6;
+}
+#endif
+
 void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
 #if (defined(__i386__) || defined(__amd64__)) && defined(HAVE_CPUID_H)
     uint32_t eax, ebx, ecx, edx;
@@ -70,6 +85,17 @@ void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
 
         if (ecx & (1<<20))
           *flags |= PA_CPU_X86_SSE4_2;
+
+        /* OSXSAVE and AVX */
+        if ((ecx & (1<<27)) && (ecx & (1<<28)) && os_supports_avx())
+          *flags |= PA_CPU_X86_AVX;
+    }
+
+    if (level >= 7 && (*flags & PA_CPU_X86_AVX)) {
+        __cpuid_count(0x00000007, 0, eax, ebx, ecx, edx);
+
+        if (ebx & (1<<5))
+          *flags |= PA_CPU_X86_AVX2;
     }
 
     /* get extended level */
@@ -94,7 +120,7 @@ void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags) {
     }
 
 finish:
-    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s",
+    pa_log_info("CPU flags: %s%s%s%s%s%s%s%s%s%s%s%s%s",
     (*flags & PA_CPU_X86_CMOV) ? "CMOV " : "",
     (*flags & PA_CPU_X86_MMX) ? "MMX " : "",
     (*flags & PA_CPU_X86_SSE) ? "SSE " : "",
@@ -103,6 +129,8 @@ finish:
     (*flags & PA_CPU_X86_SSSE3) ? "SSSE3 " : "",
     (*flags & PA_CPU_X86_SSE4_1) ? "SSE4_1 " : "",
     (*flags & PA_CPU_X86_SSE4_2) ? "SSE4_2 " : "",
+    (*flags & PA_CPU_X86_AVX) ? "AVX " : "",
+    (*flags & PA_CPU_X86_AVX2) ? "AVX2 " : "",
     (*flags & PA_CPU_X86_MMXEXT) ? "MMXEXT " : "",
     (*flags & PA_CPU_X86_3DNOW) ? "3DNOW " : "",
     (*flags & PA_CPU_X86_3DNOWEXT) ? "3DNOWEXT " : "");
@@ -123,6 +151,17 @@ bool pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
         pa_volume_func_init_sse(*flags);
         pa_remap_func_init_sse(*flags);
         pa_convert_func_init_sse(*flags);
+        pa_mix_func_init_sse(*flags);
+        pa_polyphase_func_init_sse(*flags);
+    }
+
+    if (*flags & PA_CPU_X86_AVX)
+        pa_polyphase_func_init_avx(*flags);
+
+    if (*flags & PA_CPU_X86_AVX2) {
+        pa_volume_func_init_avx2(*flags);
+        pa_remap_func_init_avx2(*flags);
+        pa_mix_func_init_avx2(*flags);
     }
 
     return true;
@@ -35,7 +35,9 @@ typedef enum pa_cpu_x86_flag {
     PA_CPU_X86_SSE4_2    = (1 << 7),
     PA_CPU_X86_3DNOW     = (1 << 8),
     PA_CPU_X86_3DNOWEXT  = (1 << 9),
-    PA_CPU_X86_CMOV      = (1 << 10)
+    PA_CPU_X86_CMOV      = (1 << 10),
+    PA_CPU_X86_AVX       = (1 << 11),
+    PA_CPU_X86_AVX2      = (1 << 12)
 } pa_cpu_x86_flag_t;
 
 void pa_cpu_get_x86_flags(pa_cpu_x86_flag_t *flags);
@@ -50,10 +52,18 @@ typedef int64_t pa_reg_x86;
 /* some optimized functions */
 void pa_volume_func_init_mmx(pa_cpu_x86_flag_t flags);
 void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_volume_func_init_avx2(pa_cpu_x86_flag_t flags);
 
 void pa_remap_func_init_mmx(pa_cpu_x86_flag_t flags);
 void pa_remap_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_remap_func_init_avx2(pa_cpu_x86_flag_t flags);
 
 void pa_convert_func_init_sse (pa_cpu_x86_flag_t flags);
 
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_mix_func_init_avx2(pa_cpu_x86_flag_t flags);
+
+void pa_polyphase_func_init_sse(pa_cpu_x86_flag_t flags);
+void pa_polyphase_func_init_avx(pa_cpu_x86_flag_t flags);
+
 #endif /* foocpux86hfoo */
@@ -33,6 +33,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/core-error.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #ifndef HAVE_PIPE
@@ -43,8 +44,23 @@
 #include <sys/eventfd.h>
 #endif
 
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+#include <linux/futex.h>
+#define USE_FUTEX
+#endif
+
 #include "fdsem.h"
 
+#ifdef USE_FUTEX
+/* How long pa_fdsem_wait() looks out for a signal before going to sleep,
+ * when the signalling thread can run on another CPU meanwhile. That is
+ * about what a futex sleep and wakeup costs. */
+#define SPIN_USEC 10
+
+/* The clock is read only every this many polls */
+#define SPIN_CLOCK_POLLS 16
+#endif
+
 struct pa_fdsem {
     int fds[2];
 #ifdef HAVE_SYS_EVENTFD_H
@@ -52,8 +68,57 @@ struct pa_fdsem {
 #endif
     int write_type;
     pa_fdsem_data *data;
+
+#ifdef USE_FUTEX
+    /* Only used for in-process semaphores: threads sleeping in
+     * pa_fdsem_wait() on a futex rather than in poll() on the fd */
+    bool use_futex;
+    bool spin;
+    pa_atomic_t futex_waiting;
+#endif
 };
 
+#ifdef USE_FUTEX
+static void futex_wait(pa_atomic_t *a, int value) {
+    /* Spurious wakeups and EAGAIN are fine, callers loop anyway */
+    syscall(SYS_futex, &a->value, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(pa_atomic_t *a) {
+    syscall(SYS_futex, &a->value, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/* Tells the CPU that this is a busy wait, so that it can save power and
+ * leave resources to a sibling hyperthread */
+static inline void cpu_relax(void) {
+#if defined(__i386__) || defined(__amd64__)
+    __asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 7)
+    __asm__ __volatile__ ("yield" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+/* Returns true if the semaphore was signalled within SPIN_USEC */
+static bool spin_wait(pa_fdsem *f) {
+    pa_usec_t deadline = pa_rtclock_now() + SPIN_USEC;
+    unsigned i;
+
+    for (;;) {
+        for (i = 0; i < SPIN_CLOCK_POLLS; i++) {
+            if (pa_atomic_load(&f->data->signalled) && pa_atomic_cmpxchg(&f->data->signalled, 1, 0))
+                return true;
+
+            cpu_relax();
+        }
+
+        if (pa_rtclock_now() >= deadline)
+            return false;
+    }
+}
+#endif
+
 pa_fdsem *pa_fdsem_new(void) {
     pa_fdsem *f;
 
@@ -77,6 +142,15 @@ pa_fdsem *pa_fdsem_new(void) {
     pa_atomic_store(&f->data->signalled, 0);
     pa_atomic_store(&f->data->in_pipe, 0);
 
+#ifdef USE_FUTEX
+    /* The data is private to this process, so threads that block in
+     * pa_fdsem_wait() can sleep on it directly. The fd stays around for
+     * those that need something to poll() on. */
+    f->use_futex = true;
+    f->spin = pa_ncpus() > 1;
+    pa_atomic_store(&f->futex_waiting, 0);
+#endif
+
     return f;
 }
 
@@ -181,6 +255,11 @@ void pa_fdsem_post(pa_fdsem *f) {
 
     if (pa_atomic_cmpxchg(&f->data->signalled, 0, 1)) {
 
+#ifdef USE_FUTEX
+        if (f->use_futex && pa_atomic_load(&f->futex_waiting))
+            futex_wake(&f->data->signalled);
+#endif
+
         if (pa_atomic_load(&f->data->waiting)) {
             ssize_t r;
             char x = 'x';
@@ -227,6 +306,23 @@ void pa_fdsem_wait(pa_fdsem *f) {
     if (pa_atomic_cmpxchg(&f->data->signalled, 1, 0))
         return;
 
+#ifdef USE_FUTEX
+    if (f->use_futex) {
+        /* The other side is often just about to signal us. On a single
+         * CPU it can't do that while we spin. */
+        if (f->spin && spin_wait(f))
+            return;
+
+        pa_atomic_inc(&f->futex_waiting);
+
+        while (!pa_atomic_cmpxchg(&f->data->signalled, 1, 0))
+            futex_wait(&f->data->signalled, 0);
+
+        pa_assert_se(pa_atomic_dec(&f->futex_waiting) >= 1);
+        return;
+    }
+#endif
+
     pa_atomic_inc(&f->data->waiting);
 
     while (!pa_atomic_cmpxchg(&f->data->signalled, 1, 0)) {
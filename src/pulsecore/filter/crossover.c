@@ -7,37 +7,71 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulsecore/macro.h>
 
 #include "crossover.h"
 
-void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq)
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void lr4_bank_init(struct lr4_bank *bank, unsigned channels)
 {
-	biquad_set(&lr4->bq, type, freq);
-	lr4->x1 = 0;
-	lr4->x2 = 0;
-	lr4->y1 = 0;
-	lr4->y2 = 0;
-	lr4->z1 = 0;
-	lr4->z2 = 0;
+	unsigned i;
+
+	pa_assert(channels > 0 && channels <= PA_CHANNELS_MAX);
+
+	memset(bank, 0, sizeof(*bank));
+	bank->channels = (int) channels;
+
+	for (i = 0; i < channels; i++)
+		bank->b0[i] = 1;
 }
 
-void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest)
+void lr4_bank_set(struct lr4_bank *bank, int channel, enum biquad_type type, float freq)
 {
-	float lx1 = lr4->x1;
-	float lx2 = lr4->x2;
-	float ly1 = lr4->y1;
-	float ly2 = lr4->y2;
-	float lz1 = lr4->z1;
-	float lz2 = lr4->z2;
-	float lb0 = lr4->bq.b0;
-	float lb1 = lr4->bq.b1;
-	float lb2 = lr4->bq.b2;
-	float la1 = lr4->bq.a1;
-	float la2 = lr4->bq.a2;
+	struct lr4_state *s = &bank->state;
+	struct biquad bq;
+
+	pa_assert(channel >= 0 && channel < bank->channels);
+
+	biquad_set(&bq, type, freq);
+	bank->b0[channel] = bq.b0;
+	bank->b1[channel] = bq.b1;
+	bank->b2[channel] = bq.b2;
+	bank->a1[channel] = bq.a1;
+	bank->a2[channel] = bq.a2;
+
+	s->x1[channel] = 0;
+	s->x2[channel] = 0;
+	s->y1[channel] = 0;
+	s->y2[channel] = 0;
+	s->z1[channel] = 0;
+	s->z2[channel] = 0;
+}
+
+/* Filters a single channel c. This is the plain implementation, which
+ * takes care of the channels that don't fill a vector. */
+static void process_channel_float32(struct lr4_bank *bank, int c, int samples, float *src, float *dest)
+{
+	struct lr4_state *s = &bank->state;
+	int channels = bank->channels;
+	float lx1 = s->x1[c];
+	float lx2 = s->x2[c];
+	float ly1 = s->y1[c];
+	float ly2 = s->y2[c];
+	float lz1 = s->z1[c];
+	float lz2 = s->z2[c];
+	float lb0 = bank->b0[c];
+	float lb1 = bank->b1[c];
+	float lb2 = bank->b2[c];
+	float la1 = bank->a1[c];
+	float la2 = bank->a2[c];
 
 	int i;
-	for (i = 0; i < samples * channels; i += channels) {
+	for (i = c; i < samples * channels; i += channels) {
 		float x, y, z;
 		x = src[i];
 		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
@@ -51,30 +85,32 @@ void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src,
 		dest[i] = z;
 	}
 
-	lr4->x1 = lx1;
-	lr4->x2 = lx2;
-	lr4->y1 = ly1;
-	lr4->y2 = ly2;
-	lr4->z1 = lz1;
-	lr4->z2 = lz2;
+	s->x1[c] = lx1;
+	s->x2[c] = lx2;
+	s->y1[c] = ly1;
+	s->y2[c] = ly2;
+	s->z1[c] = lz1;
+	s->z2[c] = lz2;
 }
 
-void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest)
+static void process_channel_s16(struct lr4_bank *bank, int c, int samples, short *src, short *dest)
 {
-	float lx1 = lr4->x1;
-	float lx2 = lr4->x2;
-	float ly1 = lr4->y1;
-	float ly2 = lr4->y2;
-	float lz1 = lr4->z1;
-	float lz2 = lr4->z2;
-	float lb0 = lr4->bq.b0;
-	float lb1 = lr4->bq.b1;
-	float lb2 = lr4->bq.b2;
-	float la1 = lr4->bq.a1;
-	float la2 = lr4->bq.a2;
+	struct lr4_state *s = &bank->state;
+	int channels = bank->channels;
+	float lx1 = s->x1[c];
+	float lx2 = s->x2[c];
+	float ly1 = s->y1[c];
+	float ly2 = s->y2[c];
+	float lz1 = s->z1[c];
+	float lz2 = s->z2[c];
+	float lb0 = bank->b0[c];
+	float lb1 = bank->b1[c];
+	float lb2 = bank->b2[c];
+	float la1 = bank->a1[c];
+	float la2 = bank->a2[c];
 
 	int i;
-	for (i = 0; i < samples * channels; i += channels) {
+	for (i = c; i < samples * channels; i += channels) {
 		float x, y, z;
 		x = src[i];
 		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
@@ -88,10 +124,139 @@ void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, sho
 		dest[i] = PA_CLAMP_UNLIKELY((int) z, -0x8000, 0x7fff);
 	}
 
-	lr4->x1 = lx1;
-	lr4->x2 = lx2;
-	lr4->y1 = ly1;
-	lr4->y2 = ly2;
-	lr4->z1 = lz1;
-	lr4->z2 = lz2;
+	s->x1[c] = lx1;
+	s->x2[c] = lx2;
+	s->y1[c] = ly1;
+	s->y2[c] = ly2;
+	s->z1[c] = lz1;
+	s->z2[c] = lz2;
+}
+
+#ifdef __SSE2__
+/* SSE2 is always there on x86-64, so no run time check is needed. The
+ * channels c to c + 3 are filtered together, with the same operations in
+ * the same order as the plain implementation. */
+#define LANES 4
+
+struct lanes {
+	__m128 x1, x2, y1, y2, z1, z2;
+	__m128 b0, b1, b2, a1, a2;
+};
+
+static inline void load_lanes(struct lr4_bank *bank, int c, struct lanes *l)
+{
+	struct lr4_state *s = &bank->state;
+
+	l->x1 = _mm_loadu_ps(s->x1 + c);
+	l->x2 = _mm_loadu_ps(s->x2 + c);
+	l->y1 = _mm_loadu_ps(s->y1 + c);
+	l->y2 = _mm_loadu_ps(s->y2 + c);
+	l->z1 = _mm_loadu_ps(s->z1 + c);
+	l->z2 = _mm_loadu_ps(s->z2 + c);
+	l->b0 = _mm_loadu_ps(bank->b0 + c);
+	l->b1 = _mm_loadu_ps(bank->b1 + c);
+	l->b2 = _mm_loadu_ps(bank->b2 + c);
+	l->a1 = _mm_loadu_ps(bank->a1 + c);
+	l->a2 = _mm_loadu_ps(bank->a2 + c);
+}
+
+static inline void store_lanes(struct lr4_bank *bank, int c, const struct lanes *l)
+{
+	struct lr4_state *s = &bank->state;
+
+	_mm_storeu_ps(s->x1 + c, l->x1);
+	_mm_storeu_ps(s->x2 + c, l->x2);
+	_mm_storeu_ps(s->y1 + c, l->y1);
+	_mm_storeu_ps(s->y2 + c, l->y2);
+	_mm_storeu_ps(s->z1 + c, l->z1);
+	_mm_storeu_ps(s->z2 + c, l->z2);
+}
+
+static inline __m128 biquad_lanes(const struct lanes *l, __m128 x, __m128 x1, __m128 x2, __m128 y1, __m128 y2)
+{
+	__m128 y;
+
+	y = _mm_add_ps(_mm_mul_ps(l->b0, x), _mm_mul_ps(l->b1, x1));
+	y = _mm_add_ps(y, _mm_mul_ps(l->b2, x2));
+	y = _mm_sub_ps(y, _mm_mul_ps(l->a1, y1));
+	return _mm_sub_ps(y, _mm_mul_ps(l->a2, y2));
+}
+
+static inline __m128 lr4_lanes(struct lanes *l, __m128 x)
+{
+	__m128 y, z;
+
+	y = biquad_lanes(l, x, l->x1, l->x2, l->y1, l->y2);
+	z = biquad_lanes(l, y, l->y1, l->y2, l->z1, l->z2);
+	l->x2 = l->x1;
+	l->x1 = x;
+	l->y2 = l->y1;
+	l->y1 = y;
+	l->z2 = l->z1;
+	l->z1 = z;
+
+	return z;
+}
+
+static void process_lanes_float32(struct lr4_bank *bank, int c, int samples, float *src, float *dest)
+{
+	int channels = bank->channels;
+	struct lanes l;
+	int i;
+
+	load_lanes(bank, c, &l);
+
+	for (i = c; i < samples * channels; i += channels)
+		_mm_storeu_ps(dest + i, lr4_lanes(&l, _mm_loadu_ps(src + i)));
+
+	store_lanes(bank, c, &l);
+}
+
+static void process_lanes_s16(struct lr4_bank *bank, int c, int samples, short *src, short *dest)
+{
+	int channels = bank->channels;
+	struct lanes l;
+	int i;
+
+	load_lanes(bank, c, &l);
+
+	for (i = c; i < samples * channels; i += channels) {
+		__m128i v = _mm_loadl_epi64((const __m128i *) (src + i));
+		__m128 z;
+
+		z = lr4_lanes(&l, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)));
+
+		/* Truncate like the cast, then saturate */
+		v = _mm_cvttps_epi32(z);
+		_mm_storel_epi64((__m128i *) (dest + i), _mm_packs_epi32(v, v));
+	}
+
+	store_lanes(bank, c, &l);
+}
+#endif /* __SSE2__ */
+
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, float *src, float *dest)
+{
+	int c = 0;
+
+#ifdef LANES
+	for (; c + LANES <= bank->channels; c += LANES)
+		process_lanes_float32(bank, c, samples, src, dest);
+#endif
+
+	for (; c < bank->channels; c++)
+		process_channel_float32(bank, c, samples, src, dest);
+}
+
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, short *src, short *dest)
+{
+	int c = 0;
+
+#ifdef LANES
+	for (; c + LANES <= bank->channels; c += LANES)
+		process_lanes_s16(bank, c, samples, src, dest);
+#endif
+
+	for (; c < bank->channels; c++)
+		process_channel_s16(bank, c, samples, src, dest);
 }
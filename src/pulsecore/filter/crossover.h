@@ -6,6 +6,8 @@
 #ifndef CROSSOVER_H_
 #define CROSSOVER_H_
 
+#include <pulse/sample.h>
+
 #include "biquad.h"
 /* An LR4 filter is two biquads with the same parameters connected in series:
  *
@@ -13,17 +15,31 @@
  *
  * Both biquad filter has the same parameter b[012] and a[12],
  * The variable [xyz][12] keep the history values.
+ *
+ * A bank holds one LR4 filter per channel of interleaved audio. The
+ * parameters and history values are stored as arrays over the channels,
+ * so that several channels can be filtered at once, one per vector lane.
  */
-struct lr4 {
-	struct biquad bq;
-	float x1, x2;
-	float y1, y2;
-	float z1, z2;
+struct lr4_state {
+	float x1[PA_CHANNELS_MAX], x2[PA_CHANNELS_MAX];
+	float y1[PA_CHANNELS_MAX], y2[PA_CHANNELS_MAX];
+	float z1[PA_CHANNELS_MAX], z2[PA_CHANNELS_MAX];
 };
 
-void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq);
+struct lr4_bank {
+	int channels;
+	float b0[PA_CHANNELS_MAX], b1[PA_CHANNELS_MAX], b2[PA_CHANNELS_MAX];
+	float a1[PA_CHANNELS_MAX], a2[PA_CHANNELS_MAX];
+	struct lr4_state state;
+};
+
+/* Sets up a bank for the given number of channels, with all filters
+ * letting everything through, and clears the history. */
+void lr4_bank_init(struct lr4_bank *bank, unsigned channels);
+
+void lr4_bank_set(struct lr4_bank *bank, int channel, enum biquad_type type, float freq);
 
-void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest);
-void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest);
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, float *src, float *dest);
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, short *src, short *dest);
 
 #endif /* CROSSOVER_H_ */
@@ -23,20 +23,24 @@
 
 #include "lfe-filter.h"
 #include <pulse/xmalloc.h>
-#include <pulsecore/flist.h>
-#include <pulsecore/llist.h>
 #include <pulsecore/filter/biquad.h>
 #include <pulsecore/filter/crossover.h>
 
-struct saved_state {
-    PA_LLIST_FIELDS(struct saved_state);
-    pa_memchunk chunk;
+/* For rewinding, the filter state is saved into a ring of snapshots, at
+   most every snapshot_spacing frames, and the unfiltered input is kept in
+   a ring buffer. A rewind goes back to the closest snapshot before the new
+   position and filters the input from there again. The spacing is chosen
+   so that the snapshots cover maxrewind. */
+#define SNAPSHOTS 32
+
+/* Fast forwarding is done in pieces of this many frames */
+#define FORWARD_FRAMES 1024
+
+struct snapshot {
     int64_t index;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_state state;
 };
 
-PA_STATIC_FLIST_DECLARE(lfe_state, 0, pa_xfree);
-
 /* An LR4 filter, implemented as a chain of two Butterworth filters.
 
    Currently the channel map is fixed so that a highpass filter is applied to all
@@ -47,21 +51,26 @@ PA_STATIC_FLIST_DECLARE(lfe_state, 0, pa_xfree);
 
 struct pa_lfe_filter {
     int64_t index;
-    PA_LLIST_HEAD(struct saved_state, saved);
     float crossover;
     pa_channel_map cm;
     pa_sample_spec ss;
     size_t maxrewind;
     bool active;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_bank lr4;
+
+    /* Oldest first, starting at first_snapshot, wrapping around */
+    struct snapshot snapshots[SNAPSHOTS];
+    unsigned first_snapshot, n_snapshots;
+    int64_t snapshot_spacing;
+
+    /* Frame i of the input is at i % history_frames. Frames from
+       history_start up to index are valid, which after a rewind can be
+       less than history_frames */
+    uint8_t *history;
+    size_t history_frames;
+    int64_t history_start;
 };
 
-static void remove_state(pa_lfe_filter_t *f, struct saved_state *s) {
-    PA_LLIST_REMOVE(struct saved_state, f->saved, s);
-    pa_memblock_unref(s->chunk.memblock);
-    pa_xfree(s);
-}
-
 pa_lfe_filter_t * pa_lfe_filter_new(const pa_sample_spec* ss, const pa_channel_map* cm, float crossover_freq, size_t maxrewind) {
 
     pa_lfe_filter_t *f = pa_xnew0(struct pa_lfe_filter, 1);
@@ -69,14 +78,13 @@ pa_lfe_filter_t * pa_lfe_filter_new(const pa_sample_spec* ss, const pa_channel_m
     f->cm = *cm;
     f->ss = *ss;
     f->maxrewind = maxrewind;
+    f->snapshot_spacing = maxrewind / (SNAPSHOTS - 2);
     pa_lfe_filter_update_rate(f, ss->rate);
     return f;
 }
 
 void pa_lfe_filter_free(pa_lfe_filter_t *f) {
-    while (f->saved)
-        remove_state(f, f->saved);
-
+    pa_xfree(f->history);
     pa_xfree(f);
 }
 
@@ -84,64 +92,103 @@ void pa_lfe_filter_reset(pa_lfe_filter_t *f) {
     pa_lfe_filter_update_rate(f, f->ss.rate);
 }
 
-static void process_block(pa_lfe_filter_t *f, pa_memchunk *buf, bool store_result) {
-    int samples = buf->length / pa_frame_size(&f->ss);
+static void process_block(pa_lfe_filter_t *f, void *data, size_t samples) {
+    if (f->ss.format == PA_SAMPLE_FLOAT32NE)
+        lr4_bank_process_float32(&f->lr4, samples, data, data);
+    else if (f->ss.format == PA_SAMPLE_S16NE)
+        lr4_bank_process_s16(&f->lr4, samples, data, data);
+    else pa_assert_not_reached();
 
-    void *garbage = store_result ? NULL : pa_xmalloc(buf->length);
+    f->index += samples;
+}
 
-    if (f->ss.format == PA_SAMPLE_FLOAT32NE) {
-        int i;
-        float *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_float32(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
-        pa_memblock_release(buf->memblock);
+static struct snapshot *newest_snapshot(pa_lfe_filter_t *f) {
+    if (!f->n_snapshots)
+        return NULL;
+
+    return &f->snapshots[(f->first_snapshot + f->n_snapshots - 1) % SNAPSHOTS];
+}
+
+static void save_snapshot(pa_lfe_filter_t *f) {
+    struct snapshot *s;
+
+    /* Overwrite the oldest one when full */
+    if (f->n_snapshots == SNAPSHOTS) {
+        f->first_snapshot = (f->first_snapshot + 1) % SNAPSHOTS;
+        f->n_snapshots--;
     }
-    else if (f->ss.format == PA_SAMPLE_S16NE) {
-        int i;
-        short *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_s16(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
-        pa_memblock_release(buf->memblock);
+
+    s = &f->snapshots[(f->first_snapshot + f->n_snapshots++) % SNAPSHOTS];
+    s->index = f->index;
+    s->state = f->lr4.state;
+}
+
+static void ring_write(uint8_t *ring, size_t ring_frames, size_t fs, int64_t index, const uint8_t *src, size_t samples) {
+    size_t pos = index % ring_frames;
+    size_t n = PA_MIN(samples, ring_frames - pos);
+
+    memcpy(ring + pos * fs, src, n * fs);
+    memcpy(ring, src + n * fs, (samples - n) * fs);
+}
+
+static void ring_read(const uint8_t *ring, size_t ring_frames, size_t fs, int64_t index, uint8_t *dst, size_t samples) {
+    size_t pos = index % ring_frames;
+    size_t n = PA_MIN(samples, ring_frames - pos);
+
+    memcpy(dst, ring + pos * fs, n * fs);
+    memcpy(dst + n * fs, ring, (samples - n) * fs);
+}
+
+/* Makes room for at least the given number of frames, keeping what's in
+   the history so far */
+static void history_grow(pa_lfe_filter_t *f, size_t frames) {
+    size_t fs = pa_frame_size(&f->ss);
+    size_t new_frames = PA_MAX(frames, f->history_frames * 2);
+    uint8_t *h = pa_xmalloc(new_frames * fs);
+    int64_t i;
+
+    if (f->history_frames) {
+        size_t n;
+
+        for (i = f->history_start; i < f->index; i += n) {
+            size_t pos = i % f->history_frames;
+
+            n = PA_MIN((size_t) (f->index - i), f->history_frames - pos);
+            ring_write(h, new_frames, fs, i, f->history + pos * fs, n);
+        }
     }
-    else pa_assert_not_reached();
 
-    pa_xfree(garbage);
-    f->index += samples;
+    pa_xfree(f->history);
+    f->history = h;
+    f->history_frames = new_frames;
 }
 
 pa_memchunk * pa_lfe_filter_process(pa_lfe_filter_t *f, pa_memchunk *buf) {
-    pa_mempool *pool;
-    struct saved_state *s, *s2;
+    struct snapshot *s;
+    size_t samples, needed;
     void *data;
 
     if (!f->active || !buf->length)
         return buf;
 
-    /* Remove old states (FIXME: we could do better than searching the entire array here?) */
-    PA_LLIST_FOREACH_SAFE(s, s2, f->saved)
-        if (s->index + (int64_t) (s->chunk.length / pa_frame_size(&f->ss) + f->maxrewind) < f->index)
-            remove_state(f, s);
+    samples = buf->length / pa_frame_size(&f->ss);
 
-    /* Insert our existing state into the flist */
-    if ((s = pa_flist_pop(PA_STATIC_FLIST_GET(lfe_state))) == NULL)
-        s = pa_xnew(struct saved_state, 1);
-    PA_LLIST_INIT(struct saved_state, s);
+    s = newest_snapshot(f);
+    if (!s || f->index - s->index >= f->snapshot_spacing)
+        save_snapshot(f);
+
+    /* A rewind by maxrewind can need the input back to one spacing (plus
+       the block that crossed it) before the rewind position */
+    needed = PA_MIN((size_t) f->index, f->maxrewind + f->snapshot_spacing) + samples;
+    if (needed > f->history_frames)
+        history_grow(f, needed);
 
-    /* TODO: This actually memcpys the entire chunk into a new allocation, because we need to retain the original
-       in case of rewinding. Investigate whether this can be avoided. */
     data = pa_memblock_acquire_chunk(buf);
-    pool = pa_memblock_get_pool(buf->memblock);
-    s->chunk.memblock = pa_memblock_new_malloced(pool, pa_xmemdup(data, buf->length), buf->length);
-    s->chunk.length = buf->length;
-    s->chunk.index = 0;
+    ring_write(f->history, f->history_frames, pa_frame_size(&f->ss), f->index, data, samples);
+    f->history_start = PA_MAX(f->history_start, f->index + (int64_t) samples - (int64_t) f->history_frames);
+    process_block(f, data, samples);
     pa_memblock_release(buf->memblock);
-    pa_mempool_unref(pool), pool = NULL;
-
-    s->index = f->index;
-    memcpy(s->lr4, f->lr4, sizeof(struct lr4) * f->cm.channels);
-    PA_LLIST_PREPEND(struct saved_state, f->saved, s);
 
-    process_block(f, buf, true);
     return buf;
 }
 
@@ -149,10 +196,10 @@ void pa_lfe_filter_update_rate(pa_lfe_filter_t *f, uint32_t new_rate) {
     int i;
     float biquad_freq = f->crossover / (new_rate / 2);
 
-    while (f->saved)
-        remove_state(f, f->saved);
+    f->first_snapshot = f->n_snapshots = 0;
 
     f->index = 0;
+    f->history_start = 0;
     f->ss.rate = new_rate;
     if (biquad_freq <= 0 || biquad_freq >= 1) {
         pa_log_warn("Crossover frequency (%f) outside range for sample rate %d", f->crossover, new_rate);
@@ -160,42 +207,50 @@ void pa_lfe_filter_update_rate(pa_lfe_filter_t *f, uint32_t new_rate) {
         return;
     }
 
+    lr4_bank_init(&f->lr4, f->cm.channels);
     for (i = 0; i < f->cm.channels; i++)
-        lr4_set(&f->lr4[i], f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
+        lr4_bank_set(&f->lr4, i, f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
 
     f->active = true;
 }
 
 void pa_lfe_filter_rewind(pa_lfe_filter_t *f, size_t amount) {
-    struct saved_state *i, *s = NULL;
+    struct snapshot *s;
     size_t samples = amount / pa_frame_size(&f->ss);
+    size_t fs = pa_frame_size(&f->ss);
+    uint8_t *buf;
+
     f->index -= samples;
 
-    /* Find the closest saved position */
-    PA_LLIST_FOREACH(i, f->saved) {
-        if (i->index > f->index)
-            continue;
-        if (s == NULL || i->index > s->index)
-            s = i;
-    }
-    if (s == NULL) {
+    /* Whatever was saved after the new position is stale now, the newest
+       snapshot that remains is the closest one */
+    while ((s = newest_snapshot(f)) && s->index > f->index)
+        f->n_snapshots--;
+
+    if (s == NULL || s->index < f->history_start) {
         pa_log_debug("Rewinding LFE filter %zu samples to position %lli. No saved state found", samples, (long long) f->index);
         pa_lfe_filter_update_rate(f, f->ss.rate);
         return;
     }
     pa_log_debug("Rewinding LFE filter %zu samples to position %lli. Found saved state at position %lli",
         samples, (long long) f->index, (long long) s->index);
-    memcpy(f->lr4, s->lr4, sizeof(struct lr4) * f->cm.channels);
+    f->lr4.state = s->state;
+
+    if (f->index == s->index)
+        return;
 
     /* now fast forward to the actual position */
-    if (f->index > s->index) {
-        pa_memchunk x = s->chunk;
-        x.length = (f->index - s->index) * pa_frame_size(&f->ss);
-        if (x.length > s->chunk.length) {
-            pa_log_error("Hole in stream, cannot fast forward LFE filter");
-            return;
-        }
-        f->index = s->index;
-        process_block(f, &x, false);
+    buf = pa_xmalloc(FORWARD_FRAMES * fs);
+    samples = f->index - s->index;
+    f->index = s->index;
+
+    while (samples > 0) {
+        size_t n = PA_MIN(samples, (size_t) FORWARD_FRAMES);
+
+        ring_read(f->history, f->history_frames, fs, f->index, buf, n);
+        process_block(f, buf, n);
+        samples -= n;
     }
+
+    pa_xfree(buf);
 }
@@ -37,6 +37,10 @@
 
 #define FLIST_SIZE 256
 
+/* How many entries a thread keeps for itself in front of a static free
+ * list. When full, half of them are handed back to the shared list. */
+#define FLIST_CACHE_SIZE 64
+
 /* Atomic table indices contain
    sign bit = if set, indicates empty/NULL value
    tag bits (to avoid the ABA problem)
@@ -175,3 +179,73 @@ void* pa_flist_pop(pa_flist *l) {
 
     return ptr;
 }
+
+/* The per-thread cache of a static free list, see PA_STATIC_FLIST_POP()
+ * and PA_STATIC_FLIST_PUSH() */
+struct pa_flist_cache {
+    pa_flist *flist;
+    pa_free_cb_t free_cb;
+    unsigned n;
+    void *items[FLIST_CACHE_SIZE];
+};
+
+static void cache_flush(pa_flist_cache *c, unsigned n) {
+    pa_assert(n <= c->n);
+
+    while (n-- > 0) {
+        void *p = c->items[--c->n];
+
+        if (pa_flist_push(c->flist, p) < 0 && c->free_cb)
+            c->free_cb(p);
+    }
+}
+
+void pa_flist_cache_free(void *userdata) {
+    pa_flist_cache *c = userdata;
+
+    pa_assert(c);
+
+    cache_flush(c, c->n);
+    pa_xfree(c);
+}
+
+void* pa_flist_cache_pop(pa_tls *t, pa_flist *l) {
+    pa_flist_cache *c;
+
+    pa_assert(t);
+    pa_assert(l);
+
+    if ((c = pa_tls_get(t)) && c->n > 0)
+        return c->items[--c->n];
+
+    return pa_flist_pop(l);
+}
+
+int pa_flist_cache_push(pa_tls *t, pa_flist *l, pa_free_cb_t free_cb, void *p) {
+    pa_flist_cache *c;
+
+    pa_assert(t);
+    pa_assert(l);
+    pa_assert(p);
+
+    if (PA_UNLIKELY(!(c = pa_tls_get(t)))) {
+        if (pa_thread_self_is_foreign()) {
+            if (pa_flist_push(l, p) < 0 && free_cb)
+                free_cb(p);
+            return 0;
+        }
+
+        c = pa_xnew(pa_flist_cache, 1);
+        c->flist = l;
+        c->free_cb = free_cb;
+        c->n = 0;
+        pa_tls_set(t, c);
+    }
+
+    if (c->n >= FLIST_CACHE_SIZE)
+        cache_flush(c, FLIST_CACHE_SIZE / 2);
+
+    c->items[c->n++] = p;
+
+    return 0;
+}
@@ -25,6 +25,7 @@
 
 #include <pulsecore/once.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/thread.h>
 
 /* A multiple-reader multipler-write lock-free free list implementation */
 
@@ -40,6 +41,25 @@ void pa_flist_free(pa_flist *l, pa_free_cb_t free_cb);
 int pa_flist_push(pa_flist*l, void *p);
 void* pa_flist_pop(pa_flist*l);
 
+/* A cache of free entries a thread keeps for itself in front of a
+ * shared free list, so that entries freed by a thread can be reused by
+ * it without touching the shared list. Use these through
+ * PA_STATIC_FLIST_POP() and PA_STATIC_FLIST_PUSH(). When the thread
+ * exits, the cached entries are moved back to the shared list.
+ *
+ * Only threads started by pa_thread_new() get a cache, the others use
+ * the shared list directly. The thread-specific data key is never
+ * deleted, so its destructor must not run in a thread that might exit
+ * after our library was unloaded, and our own threads are always
+ * joined before that. */
+typedef struct pa_flist_cache pa_flist_cache;
+
+void* pa_flist_cache_pop(pa_tls *t, pa_flist *l);
+/* Unlike pa_flist_push() this never fails. If the shared list is full,
+ * entries are freed with free_cb. */
+int pa_flist_cache_push(pa_tls *t, pa_flist *l, pa_free_cb_t free_cb, void *p);
+void pa_flist_cache_free(void *c);
+
 /* Please note that the destructor stuff is not really necessary, we do
  * this just to make valgrind output more useful. */
 
@@ -47,7 +67,9 @@ void* pa_flist_pop(pa_flist*l);
     static struct {                                                     \
         pa_flist *volatile flist;                                       \
         pa_once once;                                                   \
-    } name##_flist = { NULL, PA_ONCE_INIT };                            \
+        pa_tls *volatile cache;                                         \
+        pa_once cache_once;                                             \
+    } name##_flist = { NULL, PA_ONCE_INIT, NULL, PA_ONCE_INIT };        \
     static void name##_flist_init(void) {                               \
         name##_flist.flist =                                            \
             pa_flist_new_with_name(size, __FILE__ ": " #name);          \
@@ -56,6 +78,21 @@ void* pa_flist_pop(pa_flist*l);
         pa_run_once(&name##_flist.once, name##_flist_init);             \
         return name##_flist.flist;                                      \
     }                                                                   \
+    static void name##_flist_cache_init(void) {                         \
+        name##_flist.cache = pa_tls_new(pa_flist_cache_free);           \
+    }                                                                   \
+    static inline pa_tls* name##_flist_cache_get(void) {                \
+        pa_run_once(&name##_flist.cache_once, name##_flist_cache_init); \
+        return name##_flist.cache;                                      \
+    }                                                                   \
+    static inline void* name##_flist_pop(void) {                        \
+        return pa_flist_cache_pop(name##_flist_cache_get(),             \
+                                  name##_flist_get());                  \
+    }                                                                   \
+    static inline int name##_flist_push(void *p) {                      \
+        return pa_flist_cache_push(name##_flist_cache_get(),            \
+                                   name##_flist_get(), (free_cb), p);   \
+    }                                                                   \
     static void name##_flist_destructor(void) PA_GCC_DESTRUCTOR;        \
     static void name##_flist_destructor(void) {                         \
         if (!pa_in_valgrind())                                          \
@@ -67,4 +104,9 @@ void* pa_flist_pop(pa_flist*l);
 
 #define PA_STATIC_FLIST_GET(name) (name##_flist_get())
 
+/* Like pa_flist_pop() and pa_flist_push() on PA_STATIC_FLIST_GET(name),
+ * but going through the calling thread's cache first */
+#define PA_STATIC_FLIST_POP(name) (name##_flist_pop())
+#define PA_STATIC_FLIST_PUSH(name, p) (name##_flist_push(p))
+
 #endif
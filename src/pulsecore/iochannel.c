@@ -240,6 +240,60 @@ ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l) {
     return r;
 }
 
+#ifdef HAVE_SYS_UIO_H
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, int n) {
+    ssize_t r;
+    size_t l = 0;
+    int i;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+
+    for (i = 0; i < n; i++)
+        l += iov[i].iov_len;
+
+    pa_assert(l);
+
+    /* Mirror pa_write(): prefer sendmsg() so that we get MSG_NOSIGNAL,
+     * and fall back to writev() if this turns out not to be a socket. */
+    if (io->ofd_type == 0) {
+        struct msghdr mh;
+
+        pa_zero(mh);
+        mh.msg_iov = (struct iovec*) iov;
+        mh.msg_iovlen = n;
+
+        while ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+            ;
+
+        if (r < 0 && errno == ENOTSOCK)
+            io->ofd_type = 1;
+    }
+
+    if (io->ofd_type != 0)
+        while ((r = writev(io->ofd, iov, n)) < 0 && errno == EINTR)
+            ;
+
+    if ((size_t) r == l)
+        return r;
+
+    if (r < 0) {
+        if (errno == EAGAIN)
+            r = 0;
+        else
+            return r;
+    }
+
+    /* Partial write - let's get a notification when we can write more */
+    io->writable = io->hungup = false;
+    enable_events(io);
+
+    return r;
+}
+#endif
+
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     ssize_t r;
 
@@ -346,30 +400,38 @@ ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l
     return r;
 }
 
+ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l, int nfd, const int *fds) {
+    struct iovec iov;
+
+    pa_assert(data);
+    pa_assert(l);
+
+    pa_zero(iov);
+    iov.iov_base = (void*) data;
+    iov.iov_len = l;
+
+    return pa_iochannel_writev_with_fds(io, &iov, 1, nfd, fds);
+}
+
 /* For more details on FD passing, check the cmsg(3) manpage
  * and IETF RFC #2292: "Advanced Sockets API for IPv6" */
-ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l, int nfd, const int *fds) {
+ssize_t pa_iochannel_writev_with_fds(pa_iochannel*io, const struct iovec *iov, int n, int nfd, const int *fds) {
     ssize_t r;
     int *msgdata;
     struct msghdr mh;
-    struct iovec iov;
     union {
         struct cmsghdr hdr;
         uint8_t data[CMSG_SPACE(sizeof(int) * MAX_ANCIL_DATA_FDS)];
     } cmsg;
 
     pa_assert(io);
-    pa_assert(data);
-    pa_assert(l);
+    pa_assert(iov);
+    pa_assert(n > 0);
     pa_assert(io->ofd >= 0);
     pa_assert(fds);
     pa_assert(nfd > 0);
     pa_assert(nfd <= MAX_ANCIL_DATA_FDS);
 
-    pa_zero(iov);
-    iov.iov_base = (void*) data;
-    iov.iov_len = l;
-
     pa_zero(cmsg);
     cmsg.hdr.cmsg_level = SOL_SOCKET;
     cmsg.hdr.cmsg_type = SCM_RIGHTS;
@@ -379,8 +441,8 @@ ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l,
     cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(int) * nfd);
 
     pa_zero(mh);
-    mh.msg_iov = &iov;
-    mh.msg_iovlen = 1;
+    mh.msg_iov = (struct iovec*) iov;
+    mh.msg_iovlen = n;
     mh.msg_control = &cmsg;
 
     /* If we followed the example on the cmsg man page, we'd use
@@ -27,6 +27,10 @@
 
 #include <sys/types.h>
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include <pulse/mainloop-api.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
@@ -51,11 +55,18 @@ void pa_iochannel_free(pa_iochannel*io);
 ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l);
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l);
 
+#ifdef HAVE_SYS_UIO_H
+/* Like pa_iochannel_write(), but gathers the data from n buffers in a
+ * single system call. */
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, int n);
+#endif
+
 #ifdef HAVE_CREDS
 bool pa_iochannel_creds_supported(pa_iochannel *io);
 int pa_iochannel_creds_enable(pa_iochannel *io);
 
 ssize_t pa_iochannel_write_with_fds(pa_iochannel*io, const void*data, size_t l, int nfd, const int *fds);
+ssize_t pa_iochannel_writev_with_fds(pa_iochannel*io, const struct iovec *iov, int n, int nfd, const int *fds);
 ssize_t pa_iochannel_write_with_creds(pa_iochannel*io, const void*data, size_t l, const pa_creds *ucred);
 ssize_t pa_iochannel_read_with_ancil_data(pa_iochannel*io, void*data, size_t l, pa_cmsg_ancil_data *ancil_data);
 #endif
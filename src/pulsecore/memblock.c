@@ -40,6 +40,7 @@
 #include <pulsecore/log.h>
 #include <pulsecore/hashmap.h>
 #include <pulsecore/semaphore.h>
+#include <pulsecore/fdsem.h>
 #include <pulsecore/mutex.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/refcnt.h>
@@ -57,6 +58,32 @@
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
 
+/* Blocks are mostly either small, as written by low latency clients, or
+ * as large as they can be, as rendered by sinks. Each smaller class gets
+ * the given number of 64ths of the requested size, and the largest class
+ * gets what's left, so that the pool doesn't get any larger than before
+ * classes were introduced. Small blocks spill over into the next larger
+ * class, so the smaller classes are kept small. Pools with fewer than
+ * PA_MEMPOOL_CLASSES_MIN_SLOTS of the largest slots only have the
+ * largest class. */
+static const struct {
+    size_t slot_size;
+    unsigned share;
+} mempool_classes[PA_MEMPOOL_CLASSES_MAX] = {
+    { 4*1024, 1 },
+    { 16*1024, 1 },
+    { PA_MEMPOOL_SLOT_SIZE, 62 },
+};
+
+#define PA_MEMPOOL_CLASSES_MIN_SLOTS 16
+
+/* When a pool is filling up, it grows by another segment of the same
+ * size and layout, up to the pool's maximum number of segments. Growing
+ * is requested once a class has handed out this many of the slots of
+ * the newest segment, see pa_mempool_set_grow_mainloop(). */
+#define PA_MEMPOOL_SEGMENTS_DEFAULT 4
+#define PA_MEMPOOL_GROW_THRESHOLD(n_slots) PA_MAX((n_slots) * 3 / 4, 1u)
+
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
 #define PA_MEMIMPORT_SLOTS_MAX 160
@@ -163,6 +190,24 @@ struct pa_memexport {
     PA_LLIST_FIELDS(pa_memexport);
 };
 
+struct mempool_class {
+    size_t slot_size;
+    unsigned n_slots;
+
+    /* Where the first slot of this class is in each segment */
+    size_t offset;
+};
+
+struct mempool_segment {
+    pa_shm memory;
+
+    /* Per class */
+    pa_atomic_t n_init[PA_MEMPOOL_CLASSES_MAX];
+
+    /* Lists of free slots that may be reused, per class */
+    pa_flist *free_slots[PA_MEMPOOL_CLASSES_MAX];
+};
+
 struct pa_mempool {
     /* Reference count the mempool
      *
@@ -184,22 +229,37 @@ struct pa_mempool {
     pa_semaphore *semaphore;
     pa_mutex *mutex;
 
-    pa_shm memory;
+    /* Segments are only ever added, under the mutex. n_segments is
+     * increased once a new one is completely set up, so it can be used
+     * without locking. */
+    struct mempool_segment segments[PA_MEMPOOL_SEGMENTS_MAX];
+    pa_atomic_t n_segments;
+    unsigned max_segments;
+    size_t segment_size;
+
+    /* Whether segments should be backed by huge pages, and be
+     * prefaulted */
+    bool huge_pages;
+    bool prefault;
+
+    /* Growing is requested by allocations, from any thread, by setting
+     * grow_requested and posting grow_fdsem. The segment is then added
+     * from the main loop, see pa_mempool_set_grow_mainloop(). */
+    pa_atomic_t grow_requested;
+    pa_fdsem *grow_fdsem;
+    pa_mainloop_api *grow_mainloop;
+    pa_io_event *grow_event;
 
     bool global;
 
-    size_t block_size;
-    unsigned n_blocks;
+    /* Smallest slots first, the classes follow each other in memory */
+    struct mempool_class classes[PA_MEMPOOL_CLASSES_MAX];
+    unsigned n_classes;
     bool is_remote_writable;
 
-    pa_atomic_t n_init;
-
     PA_LLIST_HEAD(pa_memimport, imports);
     PA_LLIST_HEAD(pa_memexport, exports);
 
-    /* A list of free slots that may be reused */
-    pa_flist *free_slots;
-
     pa_mempool_stat stat;
 };
 
@@ -258,8 +318,11 @@ pa_memblock *pa_memblock_new(pa_mempool *p, size_t length) {
     pa_assert(p);
     pa_assert(length);
 
-    if (!(b = pa_memblock_new_pool(p, length)))
+    if (!(b = pa_memblock_new_pool(p, length))) {
+        /* Such blocks need to be copied when sent to another process */
+        pa_atomic_inc(&p->stat.n_malloc_fallback);
         b = memblock_new_appended(p, length);
+    }
 
     return b;
 }
@@ -292,35 +355,101 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static inline size_t mempool_slot_size_max(pa_mempool *p) {
+    return p->classes[p->n_classes - 1].slot_size;
+}
+
+/* No lock necessary */
+static size_t mempool_slot_size_for(pa_mempool *p, size_t size) {
+    unsigned c;
+
+    for (c = 0; c < p->n_classes; c++)
+        if (p->classes[c].slot_size >= size)
+            return p->classes[c].slot_size;
+
+    return 0;
+}
+
+static int mempool_add_segment(pa_mempool *p, pa_mem_type_t type);
+
+/* No lock necessary */
+static struct mempool_slot* mempool_allocate_class_slot(pa_mempool *p, struct mempool_segment *seg, unsigned c, bool *filling) {
+    struct mempool_class *k = &p->classes[c];
     struct mempool_slot *slot;
-    pa_assert(p);
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
+    if (!(slot = pa_flist_pop(seg->free_slots[c]))) {
         int idx;
 
         /* The free list was empty, we have to allocate a new entry */
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
-        else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
-
-        if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
-            return NULL;
+        if ((unsigned) (idx = pa_atomic_inc(&seg->n_init[c])) >= k->n_slots)
+            pa_atomic_dec(&seg->n_init[c]);
+        else {
+            slot = (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + k->offset + (k->slot_size * (size_t) idx));
+            *filling = (unsigned) idx + 1 == PA_MEMPOOL_GROW_THRESHOLD(k->n_slots);
         }
     }
 
+    return slot;
+}
+
+/* No lock necessary. Never blocks, so that realtime threads may ask the
+ * pool to grow. */
+static void mempool_request_grow(pa_mempool *p) {
+    if ((unsigned) pa_atomic_load(&p->n_segments) >= p->max_segments)
+        return;
+
+    if (!pa_atomic_cmpxchg(&p->grow_requested, 0, 1))
+        return;
+
+    if (p->grow_fdsem)
+        pa_fdsem_post(p->grow_fdsem);
+}
+
+/* No lock necessary, and never grows the pool itself */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, size_t size) {
+    unsigned n_segments, c, i;
+    pa_assert(p);
+
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+
+    /* Take the smallest class the size fits in, and if that one is full
+     * the next larger one. Ask for growing when filling up the last
+     * segment or when all of them are full. */
+    for (c = 0; c < p->n_classes; c++) {
+        struct mempool_slot *slot = NULL;
+        bool filling = false;
+
+        if (p->classes[c].slot_size < size)
+            continue;
+
+        for (i = 0; i < n_segments && !slot; i++)
+            slot = mempool_allocate_class_slot(p, &p->segments[i], c, &filling);
+
+        if (slot) {
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
-/*     if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
-/*     } */
+/*             if (PA_UNLIKELY(pa_in_valgrind())) { */
+/*                 VALGRIND_MALLOCLIKE_BLOCK(slot, p->classes[c].slot_size, 0, 0); */
+/*             } */
 /* #endif */
 
-    return slot;
+            if (filling && i == n_segments)
+                mempool_request_grow(p);
+
+            pa_atomic_inc(&p->stat.n_allocated_by_class[c]);
+            pa_atomic_inc(&p->stat.n_accumulated_by_class[c]);
+            return slot;
+        }
+
+        pa_atomic_inc(&p->stat.n_class_full[c]);
+    }
+
+    mempool_request_grow(p);
+
+    if (pa_log_ratelimit(PA_LOG_DEBUG))
+        pa_log_debug("Pool full");
+    pa_atomic_inc(&p->stat.n_pool_full);
+    return NULL;
 }
 
 /* No lock necessary, totally redundant anyway */
@@ -329,23 +458,69 @@ static inline void* mempool_slot_data(struct mempool_slot *slot) {
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
+static struct mempool_segment* mempool_segment_by_ptr(pa_mempool *p, void *ptr) {
+    unsigned i, n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+
     pa_assert(p);
 
-    pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
-    pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
+    for (i = 0; i < n_segments; i++) {
+        pa_shm *m = &p->segments[i].memory;
+
+        if ((uint8_t*) ptr >= (uint8_t*) m->ptr && (uint8_t*) ptr < (uint8_t*) m->ptr + m->size)
+            return &p->segments[i];
+    }
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
+    pa_assert_not_reached();
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
-    unsigned idx;
+static unsigned mempool_slot_class(pa_mempool *p, struct mempool_segment *seg, void *ptr) {
+    size_t offset;
+    unsigned c;
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
-        return NULL;
+    pa_assert(p);
+
+    offset = (size_t) ((uint8_t*) ptr - (uint8_t*) seg->memory.ptr);
+
+    for (c = p->n_classes - 1; p->classes[c].offset > offset; c--)
+        ;
+
+    return c;
+}
+
+/* No lock necessary */
+static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr, struct mempool_segment **seg, unsigned *c) {
+    struct mempool_class *k;
+    size_t idx;
+
+    *seg = mempool_segment_by_ptr(p, ptr);
+    k = &p->classes[*c = mempool_slot_class(p, *seg, ptr)];
+    idx = ((size_t) ((uint8_t*) ptr - (uint8_t*) (*seg)->memory.ptr) - k->offset) / k->slot_size;
+
+    return (struct mempool_slot*) ((uint8_t*) (*seg)->memory.ptr + k->offset + (idx * k->slot_size));
+}
+
+/* No lock necessary */
+static void mempool_free_slot(pa_mempool *p, void *ptr) {
+    struct mempool_segment *seg;
+    struct mempool_slot *slot;
+    unsigned c;
+
+    pa_assert_se(slot = mempool_slot_by_ptr(p, ptr, &seg, &c));
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+/* #ifdef HAVE_VALGRIND_MEMCHECK_H */
+/*     if (PA_UNLIKELY(pa_in_valgrind())) { */
+/*         VALGRIND_FREELIKE_BLOCK(slot, p->classes[c].slot_size); */
+/*     } */
+/* #endif */
+
+    /* The free list dimensions should easily allow all slots
+     * to fit in, hence try harder if pushing this slot into
+     * the free list fails */
+    while (pa_flist_push(seg->free_slots[c], slot) < 0)
+        ;
+
+    pa_atomic_dec(&p->stat.n_allocated_by_class[c]);
 }
 
 /* No lock necessary */
@@ -365,6 +540,7 @@ void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable) {
 pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     pa_memblock *b = NULL;
     struct mempool_slot *slot;
+    size_t slot_size;
     static int mempool_disable = 0;
 
     pa_assert(p);
@@ -382,28 +558,32 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    /* The header goes into the slot too, unless that would need a slot
+     * of a larger class than the data alone */
+    slot_size = mempool_slot_size_for(p, length);
 
-        if (!(slot = mempool_allocate_slot(p)))
+    if (slot_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+
+        if (!(slot = mempool_allocate_slot(p, PA_ALIGN(sizeof(pa_memblock)) + length)))
             return NULL;
 
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
+    } else if (slot_size >= length) {
 
-        if (!(slot = mempool_allocate_slot(p)))
+        if (!(slot = mempool_allocate_slot(p, length)))
             return NULL;
 
-        if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
+        if (!(b = PA_STATIC_FLIST_POP(unused_memblocks)))
             b = pa_xnew(pa_memblock, 1);
 
         b->type = PA_MEMBLOCK_POOL_EXTERNAL;
         pa_atomic_ptr_store(&b->data, mempool_slot_data(slot));
 
     } else {
-        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->block_size);
+        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) mempool_slot_size_max(p));
         pa_atomic_inc(&p->stat.n_too_large_for_pool);
         return NULL;
     }
@@ -429,7 +609,7 @@ pa_memblock *pa_memblock_new_fixed(pa_mempool *p, void *d, size_t length, bool r
     pa_assert(length != (size_t) -1);
     pa_assert(length);
 
-    if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
+    if (!(b = PA_STATIC_FLIST_POP(unused_memblocks)))
         b = pa_xnew(pa_memblock, 1);
 
     PA_REFCNT_INIT(b);
@@ -463,7 +643,7 @@ pa_memblock *pa_memblock_new_user(
     pa_assert(length != (size_t) -1);
     pa_assert(free_cb);
 
-    if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
+    if (!(b = PA_STATIC_FLIST_POP(unused_memblocks)))
         b = pa_xnew(pa_memblock, 1);
 
     PA_REFCNT_INIT(b);
@@ -492,6 +672,29 @@ bool pa_memblock_is_ours(pa_memblock *b) {
     return b->type != PA_MEMBLOCK_IMPORTED;
 }
 
+/* No lock necessary */
+int pa_memblock_get_shm_id(pa_memblock *b, pa_mem_type_t *type, uint32_t *shm_id) {
+    pa_shm *memory;
+
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+    pa_assert(type);
+    pa_assert(shm_id);
+
+    if (b->type == PA_MEMBLOCK_IMPORTED) {
+        pa_assert(b->per_type.imported.segment);
+        memory = &b->per_type.imported.segment->memory;
+    } else if ((b->type == PA_MEMBLOCK_POOL || b->type == PA_MEMBLOCK_POOL_EXTERNAL) && pa_mempool_is_shared(b->pool))
+        memory = &mempool_segment_by_ptr(b->pool, pa_atomic_ptr_load(&b->data))->memory;
+    else
+        return -1;
+
+    *type = memory->type;
+    *shm_id = memory->id;
+
+    return 0;
+}
+
 /* No lock necessary */
 bool pa_memblock_is_read_only(pa_memblock *b) {
     pa_assert(b);
@@ -601,7 +804,7 @@ static void memblock_free(pa_memblock *b) {
             /* Fall through */
 
         case PA_MEMBLOCK_FIXED:
-            if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
+            if (PA_STATIC_FLIST_PUSH(unused_memblocks, b) < 0)
                 pa_xfree(b);
 
             break;
@@ -634,7 +837,7 @@ static void memblock_free(pa_memblock *b) {
 
             import->release_cb(import, b->per_type.imported.id, import->userdata);
 
-            if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
+            if (PA_STATIC_FLIST_PUSH(unused_memblocks, b) < 0)
                 pa_xfree(b);
 
             break;
@@ -642,27 +845,14 @@ static void memblock_free(pa_memblock *b) {
 
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
-            struct mempool_slot *slot;
             bool call_free;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
-
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
-/* #ifdef HAVE_VALGRIND_MEMCHECK_H */
-/*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
-/*             } */
-/* #endif */
-
-            /* The free list dimensions should easily allow all slots
-             * to fit in, hence try harder if pushing this slot into
-             * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
-                ;
+            mempool_free_slot(b->pool, pa_atomic_ptr_load(&b->data));
 
             if (call_free)
-                if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
+                if (PA_STATIC_FLIST_PUSH(unused_memblocks, b) < 0)
                     pa_xfree(b);
 
             break;
@@ -711,10 +901,10 @@ static void memblock_make_local(pa_memblock *b) {
 
     pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
 
-    if (b->length <= b->pool->block_size) {
+    if (b->length <= mempool_slot_size_max(b->pool)) {
         struct mempool_slot *slot;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, b->length))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -826,41 +1016,81 @@ static void memblock_replace_import(pa_memblock *b) {
  * TODO-1: Transform the global core mempool to a per-client one
  * TODO-2: Remove global mempools support */
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
+    return pa_mempool_new_with_block_size(type, size, PA_MEMPOOL_SLOT_SIZE - PA_ALIGN(sizeof(pa_memblock)), per_client);
+}
+
+/* Like pa_mempool_new(), but the largest blocks handed out are at least
+ * @block_size_max bytes instead of a little less than 64 KiB. The pool
+ * always holds at least two of them. */
+pa_mempool *pa_mempool_new_with_block_size(pa_mem_type_t type, size_t size, size_t block_size_max, bool per_client) {
     pa_mempool *p;
     char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
     const size_t page_size = pa_page_size();
+    size_t block_size, total, offset = 0;
+    unsigned n_blocks, c;
+
+    pa_assert(block_size_max > 0);
 
     p = pa_xnew0(pa_mempool, 1);
     PA_REFCNT_INIT(p);
 
-    p->block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
-    if (p->block_size < page_size)
-        p->block_size = page_size;
+    block_size = PA_PAGE_ALIGN(block_size_max + PA_ALIGN(sizeof(pa_memblock)));
+    if (block_size < page_size)
+        block_size = page_size;
 
     if (size <= 0)
-        p->n_blocks = PA_MEMPOOL_SLOTS_MAX;
+        n_blocks = PA_MEMPOOL_SLOTS_MAX;
     else {
-        p->n_blocks = (unsigned) (size / p->block_size);
+        n_blocks = (unsigned) (size / block_size);
 
-        if (p->n_blocks < 2)
-            p->n_blocks = 2;
+        if (n_blocks < 2)
+            n_blocks = 2;
     }
 
-    if (pa_shm_create_rw(&p->memory, type, p->n_blocks * p->block_size, 0700) < 0) {
+    total = n_blocks * block_size;
+
+    /* The smaller classes are left out if they end up with slots as large
+     * as the previous class, which happens with large pages. The largest
+     * class gets what's left. */
+    for (c = 0; c < PA_MEMPOOL_CLASSES_MAX; c++) {
+        struct mempool_class *k = &p->classes[p->n_classes];
+
+        if (c == PA_MEMPOOL_CLASSES_MAX - 1) {
+            k->slot_size = block_size;
+            k->n_slots = (unsigned) ((total - offset) / block_size);
+        } else {
+            k->slot_size = PA_MAX(PA_PAGE_ALIGN(mempool_classes[c].slot_size), page_size);
+
+            if (n_blocks < PA_MEMPOOL_CLASSES_MIN_SLOTS || k->slot_size >= block_size ||
+                (p->n_classes > 0 && k->slot_size <= p->classes[p->n_classes - 1].slot_size))
+                continue;
+
+            k->n_slots = (unsigned) (total / 64 * mempool_classes[c].share / k->slot_size);
+        }
+
+        k->offset = offset;
+        offset += k->n_slots * k->slot_size;
+        p->n_classes++;
+    }
+
+    p->segment_size = offset;
+    p->max_segments = PA_MEMPOOL_SEGMENTS_DEFAULT;
+
+    if (mempool_add_segment(p, type) < 0) {
         pa_xfree(p);
         return NULL;
     }
 
-    pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
+    pa_log_debug("Using %s memory pool, total size is %s, maximum usable slot size is %lu",
                  pa_mem_type_to_string(type),
-                 p->n_blocks,
-                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
-                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
+                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) offset),
                  (unsigned long) pa_mempool_block_size_max(p));
 
-    p->global = !per_client;
+    for (c = 0; c < p->n_classes; c++)
+        pa_log_debug("Memory pool class %u: %u slots of size %s each", c, p->classes[c].n_slots,
+                     pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->classes[c].slot_size));
 
-    pa_atomic_store(&p->n_init, 0);
+    p->global = !per_client;
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
@@ -868,12 +1098,41 @@ pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client) {
     p->mutex = pa_mutex_new(true, true);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
-
     return p;
 }
 
+/* Call with the mutex locked, if there is one already */
+static int mempool_add_segment(pa_mempool *p, pa_mem_type_t type) {
+    unsigned n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+    struct mempool_segment *seg = &p->segments[n_segments];
+    unsigned c;
+
+    pa_assert(n_segments < PA_MEMPOOL_SEGMENTS_MAX);
+
+    if (pa_shm_create_rw(&seg->memory, type, p->segment_size, 0700) < 0)
+        return -1;
+
+    for (c = 0; c < p->n_classes; c++) {
+        pa_atomic_store(&seg->n_init[c], 0);
+        seg->free_slots[c] = pa_flist_new(p->classes[c].n_slots);
+    }
+
+    if (p->huge_pages && pa_shm_set_huge_pages(&seg->memory) >= 0)
+        pa_atomic_inc(&p->stat.n_huge_pages_requested);
+
+    if (p->prefault)
+        pa_shm_prefault(&seg->memory);
+
+    /* Only now the segment may be used */
+    pa_atomic_inc(&p->n_segments);
+    pa_atomic_inc(&p->stat.n_segments);
+
+    return 0;
+}
+
 static void mempool_free(pa_mempool *p) {
+    unsigned c, i, n_segments;
+
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -886,44 +1145,47 @@ static void mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
-
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
         /* Ouch, somebody is retaining a memory block reference! */
 
 #ifdef DEBUG_REF
-        unsigned i;
-        pa_flist *list;
-
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_segments); i++)
+            for (c = 0; c < p->n_classes; c++) {
+                struct mempool_segment *seg = &p->segments[i];
+                struct mempool_class *mc = &p->classes[c];
+                unsigned j;
+                pa_flist *list;
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
-            struct mempool_slot *slot;
-            pa_memblock *b, *k;
+                list = pa_flist_new(mc->n_slots);
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
-            b = mempool_slot_data(slot);
+                for (j = 0; j < (unsigned) pa_atomic_load(&seg->n_init[c]); j++) {
+                    struct mempool_slot *slot;
+                    pa_memblock *b, *k;
 
-            while ((k = pa_flist_pop(p->free_slots))) {
-                while (pa_flist_push(list, k) < 0)
-                    ;
+                    slot = (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + mc->offset + (mc->slot_size * (size_t) j));
+                    b = mempool_slot_data(slot);
 
-                if (b == k)
-                    break;
-            }
+                    while ((k = pa_flist_pop(seg->free_slots[c]))) {
+                        while (pa_flist_push(list, k) < 0)
+                            ;
 
-            if (!k)
-                pa_log("REF: Leaked memory block %p", b);
+                        if (b == k)
+                            break;
+                    }
 
-            while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
-                    ;
-        }
+                    if (!k)
+                        pa_log("REF: Leaked memory block %p", b);
 
-        pa_flist_free(list, NULL);
+                    while ((k = pa_flist_pop(list)))
+                        while (pa_flist_push(seg->free_slots[c], k) < 0)
+                            ;
+                }
+
+                pa_flist_free(list, NULL);
+            }
 
 #endif
 
@@ -932,7 +1194,20 @@ static void mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
-    pa_shm_free(&p->memory);
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+
+    for (i = 0; i < n_segments; i++) {
+        for (c = 0; c < p->n_classes; c++)
+            pa_flist_free(p->segments[i].free_slots[c], NULL);
+
+        pa_shm_free(&p->segments[i].memory);
+    }
+
+    /* The io event has to be freed from the main loop's thread */
+    pa_assert(!p->grow_event);
+
+    if (p->grow_fdsem)
+        pa_fdsem_free(p->grow_fdsem);
 
     pa_mutex_free(p->mutex);
     pa_semaphore_free(p->semaphore);
@@ -951,44 +1226,69 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
 
-    return p->block_size - PA_ALIGN(sizeof(pa_memblock));
+    return mempool_slot_size_max(p) - PA_ALIGN(sizeof(pa_memblock));
+}
+
+/* No lock necessary */
+int pa_mempool_get_class(pa_mempool *p, unsigned idx, size_t *slot_size, unsigned *n_slots) {
+    pa_assert(p);
+
+    if (idx >= p->n_classes)
+        return -1;
+
+    if (slot_size)
+        *slot_size = p->classes[idx].slot_size;
+    if (n_slots)
+        *n_slots = p->classes[idx].n_slots;
+
+    return 0;
 }
 
 /* No lock necessary */
 void pa_mempool_vacuum(pa_mempool *p) {
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned c, i;
 
     pa_assert(p);
 
-    list = pa_flist_new(p->n_blocks);
+    /* Punching holes would split up the huge pages again */
+    if (p->huge_pages)
+        return;
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+    for (i = 0; i < (unsigned) pa_atomic_load(&p->n_segments); i++)
+        for (c = 0; c < p->n_classes; c++) {
+            struct mempool_segment *seg = &p->segments[i];
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+            list = pa_flist_new(p->classes[c].n_slots);
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
-    }
+            while ((slot = pa_flist_pop(seg->free_slots[c])))
+                while (pa_flist_push(list, slot) < 0)
+                    ;
 
-    pa_flist_free(list, NULL);
+            while ((slot = pa_flist_pop(list))) {
+                pa_shm_punch(&seg->memory, (size_t) ((uint8_t*) slot - (uint8_t*) seg->memory.ptr), p->classes[c].slot_size);
+
+                while (pa_flist_push(seg->free_slots[c], slot))
+                    ;
+            }
+
+            pa_flist_free(list, NULL);
+        }
 }
 
 /* No lock necessary */
 bool pa_mempool_is_shared(pa_mempool *p) {
     pa_assert(p);
 
-    return pa_mem_type_is_shared(p->memory.type);
+    return pa_mem_type_is_shared(p->segments[0].memory.type);
 }
 
 /* No lock necessary */
 bool pa_mempool_is_memfd_backed(const pa_mempool *p) {
     pa_assert(p);
 
-    return (p->memory.type == PA_MEM_TYPE_SHARED_MEMFD);
+    return (p->segments[0].memory.type == PA_MEM_TYPE_SHARED_MEMFD);
 }
 
 /* No lock necessary */
@@ -998,11 +1298,161 @@ int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
     if (!pa_mempool_is_shared(p))
         return -1;
 
-    *id = p->memory.id;
+    *id = p->segments[0].memory.id;
+
+    return 0;
+}
+
+/* No lock necessary */
+unsigned pa_mempool_get_n_segments(pa_mempool *p) {
+    pa_assert(p);
+
+    return (unsigned) pa_atomic_load(&p->n_segments);
+}
+
+/* No lock necessary */
+int pa_mempool_get_segment_shm_id(pa_mempool *p, unsigned segment, uint32_t *id) {
+    pa_assert(p);
+
+    if (!pa_mempool_is_shared(p) || segment >= pa_mempool_get_n_segments(p))
+        return -1;
+
+    *id = p->segments[segment].memory.id;
 
     return 0;
 }
 
+/* Self-locked. Adds a segment right away, which may take a while, so
+ * don't call this from a realtime thread. */
+int pa_mempool_grow(pa_mempool *p) {
+    char t[PA_BYTES_SNPRINT_MAX];
+    unsigned n_segments;
+    int r = -1;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+
+    pa_atomic_store(&p->grow_requested, 0);
+
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+    if (n_segments < p->max_segments && mempool_add_segment(p, p->segments[0].memory.type) >= 0) {
+        pa_log_info("Memory pool filling up, added segment %u of %s", n_segments,
+                    pa_bytes_snprint(t, sizeof(t), (unsigned) p->segment_size));
+        r = 0;
+    }
+
+    pa_mutex_unlock(p->mutex);
+
+    return r;
+}
+
+static void grow_cb(pa_mainloop_api *m, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    pa_mempool *p = userdata;
+
+    pa_assert(p);
+    pa_assert(p->grow_event == e);
+
+    pa_fdsem_after_poll(p->grow_fdsem);
+
+    do {
+        if (pa_atomic_load(&p->grow_requested))
+            pa_mempool_grow(p);
+    } while (pa_fdsem_before_poll(p->grow_fdsem) < 0);
+}
+
+/* Allocations never grow the pool themselves, as they happen in
+ * realtime threads too, and setting up a segment means creating and
+ * mapping shared memory. Instead, when the pool is filling up they ask
+ * for a segment to be added from the main loop m, and fall back to
+ * malloc() if the pool is full before that happened. Without a main
+ * loop the pool doesn't grow. Call from m's thread, and with NULL
+ * before m goes away. */
+void pa_mempool_set_grow_mainloop(pa_mempool *p, pa_mainloop_api *m) {
+    pa_assert(p);
+
+    if (p->grow_event) {
+        p->grow_mainloop->io_free(p->grow_event);
+        p->grow_event = NULL;
+        p->grow_mainloop = NULL;
+    }
+
+    if (!m)
+        return;
+
+    /* The fdsem stays around until the pool is freed, since any thread
+     * might be posting it */
+    if (!p->grow_fdsem && !(p->grow_fdsem = pa_fdsem_new())) {
+        pa_log_warn("Failed to create fdsem, the memory pool won't grow.");
+        return;
+    }
+
+    p->grow_mainloop = m;
+
+    /* Requests that came in before are handled right away */
+    do {
+        if (pa_atomic_load(&p->grow_requested))
+            pa_mempool_grow(p);
+    } while (pa_fdsem_before_poll(p->grow_fdsem) < 0);
+
+    pa_assert_se(p->grow_event = m->io_new(m, pa_fdsem_get(p->grow_fdsem), PA_IO_EVENT_INPUT, grow_cb, p));
+}
+
+/* Self-locked */
+void pa_mempool_set_max_segments(pa_mempool *p, unsigned n) {
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+    p->max_segments = PA_CLAMP(n, 1u, (unsigned) PA_MEMPOOL_SEGMENTS_MAX);
+    pa_mutex_unlock(p->mutex);
+}
+
+/* Self-locked. Applies to the existing segments and the ones added
+ * later on. */
+void pa_mempool_set_huge_pages(pa_mempool *p, bool huge_pages) {
+    unsigned i, n_segments;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+
+    if (huge_pages && !p->huge_pages) {
+        n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+
+        for (i = 0; i < n_segments; i++)
+            if (pa_shm_set_huge_pages(&p->segments[i].memory) >= 0)
+                pa_atomic_inc(&p->stat.n_huge_pages_requested);
+
+        if (pa_atomic_load(&p->stat.n_huge_pages_requested) > 0)
+            pa_log_info("Requested huge pages for the memory pool.");
+        else
+            pa_log_info("Huge pages are not available for the memory pool.");
+    }
+
+    p->huge_pages = huge_pages;
+
+    pa_mutex_unlock(p->mutex);
+}
+
+/* Self-locked. Applies to the segments added later on as well, which
+ * happens from the main loop, see pa_mempool_set_grow_mainloop(). */
+void pa_mempool_prefault(pa_mempool *p) {
+    unsigned i, n_segments;
+
+    pa_assert(p);
+
+    pa_mutex_lock(p->mutex);
+
+    p->prefault = true;
+
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
+
+    for (i = 0; i < n_segments; i++)
+        pa_shm_prefault(&p->segments[i].memory);
+
+    pa_mutex_unlock(p->mutex);
+}
+
 pa_mempool* pa_mempool_ref(pa_mempool *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -1042,18 +1492,19 @@ bool pa_mempool_is_per_client(pa_mempool *p) {
  * should only be called once during during a mempool's lifetime.
  *
  * Check pa_shm->fd and pa_mempool_new() for further context. */
-int pa_mempool_take_memfd_fd(pa_mempool *p) {
+int pa_mempool_take_memfd_fd(pa_mempool *p, unsigned segment) {
     int memfd_fd;
 
     pa_assert(p);
+    pa_assert(segment < pa_mempool_get_n_segments(p));
     pa_assert(pa_mempool_is_shared(p));
     pa_assert(pa_mempool_is_memfd_backed(p));
     pa_assert(pa_mempool_is_per_client(p));
 
     pa_mutex_lock(p->mutex);
 
-    memfd_fd = p->memory.fd;
-    p->memory.fd = -1;
+    memfd_fd = p->segments[segment].memory.fd;
+    p->segments[segment].memory.fd = -1;
 
     pa_mutex_unlock(p->mutex);
 
@@ -1069,15 +1520,16 @@ int pa_mempool_take_memfd_fd(pa_mempool *p) {
  * close the returned descriptor by your own.
  *
  * Check pa_mempool_new() for further context. */
-int pa_mempool_get_memfd_fd(pa_mempool *p) {
+int pa_mempool_get_memfd_fd(pa_mempool *p, unsigned segment) {
     int memfd_fd;
 
     pa_assert(p);
+    pa_assert(segment < pa_mempool_get_n_segments(p));
     pa_assert(pa_mempool_is_shared(p));
     pa_assert(pa_mempool_is_memfd_backed(p));
     pa_assert(pa_mempool_is_global(p));
 
-    memfd_fd = p->memory.fd;
+    memfd_fd = p->segments[segment].memory.fd;
     pa_assert(memfd_fd != -1);
 
     return memfd_fd;
@@ -1265,7 +1717,7 @@ pa_memblock* pa_memimport_get(pa_memimport *i, pa_mem_type_t type, uint32_t bloc
     if (offset+size > seg->memory.size)
         goto finish;
 
-    if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
+    if (!(b = PA_STATIC_FLIST_POP(unused_memblocks)))
         b = pa_xnew(pa_memblock, 1);
 
     PA_REFCNT_INIT(b);
@@ -1498,7 +1950,7 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, pa_mem_type_t *type, uint3
         pa_assert(b->type == PA_MEMBLOCK_POOL || b->type == PA_MEMBLOCK_POOL_EXTERNAL);
         pa_assert(b->pool);
         pa_assert(pa_mempool_is_shared(b->pool));
-        memory = &b->pool->memory;
+        memory = &mempool_segment_by_ptr(b->pool, data)->memory;
     }
 
     pa_assert(data >= memory->ptr);
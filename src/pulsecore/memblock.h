@@ -27,6 +27,7 @@ typedef struct pa_memblock pa_memblock;
 #include <inttypes.h>
 
 #include <pulse/def.h>
+#include <pulse/mainloop-api.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/atomic.h>
 #include <pulsecore/memchunk.h>
@@ -57,6 +58,14 @@ typedef struct pa_memexport pa_memexport;
 typedef void (*pa_memimport_release_cb_t)(pa_memimport *i, uint32_t block_id, void *userdata);
 typedef void (*pa_memexport_revoke_cb_t)(pa_memexport *e, uint32_t block_id, void *userdata);
 
+/* The pool is split into classes of slots of different sizes, so that
+ * small blocks don't take up a whole large slot */
+#define PA_MEMPOOL_CLASSES_MAX 3
+
+/* A full pool can grow by more segments of the same size, up to this
+ * many in total */
+#define PA_MEMPOOL_SEGMENTS_MAX 8
+
 /* Please note that updates to this structure are not locked,
  * i.e. n_allocated might be updated at a point in time where
  * n_accumulated is not yet. Take these values with a grain of salt,
@@ -74,8 +83,24 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Blocks that did not fit into the pool and were allocated with
+     * malloc() instead, which have to be copied to be shared */
+    pa_atomic_t n_malloc_fallback;
+    pa_atomic_t n_segments;
+
+    /* Segments for which huge pages were requested. Whether the kernel
+     * actually found any shows in AnonHugePages or ShmemHugePages of
+     * /proc/<pid>/smaps. */
+    pa_atomic_t n_huge_pages_requested;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
+
+    /* Slots in use per class, smallest class first, and how often a
+     * class was full so that a larger one had to be used */
+    pa_atomic_t n_allocated_by_class[PA_MEMPOOL_CLASSES_MAX];
+    pa_atomic_t n_accumulated_by_class[PA_MEMPOOL_CLASSES_MAX];
+    pa_atomic_t n_class_full[PA_MEMPOOL_CLASSES_MAX];
 };
 
 /* Allocate a new memory block of type PA_MEMBLOCK_MEMPOOL or PA_MEMBLOCK_APPENDED, depending on the size */
@@ -107,6 +132,9 @@ manually if called from more than one thread at the same time. */
 void pa_memblock_unref_fixed(pa_memblock*b);
 
 bool pa_memblock_is_ours(pa_memblock *b);
+/* Where in shared memory the block lives. Fails if it would have to be
+ * copied into shared memory first. */
+int pa_memblock_get_shm_id(pa_memblock *b, pa_mem_type_t *type, uint32_t *shm_id);
 bool pa_memblock_is_read_only(pa_memblock *b);
 bool pa_memblock_is_silence(pa_memblock *b);
 bool pa_memblock_ref_is_one(pa_memblock *b);
@@ -125,11 +153,19 @@ pa_memblock *pa_memblock_will_need(pa_memblock *b);
 
 /* The memory block manager */
 pa_mempool *pa_mempool_new(pa_mem_type_t type, size_t size, bool per_client);
+pa_mempool *pa_mempool_new_with_block_size(pa_mem_type_t type, size_t size, size_t block_size_max, bool per_client);
 void pa_mempool_unref(pa_mempool *p);
 pa_mempool* pa_mempool_ref(pa_mempool *p);
 const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p);
 void pa_mempool_vacuum(pa_mempool *p);
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id);
+unsigned pa_mempool_get_n_segments(pa_mempool *p);
+int pa_mempool_get_segment_shm_id(pa_mempool *p, unsigned segment, uint32_t *id);
+void pa_mempool_set_max_segments(pa_mempool *p, unsigned n);
+void pa_mempool_set_grow_mainloop(pa_mempool *p, pa_mainloop_api *m);
+int pa_mempool_grow(pa_mempool *p);
+void pa_mempool_set_huge_pages(pa_mempool *p, bool huge_pages);
+void pa_mempool_prefault(pa_mempool *p);
 bool pa_mempool_is_shared(pa_mempool *p);
 bool pa_mempool_is_memfd_backed(const pa_mempool *p);
 bool pa_mempool_is_global(pa_mempool *p);
@@ -137,9 +173,10 @@ bool pa_mempool_is_per_client(pa_mempool *p);
 bool pa_mempool_is_remote_writable(pa_mempool *p);
 void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable);
 size_t pa_mempool_block_size_max(pa_mempool *p);
+int pa_mempool_get_class(pa_mempool *p, unsigned idx, size_t *slot_size, unsigned *n_slots);
 
-int pa_mempool_take_memfd_fd(pa_mempool *p);
-int pa_mempool_get_memfd_fd(pa_mempool *p);
+int pa_mempool_take_memfd_fd(pa_mempool *p, unsigned segment);
+int pa_mempool_get_memfd_fd(pa_mempool *p, unsigned segment);
 
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata);
@@ -30,29 +30,42 @@
 #include <pulsecore/log.h>
 #include <pulsecore/mcalign.h>
 #include <pulsecore/macro.h>
-#include <pulsecore/flist.h>
 
 #include "memblockq.h"
 
 /* #define MEMBLOCKQ_DEBUG */
 
+/* The queued blocks are kept sorted by index in a ring of descriptors,
+ * so that dropping played data is O(1) and blocks can be looked up by
+ * index with a binary search. Positions passed around in here are
+ * relative to the first block in the queue. */
 struct list_item {
-    struct list_item *next, *prev;
     int64_t index;
     pa_memchunk chunk;
 };
 
-PA_STATIC_FLIST_DECLARE(list_items, 0, pa_xfree);
+#define MEMBLOCKQ_ITEMS_MIN 16
+
+/* Chunks shorter than this are copied into a block of the queue's own
+ * when coalescing is enabled, so that consecutive small writes end up
+ * in a single queue entry. The block is small enough to still fit into
+ * the smallest slots of the memory pool. */
+#define MEMBLOCKQ_COALESCE_CHUNK_MAX 512
+#define MEMBLOCKQ_COALESCE_BLOCK_SIZE (3*1024)
 
 struct pa_memblockq {
-    struct list_item *blocks, *blocks_tail;
-    struct list_item *current_read, *current_write;
+    struct list_item *items;
+    unsigned n_items_max, first;
     unsigned n_blocks;
+    unsigned current_read;
     size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
     int64_t read_index, write_index;
     bool in_prebuf;
     pa_memchunk silence;
     pa_mcalign *mcalign;
+    bool coalesce;
+    pa_memblock *coalesce_block;
+    size_t coalesce_index;
     int64_t missing, requested;
     char *name;
     pa_sample_spec sample_spec;
@@ -102,6 +115,9 @@ pa_memblockq* pa_memblockq_new(
 
     bq->mcalign = pa_mcalign_new(bq->base);
 
+    bq->n_items_max = MEMBLOCKQ_ITEMS_MIN;
+    bq->items = pa_xnew(struct list_item, bq->n_items_max);
+
     return bq;
 }
 
@@ -116,112 +132,162 @@ void pa_memblockq_free(pa_memblockq* bq) {
     if (bq->mcalign)
         pa_mcalign_free(bq->mcalign);
 
+    if (bq->coalesce_block)
+        pa_memblock_unref(bq->coalesce_block);
+
+    pa_xfree(bq->items);
     pa_xfree(bq->name);
     pa_xfree(bq);
 }
 
-static void fix_current_read(pa_memblockq *bq) {
-    pa_assert(bq);
+static inline struct list_item* item_at(pa_memblockq *bq, unsigned i) {
+    return bq->items + ((bq->first + i) & (bq->n_items_max - 1));
+}
 
-    if (PA_UNLIKELY(!bq->blocks)) {
-        bq->current_read = NULL;
-        return;
-    }
+static inline int64_t item_end(struct list_item *q) {
+    return q->index + (int64_t) q->chunk.length;
+}
 
-    if (PA_UNLIKELY(!bq->current_read))
-        bq->current_read = bq->blocks;
+static inline struct list_item* last_item(pa_memblockq *bq) {
+    return bq->n_blocks > 0 ? item_at(bq, bq->n_blocks - 1) : NULL;
+}
+
+/* Returns whether i is the position of the first block that ends right
+ * of idx, i.e. the one containing idx or the next one following it */
+static bool is_block_for(pa_memblockq *bq, unsigned i, int64_t idx) {
 
-    /* Scan left */
-    while (PA_UNLIKELY(bq->current_read->index > bq->read_index))
+    if (i > bq->n_blocks)
+        return false;
 
-        if (bq->current_read->prev)
-            bq->current_read = bq->current_read->prev;
+    if (i < bq->n_blocks && item_end(item_at(bq, i)) <= idx)
+        return false;
+
+    return i == 0 || item_end(item_at(bq, i - 1)) <= idx;
+}
+
+/* Looks up the block for idx as described above, or n_blocks if all
+ * blocks end left of it. hint is checked first, as well as the block
+ * following it, before falling back to a binary search. */
+static unsigned find_block(pa_memblockq *bq, int64_t idx, unsigned hint) {
+    unsigned l, r;
+
+    if (is_block_for(bq, hint, idx))
+        return hint;
+
+    if (is_block_for(bq, hint + 1, idx))
+        return hint + 1;
+
+    l = 0;
+    r = bq->n_blocks;
+
+    while (l < r) {
+        unsigned m = l + (r - l) / 2;
+
+        if (item_end(item_at(bq, m)) <= idx)
+            l = m + 1;
         else
-            break;
+            r = m;
+    }
 
-    /* Scan right */
-    while (PA_LIKELY(bq->current_read != NULL) && PA_UNLIKELY(bq->current_read->index + (int64_t) bq->current_read->chunk.length <= bq->read_index))
-        bq->current_read = bq->current_read->next;
+    return l;
+}
+
+static void fix_current_read(pa_memblockq *bq) {
+    pa_assert(bq);
+
+    bq->current_read = find_block(bq, bq->read_index, bq->current_read);
 
     /* At this point current_read will either point at or left of the
-       next block to play. It may be NULL in case everything in
-       the queue was already played */
+       next block to play. It is n_blocks in case everything in the
+       queue was already played */
 }
 
-static void fix_current_write(pa_memblockq *bq) {
-    pa_assert(bq);
+static void grow_items(pa_memblockq *bq, unsigned n) {
+    struct list_item *items;
+    unsigned n_items_max, i;
+
+    n_items_max = bq->n_items_max;
+    while (n_items_max < n)
+        n_items_max *= 2;
 
-    if (PA_UNLIKELY(!bq->blocks)) {
-        bq->current_write = NULL;
+    if (n_items_max == bq->n_items_max)
         return;
-    }
 
-    if (PA_UNLIKELY(!bq->current_write))
-        bq->current_write = bq->blocks_tail;
+    items = pa_xnew(struct list_item, n_items_max);
 
-    /* Scan right */
-    while (PA_UNLIKELY(bq->current_write->index + (int64_t) bq->current_write->chunk.length <= bq->write_index))
+    for (i = 0; i < bq->n_blocks; i++)
+        items[i] = *item_at(bq, i);
 
-        if (bq->current_write->next)
-            bq->current_write = bq->current_write->next;
-        else
-            break;
+    pa_xfree(bq->items);
+    bq->items = items;
+    bq->n_items_max = n_items_max;
+    bq->first = 0;
+}
 
-    /* Scan left */
-    while (PA_LIKELY(bq->current_write != NULL) && PA_UNLIKELY(bq->current_write->index > bq->write_index))
-        bq->current_write = bq->current_write->prev;
+/* Makes room for n new blocks in front of position i */
+static void insert_items(pa_memblockq *bq, unsigned i, unsigned n) {
+    unsigned j;
 
-    /* At this point current_write will either point at or right of
-       the next block to write data to. It may be NULL in case
-       everything in the queue is still to be played */
-}
+    pa_assert(i <= bq->n_blocks);
 
-static void drop_block(pa_memblockq *bq, struct list_item *q) {
-    pa_assert(bq);
-    pa_assert(q);
+    grow_items(bq, bq->n_blocks + n);
 
-    pa_assert(bq->n_blocks >= 1);
+    if (i == 0) {
+        bq->first = (bq->first - n) & (bq->n_items_max - 1);
+        bq->n_blocks += n;
+    } else {
+        bq->n_blocks += n;
 
-    if (q->prev)
-        q->prev->next = q->next;
-    else {
-        pa_assert(bq->blocks == q);
-        bq->blocks = q->next;
+        for (j = bq->n_blocks - 1; j >= i + n; j--)
+            *item_at(bq, j) = *item_at(bq, j - n);
     }
 
-    if (q->next)
-        q->next->prev = q->prev;
-    else {
-        pa_assert(bq->blocks_tail == q);
-        bq->blocks_tail = q->prev;
-    }
+    if (bq->current_read >= i)
+        bq->current_read += n;
+}
 
-    if (bq->current_write == q)
-        bq->current_write = q->prev;
+/* Drops n blocks starting at position i */
+static void drop_blocks(pa_memblockq *bq, unsigned i, unsigned n) {
+    unsigned j;
 
-    if (bq->current_read == q)
-        bq->current_read = q->next;
+    pa_assert(i + n <= bq->n_blocks);
 
-    pa_memblock_unref(q->chunk.memblock);
+    if (n == 0)
+        return;
+
+    for (j = i; j < i + n; j++)
+        pa_memblock_unref(item_at(bq, j)->chunk.memblock);
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(list_items), q) < 0)
-        pa_xfree(q);
+    if (i == 0)
+        bq->first = (bq->first + n) & (bq->n_items_max - 1);
+    else
+        for (j = i; j + n < bq->n_blocks; j++)
+            *item_at(bq, j) = *item_at(bq, j + n);
 
-    bq->n_blocks--;
+    bq->n_blocks -= n;
+
+    if (bq->current_read >= i + n)
+        bq->current_read -= n;
+    else if (bq->current_read > i)
+        bq->current_read = i;
 }
 
 static void drop_backlog(pa_memblockq *bq) {
     int64_t boundary;
+    unsigned n;
     pa_assert(bq);
 
     boundary = bq->read_index - (int64_t) bq->maxrewind;
 
-    while (bq->blocks && (bq->blocks->index + (int64_t) bq->blocks->chunk.length <= boundary))
-        drop_block(bq, bq->blocks);
+    if (bq->n_blocks > 0 && item_end(item_at(bq, 0)) <= boundary) {
+        n = find_block(bq, boundary, bq->current_read);
+        drop_blocks(bq, 0, n);
+    }
 }
 
 static bool can_push(pa_memblockq *bq, size_t l) {
     int64_t end;
+    struct list_item *q;
 
     pa_assert(bq);
 
@@ -234,7 +300,7 @@ static bool can_push(pa_memblockq *bq, size_t l) {
             return true;
     }
 
-    end = bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->write_index;
+    end = (q = last_item(bq)) ? item_end(q) : bq->write_index;
 
     /* Make sure that the list doesn't get too long */
     if (bq->write_index + (int64_t) l > end)
@@ -274,10 +340,39 @@ static void read_index_changed(pa_memblockq *bq, int64_t old_read_index) {
 #endif
 }
 
+/* Copies the chunk to the end of the coalescing block, and makes it
+ * point there. Data already in the block is never touched again, so
+ * it doesn't matter who else still references it. */
+static void coalesce_chunk(pa_memblockq *bq, pa_memchunk *chunk) {
+    pa_memchunk tchunk;
+
+    if (!bq->coalesce_block ||
+        bq->coalesce_index + chunk->length > pa_memblock_get_length(bq->coalesce_block)) {
+        pa_mempool *pool;
+
+        if (bq->coalesce_block)
+            pa_memblock_unref(bq->coalesce_block);
+
+        pool = pa_memblock_get_pool(chunk->memblock);
+        bq->coalesce_block = pa_memblock_new(pool, (MEMBLOCKQ_COALESCE_BLOCK_SIZE / bq->base) * bq->base);
+        bq->coalesce_index = 0;
+        pa_mempool_unref(pool);
+    }
+
+    tchunk.memblock = bq->coalesce_block;
+    tchunk.index = bq->coalesce_index;
+    tchunk.length = chunk->length;
+    pa_memchunk_memcpy(&tchunk, chunk);
+
+    bq->coalesce_index += chunk->length;
+    *chunk = tchunk;
+}
+
 int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
-    struct list_item *q, *n;
+    struct list_item *q;
     pa_memchunk chunk;
-    int64_t old;
+    int64_t old, end;
+    unsigned i, j;
 
     pa_assert(bq);
     pa_assert(uchunk);
@@ -293,147 +388,98 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
 
     old = bq->write_index;
     chunk = *uchunk;
+    end = bq->write_index + (int64_t) chunk.length;
 
-    fix_current_write(bq);
-    q = bq->current_write;
-
-    /* First we advance the q pointer right of where we want to
-     * write to */
+    /* Contiguous small writes are merged with the previous entry below,
+     * once they are in the same block */
+    if (bq->coalesce && chunk.length < MEMBLOCKQ_COALESCE_CHUNK_MAX)
+        coalesce_chunk(bq, &chunk);
 
-    if (q) {
-        while (bq->write_index + (int64_t) chunk.length > q->index)
-            if (q->next)
-                q = q->next;
-            else
-                break;
-    }
+    /* Usually we just append at the end, so check that first */
+    if (!(q = last_item(bq)) || item_end(q) <= bq->write_index)
+        i = bq->n_blocks;
+    else
+        i = find_block(bq, bq->write_index, bq->current_read);
 
-    if (!q)
-        q = bq->blocks_tail;
+    /* Position i is now the first block we might overwrite */
 
-    /* We go from back to front to look for the right place to add
-     * this new entry. Drop data we will overwrite on the way */
+    if (i < bq->n_blocks && (q = item_at(bq, i))->index < bq->write_index) {
+        /* The write index points into this memblock, so let's
+         * truncate or split it */
 
-    while (q) {
+        if (end < item_end(q)) {
+            struct list_item *p;
+            size_t d;
 
-        if (bq->write_index >= q->index + (int64_t) q->chunk.length)
-            /* We found the entry where we need to place the new entry immediately after */
-            break;
-        else if (bq->write_index + (int64_t) chunk.length <= q->index) {
-            /* This entry isn't touched at all, let's skip it */
-            q = q->prev;
-        } else if (bq->write_index <= q->index &&
-                   bq->write_index + (int64_t) chunk.length >= q->index + (int64_t) q->chunk.length) {
+            /* We need to save the end of this memchunk, in a new
+             * entry right after it */
+            insert_items(bq, i + 1, 1);
+            q = item_at(bq, i);
+            p = item_at(bq, i + 1);
 
-            /* This entry is fully replaced by the new entry, so let's drop it */
+            p->chunk = q->chunk;
+            pa_memblock_ref(p->chunk.memblock);
 
-            struct list_item *p;
-            p = q;
-            q = q->prev;
-            drop_block(bq, p);
-        } else if (bq->write_index >= q->index) {
-            /* The write index points into this memblock, so let's
-             * truncate or split it */
-
-            if (bq->write_index + (int64_t) chunk.length < q->index + (int64_t) q->chunk.length) {
-
-                /* We need to save the end of this memchunk */
-                struct list_item *p;
-                size_t d;
-
-                /* Create a new list entry for the end of the memchunk */
-                if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
-                    p = pa_xnew(struct list_item, 1);
-
-                p->chunk = q->chunk;
-                pa_memblock_ref(p->chunk.memblock);
-
-                /* Calculate offset */
-                d = (size_t) (bq->write_index + (int64_t) chunk.length - q->index);
-                pa_assert(d > 0);
-
-                /* Drop it from the new entry */
-                p->index = q->index + (int64_t) d;
-                p->chunk.length -= d;
-
-                /* Add it to the list */
-                p->prev = q;
-                if ((p->next = q->next))
-                    q->next->prev = p;
-                else
-                    bq->blocks_tail = p;
-                q->next = p;
-
-                bq->n_blocks++;
-            }
-
-            /* Truncate the chunk */
-            if (!(q->chunk.length = (size_t) (bq->write_index - q->index))) {
-                struct list_item *p;
-                p = q;
-                q = q->prev;
-                drop_block(bq, p);
-            }
+            /* Calculate offset */
+            d = (size_t) (end - q->index);
+            pa_assert(d > 0);
 
-            /* We had to truncate this block, hence we're now at the right position */
-            break;
-        } else {
-            size_t d;
+            /* Drop it from the new entry */
+            p->index = q->index + (int64_t) d;
+            p->chunk.index += d;
+            p->chunk.length -= d;
+        }
 
-            pa_assert(bq->write_index + (int64_t)chunk.length > q->index &&
-                      bq->write_index + (int64_t)chunk.length < q->index + (int64_t)q->chunk.length &&
-                      bq->write_index < q->index);
+        /* Truncate the chunk */
+        q->chunk.length = (size_t) (bq->write_index - q->index);
+        i++;
+    }
 
-            /* The job overwrites the current entry at the end, so let's drop the beginning of this entry */
+    /* Drop all entries that are fully replaced by the new entry */
+    for (j = i; j < bq->n_blocks && item_end(item_at(bq, j)) <= end; j++)
+        ;
 
-            d = (size_t) (bq->write_index + (int64_t) chunk.length - q->index);
-            q->index += (int64_t) d;
-            q->chunk.index += d;
-            q->chunk.length -= d;
+    /* The new entry overwrites the following entry at its beginning,
+     * so drop that part of it */
+    if (j < bq->n_blocks && (q = item_at(bq, j))->index < end) {
+        size_t d;
 
-            q = q->prev;
-        }
+        d = (size_t) (end - q->index);
+        q->index += (int64_t) d;
+        q->chunk.index += d;
+        q->chunk.length -= d;
     }
 
-    if (q) {
-        pa_assert(bq->write_index >=  q->index + (int64_t)q->chunk.length);
-        pa_assert(!q->next || (bq->write_index + (int64_t)chunk.length <= q->next->index));
+    pa_assert(i == 0 || item_end(item_at(bq, i - 1)) <= bq->write_index);
+    pa_assert(j >= bq->n_blocks || end <= item_at(bq, j)->index);
 
-        /* Try to merge memory blocks */
+    /* Try to merge memory blocks */
+    if (i > 0) {
+        q = item_at(bq, i - 1);
 
         if (q->chunk.memblock == chunk.memblock &&
             q->chunk.index + q->chunk.length == chunk.index &&
-            bq->write_index == q->index + (int64_t) q->chunk.length) {
+            bq->write_index == item_end(q)) {
 
             q->chunk.length += chunk.length;
-            bq->write_index += (int64_t) chunk.length;
+            bq->write_index = end;
+            drop_blocks(bq, i, j - i);
             goto finish;
         }
-    } else
-        pa_assert(!bq->blocks || (bq->write_index + (int64_t)chunk.length <= bq->blocks->index));
-
-    if (!(n = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
-        n = pa_xnew(struct list_item, 1);
-
-    n->chunk = chunk;
-    pa_memblock_ref(n->chunk.memblock);
-    n->index = bq->write_index;
-    bq->write_index += (int64_t) n->chunk.length;
-
-    n->next = q ? q->next : bq->blocks;
-    n->prev = q;
-
-    if (n->next)
-        n->next->prev = n;
-    else
-        bq->blocks_tail = n;
+    }
 
-    if (n->prev)
-        n->prev->next = n;
-    else
-        bq->blocks = n;
+    if (j > i) {
+        /* Reuse the first of the entries we replace */
+        pa_memblock_unref(item_at(bq, i)->chunk.memblock);
+        drop_blocks(bq, i + 1, j - i - 1);
+    } else
+        insert_items(bq, i, 1);
 
-    bq->n_blocks++;
+    q = item_at(bq, i);
+    q->chunk = chunk;
+    pa_memblock_ref(q->chunk.memblock);
+    q->index = bq->write_index;
+    bq->write_index = end;
 
 finish:
 
@@ -472,6 +518,7 @@ static bool update_prebuf(pa_memblockq *bq) {
 }
 
 int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
+    struct list_item *q;
     int64_t d;
     pa_assert(bq);
     pa_assert(chunk);
@@ -481,14 +528,15 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
         return -1;
 
     fix_current_read(bq);
+    q = bq->current_read < bq->n_blocks ? item_at(bq, bq->current_read) : NULL;
 
     /* Do we need to spit out silence? */
-    if (!bq->current_read || bq->current_read->index > bq->read_index) {
+    if (!q || q->index > bq->read_index) {
         size_t length;
 
         /* How much silence shall we return? */
-        if (bq->current_read)
-            length = (size_t) (bq->current_read->index - bq->read_index);
+        if (q)
+            length = (size_t) (q->index - bq->read_index);
         else if (bq->write_index > bq->read_index)
             length = (size_t) (bq->write_index - bq->read_index);
         else
@@ -518,11 +566,11 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
     }
 
     /* Ok, let's pass real data to the caller */
-    *chunk = bq->current_read->chunk;
+    *chunk = q->chunk;
     pa_memblock_ref(chunk->memblock);
 
-    pa_assert(bq->read_index >= bq->current_read->index);
-    d = bq->read_index - bq->current_read->index;
+    pa_assert(bq->read_index >= q->index);
+    d = bq->read_index - q->index;
     chunk->index += (size_t) d;
     chunk->length -= (size_t) d;
 
@@ -533,7 +581,7 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
     pa_mempool *pool;
     pa_memchunk tchunk, rchunk;
     int64_t ri;
-    struct list_item *item;
+    unsigned i;
 
     pa_assert(bq);
     pa_assert(block_size > 0);
@@ -562,10 +610,11 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
 
     /* We don't need to call fix_current_read() here, since
      * pa_memblock_peek() already did that */
-    item = bq->current_read;
+    i = bq->current_read;
     ri = bq->read_index + tchunk.length;
 
     while (rchunk.index < block_size) {
+        struct list_item *item = i < bq->n_blocks ? item_at(bq, i) : NULL;
 
         if (!item || item->index > ri) {
             /* Do we need to append silence? */
@@ -585,7 +634,7 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
             tchunk.length -= (size_t) d;
 
             /* Go to next item for the next iteration */
-            item = item->next;
+            i++;
         }
 
         rchunk.length = tchunk.length = PA_MIN(tchunk.length, block_size - rchunk.index);
@@ -617,13 +666,13 @@ void pa_memblockq_drop(pa_memblockq *bq, size_t length) {
 
         fix_current_read(bq);
 
-        if (bq->current_read) {
+        if (bq->current_read < bq->n_blocks) {
             int64_t p, d;
 
             /* We go through this piece by piece to make sure we don't
              * drop more than allowed by prebuf */
 
-            p = bq->current_read->index + (int64_t) bq->current_read->chunk.length;
+            p = item_end(item_at(bq, bq->current_read));
             pa_assert(p >= bq->read_index);
             d = p - bq->read_index;
 
@@ -633,6 +682,11 @@ void pa_memblockq_drop(pa_memblockq *bq, size_t length) {
             bq->read_index += d;
             length -= (size_t) d;
 
+            /* If we're through with this block, the next one is where
+             * we continue */
+            if (bq->read_index == p)
+                bq->current_read++;
+
         } else {
 
             /* The list is empty, there's nothing we could drop */
@@ -697,7 +751,7 @@ void pa_memblockq_seek(pa_memblockq *bq, int64_t offset, pa_seek_mode_t seek, bo
             bq->write_index = bq->read_index + offset;
             break;
         case PA_SEEK_RELATIVE_END:
-            bq->write_index = (bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->read_index) + offset;
+            bq->write_index = (bq->n_blocks > 0 ? item_end(last_item(bq)) : bq->read_index) + offset;
             break;
         default:
             pa_assert_not_reached();
@@ -968,14 +1022,25 @@ int pa_memblockq_splice(pa_memblockq *bq, pa_memblockq *source) {
 }
 
 void pa_memblockq_willneed(pa_memblockq *bq) {
-    struct list_item *q;
+    unsigned i;
 
     pa_assert(bq);
 
     fix_current_read(bq);
 
-    for (q = bq->current_read; q; q = q->next)
-        pa_memchunk_will_need(&q->chunk);
+    for (i = bq->current_read; i < bq->n_blocks; i++)
+        pa_memchunk_will_need(&item_at(bq, i)->chunk);
+}
+
+void pa_memblockq_set_coalesce(pa_memblockq *bq, bool coalesce) {
+    pa_assert(bq);
+
+    bq->coalesce = coalesce;
+
+    if (!coalesce && bq->coalesce_block) {
+        pa_memblock_unref(bq->coalesce_block);
+        bq->coalesce_block = NULL;
+    }
 }
 
 void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
@@ -994,14 +1059,13 @@ void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
 bool pa_memblockq_is_empty(pa_memblockq *bq) {
     pa_assert(bq);
 
-    return !bq->blocks;
+    return bq->n_blocks == 0;
 }
 
 void pa_memblockq_silence(pa_memblockq *bq) {
     pa_assert(bq);
 
-    while (bq->blocks)
-        drop_block(bq, bq->blocks);
+    drop_blocks(bq, 0, bq->n_blocks);
 
     pa_assert(bq->n_blocks == 0);
 }
@@ -163,6 +163,11 @@ void pa_memblockq_set_prebuf(pa_memblockq *memblockq, size_t prebuf);
 void pa_memblockq_set_maxrewind(pa_memblockq *memblockq, size_t maxrewind); /* Set the maximum history size */
 void pa_memblockq_set_silence(pa_memblockq *memblockq, pa_memchunk *silence);
 
+/* Copy small chunks into larger blocks owned by the queue when they
+ * are pushed, so that consecutive small writes are merged into a
+ * single queue entry. Disabled by default. */
+void pa_memblockq_set_coalesce(pa_memblockq *bq, bool coalesce);
+
 /* Apply the data from pa_buffer_attr */
 void pa_memblockq_apply_attr(pa_memblockq *memblockq, const pa_buffer_attr *a);
 void pa_memblockq_get_attr(pa_memblockq *bq, pa_buffer_attr *a);
@@ -66,7 +66,7 @@ static void calc_linear_float_volume(float linear[], const pa_cvolume *volume) {
 }
 
 static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
-    unsigned k, channel;
+    unsigned k, channel, padding;
     float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
 
     pa_assert(streams);
@@ -76,16 +76,18 @@ static void calc_linear_integer_stream_volumes(pa_mix_info streams[], unsigned n
     calc_linear_float_volume(linear, volume);
 
     for (k = 0; k < nstreams; k++) {
+        pa_mix_info *m = streams + k;
 
-        for (channel = 0; channel < spec->channels; channel++) {
-            pa_mix_info *m = streams + k;
+        for (channel = 0; channel < spec->channels; channel++)
             m->linear[channel].i = (int32_t) lrint(pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel] * 0x10000);
-        }
+
+        for (padding = 0; padding < PA_MIX_LINEAR_PADDING; padding++, channel++)
+            m->linear[channel] = m->linear[padding];
     }
 }
 
 static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nstreams, const pa_cvolume *volume, const pa_sample_spec *spec) {
-    unsigned k, channel;
+    unsigned k, channel, padding;
     float linear[PA_CHANNELS_MAX + VOLUME_PADDING];
 
     pa_assert(streams);
@@ -95,11 +97,13 @@ static void calc_linear_float_stream_volumes(pa_mix_info streams[], unsigned nst
     calc_linear_float_volume(linear, volume);
 
     for (k = 0; k < nstreams; k++) {
+        pa_mix_info *m = streams + k;
 
-        for (channel = 0; channel < spec->channels; channel++) {
-            pa_mix_info *m = streams + k;
+        for (channel = 0; channel < spec->channels; channel++)
             m->linear[channel].f = (float) (pa_sw_volume_to_linear(m->volume.values[channel]) * linear[channel]);
-        }
+
+        for (padding = 0; padding < PA_MIX_LINEAR_PADDING; padding++, channel++)
+            m->linear[channel] = m->linear[padding];
     }
 }
 
@@ -214,12 +218,8 @@ static void pa_mix_ch2_s16ne(pa_mix_info streams[], unsigned nstreams, int16_t *
     }
 }
 
-static void pa_mix_generic_s16ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
-    unsigned channel = 0;
-
-    length /= sizeof(int16_t);
-
-    for (; length > 0; length--) {
+void pa_mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *data, unsigned n) {
+    for (; n > 0; n--) {
         int32_t sum = 0;
         unsigned i;
 
@@ -240,6 +240,10 @@ static void pa_mix_generic_s16ne(pa_mix_info streams[], unsigned nstreams, unsig
     }
 }
 
+static void pa_mix_generic_s16ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    pa_mix_s16ne_tail(streams, nstreams, channels, 0, data, length / sizeof(int16_t));
+}
+
 static void pa_mix_s16ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
     if (nstreams == 2 && channels == 1)
         pa_mix2_ch1_s16ne(streams, data, length);
@@ -279,12 +283,8 @@ static void pa_mix_s16re_c(pa_mix_info streams[], unsigned nstreams, unsigned ch
     }
 }
 
-static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
-    unsigned channel = 0;
-
-    length /= sizeof(int32_t);
-
-    for (; length > 0; length--, data++) {
+void pa_mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *data, unsigned n) {
+    for (; n > 0; n--, data++) {
         int64_t sum = 0;
         unsigned i;
 
@@ -309,6 +309,10 @@ static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned ch
     }
 }
 
+static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    pa_mix_s32ne_tail(streams, nstreams, channels, 0, data, length / sizeof(int32_t));
+}
+
 static void pa_mix_s32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
     unsigned channel = 0;
 
@@ -536,12 +540,8 @@ static void pa_mix_alaw_c(pa_mix_info streams[], unsigned nstreams, unsigned cha
     }
 }
 
-static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
-    unsigned channel = 0;
-
-    length /= sizeof(float);
-
-    for (; length > 0; length--, data++) {
+void pa_mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *data, unsigned n) {
+    for (; n > 0; n--, data++) {
         float sum = 0;
         unsigned i;
 
@@ -564,6 +564,10 @@ static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigne
     }
 }
 
+static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    pa_mix_float32ne_tail(streams, nstreams, channels, 0, data, length / sizeof(float));
+}
+
 static void pa_mix_float32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
     unsigned channel = 0;
 
@@ -606,9 +610,11 @@ static pa_do_mix_func_t do_mix_table[] = {
 };
 
 void pa_mix_func_init(const pa_cpu_info *cpu_info) {
+    /* Don't replace an optimized mixer that was registered by the
+     * CPU specific initialisation already */
     if (cpu_info->force_generic_code)
         do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_generic_s16ne;
-    else
+    else if (do_mix_table[PA_SAMPLE_S16NE] == (pa_do_mix_func_t) pa_mix_generic_s16ne)
         do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_s16ne_c;
 }
 
@@ -628,7 +634,7 @@ size_t pa_mix(
     pa_assert(data);
     pa_assert(length);
     pa_assert(spec);
-    pa_assert(nstreams > 1);
+    pa_assert(nstreams > 0);
 
     if (!volume)
         volume = pa_cvolume_reset(&full_volume, spec->channels);
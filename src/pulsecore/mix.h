@@ -26,6 +26,11 @@
 #include <pulse/volume.h>
 #include <pulsecore/memchunk.h>
 
+/* pa_mix() repeats the per-channel factors in pa_mix_info.linear for
+ * this many entries after the last channel, so that SIMD mixers can load
+ * a full vector of factors starting at any channel. */
+#define PA_MIX_LINEAR_PADDING 16
+
 typedef struct pa_mix_info {
     pa_memchunk chunk;
     pa_cvolume volume;
@@ -37,7 +42,7 @@ typedef struct pa_mix_info {
     union {
         int32_t i;
         float f;
-    } linear[PA_CHANNELS_MAX];
+    } linear[PA_CHANNELS_MAX + PA_MIX_LINEAR_PADDING];
 } pa_mix_info;
 
 size_t pa_mix(
@@ -54,6 +59,12 @@ typedef void (*pa_do_mix_func_t) (pa_mix_info streams[], unsigned nstreams, unsi
 pa_do_mix_func_t pa_get_mix_func(pa_sample_format_t f);
 void pa_set_mix_func(pa_sample_format_t f, pa_do_mix_func_t func);
 
+/* The reference mixers, for n samples starting at the given channel. SIMD
+ * mixers use them for whatever doesn't fill a whole vector. */
+void pa_mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int16_t *data, unsigned n);
+void pa_mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, int32_t *data, unsigned n);
+void pa_mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel, float *data, unsigned n);
+
 void pa_volume_memchunk(
     pa_memchunk*c,
     const pa_sample_spec *spec,
@@ -0,0 +1,186 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* These are the 256 bit variants of the mixers in mix_sse.c, see there
+ * for how the factors are loaded. Whatever doesn't fill a whole vector
+ * is left to the reference mixers in mix.c, continuing at the channel
+ * the vectors stopped. */
+
+__attribute__ ((target ("avx2")))
+static inline __m256i mult_s16_volume_avx2(__m256i s, __m256i v) {
+    __m256i sign, lo;
+
+    sign = _mm256_and_si256(_mm256_cmpgt_epi16(_mm256_setzero_si256(), s), v);
+    lo = _mm256_sub_epi32(_mm256_mulhi_epu16(s, v), sign);
+
+    return _mm256_add_epi32(lo, _mm256_madd_epi16(s, _mm256_srli_epi32(v, 16)));
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned channel = 0, n;
+
+    length /= sizeof(int16_t);
+
+    for (n = length / 16; n > 0; n--) {
+        __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256i s, f0, f1;
+
+            s = _mm256_loadu_si256((const __m256i *) m->ptr);
+            f0 = _mm256_loadu_si256((const __m256i *) &m->linear[channel].i);
+            f1 = _mm256_loadu_si256((const __m256i *) &m->linear[channel + 8].i);
+
+            /* unpack works within 128 bit lanes, arrange the factors
+             * accordingly: samples 0-3 and 8-11 go to the low unpack,
+             * 4-7 and 12-15 to the high one */
+            sum0 = _mm256_add_epi32(sum0, mult_s16_volume_avx2(_mm256_unpacklo_epi16(s, _mm256_setzero_si256()),
+                                                               _mm256_permute2x128_si256(f0, f1, 0x20)));
+            sum1 = _mm256_add_epi32(sum1, mult_s16_volume_avx2(_mm256_unpackhi_epi16(s, _mm256_setzero_si256()),
+                                                               _mm256_permute2x128_si256(f0, f1, 0x31)));
+
+            m->ptr = (uint8_t*) m->ptr + 16 * sizeof(int16_t);
+        }
+
+        /* packssdw works within 128 bit lanes as well, which restores the
+         * original sample order */
+        _mm256_storeu_si256((__m256i *) data, _mm256_packs_epi32(sum0, sum1));
+        data += 16;
+
+        channel += 16;
+        while (channel >= channels)
+            channel -= channels;
+    }
+
+    pa_mix_s16ne_tail(streams, nstreams, channels, channel, data, length % 16);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned channel = 0, n;
+
+    length /= sizeof(float);
+
+    for (n = length / 8; n > 0; n--) {
+        __m256 sum = _mm256_setzero_ps();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps((const float *) m->ptr), _mm256_loadu_ps(&m->linear[channel].f)));
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(float);
+        }
+
+        _mm256_storeu_ps(data, sum);
+        data += 8;
+
+        channel += 8;
+        while (channel >= channels)
+            channel -= channels;
+    }
+
+    pa_mix_float32ne_tail(streams, nstreams, channels, channel, data, length % 8);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i mult_s32_volume_avx2(__m256i s, __m256i v) {
+    __m256i p, sign;
+
+    p = _mm256_mul_epi32(s, v);
+    sign = _mm256_shuffle_epi32(_mm256_srai_epi32(p, 31), _MM_SHUFFLE(3, 3, 1, 1));
+
+    return _mm256_or_si256(_mm256_srli_epi64(p, 16), _mm256_slli_epi64(sign, 48));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i clamp_s64_to_s32_avx2(__m256i sum) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x80000000LL);
+
+    sum = _mm256_blendv_epi8(sum, max, _mm256_cmpgt_epi64(sum, max));
+    return _mm256_blendv_epi8(sum, min, _mm256_cmpgt_epi64(min, sum));
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned channel = 0, n;
+
+    length /= sizeof(int32_t);
+
+    for (n = length / 8; n > 0; n--) {
+        __m256i even = _mm256_setzero_si256(), odd = _mm256_setzero_si256();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m256i s, v;
+
+            s = _mm256_loadu_si256((const __m256i *) m->ptr);
+            v = _mm256_loadu_si256((const __m256i *) &m->linear[channel].i);
+
+            even = _mm256_add_epi64(even, mult_s32_volume_avx2(s, v));
+            odd = _mm256_add_epi64(odd, mult_s32_volume_avx2(_mm256_srli_epi64(s, 32), _mm256_srli_epi64(v, 32)));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int32_t);
+        }
+
+        /* Put the low halves of the clamped odd sums next to the even ones */
+        even = clamp_s64_to_s32_avx2(even);
+        odd = clamp_s64_to_s32_avx2(odd);
+        _mm256_storeu_si256((__m256i *) data, _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA));
+        data += 8;
+
+        channel += 8;
+        while (channel >= channels)
+            channel -= channels;
+    }
+
+    pa_mix_s32ne_tail(streams, nstreams, channels, channel, data, length % 8);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
+void pa_mix_func_init_avx2(pa_cpu_x86_flag_t flags) {
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized mixing functions.");
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+}
@@ -0,0 +1,184 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* All mixers here process the streams vector by vector. For each vector
+ * the factors are loaded from pa_mix_info.linear starting at the channel
+ * of the first sample, which is valid thanks to the padding pa_mix()
+ * appends to the factors. Whatever doesn't fill a whole vector is left
+ * to the reference mixers in mix.c. */
+
+/* Multiplies four s16 samples, zero-extended to 32 bit, with four 16.16
+ * fixed point factors. The low half of the factor is multiplied unsigned
+ * and corrected for negative samples, the high half with pmaddwd, which
+ * gives the same result as pa_mult_s16_volume(). */
+__attribute__ ((target ("sse2")))
+static inline __m128i mult_s16_volume_sse2(__m128i s, __m128i v) {
+    __m128i sign, lo;
+
+    sign = _mm_and_si128(_mm_cmpgt_epi16(_mm_setzero_si128(), s), v);
+    lo = _mm_sub_epi32(_mm_mulhi_epu16(s, v), sign);
+
+    return _mm_add_epi32(lo, _mm_madd_epi16(s, _mm_srli_epi32(v, 16)));
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_mix_s16ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    unsigned channel = 0, n;
+
+    length /= sizeof(int16_t);
+
+    for (n = length / 8; n > 0; n--) {
+        __m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m128i s, v0, v1;
+
+            s = _mm_loadu_si128((const __m128i *) m->ptr);
+            v0 = _mm_loadu_si128((const __m128i *) &m->linear[channel].i);
+            v1 = _mm_loadu_si128((const __m128i *) &m->linear[channel + 4].i);
+
+            sum0 = _mm_add_epi32(sum0, mult_s16_volume_sse2(_mm_unpacklo_epi16(s, _mm_setzero_si128()), v0));
+            sum1 = _mm_add_epi32(sum1, mult_s16_volume_sse2(_mm_unpackhi_epi16(s, _mm_setzero_si128()), v1));
+
+            m->ptr = (uint8_t*) m->ptr + 8 * sizeof(int16_t);
+        }
+
+        /* packssdw saturates, just like PA_CLAMP_UNLIKELY() */
+        _mm_storeu_si128((__m128i *) data, _mm_packs_epi32(sum0, sum1));
+        data += 8;
+
+        channel += 8;
+        while (channel >= channels)
+            channel -= channels;
+    }
+
+    pa_mix_s16ne_tail(streams, nstreams, channels, channel, data, length % 8);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_mix_float32ne_sse2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    unsigned channel = 0, n;
+
+    length /= sizeof(float);
+
+    for (n = length / 4; n > 0; n--) {
+        __m128 sum = _mm_setzero_ps();
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps((const float *) m->ptr), _mm_loadu_ps(&m->linear[channel].f)));
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(float);
+        }
+
+        _mm_storeu_ps(data, sum);
+        data += 4;
+
+        channel += 4;
+        while (channel >= channels)
+            channel -= channels;
+    }
+
+    pa_mix_float32ne_tail(streams, nstreams, channels, channel, data, length % 4);
+}
+
+/* (v * cv) >> 16 on the signed 64 bit products in the even lanes. SSE has
+ * no arithmetic 64 bit shift, so the sign is shifted in by hand. */
+__attribute__ ((target ("sse4.1")))
+static inline __m128i mult_s32_volume_sse4_1(__m128i s, __m128i v) {
+    __m128i p, sign;
+
+    p = _mm_mul_epi32(s, v);
+    sign = _mm_shuffle_epi32(_mm_srai_epi32(p, 31), _MM_SHUFFLE(3, 3, 1, 1));
+
+    return _mm_or_si128(_mm_srli_epi64(p, 16), _mm_slli_epi64(sign, 48));
+}
+
+__attribute__ ((target ("sse4.1")))
+static void pa_mix_s32ne_sse4_1(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    unsigned channel = 0, n;
+
+    length /= sizeof(int32_t);
+
+    for (n = length / 4; n > 0; n--) {
+        __m128i even = _mm_setzero_si128(), odd = _mm_setzero_si128();
+        PA_DECLARE_ALIGNED(16, int64_t, sum[4]);
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            pa_mix_info *m = streams + i;
+            __m128i s, v;
+
+            s = _mm_loadu_si128((const __m128i *) m->ptr);
+            v = _mm_loadu_si128((const __m128i *) &m->linear[channel].i);
+
+            even = _mm_add_epi64(even, mult_s32_volume_sse4_1(s, v));
+            odd = _mm_add_epi64(odd, mult_s32_volume_sse4_1(_mm_srli_epi64(s, 32), _mm_srli_epi64(v, 32)));
+
+            m->ptr = (uint8_t*) m->ptr + 4 * sizeof(int32_t);
+        }
+
+        /* There is no 64 bit compare before SSE4.2, clamp in C */
+        _mm_store_si128((__m128i *) &sum[0], _mm_unpacklo_epi64(even, odd));
+        _mm_store_si128((__m128i *) &sum[2], _mm_unpackhi_epi64(even, odd));
+
+        for (i = 0; i < 4; i++)
+            *data++ = (int32_t) PA_CLAMP_UNLIKELY(sum[i], -0x80000000LL, 0x7FFFFFFFLL);
+
+        channel += 4;
+        while (channel >= channels)
+            channel -= channels;
+    }
+
+    pa_mix_s32ne_tail(streams, nstreams, channels, channel, data, length % 4);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
+void pa_mix_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized mixing functions.");
+        pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse2);
+        pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse2);
+    }
+
+    if (flags & PA_CPU_X86_SSE4_1) {
+        pa_log_info("Initialising SSE4.1 optimized mixing functions.");
+        pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse4_1);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+}
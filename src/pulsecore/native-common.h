@@ -202,7 +202,7 @@ enum {
 #define PA_NATIVE_DEFAULT_UNIX_SOCKET "native"
 
 int pa_common_command_register_memfd_shmid(pa_pstream *p, pa_pdispatch *pd, uint32_t version,
-                                           uint32_t command, pa_tagstruct *t);
+                                           uint32_t command, uint32_t tag, pa_tagstruct *t);
 
 PA_C_DECL_END
 
@@ -37,6 +37,7 @@ struct pa_packet {
     enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
     size_t length;
     uint8_t *data;
+    pa_free_cb_t free_cb;
     union {
         uint8_t appended[MAX_APPENDED_SIZE];
     } per_type;
@@ -56,6 +57,7 @@ pa_packet* pa_packet_new(size_t length) {
     if (length > MAX_APPENDED_SIZE) {
         p->data = pa_xmalloc(length);
         p->type = PA_PACKET_DYNAMIC;
+        p->free_cb = pa_xfree;
     } else {
         p->data = p->per_type.appended;
         p->type = PA_PACKET_APPENDED;
@@ -76,10 +78,15 @@ pa_packet* pa_packet_new_data(const void* data, size_t length) {
 }
 
 pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
+    return pa_packet_new_user(data, length, pa_xfree);
+}
+
+pa_packet* pa_packet_new_user(void* data, size_t length, pa_free_cb_t free_cb) {
     pa_packet *p;
 
     pa_assert(data);
     pa_assert(length > 0);
+    pa_assert(free_cb);
 
     if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
         p = pa_xnew(pa_packet, 1);
@@ -87,6 +94,7 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     p->length = length;
     p->data = data;
     p->type = PA_PACKET_DYNAMIC;
+    p->free_cb = free_cb;
 
     return p;
 }
@@ -115,7 +123,7 @@ void pa_packet_unref(pa_packet *p) {
 
     if (PA_REFCNT_DEC(p) <= 0) {
         if (p->type == PA_PACKET_DYNAMIC)
-            pa_xfree(p->data);
+            p->free_cb(p->data);
         if (pa_flist_push(PA_STATIC_FLIST_GET(packets), p) < 0)
             pa_xfree(p);
     }
@@ -23,6 +23,8 @@
 #include <sys/types.h>
 #include <inttypes.h>
 
+#include <pulse/def.h>
+
 typedef struct pa_packet pa_packet;
 
 /* create empty packet (either of type appended or dynamic depending
@@ -37,6 +39,9 @@ pa_packet* pa_packet_new_data(const void* data, size_t length);
  * i.e. memory is free()d with the packet */
 pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
+/* like pa_packet_new_dynamic(), but the memory is released with free_cb */
+pa_packet* pa_packet_new_user(void* data, size_t length, pa_free_cb_t free_cb);
+
 const void* pa_packet_data(pa_packet *p, size_t *l);
 
 pa_packet* pa_packet_ref(pa_packet *p);
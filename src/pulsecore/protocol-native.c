@@ -73,6 +73,10 @@
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
 #define DEFAULT_FRAGSIZE_MSEC DEFAULT_TLENGTH_MSEC
 
+/* Limits for the srbchannel ringbuffer size clients may ask for */
+#define DEFAULT_SRBCHANNEL_MAX_SIZE (1024*1024) /* 1MB */
+#define SRBCHANNEL_MAX_SIZE_LIMIT (64*1024*1024) /* 64MB */
+
 struct pa_native_protocol;
 
 typedef struct record_stream {
@@ -100,6 +104,12 @@ typedef struct record_stream {
     size_t on_the_fly_snapshot;
     pa_usec_t current_monitor_latency;
     pa_usec_t current_source_latency;
+
+    /* Bytes sent to the client as references into shared memory, and
+     * bytes that had to be copied, as reported by the pstream. Only
+     * published when the stream is queried or goes away, see
+     * record_stream_update_proplist(). */
+    uint64_t zero_copy_bytes, copied_bytes;
 } record_stream;
 
 #define RECORD_STREAM(o) (record_stream_cast(o))
@@ -174,13 +184,21 @@ struct pa_native_connection {
     bool authorized:1;
     bool is_local:1;
     uint32_t version;
+    size_t srbchannel_size;
     pa_client *client;
     /* R/W mempool, one per client connection, for srbchannel transport.
-     * Both server and client can write to this shm area.
+     * Both server and client can write to this shm area. If the client
+     * asked for a ringbuffer size, its blocks are just large enough.
      *
      * Note: This will be NULL if our connection with the client does
      * not support srbchannels */
     pa_mempool *rw_mempool;
+    /* Read-only for the client, one per client connection, record
+     * data is rendered into it. Only there for memfd connections, and
+     * created with the first record stream.
+     *
+     * Note: Unlike the core's pool, no other client can read this */
+    pa_mempool *record_mempool;
     pa_pstream *pstream;
     pa_pdispatch *pdispatch;
     pa_idxset *record_streams, *output_streams;
@@ -326,6 +344,12 @@ static upload_stream* upload_stream_new(
     return s;
 }
 
+/* Called from main context */
+static void record_stream_update_proplist(record_stream *s) {
+    pa_proplist_setf(s->source_output->proplist, "native-protocol.record.zero-copy-bytes", "%llu", (unsigned long long) s->zero_copy_bytes);
+    pa_proplist_setf(s->source_output->proplist, "native-protocol.record.copied-bytes", "%llu", (unsigned long long) s->copied_bytes);
+}
+
 /* Called from main context */
 static void record_stream_unlink(record_stream *s) {
     pa_assert(s);
@@ -333,6 +357,12 @@ static void record_stream_unlink(record_stream *s) {
     if (!s->connection)
         return;
 
+    if (s->source_output)
+        record_stream_update_proplist(s);
+
+    pa_log_debug("Record stream %u sent %llu bytes without copying and copied %llu bytes.", s->index,
+                 (unsigned long long) s->zero_copy_bytes, (unsigned long long) s->copied_bytes);
+
     if (s->source_output) {
         pa_source_output_unlink(s->source_output);
         pa_source_output_unref(s->source_output);
@@ -496,6 +526,32 @@ static void fix_record_buffer_attr_post(record_stream *s) {
         s->buffer_attr.fragsize = s->buffer_attr.maxlength;
 }
 
+/* Called from main context */
+static pa_mempool* get_record_mempool(pa_native_connection *c) {
+    const char *reason;
+
+    if (c->record_mempool || !pa_pstream_get_memfd(c->pstream))
+        return c->record_mempool;
+
+    if (!(c->record_mempool = pa_mempool_new(PA_MEM_TYPE_SHARED_MEMFD, c->protocol->core->shm_size, true))) {
+        pa_log_warn("Failed to allocate record memory pool, using the core's.");
+        return NULL;
+    }
+
+    if (pa_pstream_register_memfd_mempool(c->pstream, c->record_mempool, &reason)) {
+        pa_log_warn("Failed to register record memory pool, using the core's. Reason: %s", reason);
+        pa_mempool_unref(c->record_mempool);
+        c->record_mempool = NULL;
+        return NULL;
+    }
+
+    if (c->protocol->core->shm_max_segments > 0)
+        pa_mempool_set_max_segments(c->record_mempool, c->protocol->core->shm_max_segments);
+    pa_mempool_set_grow_mainloop(c->record_mempool, c->protocol->core->mainloop);
+
+    return c->record_mempool;
+}
+
 /* Called from main context */
 static record_stream* record_stream_new(
         pa_native_connection *c,
@@ -554,6 +610,11 @@ static record_stream* record_stream_new(
         data.resample_method = PA_RESAMPLER_PEAKS;
     data.flags = flags;
 
+    /* Render converted data straight into a pool of this client, so
+     * that it can be handed over without a copy. Not into the
+     * srbchannel's pool, which the client can write to. */
+    data.mempool = get_record_mempool(c);
+
     *ret = -pa_source_output_new(&source_output, c->protocol->core, &data);
 
     pa_source_output_new_data_done(&data);
@@ -1026,7 +1087,9 @@ static playback_stream* playback_stream_new(
         data.save_muted = false;
     }
     data.sync_base = ssync ? ssync->sink_input : NULL;
-    data.flags = flags;
+    /* sink_input_pop_cb() only touches the stream itself and posts
+     * to the thread's queue, which takes multiple writers */
+    data.flags = flags | PA_SINK_INPUT_PARALLEL_PEEK;
 
     *ret = -pa_sink_input_new(&sink_input, c->protocol->core, &data);
 
@@ -1081,6 +1144,10 @@ static playback_stream* playback_stream_new(
     pa_xfree(memblockq_name);
     pa_memblock_unref(silence.memblock);
 
+    /* Clients like games and VoIP apps often write only a few hundred
+     * bytes at a time, don't hand them to the sink one by one */
+    pa_memblockq_set_coalesce(s->memblockq, true);
+
     pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
 
     *missing = (uint32_t) pa_memblockq_pop_missing(s->memblockq);
@@ -1225,8 +1292,14 @@ static void native_connection_free(pa_object *o) {
 
     pa_pdispatch_unref(c->pdispatch);
     pa_pstream_unref(c->pstream);
-    if (c->rw_mempool)
+    if (c->rw_mempool) {
+        pa_mempool_set_grow_mainloop(c->rw_mempool, NULL);
         pa_mempool_unref(c->rw_mempool);
+    }
+    if (c->record_mempool) {
+        pa_mempool_set_grow_mainloop(c->record_mempool, NULL);
+        pa_mempool_unref(c->record_mempool);
+    }
 
     pa_client_free(c->client);
 
@@ -2447,6 +2520,7 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
     pa_memchunk mc;
     pa_tagstruct *t;
     int fdlist[2];
+    size_t size = (size_t) -1;
 
 #ifndef HAVE_CREDS
     pa_log_debug("Disabling srbchannel, reason: No fd passing support");
@@ -2474,11 +2548,25 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         return;
     }
 
-    if (!(c->rw_mempool = pa_mempool_new(shm_type, c->protocol->core->shm_size, true))) {
+    if (c->srbchannel_size > 0) {
+        size_t block_size;
+
+        size = PA_MIN(c->srbchannel_size, c->options->srbchannel_max_size > 0 ?
+                                          (size_t) c->options->srbchannel_max_size : DEFAULT_SRBCHANNEL_MAX_SIZE);
+        block_size = pa_srbchannel_block_size(size);
+
+        c->rw_mempool = pa_mempool_new_with_block_size(shm_type, block_size, block_size, true);
+    } else
+        c->rw_mempool = pa_mempool_new(shm_type, c->protocol->core->shm_size, true);
+
+    if (!c->rw_mempool) {
         pa_log_warn("Disabling srbchannel, reason: Failed to allocate shared "
                     "writable memory pool.");
         return;
     }
+    if (c->protocol->core->shm_max_segments > 0)
+        pa_mempool_set_max_segments(c->rw_mempool, c->protocol->core->shm_max_segments);
+    pa_mempool_set_grow_mainloop(c->rw_mempool, c->protocol->core->mainloop);
 
     if (shm_type == PA_MEM_TYPE_SHARED_MEMFD) {
         const char *reason;
@@ -2489,12 +2577,18 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
     }
     pa_mempool_set_is_remote_writable(c->rw_mempool, true);
 
-    srb = pa_srbchannel_new(c->protocol->core->mainloop, c->rw_mempool);
+    /* Clients that don't ask for a size get the largest ringbuffers
+     * that fit into one block, unless that is more than the limit */
+    if (c->srbchannel_size == 0 && c->options->srbchannel_max_size > 0 &&
+        pa_srbchannel_block_size(c->options->srbchannel_max_size) <= pa_mempool_block_size_max(c->rw_mempool))
+        size = c->options->srbchannel_max_size;
+
+    srb = pa_srbchannel_new(c->protocol->core->mainloop, c->rw_mempool, size);
     if (!srb) {
         pa_log_debug("Failed to create srbchannel");
         goto fail;
     }
-    pa_log_debug("Enabling srbchannel...");
+    pa_log_debug("Enabling srbchannel with 2 * %zu bytes of ringbuffer...", pa_srbchannel_get_capacity(srb));
     pa_srbchannel_export(srb, &srbt);
 
     /* Send enable command to client */
@@ -2516,6 +2610,7 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
 
 fail:
     if (c->rw_mempool) {
+        pa_mempool_set_grow_mainloop(c->rw_mempool, NULL);
         pa_mempool_unref(c->rw_mempool);
         c->rw_mempool = NULL;
     }
@@ -2569,6 +2664,15 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
         if ((c->version & PA_PROTOCOL_VERSION_MASK) >= 31)
             memfd_on_remote = !!(c->version & PA_PROTOCOL_FLAG_MEMFD);
 
+        /* Starting with protocol version 33, the client may ask for the
+         * size of the srbchannel ringbuffers with a few more bits. */
+        if ((c->version & PA_PROTOCOL_VERSION_MASK) >= 33) {
+            unsigned l = (c->version & PA_PROTOCOL_FLAG_SRBCHANNEL_SIZE_MASK) >> PA_PROTOCOL_FLAG_SRBCHANNEL_SIZE_SHIFT;
+
+            if (l > 0)
+                c->srbchannel_size = (size_t) 1 << l;
+        }
+
         /* Reserve the two most-significant _bytes_ of the version tag
          * for flags. */
         c->version &= PA_PROTOCOL_VERSION_MASK;
@@ -2671,6 +2775,8 @@ static void command_auth(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_ta
     if (do_shm) {
         if (do_memfd && memfd_on_remote) {
             pa_pstream_enable_memfd(c->pstream);
+            if (c->version >= 33)
+                pa_pstream_enable_memfd_shmid_ack(c->pstream);
             shm_type = PA_MEM_TYPE_SHARED_MEMFD;
         } else
             shm_type = PA_MEM_TYPE_SHARED_POSIX;
@@ -2719,7 +2825,7 @@ static void command_register_memfd_shmid(pa_pdispatch *pd, uint32_t command, uin
     pa_native_connection_assert_ref(c);
     pa_assert(t);
 
-    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, t))
+    if (pa_common_command_register_memfd_shmid(c->pstream, pd, c->version, command, tag, t))
         protocol_error(c);
 }
 
@@ -3410,6 +3516,9 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_assert(t);
     pa_source_output_assert_ref(s);
 
+    if (s->push == source_output_push_cb)
+        record_stream_update_proplist(RECORD_STREAM(s->userdata));
+
     fixup_sample_spec(c, &fixed_ss, &s->sample_spec);
 
     has_volume = pa_source_output_is_volume_readable(s);
@@ -5072,6 +5181,22 @@ static void pstream_release_callback(pa_pstream *p, uint32_t block_id, void *use
         pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_RELEASE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
 }
 
+static void pstream_memblock_sent_callback(pa_pstream *p, uint32_t channel, size_t length, bool shared, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    record_stream *r;
+
+    pa_native_connection_assert_ref(c);
+
+    /* The stream might be gone by the time its last blocks are written */
+    if (!(r = RECORD_STREAM(pa_idxset_get_by_index(c->record_streams, channel))))
+        return;
+
+    if (shared)
+        r->zero_copy_bytes += length;
+    else
+        r->copied_bytes += length;
+}
+
 /*** client callbacks ***/
 
 static void client_kill_cb(pa_client *c) {
@@ -5171,6 +5296,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->is_local = pa_iochannel_socket_is_local(io);
     c->version = 8;
+    c->srbchannel_size = 0;
 
     c->client = client;
     c->client->kill = client_kill_cb;
@@ -5178,6 +5304,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     c->client->userdata = c;
 
     c->rw_mempool = NULL;
+    c->record_mempool = NULL;
 
     c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
     pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
@@ -5186,6 +5313,7 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_pstream_set_drain_callback(c->pstream, pstream_drain_callback, c);
     pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
     pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
+    pa_pstream_set_memblock_sent_callback(c->pstream, pstream_memblock_sent_callback, c);
 
     c->pdispatch = pa_pdispatch_new(p->core->mainloop, true, command_table, PA_COMMAND_MAX);
 
@@ -5388,6 +5516,17 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    o->srbchannel_max_size = 0;
+    if (pa_modargs_get_value_u32(ma, "srbchannel-max-size", &o->srbchannel_max_size) < 0) {
+        pa_log("srbchannel-max-size= expects a numerical argument.");
+        return -1;
+    }
+
+    if (o->srbchannel_max_size > SRBCHANNEL_MAX_SIZE_LIMIT) {
+        pa_log("srbchannel-max-size= may be at most %u bytes.", SRBCHANNEL_MAX_SIZE_LIMIT);
+        return -1;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "auth-anonymous", &o->auth_anonymous) < 0) {
         pa_log("auth-anonymous= expects a boolean argument.");
         return -1;
@@ -32,14 +32,23 @@
 
 static void pa_pstream_send_tagstruct_with_ancil_data(pa_pstream *p, pa_tagstruct *t, pa_cmsg_ancil_data *ancil_data) {
     size_t length;
-    const uint8_t *data;
+    uint8_t *data;
+    pa_free_cb_t free_cb;
     pa_packet *packet;
 
     pa_assert(p);
     pa_assert(t);
 
-    pa_assert_se(data = pa_tagstruct_data(t, &length));
-    pa_assert_se(packet = pa_packet_new_data(data, length));
+    /* Larger tagstructs hand their buffer over to the packet instead of
+     * having it copied, small ones fit into the packet's appended buffer */
+    if ((data = pa_tagstruct_steal_data(t, &length, &free_cb)))
+        pa_assert_se(packet = pa_packet_new_user(data, length, free_cb));
+    else {
+        const uint8_t *d;
+
+        pa_assert_se(d = pa_tagstruct_data(t, &length));
+        pa_assert_se(packet = pa_packet_new_data(d, length));
+    }
     pa_tagstruct_free(t);
 
     pa_pstream_send_packet(p, packet, ancil_data);
@@ -128,13 +137,17 @@ void pa_pstream_send_simple_ack(pa_pstream *p, uint32_t tag) {
  * between that ID and the passed memfd memory area.
  *
  * By doing so, we won't need to reference the pool's memfd fd any
- * further - just its ID. Both endpoints can then close their fds. */
+ * further - just its ID. Both endpoints can then close their fds.
+ *
+ * A pool that grew has a memfd region per segment. Segments that are
+ * already registered are skipped, so this is called again when new
+ * ones show up, see pa_pstream_send_memblock(). */
 int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool, const char **fail_reason) {
 #if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
-    unsigned shm_id;
+    unsigned shm_id, i;
     int memfd_fd, ret = -1;
     pa_tagstruct *t;
-    bool per_client_mempool;
+    bool per_client_mempool, ask_ack;
 
     pa_assert(p);
     pa_assert(fail_reason);
@@ -164,27 +177,43 @@ int pa_pstream_register_memfd_mempool(pa_pstream *p, pa_mempool *pool, const cha
         goto finish;
     }
 
-    memfd_fd = (per_client_mempool) ? pa_mempool_take_memfd_fd(pool) :
-                                      pa_mempool_get_memfd_fd(pool);
-
-    /* Note! For per-client mempools we've taken ownership of the memfd
-     * fd, and we're thus the sole code path responsible for closing it.
-     * In case of any failure, it MUST be closed. */
-
-    if (pa_pstream_attach_memfd_shmid(p, shm_id, memfd_fd)) {
-        *fail_reason = "could not attach memfd SHM ID to pipe";
-
-        if (per_client_mempool)
-            pa_assert_se(pa_close(memfd_fd) == 0);
-        goto finish;
+    for (i = 0; pa_mempool_get_segment_shm_id(pool, i, &shm_id) == 0; i++) {
+        if (pa_pstream_memfd_shmid_is_registered(p, shm_id))
+            continue;
+
+        memfd_fd = (per_client_mempool) ? pa_mempool_take_memfd_fd(pool, i) :
+                                          pa_mempool_get_memfd_fd(pool, i);
+
+        /* Note! For per-client mempools we've taken ownership of the memfd
+         * fd, and we're thus the sole code path responsible for closing it.
+         * In case of any failure, it MUST be closed. */
+
+        if (pa_pstream_attach_memfd_shmid(p, shm_id, memfd_fd)) {
+            *fail_reason = "could not attach memfd SHM ID to pipe";
+
+            if (per_client_mempool)
+                pa_assert_se(pa_close(memfd_fd) == 0);
+            goto finish;
+        }
+
+        /* Segments added by growing the pool may be registered while
+         * an srbchannel is in use, so ask for an acknowledgement for
+         * those, see pa_pstream_expect_memfd_shmid_ack(). Any tag other
+         * than -1 does that. Peers that can't acknowledge are sent
+         * copies of the blocks in those segments. */
+        ask_ack = false;
+        if (i > 0) {
+            pa_pstream_expect_memfd_shmid_ack(p, shm_id);
+            ask_ack = pa_pstream_get_memfd_shmid_ack(p);
+        }
+
+        t = pa_tagstruct_new();
+        pa_tagstruct_putu32(t, PA_COMMAND_REGISTER_MEMFD_SHMID);
+        pa_tagstruct_putu32(t, ask_ack ? 0 : (uint32_t) -1); /* tag */
+        pa_tagstruct_putu32(t, shm_id);
+        pa_pstream_send_tagstruct_with_fds(p, t, 1, &memfd_fd, per_client_mempool);
     }
 
-    t = pa_tagstruct_new();
-    pa_tagstruct_putu32(t, PA_COMMAND_REGISTER_MEMFD_SHMID);
-    pa_tagstruct_putu32(t, (uint32_t) -1); /* tag */
-    pa_tagstruct_putu32(t, shm_id);
-    pa_pstream_send_tagstruct_with_fds(p, t, 1, &memfd_fd, per_client_mempool);
-
     ret = 0;
 finish:
     pa_pstream_unref(p);
@@ -33,6 +33,7 @@
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/idxset.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/socket.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/log.h>
@@ -42,12 +43,14 @@
 #include <pulsecore/macro.h>
 
 #include "pstream.h"
+#include "pstream-util.h"
 
 /* We piggyback information if audio data blocks are stored in SHM on the seek mode */
 #define PA_FLAG_SHMDATA     0x80000000LU
 #define PA_FLAG_SHMDATA_MEMFD_BLOCK         0x20000000LU
 #define PA_FLAG_SHMRELEASE  0x40000000LU
 #define PA_FLAG_SHMREVOKE   0xC0000000LU
+#define PA_FLAG_SHMID_ACK   0x10000000LU
 #define PA_FLAG_SHMMASK     0xFF000000LU
 #define PA_FLAG_SEEKMASK    0x000000FFLU
 #define PA_FLAG_SHMWRITABLE 0x00800000LU
@@ -77,6 +80,11 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
 
 #define MINIBUF_SIZE (256)
 
+/* Up to this many queued items, but not many more bytes than this, are
+ * gathered into a single sendmsg() call */
+#define WRITE_BATCH_MAX (16)
+#define WRITE_BATCH_BYTES_MAX (64*1024)
+
 /* To allow uploading a single sample in one frame, this value should be the
  * same size (16 MB) as PA_SCACHE_ENTRY_SIZE_MAX from pulsecore/core-scache.h.
  */
@@ -89,7 +97,8 @@ struct item_info {
         PA_PSTREAM_ITEM_PACKET,
         PA_PSTREAM_ITEM_MEMBLOCK,
         PA_PSTREAM_ITEM_SHMRELEASE,
-        PA_PSTREAM_ITEM_SHMREVOKE
+        PA_PSTREAM_ITEM_SHMREVOKE,
+        PA_PSTREAM_ITEM_SHMID_ACK
     } type;
 
     /* packet info */
@@ -107,6 +116,21 @@ struct item_info {
 
     /* release/revoke info */
     uint32_t block_id;
+
+    /* memfd registration ack info */
+    uint32_t shm_id;
+};
+
+struct pstream_write {
+    union {
+        uint8_t minibuf[MINIBUF_SIZE];
+        pa_pstream_descriptor descriptor;
+    };
+    struct item_info* current;
+    void *data;
+    size_t index;
+    int minibuf_validsize;
+    pa_memchunk memchunk;
 };
 
 struct pstream_read {
@@ -131,17 +155,12 @@ struct pa_pstream {
 
     bool dead;
 
-    struct {
-        union {
-            uint8_t minibuf[MINIBUF_SIZE];
-            pa_pstream_descriptor descriptor;
-        };
-        struct item_info* current;
-        void *data;
-        size_t index;
-        int minibuf_validsize;
-        pa_memchunk memchunk;
-    } write;
+    struct pstream_write write;
+
+    /* Items already taken off the send queue and prepared to go out
+     * right behind the current one, kept as a ring */
+    struct pstream_write batch[WRITE_BATCH_MAX - 1];
+    unsigned batch_idx, n_batch;
 
     struct pstream_read readio, readsrb;
 
@@ -152,13 +171,26 @@ struct pa_pstream {
      * @use_memfd: pipe supports sending SHM memfd block references
      *
      * @registered_memfd_ids: registered memfd pools SHM IDs. Check
-     * pa_pstream_register_memfd_mempool() for more information. */
-    bool use_shm, use_memfd;
+     * pa_pstream_register_memfd_mempool() for more information.
+     *
+     * @unacked_memfd_ids: registered memfd SHM IDs the other end has
+     * not acknowledged yet. Blocks in them are sent as copies, see
+     * pa_pstream_expect_memfd_shmid_ack().
+     *
+     * @use_memfd_shmid_ack: the other end acknowledges memfd SHM IDs
+     * on request (protocol version >= 33) */
+    bool use_shm, use_memfd, use_memfd_shmid_ack;
     pa_idxset *registered_memfd_ids;
+    pa_idxset *unacked_memfd_ids;
 
     pa_memimport *import;
     pa_memexport *export;
 
+    /* Exports of blocks from pools other than ours, by pool. They are
+     * kept around so that such blocks stay alive until the other end
+     * releases them. */
+    pa_hashmap *pool_exports;
+
     pa_pstream_packet_cb_t receive_packet_callback;
     void *receive_packet_callback_userdata;
 
@@ -177,6 +209,12 @@ struct pa_pstream {
     pa_pstream_block_id_cb_t release_callback;
     void *release_callback_userdata;
 
+    pa_pstream_memblock_sent_cb_t memblock_sent_callback;
+    void *memblock_sent_callback_userdata;
+
+    /* Write calls on the iochannel so far */
+    unsigned n_writes;
+
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
@@ -375,6 +413,56 @@ int pa_pstream_attach_memfd_shmid(pa_pstream *p, unsigned shm_id, int memfd_fd)
     return 0;
 }
 
+bool pa_pstream_memfd_shmid_is_registered(pa_pstream *p, unsigned shm_id) {
+    pa_assert(p);
+
+    return p->registered_memfd_ids && pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
+static bool memfd_shmid_is_acked(pa_pstream *p, unsigned shm_id) {
+    return !p->unacked_memfd_ids || !pa_idxset_get_by_data(p->unacked_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
+/* The registration of a memfd region goes over the socket, because it
+ * carries the fd, while block references go over the srbchannel if
+ * there is one. The other end reads the two independently, so it might
+ * see a reference before the region it points into. For regions
+ * registered after the srbchannel might have been set up, the
+ * registration asks for an acknowledgement, and until that arrives
+ * blocks in the region are sent as copies. Peers that don't know about
+ * acknowledgements, see pa_pstream_enable_memfd_shmid_ack(), are not
+ * asked for one and get copies only. */
+void pa_pstream_expect_memfd_shmid_ack(pa_pstream *p, unsigned shm_id) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->unacked_memfd_ids);
+
+    pa_idxset_put(p->unacked_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL);
+}
+
+/* Pools grow by adding segments, which have their own memfd regions.
+ * If the pool of the block is registered with us, make sure all of its
+ * segments are, before the block is queued */
+static void register_grown_mempool(pa_pstream *p, pa_memblock *b) {
+    pa_mempool *pool;
+    uint32_t shm_id;
+    unsigned n;
+    const char *reason;
+
+    pool = pa_memblock_get_pool(b);
+
+    if (pa_mempool_is_memfd_backed(pool) &&
+        (n = pa_mempool_get_n_segments(pool)) > 1 &&
+        pa_mempool_get_shm_id(pool, &shm_id) == 0 && pa_pstream_memfd_shmid_is_registered(p, shm_id) &&
+        pa_mempool_get_segment_shm_id(pool, n - 1, &shm_id) == 0 && !pa_pstream_memfd_shmid_is_registered(p, shm_id)) {
+
+        if (pa_pstream_register_memfd_mempool(p, pool, &reason) < 0)
+            pa_log_warn("Failed to register new memfd pool segments: %s", reason);
+    }
+
+    pa_mempool_unref(pool);
+}
+
 static void item_free(void *item) {
     struct item_info *i = item;
     pa_assert(i);
@@ -413,6 +501,18 @@ static void pstream_free(pa_pstream *p) {
     if (p->write.memchunk.memblock)
         pa_memblock_unref(p->write.memchunk.memblock);
 
+    while (p->n_batch > 0) {
+        struct pstream_write *w = &p->batch[p->batch_idx];
+
+        item_free(w->current);
+
+        if (w->memchunk.memblock)
+            pa_memblock_unref(w->memchunk.memblock);
+
+        p->batch_idx = (p->batch_idx + 1) % PA_ELEMENTSOF(p->batch);
+        p->n_batch--;
+    }
+
     if (p->readsrb.memblock)
         pa_memblock_unref(p->readsrb.memblock);
 
@@ -428,6 +528,9 @@ static void pstream_free(pa_pstream *p) {
     if (p->registered_memfd_ids)
         pa_idxset_free(p->registered_memfd_ids, NULL);
 
+    if (p->unacked_memfd_ids)
+        pa_idxset_free(p->unacked_memfd_ids, NULL);
+
     pa_xfree(p);
 }
 
@@ -481,6 +584,9 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
     idx = 0;
     length = chunk->length;
 
+    if (p->use_memfd)
+        register_grown_mempool(p, chunk->memblock);
+
     bsm = pa_mempool_block_size_max(p->mempool);
 
     while (length > 0) {
@@ -571,6 +677,26 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
     p->mainloop->defer_enable(p->defer_event, 1);
 }
 
+void pa_pstream_send_memfd_shmid_ack(pa_pstream *p, unsigned shm_id) {
+    struct item_info *item;
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->dead)
+        return;
+
+    if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
+        item = pa_xnew(struct item_info, 1);
+    item->type = PA_PSTREAM_ITEM_SHMID_ACK;
+    item->shm_id = shm_id;
+#ifdef HAVE_CREDS
+    item->with_ancil_data = false;
+#endif
+
+    pa_queue_push(p->send_queue, item);
+    p->mainloop->defer_enable(p->defer_event, 1);
+}
+
 /* might be called from thread context */
 static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userdata) {
     pa_pstream *p = userdata;
@@ -584,77 +710,97 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
-    pa_assert(p);
-    pa_assert(PA_REFCNT_VALUE(p) > 0);
+static pa_memexport *get_pool_export(pa_pstream *p, pa_mempool *pool) {
+    pa_memexport *e;
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    if (pool == p->mempool) {
+        pa_assert(p->export);
+        return p->export;
+    }
 
-    if (!p->write.current)
-        return;
-    p->write.index = 0;
-    p->write.data = NULL;
-    p->write.minibuf_validsize = 0;
-    pa_memchunk_reset(&p->write.memchunk);
+    if (!p->pool_exports)
+        p->pool_exports = pa_hashmap_new_full(NULL, NULL, NULL, (pa_free_cb_t) pa_memexport_free);
+
+    if (!(e = pa_hashmap_get(p->pool_exports, pool))) {
+        pa_assert_se(e = pa_memexport_new(pool, memexport_revoke_cb, p));
+        pa_hashmap_put(p->pool_exports, pool, e);
+    }
 
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+    return e;
+}
 
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+static void prepare_write_item(pa_pstream *p, struct pstream_write *w, struct item_info *item) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(w);
+    pa_assert(item);
+
+    w->current = item;
+    w->index = 0;
+    w->data = NULL;
+    w->minibuf_validsize = 0;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
         size_t plen;
 
-        pa_assert(p->write.current->packet);
+        pa_assert(w->current->packet);
 
-        p->write.data = (void *) pa_packet_data(p->write.current->packet, &plen);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+        w->data = (void *) pa_packet_data(w->current->packet, &plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
 
         if (plen <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
-            memcpy(&p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], p->write.data, plen);
-            p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, plen);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
         }
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMID_ACK) {
+
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMID_ACK);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->shm_id);
 
     } else {
         uint32_t flags;
         bool send_payload = true;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             pa_mem_type_t type;
             uint32_t block_id, shm_id;
             size_t offset, length;
-            uint32_t *shm_info = (uint32_t *) &p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+            uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
             size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
-            pa_mempool *current_pool = pa_memblock_get_pool(p->write.current->chunk.memblock);
+            pa_mempool *current_pool = pa_memblock_get_pool(w->current->chunk.memblock);
             pa_memexport *current_export;
 
-            if (p->mempool == current_pool)
-                pa_assert_se(current_export = p->export);
-            else
-                pa_assert_se(current_export = pa_memexport_new(current_pool, memexport_revoke_cb, p));
+            current_export = get_pool_export(p, current_pool);
 
             if (pa_memexport_put(current_export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &type,
                                  &block_id,
                                  &shm_id,
@@ -666,8 +812,11 @@ static void prepare_next_write_item(pa_pstream *p) {
 
                 if (type == PA_MEM_TYPE_SHARED_MEMFD && p->use_memfd) {
                     if (pa_idxset_get_by_data(p->registered_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
-                        flags |= PA_FLAG_SHMDATA_MEMFD_BLOCK;
-                        send_payload = false;
+                        /* Not acknowledged yet: copy, see pa_pstream_expect_memfd_shmid_ack() */
+                        if (memfd_shmid_is_acked(p, shm_id)) {
+                            flags |= PA_FLAG_SHMDATA_MEMFD_BLOCK;
+                            send_payload = false;
+                        }
                     } else {
                         if (pa_log_ratelimit(PA_LOG_ERROR)) {
                             pa_log("Cannot send block reference with non-registered memfd ID = %u", shm_id);
@@ -685,29 +834,75 @@ static void prepare_next_write_item(pa_pstream *p) {
 
                     shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
                     shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                    shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                    shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-                    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
-                    p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+                    w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
                 }
             }
 /*             else */
 /*                 FIXME: Avoid memexport slot leaks. Call pa_memexport_process_release() */
 /*                 pa_log_warn("Failed to export memory block."); */
 
-            if (current_export != p->export)
-                pa_memexport_free(current_export);
             pa_mempool_unref(current_pool);
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+    }
+}
+
+/* Called once the current item has been written out completely */
+static void retire_write_item(pa_pstream *p) {
+    struct item_info *item;
+
+    pa_assert(p);
+    pa_assert(p->write.current);
+
+    item = p->write.current;
+    p->write.current = NULL;
+
+    if (item->type == PA_PSTREAM_ITEM_MEMBLOCK && p->memblock_sent_callback)
+        p->memblock_sent_callback(p, item->channel, item->chunk.length,
+                                  !!(ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS]) & PA_FLAG_SHMDATA),
+                                  p->memblock_sent_callback_userdata);
+
+    item_free(item);
+
+    if (p->write.memchunk.memblock)
+        pa_memblock_unref(p->write.memchunk.memblock);
+
+    pa_memchunk_reset(&p->write.memchunk);
+}
+
+static struct pstream_write *batch_item(pa_pstream *p, unsigned i) {
+    pa_assert(i < PA_ELEMENTSOF(p->batch));
+
+    return &p->batch[(p->batch_idx + i) % PA_ELEMENTSOF(p->batch)];
+}
+
+static void prepare_next_write_item(pa_pstream *p) {
+    struct item_info *item;
+
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    if (p->n_batch > 0) {
+        /* Items gathered by an earlier batched write are next in line */
+        p->write = p->batch[p->batch_idx];
+        p->batch_idx = (p->batch_idx + 1) % PA_ELEMENTSOF(p->batch);
+        p->n_batch--;
+    } else if ((item = pa_queue_pop(p->send_queue)))
+        prepare_write_item(p, &p->write, item);
+    else {
+        p->write.current = NULL;
+        return;
     }
 
 #ifdef HAVE_CREDS
@@ -726,9 +921,164 @@ static void check_srbpending(pa_pstream *p) {
     p->srb = p->srbpending;
     p->is_srbpending = false;
 
-    if (p->srb)
+    if (p->srb) {
+        /* do_pstream_read_write() always reads until the srbchannel is
+         * empty, and so does the pstream on the other end */
+        pa_srbchannel_set_batch_wakeups(p->srb, true);
         pa_srbchannel_set_callback(p->srb, srb_callback, p);
+    }
+}
+
+#ifdef HAVE_SYS_UIO_H
+/* Fills in up to two iovecs with whatever part of w has not been
+ * written yet. Returns the number of iovecs used. */
+static int fill_write_iovec(struct pstream_write *w, struct iovec *iov, size_t *l, pa_memblock **release_memblock) {
+    size_t length, offset;
+    int n = 0;
+
+    pa_assert(w);
+    pa_assert(w->current);
+
+    length = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]);
+    *l = length - w->index;
+    *release_memblock = NULL;
+
+    if (w->minibuf_validsize > 0) {
+        iov[0].iov_base = w->minibuf + w->index;
+        iov[0].iov_len = w->minibuf_validsize - w->index;
+        return 1;
+    }
+
+    if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        iov[n].iov_base = (uint8_t*) w->descriptor + w->index;
+        iov[n].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
+        n++;
+    }
+
+    offset = PA_MAX(w->index, PA_PSTREAM_DESCRIPTOR_SIZE);
+
+    if (length > offset) {
+        void *d;
+
+        pa_assert(w->data || w->memchunk.memblock);
+
+        if (w->data)
+            d = w->data;
+        else {
+            d = pa_memblock_acquire_chunk(&w->memchunk);
+            *release_memblock = w->memchunk.memblock;
+        }
+
+        iov[n].iov_base = (uint8_t*) d + offset - PA_PSTREAM_DESCRIPTOR_SIZE;
+        iov[n].iov_len = length - offset;
+        n++;
+    }
+
+    return n;
+}
+
+/* Writes the current item together with as many of the items queued
+ * behind it as possible, using a single system call. */
+static int do_write_batch(pa_pstream *p) {
+    struct iovec iov[2 * WRITE_BATCH_MAX];
+    pa_memblock *release_memblocks[WRITE_BATCH_MAX], *release_memblock;
+    unsigned i, n_release = 0;
+    int n_iov;
+    size_t l, total;
+    bool completed = false;
+    ssize_t r;
+
+    n_iov = fill_write_iovec(&p->write, iov, &total, &release_memblock);
+    if (release_memblock)
+        release_memblocks[n_release++] = release_memblock;
+
+    for (i = 0; total < WRITE_BATCH_BYTES_MAX; i++) {
+        struct pstream_write *w;
+
+        if (i == p->n_batch) {
+            struct item_info *item;
+
+            if (p->n_batch >= PA_ELEMENTSOF(p->batch) || !(item = pa_queue_pop(p->send_queue)))
+                break;
+
+            w = batch_item(p, p->n_batch++);
+            prepare_write_item(p, w, item);
+        } else
+            w = batch_item(p, i);
+
+#ifdef HAVE_CREDS
+        /* Ancillary data travels with the first byte of a message, so an
+         * item that carries some has to wait until it is the current one */
+        if (w->current->with_ancil_data)
+            break;
+#endif
+
+        n_iov += fill_write_iovec(w, iov + n_iov, &l, &release_memblock);
+        if (release_memblock)
+            release_memblocks[n_release++] = release_memblock;
+        total += l;
+    }
+
+#ifdef HAVE_CREDS
+    if (p->send_ancil_data_now) {
+        pa_assert(!p->write_ancil_data->creds_valid);
+
+        if ((r = pa_iochannel_writev_with_fds(p->io, iov, n_iov, p->write_ancil_data->nfd, p->write_ancil_data->fds)) < 0)
+            goto fail;
+
+        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
+        p->send_ancil_data_now = false;
+    } else
+#endif
+    if ((r = pa_iochannel_writev(p->io, iov, n_iov)) < 0)
+        goto fail;
+
+    p->n_writes++;
+
+    for (i = 0; i < n_release; i++)
+        pa_memblock_release(release_memblocks[i]);
+
+    /* Retire everything that went out completely */
+    l = (size_t) r;
+    for (;;) {
+        size_t left = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - p->write.index;
+
+        if (l < left) {
+            p->write.index += l;
+            l = 0;
+            break;
+        }
+
+        l -= left;
+
+        retire_write_item(p);
+        completed = true;
+
+        if (p->n_batch == 0)
+            break;
+
+        prepare_next_write_item(p);
+    }
+
+    pa_assert(l == 0);
+
+    if (completed && p->drain_callback && !pa_pstream_is_pending(p))
+        p->drain_callback(p, p->drain_callback_userdata);
+
+    return (size_t) r == total ? 1 : 0;
+
+fail:
+#ifdef HAVE_CREDS
+    if (p->send_ancil_data_now)
+        pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
+#endif
+
+    for (i = 0; i < n_release; i++)
+        pa_memblock_release(release_memblocks[i]);
+
+    return -1;
 }
+#endif
 
 static int do_write(pa_pstream *p) {
     void *d;
@@ -748,6 +1098,15 @@ static int do_write(pa_pstream *p) {
         return 0;
     }
 
+#ifdef HAVE_SYS_UIO_H
+    if (!p->srb
+#ifdef HAVE_CREDS
+        && !(p->send_ancil_data_now && p->write_ancil_data->creds_valid)
+#endif
+        )
+        return do_write_batch(p);
+#endif
+
     if (p->write.minibuf_validsize > 0) {
         d = p->write.minibuf + p->write.index;
         l = p->write.minibuf_validsize - p->write.index;
@@ -783,12 +1142,15 @@ static int do_write(pa_pstream *p) {
 
         pa_cmsg_ancil_data_close_fds(p->write_ancil_data);
         p->send_ancil_data_now = false;
+        p->n_writes++;
     } else
 #endif
     if (p->srb)
         r = pa_srbchannel_write(p->srb, d, l);
     else if ((r = pa_iochannel_write(p->io, d, l)) < 0)
         goto fail;
+    else
+        p->n_writes++;
 
     if (release_memblock)
         pa_memblock_release(release_memblock);
@@ -796,14 +1158,7 @@ static int do_write(pa_pstream *p) {
     p->write.index += (size_t) r;
 
     if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
-
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
-
-        pa_memchunk_reset(&p->write.memchunk);
+        retire_write_item(p);
 
         if (p->drain_callback && !pa_pstream_is_pending(p))
             p->drain_callback(p, p->drain_callback_userdata);
@@ -926,8 +1281,34 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
 
 /*             pa_log("Got release frame for %u", ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI])); */
 
+            uint32_t block_id = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]);
+
             pa_assert(p->export);
-            pa_memexport_process_release(p->export, ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]));
+
+            /* Block IDs are unique across all exports */
+            if (pa_memexport_process_release(p->export, block_id) < 0 && p->pool_exports) {
+                pa_memexport *e;
+                void *state;
+
+                PA_HASHMAP_FOREACH(e, p->pool_exports, state)
+                    if (pa_memexport_process_release(e, block_id) >= 0)
+                        break;
+            }
+
+            goto frame_done;
+
+        } else if (flags == PA_FLAG_SHMID_ACK) {
+
+            /* The other end has attached a memfd region we asked an
+             * acknowledgement for, references into it are safe now */
+
+            uint32_t shm_id = ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI]);
+
+            if (!p->use_memfd_shmid_ack ||
+                !pa_idxset_remove_by_data(p->unacked_memfd_ids, PA_UINT32_TO_PTR(shm_id), NULL)) {
+                pa_log_warn("Received unexpected memfd SHM ID acknowledgement.");
+                return -1;
+            }
 
             goto frame_done;
 
@@ -1148,6 +1529,14 @@ void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb,
     p->revoke_callback_userdata = userdata;
 }
 
+void pa_pstream_set_memblock_sent_callback(pa_pstream *p, pa_pstream_memblock_sent_cb_t cb, void *userdata) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->memblock_sent_callback = cb;
+    p->memblock_sent_callback_userdata = userdata;
+}
+
 bool pa_pstream_is_pending(pa_pstream *p) {
     bool b;
 
@@ -1157,7 +1546,7 @@ bool pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = false;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write.current || p->n_batch > 0 || !pa_queue_isempty(p->send_queue);
 
     return b;
 }
@@ -1194,6 +1583,11 @@ void pa_pstream_unlink(pa_pstream *p) {
         p->import = NULL;
     }
 
+    if (p->pool_exports) {
+        pa_hashmap_free(p->pool_exports);
+        p->pool_exports = NULL;
+    }
+
     if (p->export) {
         pa_memexport_free(p->export);
         p->export = NULL;
@@ -1213,6 +1607,7 @@ void pa_pstream_unlink(pa_pstream *p) {
     p->drain_callback = NULL;
     p->receive_packet_callback = NULL;
     p->receive_memblock_callback = NULL;
+    p->memblock_sent_callback = NULL;
 }
 
 void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
@@ -1228,6 +1623,11 @@ void pa_pstream_enable_shm(pa_pstream *p, bool enable) {
 
     } else {
 
+        if (p->pool_exports) {
+            pa_hashmap_free(p->pool_exports);
+            p->pool_exports = NULL;
+        }
+
         if (p->export) {
             pa_memexport_free(p->export);
             p->export = NULL;
@@ -1244,9 +1644,19 @@ void pa_pstream_enable_memfd(pa_pstream *p) {
 
     if (!p->registered_memfd_ids) {
         p->registered_memfd_ids = pa_idxset_new(NULL, NULL);
+        p->unacked_memfd_ids = pa_idxset_new(NULL, NULL);
     }
 }
 
+/* Only for peers with protocol version >= 33 */
+void pa_pstream_enable_memfd_shmid_ack(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->use_memfd);
+
+    p->use_memfd_shmid_ack = true;
+}
+
 bool pa_pstream_get_shm(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -1261,6 +1671,20 @@ bool pa_pstream_get_memfd(pa_pstream *p) {
     return p->use_memfd;
 }
 
+bool pa_pstream_get_memfd_shmid_ack(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    return p->use_memfd_shmid_ack;
+}
+
+unsigned pa_pstream_get_n_writes(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    return p->n_writes;
+}
+
 void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0 || srb == NULL);
@@ -238,6 +238,146 @@ static void remap_channels_matrix_float32ne_c(pa_remap_t *m, float *dst, const f
     }
 }
 
+pa_remap_matrix_t *pa_remap_matrix_new(const pa_remap_t *m) {
+    pa_remap_matrix_t *mx;
+    unsigned ic, oc, n_ic, n_oc, n_terms = 0;
+
+    pa_assert(m);
+
+    n_ic = m->i_ss.channels;
+    n_oc = m->o_ss.channels;
+
+    mx = pa_xnew0(pa_remap_matrix_t, 1);
+
+    for (ic = 0; ic < n_ic; ic++) {
+        bool used = false;
+
+        for (oc = 0; oc < n_oc; oc++) {
+            int32_t vol_i = PA_MIN(m->map_table_i[oc][ic], 0x10000);
+            float vol_f = PA_MIN(m->map_table_f[oc][ic], 1.0f);
+
+            /* The s16 and float tables don't necessarily agree on
+             * which factors are zero */
+            if (vol_i <= 0 && vol_f <= 0.0f)
+                continue;
+
+            used = true;
+            n_terms++;
+
+            if (oc >= PA_REMAP_VECTOR_CHANNELS)
+                continue;
+
+            mx->f[mx->n_ic][oc] = PA_MAX(vol_f, 0.0f);
+            mx->frac[mx->n_ic][oc] = vol_i > 0 && vol_i < 0x10000 ? (uint16_t) vol_i : 0;
+            mx->full[mx->n_ic][oc] = vol_i >= 0x10000 ? -1 : 0;
+        }
+
+        if (used)
+            mx->ic[mx->n_ic++] = (uint8_t) ic;
+    }
+
+    if (n_terms <= 2 * n_oc) {
+        for (oc = 0; oc < n_oc; oc++)
+            for (ic = 0; ic < n_ic; ic++) {
+                pa_remap_term_t *t = mx->terms + mx->n_terms;
+
+                t->vol_i = PA_MIN(m->map_table_i[oc][ic], 0x10000);
+                t->vol_f = PA_MIN(m->map_table_f[oc][ic], 1.0f);
+
+                if (t->vol_i <= 0 && t->vol_f <= 0.0f)
+                    continue;
+
+                t->ic = (uint8_t) ic;
+                t->oc = (uint8_t) oc;
+                t->vol_i = PA_MAX(t->vol_i, 0);
+                t->vol_f = PA_MAX(t->vol_f, 0.0f);
+                mx->n_terms++;
+            }
+    }
+
+    return mx;
+}
+
+/* Same as remap_channels_matrix_s16ne_c(), but a frame at a time, so that
+ * everything stays in registers */
+void pa_remap_matrix_s16ne_c(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned oc, k;
+
+    pa_assert(n_oc <= PA_REMAP_VECTOR_CHANNELS);
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        for (oc = 0; oc < n_oc; oc++) {
+            int16_t sum = 0;
+
+            for (k = 0; k < mx->n_ic; k++) {
+                int32_t s = src[mx->ic[k]];
+
+                if (mx->full[k][oc])
+                    sum += (int16_t) s;
+                else if (mx->frac[k][oc])
+                    sum += (int16_t) ((s * mx->frac[k][oc]) >> 16);
+            }
+
+            dst[oc] = sum;
+        }
+    }
+}
+
+void pa_remap_matrix_float32ne_c(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned oc, k;
+
+    pa_assert(n_oc <= PA_REMAP_VECTOR_CHANNELS);
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        for (oc = 0; oc < n_oc; oc++) {
+            float sum = 0.0f;
+
+            for (k = 0; k < mx->n_ic; k++)
+                sum += src[mx->ic[k]] * mx->f[k][oc];
+
+            dst[oc] = sum;
+        }
+    }
+}
+
+/* For matrices with few non-zero factors, e.g. upmixing: only the terms
+ * that contribute */
+static void remap_sparse_s16ne_c(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned t;
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        memset(dst, 0, n_oc * sizeof(int16_t));
+
+        for (t = 0; t < mx->n_terms; t++) {
+            const pa_remap_term_t *term = mx->terms + t;
+
+            if (term->vol_i >= 0x10000)
+                dst[term->oc] += src[term->ic];
+            else if (term->vol_i > 0)
+                dst[term->oc] += (int16_t) (((int32_t) src[term->ic] * term->vol_i) >> 16);
+        }
+    }
+}
+
+static void remap_sparse_float32ne_c(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned t;
+
+    for (; n > 0; n--, src += n_ic, dst += n_oc) {
+        memset(dst, 0, n_oc * sizeof(float));
+
+        for (t = 0; t < mx->n_terms; t++)
+            dst[mx->terms[t].oc] += src[mx->terms[t].ic] * mx->terms[t].vol_f;
+    }
+}
+
 /* Produce an array containing input channel indices to map to output channels.
  * If the output channel is empty, the array element is -1. */
 bool pa_setup_remap_arrange(const pa_remap_t *m, int8_t arrange[PA_CHANNELS_MAX]) {
@@ -429,6 +569,19 @@ static void init_remap_c(pa_remap_t *m) {
         /* setup state */
         m->state = pa_xnewdup(int8_t, arrange, PA_CHANNELS_MAX);
     } else {
+        pa_remap_matrix_t *mx = pa_remap_matrix_new(m);
+
+        if (mx->n_terms > 0) {
+            pa_log_info("Using sparse matrix remapping (%u factors)", mx->n_terms);
+            pa_set_remap_func(m, (pa_do_remap_func_t) remap_sparse_s16ne_c,
+                (pa_do_remap_func_t) remap_sparse_float32ne_c);
+
+            /* setup state */
+            m->state = mx;
+            return;
+        }
+
+        pa_xfree(mx);
 
         pa_log_info("Using generic matrix remapping");
         pa_set_remap_func(m, (pa_do_remap_func_t) remap_channels_matrix_s16ne_c,
@@ -57,4 +57,47 @@ bool pa_setup_remap_arrange(const pa_remap_t *m, int8_t arrange[PA_CHANNELS_MAX]
 void pa_set_remap_func(pa_remap_t *m, pa_do_remap_func_t func_s16,
     pa_do_remap_func_t func_float);
 
+/* Most output channels a vectorized generic remapper handles */
+#define PA_REMAP_VECTOR_CHANNELS 8
+
+typedef struct pa_remap_term {
+    uint8_t ic, oc;
+    int32_t vol_i;
+    float vol_f;
+} pa_remap_term_t;
+
+/* The matrix in the form the optimized generic remappers use, set up
+ * once at init. Factors are clamped the same way as by the C version:
+ * negative ones are ignored, ones above 1.0 used as 1.0. */
+typedef struct pa_remap_matrix {
+    /* Input channels with at least one non-zero factor */
+    unsigned n_ic;
+    uint8_t ic[PA_CHANNELS_MAX];
+
+    /* With up to PA_REMAP_VECTOR_CHANNELS output channels, a row of
+     * factors for all output channels for each input channel in ic[].
+     * For s16 the factor is split into a fraction and a mask that is
+     * set if the factor is 1.0. */
+    float f[PA_CHANNELS_MAX][PA_REMAP_VECTOR_CHANNELS];
+    uint16_t frac[PA_CHANNELS_MAX][PA_REMAP_VECTOR_CHANNELS];
+    int16_t full[PA_CHANNELS_MAX][PA_REMAP_VECTOR_CHANNELS];
+
+    /* If the matrix is sparse, i.e. there are no more than two
+     * non-zero factors per output channel on average, those factors
+     * ordered by output channel. Otherwise n_terms is 0, and only then
+     * are the vectorized remappers used. */
+    unsigned n_terms;
+    pa_remap_term_t terms[2 * PA_CHANNELS_MAX];
+} pa_remap_matrix_t;
+
+/* To be used as state of the remap functions */
+pa_remap_matrix_t *pa_remap_matrix_new(const pa_remap_t *m);
+
+/* Generic remapping with a matrix from pa_remap_matrix_new() and up to
+ * PA_REMAP_VECTOR_CHANNELS output channels, for the frames that are
+ * left over by vectorized versions. Gives the same results as the
+ * other C versions. */
+void pa_remap_matrix_s16ne_c(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n);
+void pa_remap_matrix_float32ne_c(pa_remap_t *m, float *dst, const float *src, unsigned n);
+
 #endif /* fooremapfoo */
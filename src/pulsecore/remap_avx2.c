@@ -0,0 +1,137 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/sample.h>
+#include <pulse/xmalloc.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "remap.h"
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* The 256 bit variants of the matrix remappers in remap_sse.c, see there.
+ * All output channels fit in one vector of floats. For s16, a vector
+ * holds two frames. */
+
+static pa_init_remap_func_t fallback_init_remap_func;
+
+__attribute__ ((target ("avx2")))
+static void remap_matrix_float32ne_avx2(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned k;
+
+    for (; n * n_oc >= 8; n--, src += n_ic, dst += n_oc) {
+        __m256 sum = _mm256_setzero_ps();
+
+        for (k = 0; k < mx->n_ic; k++)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_broadcast_ss(src + mx->ic[k]), _mm256_loadu_ps(mx->f[k])));
+
+        _mm256_storeu_ps(dst, sum);
+    }
+
+    pa_remap_matrix_float32ne_c(m, dst, src, n);
+}
+
+/* See mult_s16_sse2() */
+__attribute__ ((target ("avx2")))
+static inline __m256i mult_s16_avx2(__m256i s, __m256i frac, __m256i full) {
+    __m256i p = _mm256_mulhi_epu16(s, frac);
+
+    p = _mm256_sub_epi16(p, _mm256_and_si256(_mm256_srai_epi16(s, 15), frac));
+    return _mm256_add_epi16(p, _mm256_and_si256(s, full));
+}
+
+__attribute__ ((target ("avx2")))
+static void remap_matrix_s16ne_avx2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned k;
+
+    /* The second frame is stored last, so it must have room for 8 */
+    for (; n >= 2 && (n - 1) * n_oc >= 8; n -= 2, src += 2 * n_ic, dst += 2 * n_oc) {
+        __m256i sum = _mm256_setzero_si256();
+
+        for (k = 0; k < mx->n_ic; k++) {
+            __m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi16(src[mx->ic[k]])),
+                                                _mm_set1_epi16(src[n_ic + mx->ic[k]]), 1);
+
+            sum = _mm256_add_epi16(sum, mult_s16_avx2(s, _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) mx->frac[k])),
+                                                      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) mx->full[k]))));
+        }
+
+        _mm_storeu_si128((__m128i *) dst, _mm256_castsi256_si128(sum));
+        _mm_storeu_si128((__m128i *) (dst + n_oc), _mm256_extracti128_si256(sum, 1));
+    }
+
+    pa_remap_matrix_s16ne_c(m, dst, src, n);
+}
+
+static void init_remap_avx2(pa_remap_t *m) {
+    unsigned n_oc, n_ic;
+    int8_t arrange[PA_CHANNELS_MAX];
+
+    n_oc = m->o_ss.channels;
+    n_ic = m->i_ss.channels;
+
+    /* Same choice as the SSE2 version */
+    if (n_ic > 1 && n_oc > 1 && n_oc <= PA_REMAP_VECTOR_CHANNELS &&
+            !pa_setup_remap_arrange(m, arrange)) {
+        pa_remap_matrix_t *mx = pa_remap_matrix_new(m);
+
+        if (mx->n_terms == 0) {
+            pa_log_info("Using AVX2 matrix remapping");
+            pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_s16ne_avx2,
+                (pa_do_remap_func_t) remap_matrix_float32ne_avx2);
+
+            /* setup state */
+            m->state = mx;
+            return;
+        }
+
+        pa_xfree(mx);
+    }
+
+    if (fallback_init_remap_func)
+        fallback_init_remap_func(m);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
+void pa_remap_func_init_avx2(pa_cpu_x86_flag_t flags) {
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized remappers.");
+
+        /* Everything else is done by what was there before */
+        if (pa_get_init_remap_func() != init_remap_avx2)
+            fallback_init_remap_func = pa_get_init_remap_func();
+
+        pa_set_init_remap_func((pa_init_remap_func_t) init_remap_avx2);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+}
@@ -24,6 +24,7 @@
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -121,9 +122,90 @@ static void remap_mono_to_stereo_float32ne_sse2(pa_remap_t *m, float *dst, const
     );
 }
 
+#ifdef HAVE_X86_INTRINSICS
+
+#include <immintrin.h>
+
+/* Generic matrix remapping, a frame at a time: the output channels are
+ * the lanes, and every used input channel is broadcast and multiplied
+ * with its row of factors. The vectors are stored whole, which writes
+ * past the frame into the next one, so the last frames, where that
+ * would go past the end, are done in C. */
+
+__attribute__ ((target ("sse")))
+static void remap_matrix_float32ne_sse(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned k;
+
+    if (n_oc <= 4) {
+        for (; n * n_oc >= 4; n--, src += n_ic, dst += n_oc) {
+            __m128 sum = _mm_setzero_ps();
+
+            for (k = 0; k < mx->n_ic; k++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(src[mx->ic[k]]), _mm_loadu_ps(mx->f[k])));
+
+            _mm_storeu_ps(dst, sum);
+        }
+    } else {
+        for (; n * n_oc >= 8; n--, src += n_ic, dst += n_oc) {
+            __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+
+            for (k = 0; k < mx->n_ic; k++) {
+                __m128 s = _mm_set1_ps(src[mx->ic[k]]);
+
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(s, _mm_loadu_ps(mx->f[k])));
+                sum1 = _mm_add_ps(sum1, _mm_mul_ps(s, _mm_loadu_ps(mx->f[k] + 4)));
+            }
+
+            _mm_storeu_ps(dst, sum0);
+            _mm_storeu_ps(dst + 4, sum1);
+        }
+    }
+
+    pa_remap_matrix_float32ne_c(m, dst, src, n);
+}
+
+/* (s * frac) >> 16 for signed s and unsigned frac, or s where full is set,
+ * exactly like the C version */
+__attribute__ ((target ("sse2")))
+static inline __m128i mult_s16_sse2(__m128i s, __m128i frac, __m128i full) {
+    __m128i p = _mm_mulhi_epu16(s, frac);
+
+    p = _mm_sub_epi16(p, _mm_and_si128(_mm_srai_epi16(s, 15), frac));
+    return _mm_add_epi16(p, _mm_and_si128(s, full));
+}
+
+__attribute__ ((target ("sse2")))
+static void remap_matrix_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    const pa_remap_matrix_t *mx = m->state;
+    const unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;
+    unsigned k;
+
+    for (; n * n_oc >= 8; n--, src += n_ic, dst += n_oc) {
+        __m128i sum = _mm_setzero_si128();
+
+        for (k = 0; k < mx->n_ic; k++) {
+            __m128i s = _mm_set1_epi16(src[mx->ic[k]]);
+
+            sum = _mm_add_epi16(sum, mult_s16_sse2(s, _mm_loadu_si128((const __m128i *) mx->frac[k]),
+                                                   _mm_loadu_si128((const __m128i *) mx->full[k])));
+        }
+
+        _mm_storeu_si128((__m128i *) dst, sum);
+    }
+
+    pa_remap_matrix_s16ne_c(m, dst, src, n);
+}
+
+#endif /* HAVE_X86_INTRINSICS */
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
+#ifdef HAVE_X86_INTRINSICS
+    int8_t arrange[PA_CHANNELS_MAX];
+#endif
 
     n_oc = m->o_ss.channels;
     n_ic = m->i_ss.channels;
@@ -135,6 +217,25 @@ static void init_remap_sse2(pa_remap_t *m) {
         pa_log_info("Using SSE2 mono to stereo remapping");
         pa_set_remap_func(m, (pa_do_remap_func_t) remap_mono_to_stereo_s16ne_sse2,
             (pa_do_remap_func_t) remap_mono_to_stereo_float32ne_sse2);
+#ifdef HAVE_X86_INTRINSICS
+    } else if (n_ic > 1 && n_oc > 1 && n_oc <= PA_REMAP_VECTOR_CHANNELS &&
+            !pa_setup_remap_arrange(m, arrange)) {
+        pa_remap_matrix_t *mx = pa_remap_matrix_new(m);
+
+        /* Mono in or out, plain rearranging and sparse matrices are left
+         * to the special C versions */
+        if (mx->n_terms > 0) {
+            pa_xfree(mx);
+            return;
+        }
+
+        pa_log_info("Using SSE2 matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_matrix_s16ne_sse2,
+            (pa_do_remap_func_t) remap_matrix_float32ne_sse);
+
+        /* setup state */
+        m->state = mx;
+#endif
     }
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -23,9 +23,16 @@
 
 #include <string.h>
 
+#ifdef HAVE_SOXR
+#include <soxr.h>
+#endif
+
 #include <pulse/xmalloc.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/llist.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
@@ -34,6 +41,10 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Size of the scratch data of one tile in the widest stage, so that a
+ * tile stays in the L1 cache while it passes through all stages */
+#define TILE_BYTES (16*1024)
+
 struct ffmpeg_data { /* data specific to ffmpeg */
     struct AVResampleContext *state;
 };
@@ -118,6 +129,9 @@ static int (* const init_table[])(pa_resampler *r) = {
     [PA_RESAMPLER_SOXR_HQ]                 = NULL,
     [PA_RESAMPLER_SOXR_VHQ]                = NULL,
 #endif
+    [PA_RESAMPLER_POLYPHASE_LQ]            = pa_resampler_polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_MQ]            = pa_resampler_polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_HQ]            = pa_resampler_polyphase_init,
 };
 
 static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
@@ -125,10 +139,8 @@ static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
 
     if (pa_resample_method_supported(PA_RESAMPLER_SPEEX_FLOAT_BASE + 1))
         method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
-    else if (flags & PA_RESAMPLER_VARIABLE_RATE)
-        method = PA_RESAMPLER_TRIVIAL;
     else
-        method = PA_RESAMPLER_FFMPEG;
+        method = PA_RESAMPLER_POLYPHASE_LQ;
 
     return method;
 }
@@ -163,13 +175,23 @@ static pa_resample_method_t fix_method(
             }
             /* Else fall through */
         case PA_RESAMPLER_FFMPEG:
+            if (flags & PA_RESAMPLER_VARIABLE_RATE) {
+                pa_log_info("Resampler '%s' cannot do variable rate, reverting to resampler 'auto'.", pa_resample_method_to_string(method));
+                method = PA_RESAMPLER_AUTO;
+            }
+            break;
+
         case PA_RESAMPLER_SOXR_MQ:
         case PA_RESAMPLER_SOXR_HQ:
         case PA_RESAMPLER_SOXR_VHQ:
+#ifdef HAVE_SOXR
+#if SOXR_THIS_VERSION < SOXR_VERSION(0, 1, 2)
             if (flags & PA_RESAMPLER_VARIABLE_RATE) {
-                pa_log_info("Resampler '%s' cannot do variable rate, reverting to resampler 'auto'.", pa_resample_method_to_string(method));
+                pa_log_info("Resampler '%s' needs libsoxr 0.1.2 for variable rate, reverting to resampler 'auto'.", pa_resample_method_to_string(method));
                 method = PA_RESAMPLER_AUTO;
             }
+#endif
+#endif
             break;
 
         /* The Peaks resampler only supports downsampling.
@@ -406,6 +428,16 @@ pa_resampler* pa_resampler_new(
     }
     r->w_fz = pa_sample_size_of_format(r->work_format) * r->work_channels;
 
+    /* Tiling hasn't been shown to be faster yet, so it is only used when
+     * asked for */
+    if (flags & PA_RESAMPLER_TILED) {
+        unsigned max_channels = PA_MAX(a->channels, b->channels);
+        size_t max_fz = PA_MAX(r->i_fz, r->o_fz);
+
+        max_fz = PA_MAX(max_fz, r->w_sz * max_channels);
+        r->tile_frames = (unsigned) (TILE_BYTES / max_fz);
+    }
+
     pa_log_debug("Resampler:");
     pa_log_debug("  rate %d -> %d (method %s)", a->rate, b->rate, pa_resample_method_to_string(r->method));
     pa_log_debug("  format %s -> %s (intermediate %s)", pa_sample_format_to_string(a->format),
@@ -659,7 +691,10 @@ static const char * const resample_methods[] = {
     "peaks",
     "soxr-mq",
     "soxr-hq",
-    "soxr-vhq"
+    "soxr-vhq",
+    "polyphase-lq",
+    "polyphase-mq",
+    "polyphase-hq"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -1428,6 +1463,142 @@ static pa_memchunk *convert_from_work_format(pa_resampler *r, pa_memchunk *input
     return &r->from_work_format_buf;
 }
 
+/* Runs all stages on one tile of the input after the other, instead of
+ * every stage on the whole input. Apart from the input and the output
+ * block, the data only passes through small scratch buffers. What the
+ * resampler doesn't consume is kept in front of the next tile, and in the
+ * leftover buffer when the input is used up, just like in resample(). */
+static void run_tiled(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
+    pa_memchunk *pending_buf = r->leftover_buf;
+    unsigned in_n_frames, pending_n_frames = 0, out_max_n_frames, out_n_frames = 0, pos, n;
+    bool map_before, map_after, front, back;
+    uint8_t *in_data;
+
+    map_before = r->map_required && r->o_ss.channels <= r->i_ss.channels;
+    map_after = r->map_required && !map_before;
+    front = r->to_work_format_func || map_before;
+    back = r->from_work_format_func || map_after;
+
+    in_n_frames = (unsigned) (in->length / r->i_fz);
+
+    if (*r->have_leftover)
+        pending_n_frames = (unsigned) (pending_buf->length / r->w_fz);
+    *r->have_leftover = false;
+
+    out_max_n_frames = (unsigned) (((uint64_t) (in_n_frames + pending_n_frames) * r->o_ss.rate) / r->i_ss.rate) + EXTRA_FRAMES;
+    fit_buf(r, &r->from_work_format_buf, r->o_fz * out_max_n_frames, &r->from_work_format_buf_size, 0);
+
+    in_data = pa_memblock_acquire_chunk(in);
+
+    for (pos = 0; pos < in_n_frames; pos += n) {
+        pa_memchunk tile, result;
+        unsigned tile_n_frames, result_n_frames, leftover_n_frames;
+        uint8_t *src, *dst;
+
+        n = PA_MIN(r->tile_frames, in_n_frames - pos);
+        src = in_data + pos * r->i_fz;
+
+        if (!front && pending_n_frames == 0) {
+            /* Nothing to do before resampling, use the input as it is */
+            tile = *in;
+            tile.index += pos * r->i_fz;
+            tile.length = r->i_fz * n;
+            tile_n_frames = n;
+        } else {
+            fit_buf(r, pending_buf, r->w_fz * (pending_n_frames + n), r->leftover_buf_size, r->w_fz * pending_n_frames);
+            dst = (uint8_t *) pa_memblock_acquire(pending_buf->memblock) + r->w_fz * pending_n_frames;
+
+            if (r->to_work_format_func && map_before) {
+                void *tmp;
+
+                fit_buf(r, &r->to_work_format_buf, r->w_sz * r->i_ss.channels * n, &r->to_work_format_buf_size, 0);
+                tmp = pa_memblock_acquire(r->to_work_format_buf.memblock);
+                r->to_work_format_func(n * r->i_ss.channels, src, tmp);
+                r->remap.do_remap(&r->remap, dst, tmp, n);
+                pa_memblock_release(r->to_work_format_buf.memblock);
+            } else if (r->to_work_format_func)
+                r->to_work_format_func(n * r->i_ss.channels, src, dst);
+            else if (map_before)
+                r->remap.do_remap(&r->remap, dst, src, n);
+            else
+                memcpy(dst, src, r->w_fz * n);
+
+            pa_memblock_release(pending_buf->memblock);
+
+            tile = *pending_buf;
+            tile_n_frames = pending_n_frames + n;
+        }
+
+        /* Without later stages, the resampler writes to the output block */
+        if (back) {
+            result_n_frames = (unsigned) (((uint64_t) tile_n_frames * r->o_ss.rate) / r->i_ss.rate) + EXTRA_FRAMES;
+            result_n_frames = PA_MIN(result_n_frames, out_max_n_frames - out_n_frames);
+            fit_buf(r, &r->resample_buf, r->w_fz * result_n_frames, &r->resample_buf_size, 0);
+            result = r->resample_buf;
+        } else {
+            result_n_frames = out_max_n_frames - out_n_frames;
+            result = r->from_work_format_buf;
+            result.index += r->o_fz * out_n_frames;
+        }
+
+        leftover_n_frames = r->impl.resample(r, &tile, tile_n_frames, &result, &result_n_frames);
+
+        if (leftover_n_frames > 0) {
+            size_t offset = r->w_fz * (tile_n_frames - leftover_n_frames);
+
+            if (tile.memblock == pending_buf->memblock) {
+                dst = pa_memblock_acquire(pending_buf->memblock);
+                memmove(dst, dst + offset, r->w_fz * leftover_n_frames);
+                pa_memblock_release(pending_buf->memblock);
+            } else {
+                fit_buf(r, pending_buf, r->w_fz * leftover_n_frames, r->leftover_buf_size, 0);
+                dst = pa_memblock_acquire(pending_buf->memblock);
+                memcpy(dst, src + offset, r->w_fz * leftover_n_frames);
+                pa_memblock_release(pending_buf->memblock);
+            }
+        }
+
+        pending_n_frames = leftover_n_frames;
+
+        if (back && result_n_frames > 0) {
+            src = pa_memblock_acquire(r->resample_buf.memblock);
+            dst = (uint8_t *) pa_memblock_acquire(r->from_work_format_buf.memblock) + r->o_fz * out_n_frames;
+
+            if (map_after && r->from_work_format_func) {
+                void *tmp;
+
+                fit_buf(r, &r->remap_buf, r->w_sz * r->o_ss.channels * result_n_frames, &r->remap_buf_size, 0);
+                tmp = pa_memblock_acquire(r->remap_buf.memblock);
+                r->remap.do_remap(&r->remap, tmp, src, result_n_frames);
+                r->from_work_format_func(result_n_frames * r->o_ss.channels, tmp, dst);
+                pa_memblock_release(r->remap_buf.memblock);
+            } else if (map_after)
+                r->remap.do_remap(&r->remap, dst, src, result_n_frames);
+            else
+                r->from_work_format_func(result_n_frames * r->o_ss.channels, src, dst);
+
+            pa_memblock_release(r->from_work_format_buf.memblock);
+            pa_memblock_release(r->resample_buf.memblock);
+        }
+
+        out_n_frames += result_n_frames;
+    }
+
+    pa_memblock_release(in->memblock);
+
+    if (pending_n_frames > 0) {
+        pending_buf->length = r->w_fz * pending_n_frames;
+        *r->have_leftover = true;
+    }
+
+    if (out_n_frames > 0) {
+        *out = r->from_work_format_buf;
+        out->length = r->o_fz * out_n_frames;
+        pa_memchunk_reset(&r->from_work_format_buf);
+    } else
+        pa_memchunk_reset(out);
+}
+
 void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
     pa_memchunk *buf;
 
@@ -1438,6 +1609,13 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
     pa_assert(in->memblock);
     pa_assert(in->length % r->i_fz == 0);
 
+    /* The LFE filter keeps a copy of every block it processes for
+     * rewinding, so it needs them whole */
+    if (r->impl.resample && !r->lfe_filter && r->tile_frames > 0) {
+        run_tiled(r, in, out);
+        return;
+    }
+
     buf = (pa_memchunk*) in;
     buf = convert_to_work_format(r, buf);
 
@@ -1466,6 +1644,195 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
         pa_memchunk_reset(out);
 }
 
+/*** shared coefficient cache ***/
+
+/* Filter tables only depend on a few parameters and are never modified
+ * once computed, so resamplers with the same parameters share them, no
+ * matter which core or thread they belong to. Streams come and go with
+ * the same few rates, so when the last reference goes away an entry is
+ * kept around, least recently released first to go, until the unused
+ * ones exceed CACHE_UNUSED_SIZE_MAX or the cache is flushed. */
+
+#define CACHE_UNUSED_SIZE_MAX (1024*1024)
+
+typedef struct cache_entry cache_entry;
+
+struct cache_entry {
+    char *key;
+    void *data;
+    size_t size;
+    unsigned ref;
+    pa_free_cb_t free_cb;
+
+    /* Only linked while ref is 0, most recently released first */
+    PA_LLIST_FIELDS(cache_entry);
+};
+
+static pa_static_mutex cache_mutex = PA_STATIC_MUTEX_INIT;
+static pa_hashmap *cache_by_key = NULL, *cache_by_data = NULL;
+static PA_LLIST_HEAD(cache_entry, cache_unused) = NULL;
+static pa_resampler_cache_stat cache_stat;
+
+static void cache_entry_free(cache_entry *e) {
+    e->free_cb(e->data);
+    pa_xfree(e->key);
+    pa_xfree(e);
+}
+
+/* Called with cache_mutex held. Unlinks e and hands it over to the
+ * caller to free once the mutex is released. */
+static void cache_entry_unlink(cache_entry *e, cache_entry **freelist) {
+    pa_assert(e->ref == 0);
+
+    PA_LLIST_REMOVE(cache_entry, cache_unused, e);
+    cache_stat.n_unused--;
+    cache_stat.unused_size -= e->size;
+
+    pa_hashmap_remove(cache_by_key, e->key);
+    pa_hashmap_remove(cache_by_data, e->data);
+    cache_stat.n_entries--;
+    cache_stat.size -= e->size;
+
+    if (pa_hashmap_isempty(cache_by_key)) {
+        pa_hashmap_free(cache_by_key);
+        pa_hashmap_free(cache_by_data);
+        cache_by_key = cache_by_data = NULL;
+    }
+
+    PA_LLIST_PREPEND(cache_entry, *freelist, e);
+}
+
+static void cache_free_list(cache_entry *freelist) {
+    cache_entry *e, *n;
+
+    PA_LLIST_FOREACH_SAFE(e, n, freelist)
+        cache_entry_free(e);
+}
+
+const void *pa_resampler_cache_get(const char *key, void *(*create)(void *userdata, size_t *size), pa_free_cb_t free_cb, void *userdata) {
+    pa_mutex *m;
+    cache_entry *e, *other;
+
+    pa_assert(key);
+    pa_assert(create);
+    pa_assert(free_cb);
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+    pa_mutex_lock(m);
+
+    if (cache_by_key && (e = pa_hashmap_get(cache_by_key, key))) {
+        if (e->ref++ == 0) {
+            PA_LLIST_REMOVE(cache_entry, cache_unused, e);
+            cache_stat.n_unused--;
+            cache_stat.unused_size -= e->size;
+        }
+
+        cache_stat.n_hits++;
+        pa_mutex_unlock(m);
+        return e->data;
+    }
+
+    cache_stat.n_misses++;
+    pa_mutex_unlock(m);
+
+    /* Computing a table takes a while, don't block others meanwhile */
+    e = pa_xnew0(cache_entry, 1);
+    e->key = pa_xstrdup(key);
+    e->data = create(userdata, &e->size);
+    e->ref = 1;
+    e->free_cb = free_cb;
+
+    pa_mutex_lock(m);
+
+    if (!cache_by_key) {
+        cache_by_key = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+        cache_by_data = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    }
+
+    /* Somebody else was quicker */
+    if ((other = pa_hashmap_get(cache_by_key, key))) {
+        if (other->ref++ == 0) {
+            PA_LLIST_REMOVE(cache_entry, cache_unused, other);
+            cache_stat.n_unused--;
+            cache_stat.unused_size -= other->size;
+        }
+
+        pa_mutex_unlock(m);
+
+        cache_entry_free(e);
+        return other->data;
+    }
+
+    pa_assert_se(pa_hashmap_put(cache_by_key, e->key, e) >= 0);
+    pa_assert_se(pa_hashmap_put(cache_by_data, e->data, e) >= 0);
+    cache_stat.n_entries++;
+    cache_stat.size += e->size;
+
+    pa_mutex_unlock(m);
+
+    return e->data;
+}
+
+void pa_resampler_cache_release(const void *data) {
+    pa_mutex *m;
+    cache_entry *e, *last, *freelist = NULL;
+
+    pa_assert(data);
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+    pa_mutex_lock(m);
+
+    pa_assert(cache_by_data);
+    pa_assert_se(e = pa_hashmap_get(cache_by_data, data));
+
+    if (--e->ref > 0) {
+        pa_mutex_unlock(m);
+        return;
+    }
+
+    PA_LLIST_PREPEND(cache_entry, cache_unused, e);
+    cache_stat.n_unused++;
+    cache_stat.unused_size += e->size;
+
+    /* Evict from the least recently released end */
+    while (cache_stat.unused_size > CACHE_UNUSED_SIZE_MAX) {
+        for (last = cache_unused; last->next; last = last->next)
+            ;
+
+        cache_entry_unlink(last, &freelist);
+    }
+
+    pa_mutex_unlock(m);
+
+    cache_free_list(freelist);
+}
+
+void pa_resampler_cache_flush(void) {
+    pa_mutex *m;
+    cache_entry *freelist = NULL;
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+    pa_mutex_lock(m);
+
+    while (cache_unused)
+        cache_entry_unlink(cache_unused, &freelist);
+
+    pa_mutex_unlock(m);
+
+    cache_free_list(freelist);
+}
+
+void pa_resampler_cache_get_stat(pa_resampler_cache_stat *stat) {
+    pa_mutex *m;
+
+    pa_assert(stat);
+
+    m = pa_static_mutex_get(&cache_mutex, false, true);
+    pa_mutex_lock(m);
+    *stat = cache_stat;
+    pa_mutex_unlock(m);
+}
+
 /*** copy (noop) implementation ***/
 
 static int copy_init(pa_resampler *r) {
@@ -61,6 +61,9 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_SOXR_MQ,
     PA_RESAMPLER_SOXR_HQ,
     PA_RESAMPLER_SOXR_VHQ,
+    PA_RESAMPLER_POLYPHASE_LQ,
+    PA_RESAMPLER_POLYPHASE_MQ,
+    PA_RESAMPLER_POLYPHASE_HQ,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -70,6 +73,7 @@ typedef enum pa_resample_flags {
     PA_RESAMPLER_NO_REMIX      = 0x0004U,
     PA_RESAMPLER_NO_LFE        = 0x0008U,
     PA_RESAMPLER_NO_FILL_SINK  = 0x0010U,
+    PA_RESAMPLER_TILED         = 0x0020U,  /* run the stages in cache-sized tiles */
 } pa_resample_flags_t;
 
 struct pa_resampler {
@@ -110,6 +114,10 @@ struct pa_resampler {
 
     pa_lfe_filter_t *lfe_filter;
 
+    /* Frames per tile of the tiled pipeline, 0 to always run the stages
+     * on whole blocks, which is what happens without PA_RESAMPLER_TILED */
+    unsigned tile_frames;
+
     pa_resampler_impl impl;
 };
 
@@ -166,6 +174,26 @@ const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_output_sample_spec(pa_resampler *r);
 
+/* A process wide cache for filter tables and other read-only data that
+ * resamplers with the same parameters can share. key must describe
+ * everything the data depends on. On a miss, create() is called to
+ * compute the data and report its size. Every successful get must be
+ * paired with a release. Released data stays cached for a while, up to a
+ * size limit; pa_resampler_cache_flush() frees whatever is unused. */
+typedef struct pa_resampler_cache_stat {
+    unsigned n_entries;
+    size_t size;
+    unsigned n_unused;
+    size_t unused_size;
+    unsigned n_hits;
+    unsigned n_misses;
+} pa_resampler_cache_stat;
+
+const void *pa_resampler_cache_get(const char *key, void *(*create)(void *userdata, size_t *size), pa_free_cb_t free_cb, void *userdata);
+void pa_resampler_cache_release(const void *data);
+void pa_resampler_cache_flush(void);
+void pa_resampler_cache_get_stat(pa_resampler_cache_stat *stat);
+
 /* Implementation specific init functions */
 int pa_resampler_ffmpeg_init(pa_resampler *r);
 int pa_resampler_libsamplerate_init(pa_resampler *r);
@@ -173,6 +201,13 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_polyphase_init(pa_resampler *r);
+
+/* Dot product used by the polyphase resampler, n is a multiple of 8 */
+typedef float (*pa_polyphase_dot_func_t)(const float *coeffs, const float *samples, unsigned n);
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void);
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
@@ -23,18 +23,29 @@
 
 #include <samplerate.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/resampler.h>
 
+struct libsamplerate_data {
+    SRC_STATE *state;
+
+    /* Passed to every src_process() call. When it differs from the one
+     * of the previous call, libsamplerate moves between the two over the
+     * block, which src_set_ratio() would make a step. */
+    double ratio;
+};
+
 static unsigned libsamplerate_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
     SRC_DATA data;
-    SRC_STATE *state;
+    struct libsamplerate_data *d;
 
     pa_assert(r);
     pa_assert(input);
     pa_assert(output);
     pa_assert(out_n_frames);
 
-    state = r->impl.data;
+    d = r->impl.data;
     memset(&data, 0, sizeof(data));
 
     data.data_in = pa_memblock_acquire_chunk(input);
@@ -43,10 +54,10 @@ static unsigned libsamplerate_resample(pa_resampler *r, const pa_memchunk *input
     data.data_out = pa_memblock_acquire_chunk(output);
     data.output_frames = (long int) *out_n_frames;
 
-    data.src_ratio = (double) r->o_ss.rate / r->i_ss.rate;
+    data.src_ratio = d->ratio;
     data.end_of_input = 0;
 
-    pa_assert_se(src_process(state, &data) == 0);
+    pa_assert_se(src_process(d->state, &data) == 0);
 
     pa_memblock_release(input->memblock);
     pa_memblock_release(output->memblock);
@@ -57,32 +68,35 @@ static unsigned libsamplerate_resample(pa_resampler *r, const pa_memchunk *input
 }
 
 static void libsamplerate_update_rates(pa_resampler *r) {
-    SRC_STATE *state;
+    struct libsamplerate_data *d;
     pa_assert(r);
 
-    state = r->impl.data;
-    pa_assert_se(src_set_ratio(state, (double) r->o_ss.rate / r->i_ss.rate) == 0);
+    d = r->impl.data;
+    d->ratio = (double) r->o_ss.rate / r->i_ss.rate;
 }
 
 static void libsamplerate_reset(pa_resampler *r) {
-    SRC_STATE *state;
+    struct libsamplerate_data *d;
     pa_assert(r);
 
-    state = r->impl.data;
-    pa_assert_se(src_reset(state) == 0);
+    d = r->impl.data;
+    pa_assert_se(src_reset(d->state) == 0);
 }
 
 static void libsamplerate_free(pa_resampler *r) {
-    SRC_STATE *state;
+    struct libsamplerate_data *d;
     pa_assert(r);
 
-    state = r->impl.data;
-    if (state)
-        src_delete(state);
+    d = r->impl.data;
+    if (d) {
+        src_delete(d->state);
+        pa_xfree(d);
+    }
 }
 
 int pa_resampler_libsamplerate_init(pa_resampler *r) {
     int err;
+    struct libsamplerate_data *d;
     SRC_STATE *state;
 
     pa_assert(r);
@@ -90,11 +104,16 @@ int pa_resampler_libsamplerate_init(pa_resampler *r) {
     if (!(state = src_new(r->method, r->work_channels, &err)))
         return -1;
 
+    d = pa_xnew(struct libsamplerate_data, 1);
+    d->state = state;
+
     r->impl.free = libsamplerate_free;
     r->impl.update_rates = libsamplerate_update_rates;
     r->impl.resample = libsamplerate_resample;
     r->impl.reset = libsamplerate_reset;
-    r->impl.data = state;
+    r->impl.data = d;
+
+    libsamplerate_update_rates(r);
 
     return 0;
 }
@@ -0,0 +1,436 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/resampler.h>
+
+/* A windowed sinc resampler working on float32ne. For every output
+ * frame the filter is centered on its position in the input, and the
+ * coefficients for the fractional part of that position are taken from
+ * a table that is computed once when the resampler is set up.
+ *
+ * If the ratio of the rates, reduced to lowest terms, has a small
+ * denominator (as for 44.1 <-> 48 <-> 96 kHz), there is one table row
+ * per possible fractional position. Otherwise, and always for variable
+ * rate resamplers, the table is oversampled and the coefficients are
+ * interpolated linearly between two rows, which also makes rate updates
+ * cheap: usually only the step size changes.
+ *
+ * The input is kept deinterleaved in a history buffer per channel, so
+ * that every output sample is a single dot product over contiguous
+ * memory, which is what the SIMD variants of the dot product speed up. */
+
+/* Filter lengths are rounded up to this so dot products need no tail */
+#define TAPS_ALIGN 8U
+
+#define MAX_TAPS 1024U
+
+/* Largest number of rows for a table without interpolation */
+#define MAX_DIRECT_PHASES 512
+
+/* Rows of an interpolated table */
+#define INTERP_PHASES 256
+
+typedef struct polyphase_quality {
+    unsigned taps;
+    float down_cutoff, up_cutoff;
+    double beta;
+} polyphase_quality;
+
+/* Roughly equivalent to speex-float-1, -3 and -6 */
+static const polyphase_quality qualities[] = {
+    [PA_RESAMPLER_POLYPHASE_LQ - PA_RESAMPLER_POLYPHASE_LQ] = { 16, 0.850f, 0.880f, 6.0 },
+    [PA_RESAMPLER_POLYPHASE_MQ - PA_RESAMPLER_POLYPHASE_LQ] = { 48, 0.895f, 0.917f, 8.0 },
+    [PA_RESAMPLER_POLYPHASE_HQ - PA_RESAMPLER_POLYPHASE_LQ] = { 96, 0.940f, 0.945f, 10.0 },
+};
+
+struct polyphase_data { /* data specific to the polyphase resampler */
+    const polyphase_quality *quality;
+    unsigned channels;
+
+    unsigned taps;
+    float cutoff;
+    bool interpolate;
+    unsigned n_phases;
+    const float *coeffs; /* n_phases (+ 1 if interpolating) rows of taps,
+                          * shared through the resampler cache */
+    float *icoeffs;     /* interpolated row */
+
+    /* Every output frame advances the position by step_int + step_frac /
+     * den input frames, frac is the fractional part of the position */
+    unsigned den;
+    unsigned step_int, step_frac;
+    unsigned frac;
+
+    /* Deinterleaved input, one row of history_size frames per channel.
+     * idx is the first frame of the window of the next output frame. */
+    float *history;
+    unsigned history_size;
+    unsigned history_len;
+    unsigned idx;
+};
+
+static float dot_c(const float *coeffs, const float *samples, unsigned n) {
+    float sum = 0.0f;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        sum += coeffs[i] * samples[i];
+
+    return sum;
+}
+
+static pa_polyphase_dot_func_t dot_func = dot_c;
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0, k;
+
+    for (k = 1.0; k < 50.0 && term > sum * 1e-12; k += 1.0) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/* Row shift in [0, 1]: the fractional position of the output frame */
+static void compute_row(float *row, unsigned taps, double shift, float cutoff, double beta) {
+    double half = taps / 2, i0_beta = bessel_i0(beta), sum = 0.0;
+    unsigned j;
+
+    for (j = 0; j < taps; j++) {
+        double x = (double) j - (half - 1.0) - shift, w, s;
+
+        if (fabs(x) >= half) {
+            row[j] = 0.0f;
+            continue;
+        }
+
+        w = bessel_i0(beta * sqrt(1.0 - (x / half) * (x / half))) / i0_beta;
+        /* The centre tap, where sin(pi c x) / (pi x) tends to c */
+        s = fabs(x) < 1e-9 ? cutoff : sin(M_PI * cutoff * x) / (M_PI * x);
+
+        row[j] = (float) (w * s);
+        sum += w * s;
+    }
+
+    /* Unity gain at DC for every row, so there's no ripple depending on
+     * the position */
+    for (j = 0; j < taps; j++)
+        row[j] = (float) (row[j] / sum);
+}
+
+static void *create_table(void *userdata, size_t *size) {
+    struct polyphase_data *d = userdata;
+    unsigned rows, p;
+    float *coeffs;
+
+    rows = d->interpolate ? d->n_phases + 1 : d->n_phases;
+    coeffs = pa_xnew(float, rows * d->taps);
+
+    for (p = 0; p < rows; p++)
+        compute_row(coeffs + p * d->taps, d->taps, (double) p / d->n_phases, d->cutoff, d->quality->beta);
+
+    *size = rows * d->taps * sizeof(float);
+
+    return coeffs;
+}
+
+static void compute_table(struct polyphase_data *d) {
+    char key[64];
+
+    pa_snprintf(key, sizeof(key), "polyphase:%u:%u%s:%0.6f:%0.1f",
+                d->taps, d->n_phases, d->interpolate ? "i" : "", d->cutoff, d->quality->beta);
+
+    if (d->coeffs)
+        pa_resampler_cache_release(d->coeffs);
+
+    d->coeffs = pa_resampler_cache_get(key, create_table, pa_xfree, d);
+
+    pa_xfree(d->icoeffs);
+    d->icoeffs = d->interpolate ? pa_xnew(float, d->taps) : NULL;
+}
+
+static void grow_history(struct polyphase_data *d, unsigned n_frames) {
+    float *history;
+    unsigned size, c;
+
+    if (n_frames <= d->history_size)
+        return;
+
+    size = PA_MAX(n_frames, d->history_size * 2);
+    history = pa_xnew0(float, size * d->channels);
+
+    for (c = 0; c < d->channels; c++)
+        memcpy(history + c * size, d->history + c * d->history_size, d->history_len * sizeof(float));
+
+    pa_xfree(d->history);
+    d->history = history;
+    d->history_size = size;
+}
+
+/* Move the window by delta frames while keeping the position of the
+ * output frames, used when the filter length changes */
+static void shift_window(struct polyphase_data *d, int delta) {
+    unsigned c, n;
+
+    if (delta >= 0 || (unsigned) -delta <= d->idx) {
+        d->idx += delta;
+        return;
+    }
+
+    /* Not enough history, prepend silence */
+    n = (unsigned) -delta - d->idx;
+    grow_history(d, d->history_len + n);
+
+    for (c = 0; c < d->channels; c++) {
+        float *h = d->history + c * d->history_size;
+
+        memmove(h + n, h, d->history_len * sizeof(float));
+        memset(h, 0, n * sizeof(float));
+    }
+
+    d->history_len += n;
+    d->idx = 0;
+}
+
+static void setup_filter(pa_resampler *r, bool force) {
+    struct polyphase_data *d = r->impl.data;
+    unsigned g, num, den, taps, old_taps;
+    bool interpolate;
+    float cutoff;
+
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    num = r->i_ss.rate / g;
+    den = r->o_ss.rate / g;
+
+    /* When downsampling the cutoff moves down and the filter gets longer */
+    if (r->i_ss.rate > r->o_ss.rate) {
+        cutoff = d->quality->down_cutoff * r->o_ss.rate / r->i_ss.rate;
+        taps = (unsigned) ceil((double) d->quality->taps * r->i_ss.rate / r->o_ss.rate);
+    } else {
+        cutoff = d->quality->up_cutoff;
+        taps = d->quality->taps;
+    }
+
+    taps = PA_ROUND_UP(taps, TAPS_ALIGN);
+    taps = PA_MIN(taps, MAX_TAPS);
+    interpolate = (r->flags & PA_RESAMPLER_VARIABLE_RATE) || den > MAX_DIRECT_PHASES;
+
+    /* Position within the input frame, in the new unit */
+    if (d->den > 0)
+        d->frac = (unsigned) (((uint64_t) d->frac * den) / d->den);
+
+    d->den = den;
+    d->step_int = num / den;
+    d->step_frac = num % den;
+
+    /* For an interpolated table, small rate changes don't justify a new
+     * one. A direct table depends on den, so it's always recomputed. */
+    if (!force && interpolate && d->interpolate &&
+        fabsf(cutoff - d->cutoff) <= 0.01f * d->cutoff && taps == d->taps)
+        return;
+
+    old_taps = d->taps;
+
+    d->taps = taps;
+    d->cutoff = cutoff;
+    d->interpolate = interpolate;
+    d->n_phases = interpolate ? INTERP_PHASES : den;
+
+    compute_table(d);
+
+    if (old_taps > 0 && old_taps != taps)
+        shift_window(d, (int) (old_taps / 2) - (int) (taps / 2));
+
+    pa_log_debug("Polyphase filter: %u taps, %u phases%s, cutoff %0.3f",
+                 d->taps, d->n_phases, d->interpolate ? " (interpolated)" : "", d->cutoff);
+}
+
+static unsigned polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    struct polyphase_data *d;
+    const float *src;
+    float *dst;
+    unsigned c, i, o, max_out;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    d = r->impl.data;
+
+    grow_history(d, d->history_len + in_n_frames);
+
+    src = pa_memblock_acquire_chunk(input);
+
+    for (c = 0; c < d->channels; c++) {
+        float *h = d->history + c * d->history_size + d->history_len;
+
+        for (i = 0; i < in_n_frames; i++)
+            h[i] = src[i * d->channels + c];
+    }
+
+    pa_memblock_release(input->memblock);
+
+    d->history_len += in_n_frames;
+
+    dst = pa_memblock_acquire_chunk(output);
+    max_out = *out_n_frames;
+
+    for (o = 0; o < max_out && d->idx + d->taps <= d->history_len; o++) {
+        const float *row;
+
+        if (d->interpolate) {
+            unsigned p, j;
+            uint64_t pos;
+            float mu;
+            const float *a, *b;
+
+            /* The position in table rows, in 1/den */
+            pos = (uint64_t) d->frac * d->n_phases;
+            p = (unsigned) (pos / d->den);
+            mu = (float) (pos % d->den) / d->den;
+
+            a = d->coeffs + p * d->taps;
+            b = a + d->taps;
+
+            for (j = 0; j < d->taps; j++)
+                d->icoeffs[j] = a[j] + mu * (b[j] - a[j]);
+
+            row = d->icoeffs;
+        } else
+            row = d->coeffs + d->frac * d->taps;
+
+        for (c = 0; c < d->channels; c++)
+            dst[o * d->channels + c] = dot_func(row, d->history + c * d->history_size + d->idx, d->taps);
+
+        d->idx += d->step_int;
+        d->frac += d->step_frac;
+        if (d->frac >= d->den) {
+            d->frac -= d->den;
+            d->idx++;
+        }
+    }
+
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o;
+
+    /* Drop what's no longer needed. When downsampling, the window may
+     * already point past the end of the input we have. */
+    if (d->idx >= d->history_len) {
+        d->idx -= d->history_len;
+        d->history_len = 0;
+    } else if (d->idx > 0) {
+        for (c = 0; c < d->channels; c++) {
+            float *h = d->history + c * d->history_size;
+
+            memmove(h, h + d->idx, (d->history_len - d->idx) * sizeof(float));
+        }
+
+        d->history_len -= d->idx;
+        d->idx = 0;
+    }
+
+    return 0;
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    struct polyphase_data *d;
+    unsigned c, n;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    /* Start with half a filter of silence, so that the first output frame
+     * is centered on the first input frame and there's no extra delay */
+    n = d->taps / 2 - 1;
+    grow_history(d, n);
+
+    for (c = 0; c < d->channels; c++)
+        memset(d->history + c * d->history_size, 0, n * sizeof(float));
+
+    d->history_len = n;
+    d->idx = 0;
+    d->frac = 0;
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    pa_assert(r);
+
+    setup_filter(r, false);
+}
+
+static void polyphase_free(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+
+    if (!(d = r->impl.data))
+        return;
+
+    if (d->coeffs)
+        pa_resampler_cache_release(d->coeffs);
+
+    pa_xfree(d->icoeffs);
+    pa_xfree(d->history);
+    pa_xfree(d);
+}
+
+int pa_resampler_polyphase_init(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+    pa_assert(r->method >= PA_RESAMPLER_POLYPHASE_LQ && r->method <= PA_RESAMPLER_POLYPHASE_HQ);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+
+    d = pa_xnew0(struct polyphase_data, 1);
+    d->quality = &qualities[r->method - PA_RESAMPLER_POLYPHASE_LQ];
+    d->channels = r->work_channels;
+
+    r->impl.free = polyphase_free;
+    r->impl.update_rates = polyphase_update_rates;
+    r->impl.resample = polyphase_resample;
+    r->impl.reset = polyphase_reset;
+    r->impl.data = d;
+
+    setup_filter(r, true);
+    polyphase_reset(r);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* Filter lengths are multiples of 8, so at most one vector is left after
+ * the unrolled loop. Plain multiply and add, AVX doesn't imply FMA. */
+__attribute__ ((target ("avx")))
+static float polyphase_dot_avx(const float *coeffs, const float *samples, unsigned n) {
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    __m128 sum;
+    unsigned i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(coeffs + i), _mm256_loadu_ps(samples + i)));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(coeffs + i + 8), _mm256_loadu_ps(samples + i + 8)));
+    }
+
+    if (i < n)
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(coeffs + i), _mm256_loadu_ps(samples + i)));
+
+    sum0 = _mm256_add_ps(sum0, sum1);
+    sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+    return _mm_cvtss_f32(sum);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
+void pa_polyphase_func_init_avx(pa_cpu_x86_flag_t flags) {
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_AVX) {
+        pa_log_info("Initialising AVX optimized polyphase resampler functions.");
+        pa_set_polyphase_dot_func(polyphase_dot_avx);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+}
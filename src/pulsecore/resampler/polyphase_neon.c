@@ -0,0 +1,50 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#include <arm_neon.h>
+
+static float polyphase_dot_neon(const float *coeffs, const float *samples, unsigned n) {
+    float32x4_t sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+    float32x2_t sum;
+    unsigned i;
+
+    for (i = 0; i < n; i += 8) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(coeffs + i), vld1q_f32(samples + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(coeffs + i + 4), vld1q_f32(samples + i + 4));
+    }
+
+    sum0 = vaddq_f32(sum0, sum1);
+    sum = vadd_f32(vget_low_f32(sum0), vget_high_f32(sum0));
+    sum = vpadd_f32(sum, sum);
+
+    return vget_lane_f32(sum, 0);
+}
+
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized polyphase resampler functions.");
+
+    pa_set_polyphase_dot_func(polyphase_dot_neon);
+}
@@ -0,0 +1,59 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* Two accumulators to hide the latency of the additions */
+__attribute__ ((target ("sse")))
+static float polyphase_dot_sse(const float *coeffs, const float *samples, unsigned n) {
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+    PA_DECLARE_ALIGNED(16, float, sum[4]);
+    unsigned i;
+
+    for (i = 0; i < n; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(coeffs + i), _mm_loadu_ps(samples + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(coeffs + i + 4), _mm_loadu_ps(samples + i + 4)));
+    }
+
+    _mm_store_ps(sum, _mm_add_ps(sum0, sum1));
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
+void pa_polyphase_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized polyphase resampler functions.");
+        pa_set_polyphase_dot_func(polyphase_dot_sse);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+}
@@ -24,11 +24,31 @@
 #include <stddef.h>
 #include <soxr.h>
 
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/resampler.h>
 
+/* libsoxr can change the ratio of a running context since 0.1.2 */
+#if SOXR_THIS_VERSION >= SOXR_VERSION(0, 1, 2)
+#define HAVE_SOXR_VR 1
+
+/* How far a variable rate context can go from the ratio it was created
+ * with. Anything beyond needs a new context. */
+#define VR_MAX_DEVIATION 1.25
+
+/* Rate changes are spread over this much output, so they can't click */
+#define VR_SLEW_USEC (10 * PA_USEC_PER_MSEC)
+#endif
+
+struct soxr_data {
+    soxr_t state;
+    double max_io_ratio; /* 0 if the context has a fixed ratio */
+};
+
 static unsigned resampler_soxr_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames,
                                         pa_memchunk *output, unsigned *out_n_frames) {
-    soxr_t state;
+    struct soxr_data *d;
     void *in, *out;
     size_t consumed = 0, produced = 0;
 
@@ -37,13 +57,13 @@ static unsigned resampler_soxr_resample(pa_resampler *r, const pa_memchunk *inpu
     pa_assert(output);
     pa_assert(out_n_frames);
 
-    state = r->impl.data;
-    pa_assert(state);
+    d = r->impl.data;
+    pa_assert(d->state);
 
     in = pa_memblock_acquire_chunk(input);
     out = pa_memblock_acquire_chunk(output);
 
-    pa_assert_se(soxr_process(state, in, in_n_frames, &consumed, out, *out_n_frames, &produced) == 0);
+    pa_assert_se(soxr_process(d->state, in, in_n_frames, &consumed, out, *out_n_frames, &produced) == 0);
 
     pa_memblock_release(input->memblock);
     pa_memblock_release(output->memblock);
@@ -53,71 +73,15 @@ static unsigned resampler_soxr_resample(pa_resampler *r, const pa_memchunk *inpu
     return in_n_frames - consumed;
 }
 
-static void resampler_soxr_free(pa_resampler *r) {
-    pa_assert(r);
-
-    if (!r->impl.data)
-        return;
-
-    soxr_delete(r->impl.data);
-    r->impl.data = NULL;
-}
-
-static void resampler_soxr_reset(pa_resampler *r) {
-#if SOXR_THIS_VERSION >= SOXR_VERSION(0, 1, 2)
-    pa_assert(r);
-
-    soxr_clear(r->impl.data);
-#else
-    /* With libsoxr prior to 0.1.2 soxr_clear() makes soxr_process() crash afterwards,
-     * so don't use this function and re-create the context instead. */
-    soxr_t old_state;
-
-    pa_assert(r);
-
-    old_state = r->impl.data;
-    r->impl.data = NULL;
-
-    if (pa_resampler_soxr_init(r) == 0) {
-        if (old_state)
-            soxr_delete(old_state);
-    } else {
-        r->impl.data = old_state;
-        pa_log_error("Failed to reset libsoxr context");
-    }
-#endif
-}
-
-static void resampler_soxr_update_rates(pa_resampler *r) {
-    soxr_t old_state;
-
-    pa_assert(r);
-
-    /* There is no update method in libsoxr,
-     * so just re-create the resampler context */
-
-    old_state = r->impl.data;
-    r->impl.data = NULL;
-
-    if (pa_resampler_soxr_init(r) == 0) {
-        if (old_state)
-            soxr_delete(old_state);
-    } else {
-        r->impl.data = old_state;
-        pa_log_error("Failed to update libsoxr sample rates");
-    }
-}
-
-int pa_resampler_soxr_init(pa_resampler *r) {
+static soxr_t create_state(pa_resampler *r, double *max_io_ratio) {
     soxr_t state;
     soxr_datatype_t io_format;
     soxr_io_spec_t io_spec;
     soxr_runtime_spec_t runtime_spec;
-    unsigned long quality_recipe;
+    unsigned long quality_recipe, quality_flags = 0;
     soxr_quality_spec_t quality;
     soxr_error_t err = NULL;
-
-    pa_assert(r);
+    double irate = r->i_ss.rate, orate = r->o_ss.rate;
 
     switch (r->work_format) {
         case PA_SAMPLE_S16NE:
@@ -150,19 +114,136 @@ int pa_resampler_soxr_init(pa_resampler *r) {
             pa_assert_not_reached();
     }
 
-    quality = soxr_quality_spec(quality_recipe, 0);
+    *max_io_ratio = 0.0;
+
+#ifdef HAVE_SOXR_VR
+    /* A variable rate context is created with the largest ratio it has
+     * to support, and has to use the HQ recipe */
+    if (r->flags & PA_RESAMPLER_VARIABLE_RATE) {
+        quality_recipe = SOXR_HQ;
+        quality_flags = SOXR_VR;
+        *max_io_ratio = irate / orate * VR_MAX_DEVIATION;
+        irate = *max_io_ratio;
+        orate = 1.0;
+    }
+#endif
 
-    state = soxr_create(r->i_ss.rate, r->o_ss.rate, r->work_channels, &err, &io_spec, &quality, &runtime_spec);
+    quality = soxr_quality_spec(quality_recipe, quality_flags);
+
+    state = soxr_create(irate, orate, r->work_channels, &err, &io_spec, &quality, &runtime_spec);
     if (!state) {
         pa_log_error("Failed to create libsoxr resampler context: %s.", (err ? err : "[unknown error]"));
-        return -1;
+        return NULL;
+    }
+
+#ifdef HAVE_SOXR_VR
+    if (*max_io_ratio > 0.0 &&
+        (err = soxr_set_io_ratio(state, (double) r->i_ss.rate / r->o_ss.rate, 0))) {
+        pa_log_error("Failed to set libsoxr resampling ratio: %s.", err);
+        soxr_delete(state);
+        return NULL;
     }
+#endif
+
+    return state;
+}
+
+/* Replaces the context with a new one for the current rates */
+static void recreate_state(pa_resampler *r) {
+    struct soxr_data *d = r->impl.data;
+    double max_io_ratio;
+    soxr_t state;
+
+    if (!(state = create_state(r, &max_io_ratio))) {
+        pa_log_error("Failed to re-create libsoxr context");
+        return;
+    }
+
+    soxr_delete(d->state);
+    d->state = state;
+    d->max_io_ratio = max_io_ratio;
+}
+
+static void resampler_soxr_free(pa_resampler *r) {
+    struct soxr_data *d;
+
+    pa_assert(r);
+
+    if (!(d = r->impl.data))
+        return;
+
+    soxr_delete(d->state);
+    pa_xfree(d);
+    r->impl.data = NULL;
+}
+
+static void resampler_soxr_reset(pa_resampler *r) {
+#if SOXR_THIS_VERSION >= SOXR_VERSION(0, 1, 2)
+    struct soxr_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    soxr_clear(d->state);
+
+#ifdef HAVE_SOXR_VR
+    /* Continue at the current ratio, not the one of the creation */
+    if (d->max_io_ratio > 0.0)
+        pa_assert_se(soxr_set_io_ratio(d->state, (double) r->i_ss.rate / r->o_ss.rate, 0) == NULL);
+#endif
+#else
+    pa_assert(r);
+
+    /* With libsoxr prior to 0.1.2 soxr_clear() makes soxr_process() crash afterwards,
+     * so don't use this function and re-create the context instead. */
+    recreate_state(r);
+#endif
+}
+
+static void resampler_soxr_update_rates(pa_resampler *r) {
+#ifdef HAVE_SOXR_VR
+    struct soxr_data *d;
+#endif
+
+    pa_assert(r);
+
+#ifdef HAVE_SOXR_VR
+    d = r->impl.data;
+
+    /* A variable rate context just glides to the new ratio, keeping
+     * everything that is in the filter */
+    if (d->max_io_ratio > 0.0 && (double) r->i_ss.rate / r->o_ss.rate <= d->max_io_ratio) {
+        size_t slew = (size_t) (VR_SLEW_USEC * r->o_ss.rate / PA_USEC_PER_SEC);
+
+        pa_assert_se(soxr_set_io_ratio(d->state, (double) r->i_ss.rate / r->o_ss.rate, slew) == NULL);
+        return;
+    }
+#endif
+
+    /* Otherwise there is no update method in libsoxr,
+     * so just re-create the resampler context */
+    recreate_state(r);
+}
+
+int pa_resampler_soxr_init(pa_resampler *r) {
+    struct soxr_data *d;
+    double max_io_ratio;
+    soxr_t state;
+
+    pa_assert(r);
+
+    if (!(state = create_state(r, &max_io_ratio)))
+        return -1;
+
+    d = pa_xnew(struct soxr_data, 1);
+    d->state = state;
+    d->max_io_ratio = max_io_ratio;
 
     r->impl.free = resampler_soxr_free;
     r->impl.reset = resampler_soxr_reset;
     r->impl.update_rates = resampler_soxr_update_rates;
     r->impl.resample = resampler_soxr_resample;
-    r->impl.data = state;
+    r->impl.data = d;
 
     return 0;
 }
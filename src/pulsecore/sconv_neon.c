@@ -23,6 +23,8 @@
 
 #include "cpu-arm.h"
 #include "sconv.h"
+#include "sconv-s16le.h"
+#include "sconv-s16be.h"
 
 #include <math.h>
 #include <arm_neon.h>
@@ -85,6 +87,131 @@ static void pa_sconv_s16le_to_f32ne_neon(unsigned n, const int16_t *src, float *
     }
 }
 
+/* 24 and 32 bit samples are converted left-aligned in 32 bit lanes. The
+ * conversion from float uses the fixed-point form of vcvt, which scales
+ * by 2^31 and saturates, but truncates instead of rounding to nearest, so
+ * results may be off by one LSB compared to the C code. */
+
+static inline float32x4_t s32_to_f32_neon(int32x4_t v) {
+    return vcvtq_n_f32_s32(v, 31);
+}
+
+static inline int32x4_t s32_from_f32_neon(float32x4_t f) {
+    return vcvtq_n_s32_f32(f, 31);
+}
+
+static inline uint32x4_t swap32_neon(uint32x4_t v) {
+    return vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(v)));
+}
+
+static void pa_sconv_s32le_to_f32ne_neon(unsigned n, const int32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_f32(b, s32_to_f32_neon(vld1q_s32(a)));
+
+    pa_sconv_s32le_to_float32ne(n, a, b);
+}
+
+static void pa_sconv_s32be_to_f32ne_neon(unsigned n, const int32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_f32(b, s32_to_f32_neon(vreinterpretq_s32_u32(swap32_neon(vld1q_u32((const uint32_t *) a)))));
+
+    pa_sconv_s32be_to_float32ne(n, a, b);
+}
+
+static void pa_sconv_s32le_from_f32ne_neon(unsigned n, const float *a, int32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_s32(b, s32_from_f32_neon(vld1q_f32(a)));
+
+    pa_sconv_s32le_from_float32ne(n, a, b);
+}
+
+static void pa_sconv_s32be_from_f32ne_neon(unsigned n, const float *a, int32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_u32((uint32_t *) b, swap32_neon(vreinterpretq_u32_s32(s32_from_f32_neon(vld1q_f32(a)))));
+
+    pa_sconv_s32be_from_float32ne(n, a, b);
+}
+
+static void pa_sconv_s24_32le_to_f32ne_neon(unsigned n, const uint32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_f32(b, s32_to_f32_neon(vreinterpretq_s32_u32(vshlq_n_u32(vld1q_u32(a), 8))));
+
+    pa_sconv_s24_32le_to_float32ne(n, a, b);
+}
+
+static void pa_sconv_s24_32be_to_f32ne_neon(unsigned n, const uint32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_f32(b, s32_to_f32_neon(vreinterpretq_s32_u32(vshlq_n_u32(swap32_neon(vld1q_u32(a)), 8))));
+
+    pa_sconv_s24_32be_to_float32ne(n, a, b);
+}
+
+static void pa_sconv_s24_32le_from_f32ne_neon(unsigned n, const float *a, uint32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_u32(b, vshrq_n_u32(vreinterpretq_u32_s32(s32_from_f32_neon(vld1q_f32(a))), 8));
+
+    pa_sconv_s24_32le_from_float32ne(n, a, b);
+}
+
+static void pa_sconv_s24_32be_from_f32ne_neon(unsigned n, const float *a, uint32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        vst1q_u32(b, swap32_neon(vshrq_n_u32(vreinterpretq_u32_s32(s32_from_f32_neon(vld1q_f32(a))), 8)));
+
+    pa_sconv_s24_32be_from_float32ne(n, a, b);
+}
+
+/* Packed 24 bit samples are deinterleaved into byte planes by vld3, eight
+ * samples at a time. lsb and msb are the plane indices of the least and
+ * most significant byte, which takes care of the byte order. */
+
+static inline void s24_to_f32ne_neon(unsigned n, const uint8_t *a, float *b, unsigned lsb, unsigned msb) {
+    for (; n >= 8; n -= 8, a += 24, b += 8) {
+        uint8x8x3_t v = vld3_u8(a);
+        uint16x8_t l = vshll_n_u8(v.val[lsb], 8);
+        uint16x8_t h = vorrq_u16(vshll_n_u8(v.val[msb], 8), vmovl_u8(v.val[1]));
+
+        vst1q_f32(b, s32_to_f32_neon(vreinterpretq_s32_u32(
+                vorrq_u32(vshll_n_u16(vget_low_u16(h), 16), vmovl_u16(vget_low_u16(l))))));
+        vst1q_f32(b + 4, s32_to_f32_neon(vreinterpretq_s32_u32(
+                vorrq_u32(vshll_n_u16(vget_high_u16(h), 16), vmovl_u16(vget_high_u16(l))))));
+    }
+}
+
+static inline void s24_from_f32ne_neon(unsigned n, const float *a, uint8_t *b, unsigned lsb, unsigned msb) {
+    for (; n >= 8; n -= 8, a += 8, b += 24) {
+        uint32x4_t s0 = vreinterpretq_u32_s32(s32_from_f32_neon(vld1q_f32(a)));
+        uint32x4_t s1 = vreinterpretq_u32_s32(s32_from_f32_neon(vld1q_f32(a + 4)));
+        uint16x8_t h = vcombine_u16(vshrn_n_u32(s0, 16), vshrn_n_u32(s1, 16));
+        uint16x8_t l = vcombine_u16(vmovn_u32(s0), vmovn_u32(s1));
+        uint8x8x3_t v;
+
+        v.val[msb] = vshrn_n_u16(h, 8);
+        v.val[1] = vmovn_u16(h);
+        v.val[lsb] = vshrn_n_u16(l, 8);
+        vst3_u8(b, v);
+    }
+}
+
+static void pa_sconv_s24le_to_f32ne_neon(unsigned n, const uint8_t *a, float *b) {
+    s24_to_f32ne_neon(n, a, b, 0, 2);
+    pa_sconv_s24le_to_float32ne(n % 8, a + (n & ~7U) * 3, b + (n & ~7U));
+}
+
+static void pa_sconv_s24be_to_f32ne_neon(unsigned n, const uint8_t *a, float *b) {
+    s24_to_f32ne_neon(n, a, b, 2, 0);
+    pa_sconv_s24be_to_float32ne(n % 8, a + (n & ~7U) * 3, b + (n & ~7U));
+}
+
+static void pa_sconv_s24le_from_f32ne_neon(unsigned n, const float *a, uint8_t *b) {
+    s24_from_f32ne_neon(n, a, b, 0, 2);
+    pa_sconv_s24le_from_float32ne(n % 8, a + (n & ~7U), b + (n & ~7U) * 3);
+}
+
+static void pa_sconv_s24be_from_f32ne_neon(unsigned n, const float *a, uint8_t *b) {
+    s24_from_f32ne_neon(n, a, b, 2, 0);
+    pa_sconv_s24be_from_float32ne(n % 8, a + (n & ~7U), b + (n & ~7U) * 3);
+}
+
 void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
     pa_log_info("Initialising ARM NEON optimized conversions.");
     pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_neon);
@@ -92,5 +219,18 @@ void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags) {
 #ifndef WORDS_BIGENDIAN
     pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_to_f32ne_neon);
     pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_neon);
+
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_to_f32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_to_f32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_to_f32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_to_f32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_to_f32ne_neon);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_to_f32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_from_f32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_from_f32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_from_f32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_from_f32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_from_f32ne_neon);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_from_f32ne_neon);
 #endif
 }
@@ -30,6 +30,8 @@
 
 #include "cpu-x86.h"
 #include "sconv.h"
+#include "sconv-s16le.h"
+#include "sconv-s16be.h"
 
 #if (!defined(__APPLE__) && !defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
 
@@ -160,6 +162,160 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
 
 #endif /* defined (__i386__) || defined (__amd64__) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* The 24 and 32 bit conversions below work on four samples per vector,
+ * left-aligned in 32 bit lanes, just like the C code does it. Conversions
+ * from float round to nearest and saturate like llrint() plus clamping in
+ * the C code, so the results are identical. Whatever doesn't fill a
+ * vector is left to the C implementation. */
+
+__attribute__ ((target ("sse2")))
+static inline __m128i swap32_sse2(__m128i v) {
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128 s32_to_float_sse2(__m128i v) {
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / (1U << 31)));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i s32_from_float_sse2(__m128 f) {
+    __m128 v = _mm_mul_ps(f, _mm_set1_ps((float) (1U << 31)));
+
+    /* cvtps2dq gives 0x80000000 for anything out of range, turn that into
+     * 0x7fffffff where the positive limit was exceeded */
+    return _mm_xor_si128(_mm_cvtps_epi32(v), _mm_castps_si128(_mm_cmpge_ps(v, _mm_set1_ps((float) (1U << 31)))));
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s32le_to_f32ne_sse2(unsigned n, const int32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_ps(b, s32_to_float_sse2(_mm_loadu_si128((const __m128i *) a)));
+
+    pa_sconv_s32le_to_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s32be_to_f32ne_sse2(unsigned n, const int32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_ps(b, s32_to_float_sse2(swap32_sse2(_mm_loadu_si128((const __m128i *) a))));
+
+    pa_sconv_s32be_to_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s32le_from_f32ne_sse2(unsigned n, const float *a, int32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_si128((__m128i *) b, s32_from_float_sse2(_mm_loadu_ps(a)));
+
+    pa_sconv_s32le_from_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s32be_from_f32ne_sse2(unsigned n, const float *a, int32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_si128((__m128i *) b, swap32_sse2(s32_from_float_sse2(_mm_loadu_ps(a))));
+
+    pa_sconv_s32be_from_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s24_32le_to_f32ne_sse2(unsigned n, const uint32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_ps(b, s32_to_float_sse2(_mm_slli_epi32(_mm_loadu_si128((const __m128i *) a), 8)));
+
+    pa_sconv_s24_32le_to_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s24_32be_to_f32ne_sse2(unsigned n, const uint32_t *a, float *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_ps(b, s32_to_float_sse2(_mm_slli_epi32(swap32_sse2(_mm_loadu_si128((const __m128i *) a)), 8)));
+
+    pa_sconv_s24_32be_to_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s24_32le_from_f32ne_sse2(unsigned n, const float *a, uint32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_si128((__m128i *) b, _mm_srli_epi32(s32_from_float_sse2(_mm_loadu_ps(a)), 8));
+
+    pa_sconv_s24_32le_from_float32ne(n, a, b);
+}
+
+__attribute__ ((target ("sse2")))
+static void pa_sconv_s24_32be_from_f32ne_sse2(unsigned n, const float *a, uint32_t *b) {
+    for (; n >= 4; n -= 4, a += 4, b += 4)
+        _mm_storeu_si128((__m128i *) b, swap32_sse2(_mm_srli_epi32(s32_from_float_sse2(_mm_loadu_ps(a)), 8)));
+
+    pa_sconv_s24_32be_from_float32ne(n, a, b);
+}
+
+/* Packed 24 bit samples are done eight at a time, as two overlapping 16
+ * byte loads or stores that together cover exactly 24 bytes, so nothing
+ * outside of the buffers is touched. The byte order is handled by the
+ * shuffle masks. */
+
+__attribute__ ((target ("ssse3")))
+static inline void s24_to_f32ne_ssse3(unsigned n, const uint8_t *a, float *b, __m128i lo, __m128i hi) {
+    for (; n >= 8; n -= 8, a += 24, b += 8) {
+        _mm_storeu_ps(b, s32_to_float_sse2(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) a), lo)));
+        _mm_storeu_ps(b + 4, s32_to_float_sse2(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (a + 8)), hi)));
+    }
+}
+
+__attribute__ ((target ("ssse3")))
+static inline void s24_from_f32ne_ssse3(unsigned n, const float *a, uint8_t *b, __m128i pack) {
+    for (; n >= 8; n -= 8, a += 8, b += 24) {
+        __m128i p0 = _mm_shuffle_epi8(s32_from_float_sse2(_mm_loadu_ps(a)), pack);
+        __m128i p1 = _mm_shuffle_epi8(s32_from_float_sse2(_mm_loadu_ps(a + 4)), pack);
+
+        _mm_storeu_si128((__m128i *) b, _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+        _mm_storel_epi64((__m128i *) (b + 16), _mm_srli_si128(p1, 4));
+    }
+}
+
+__attribute__ ((target ("ssse3")))
+static void pa_sconv_s24le_to_f32ne_ssse3(unsigned n, const uint8_t *a, float *b) {
+    const __m128i lo = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128i hi = _mm_setr_epi8(-1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15);
+
+    s24_to_f32ne_ssse3(n, a, b, lo, hi);
+    pa_sconv_s24le_to_float32ne(n % 8, a + (n & ~7U) * 3, b + (n & ~7U));
+}
+
+__attribute__ ((target ("ssse3")))
+static void pa_sconv_s24be_to_f32ne_ssse3(unsigned n, const uint8_t *a, float *b) {
+    const __m128i lo = _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9);
+    const __m128i hi = _mm_setr_epi8(-1, 6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13);
+
+    s24_to_f32ne_ssse3(n, a, b, lo, hi);
+    pa_sconv_s24be_to_float32ne(n % 8, a + (n & ~7U) * 3, b + (n & ~7U));
+}
+
+__attribute__ ((target ("ssse3")))
+static void pa_sconv_s24le_from_f32ne_ssse3(unsigned n, const float *a, uint8_t *b) {
+    const __m128i pack = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+
+    s24_from_f32ne_ssse3(n, a, b, pack);
+    pa_sconv_s24le_from_float32ne(n % 8, a + (n & ~7U), b + (n & ~7U) * 3);
+}
+
+__attribute__ ((target ("ssse3")))
+static void pa_sconv_s24be_from_f32ne_ssse3(unsigned n, const float *a, uint8_t *b) {
+    const __m128i pack = _mm_setr_epi8(3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1);
+
+    s24_from_f32ne_ssse3(n, a, b, pack);
+    pa_sconv_s24be_from_float32ne(n % 8, a + (n & ~7U), b + (n & ~7U) * 3);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
 void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
 #if (!defined(__APPLE__) && !defined(__FreeBSD__) && !defined(__FreeBSD_kernel__) && defined (__i386__)) || defined (__amd64__)
 
@@ -174,4 +330,28 @@ void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
     }
 
 #endif /* defined (__i386__) || defined (__amd64__) */
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized 24 and 32 bit conversions.");
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_to_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_from_f32ne_sse2);
+    }
+
+    if (flags & PA_CPU_X86_SSSE3) {
+        pa_log_info("Initialising SSSE3 optimized 24 bit conversions.");
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_to_f32ne_ssse3);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_to_f32ne_ssse3);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_from_f32ne_ssse3);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_from_f32ne_ssse3);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
 }
@@ -344,6 +344,139 @@ void pa_shm_punch(pa_shm *m, size_t offset, size_t size) {
 #endif
 }
 
+#ifdef MADV_HUGEPAGE
+/* Returns the huge= option of the tmpfs mounted on /dev/shm, "never"
+ * being the kernel's default, or NULL if there is none */
+static char *shm_mount_huge_option(void) {
+    FILE *f;
+    char line[1024], dir[256], options[768];
+    char *huge = NULL;
+
+    if (!(f = pa_fopen_cloexec("/proc/self/mounts", "r")))
+        return NULL;
+
+    /* Later mounts hide earlier ones, so the last match counts */
+    while (fgets(line, sizeof(line), f)) {
+        const char *state = NULL;
+        char *o;
+
+        if (sscanf(line, "%*s %255s %*s %767s", dir, options) != 2 || !pa_streq(dir, "/dev/shm"))
+            continue;
+
+        pa_xfree(huge);
+        huge = pa_xstrdup("never");
+
+        while ((o = pa_split(options, ",", &state))) {
+            if (pa_startswith(o, "huge=")) {
+                pa_xfree(huge);
+                huge = pa_xstrdup(o + 5);
+            }
+            pa_xfree(o);
+        }
+    }
+
+    fclose(f);
+
+    return huge;
+}
+
+/* MADV_HUGEPAGE succeeds even if transparent huge pages are switched
+ * off, so check the kernel's setting for the memory type in question.
+ * Private memory follows the global setting. memfds live on the kernel's
+ * internal shmem mount, which follows shmem_enabled, while POSIX SHM is
+ * governed by the huge= option of the tmpfs on /dev/shm. shmem_enabled
+ * can override either with "deny" or "force". */
+static bool huge_pages_enabled(pa_mem_type_t type) {
+    char *line, *huge;
+    bool enabled;
+
+    if (type == PA_MEM_TYPE_PRIVATE) {
+        if (!(line = pa_read_line_from_file("/sys/kernel/mm/transparent_hugepage/enabled")))
+            return false;
+
+        enabled = !strstr(line, "[never]");
+        pa_xfree(line);
+
+        return enabled;
+    }
+
+    if (!(line = pa_read_line_from_file("/sys/kernel/mm/transparent_hugepage/shmem_enabled")))
+        return false;
+
+    if (strstr(line, "[deny]") || strstr(line, "[force]")) {
+        enabled = !!strstr(line, "[force]");
+        pa_xfree(line);
+        return enabled;
+    }
+
+    if (type == PA_MEM_TYPE_SHARED_MEMFD) {
+        enabled = !strstr(line, "[never]");
+        pa_xfree(line);
+        return enabled;
+    }
+
+    pa_xfree(line);
+
+    if (!(huge = shm_mount_huge_option()))
+        return false;
+
+    enabled = !pa_streq(huge, "never");
+    pa_xfree(huge);
+
+    return enabled;
+}
+#endif
+
+/* Ask the kernel to back the memory with transparent huge pages. Only
+ * the parts of the area that are aligned to the huge page size can
+ * get them. Returns 0 if huge pages are enabled for the memory type and
+ * the kernel accepted the request, which doesn't guarantee that it will
+ * find any. */
+int pa_shm_set_huge_pages(pa_shm *m) {
+    pa_assert(m);
+    pa_assert(m->ptr);
+    pa_assert(m->size > 0);
+
+#ifdef MADV_HUGEPAGE
+    if (!huge_pages_enabled(m->type)) {
+        pa_log_info("Transparent huge pages are disabled for %s memory.", pa_mem_type_to_string(m->type));
+        return -1;
+    }
+
+    if (madvise(m->ptr, PA_PAGE_ALIGN(m->size), MADV_HUGEPAGE) < 0) {
+        pa_log_info("madvise(MADV_HUGEPAGE) failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* Fault in all pages of the area now, so that first accesses later on
+ * don't have to */
+void pa_shm_prefault(pa_shm *m) {
+    const size_t page_size = pa_page_size();
+    size_t offset;
+
+    pa_assert(m);
+    pa_assert(m->ptr);
+    pa_assert(m->size > 0);
+
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(m->ptr, PA_PAGE_ALIGN(m->size), MADV_POPULATE_WRITE) >= 0)
+        return;
+#endif
+
+    /* Writing back what's there faults the page in writable, without
+     * touching e.g. the SHM marker */
+    for (offset = 0; offset < m->size; offset += page_size) {
+        volatile uint8_t *v = (uint8_t*) m->ptr + offset;
+        *v = *v;
+    }
+}
+
 static int shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd, bool writable, bool for_cleanup) {
 #if defined(HAVE_SHM_OPEN) || defined(HAVE_MEMFD)
     char fn[32];
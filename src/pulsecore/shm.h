@@ -53,6 +53,8 @@ int pa_shm_create_rw(pa_shm *m, pa_mem_type_t type, size_t size, mode_t mode);
 int pa_shm_attach(pa_shm *m, pa_mem_type_t type, unsigned id, int memfd_fd, bool writable);
 
 void pa_shm_punch(pa_shm *m, size_t offset, size_t size);
+int pa_shm_set_huge_pages(pa_shm *m);
+void pa_shm_prefault(pa_shm *m);
 
 void pa_shm_free(pa_shm *m);
 
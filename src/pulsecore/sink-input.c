@@ -856,7 +856,7 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
 
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
-    bool do_volume_adj_here, need_volume_factor_sink;
+    bool do_volume_adj_here;
     bool volume_is_norm;
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
@@ -907,7 +907,6 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
     do_volume_adj_here = !pa_channel_map_equal(&i->channel_map, &i->sink->channel_map);
     volume_is_norm = pa_cvolume_is_norm(&i->thread_info.soft_volume) && !i->thread_info.muted;
-    need_volume_factor_sink = !pa_cvolume_is_norm(&i->volume_factor_sink);
 
     while (!pa_memblockq_is_readable(i->thread_info.render_memblockq)) {
         pa_memchunk tchunk;
@@ -942,7 +941,6 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
         while (tchunk.length > 0) {
             pa_memchunk wchunk;
-            bool nvfs = need_volume_factor_sink;
 
             wchunk = tchunk;
             pa_memblock_ref(wchunk.memblock);
@@ -954,33 +952,15 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
             if (do_volume_adj_here && !volume_is_norm) {
                 pa_memchunk_make_writable(&wchunk, 0);
 
-                if (i->thread_info.muted) {
+                if (i->thread_info.muted)
                     pa_silence_memchunk(&wchunk, &i->thread_info.sample_spec);
-                    nvfs = false;
-
-                } else if (!i->thread_info.resampler && nvfs) {
-                    pa_cvolume v;
-
-                    /* If we don't need a resampler we can merge the
-                     * post and the pre volume adjustment into one */
-
-                    pa_sw_cvolume_multiply(&v, &i->thread_info.soft_volume, &i->volume_factor_sink);
-                    pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &v);
-                    nvfs = false;
-
-                } else
+                else
                     pa_volume_memchunk(&wchunk, &i->thread_info.sample_spec, &i->thread_info.soft_volume);
             }
 
-            if (!i->thread_info.resampler) {
-
-                if (nvfs) {
-                    pa_memchunk_make_writable(&wchunk, 0);
-                    pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
-                }
-
+            if (!i->thread_info.resampler)
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
-            } else {
+            else {
                 pa_memchunk rchunk;
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
 
@@ -989,12 +969,6 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 #endif
 
                 if (rchunk.memblock) {
-
-                    if (nvfs) {
-                        pa_memchunk_make_writable(&rchunk, 0);
-                        pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
-                    }
-
                     pa_memblockq_push_align(i->thread_info.render_memblockq, &rchunk);
                     pa_memblock_unref(rchunk.memblock);
                 }
@@ -1032,6 +1006,12 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
     else
         *volume = i->thread_info.soft_volume;
+
+    /* The volume factor is in the sink's channel map in any case, so
+     * the sink can apply it while mixing instead of us scaling every
+     * chunk in an extra pass */
+    if (!pa_cvolume_is_norm(&i->volume_factor_sink))
+        pa_sw_cvolume_multiply(volume, volume, &i->volume_factor_sink);
 }
 
 /* Called from thread context */
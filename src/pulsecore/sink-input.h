@@ -58,7 +58,10 @@ typedef enum pa_sink_input_flags {
     PA_SINK_INPUT_DONT_INHIBIT_AUTO_SUSPEND = 256,
     PA_SINK_INPUT_NO_CREATE_ON_SUSPEND = 512,
     PA_SINK_INPUT_KILL_ON_SUSPEND = 1024,
-    PA_SINK_INPUT_PASSTHROUGH = 2048
+    PA_SINK_INPUT_PASSTHROUGH = 2048,
+    /* pop() only touches state of this input, and may run in a render
+     * worker concurrently with the pop() of other inputs of the sink */
+    PA_SINK_INPUT_PARALLEL_PEEK = 4096
 } pa_sink_input_flags_t;
 
 struct pa_sink_input {
@@ -49,7 +49,11 @@
 
 #include "sink.h"
 
-#define MAX_MIX_CHANNELS 32
+#define MIX_INFO_DEFAULT_SIZE 32
+
+/* Below this many inputs waking up the render workers costs more than
+ * peeking the inputs one by one */
+#define RENDER_WORKERS_MIN_INPUTS 4
 #define MIX_BUFFER_LENGTH (pa_page_size())
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
@@ -327,6 +331,10 @@ pa_sink* pa_sink_new(
     s->thread_info.rtpoll = NULL;
     s->thread_info.inputs = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL,
                                                 (pa_free_cb_t) pa_sink_input_unref);
+    s->thread_info.mix_info = pa_xnew(pa_mix_info, MIX_INFO_DEFAULT_SIZE);
+    s->thread_info.peek_inputs = pa_xnew(pa_sink_input*, MIX_INFO_DEFAULT_SIZE);
+    s->thread_info.mix_info_size = MIX_INFO_DEFAULT_SIZE;
+    s->thread_info.render_workers = pa_core_get_render_workers(core);
     s->thread_info.soft_volume =  s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
@@ -800,6 +808,8 @@ static void sink_free(pa_object *o) {
 
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs);
+    pa_xfree(s->thread_info.mix_info);
+    pa_xfree(s->thread_info.peek_inputs);
 
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
@@ -1059,6 +1069,121 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     }
 }
 
+/* Called from IO thread context, when an input was added, while the
+ * main thread waits for us. Rendering doesn't allocate, so do it here. */
+static void grow_mix_info(pa_sink *s) {
+    unsigned n_inputs, size;
+
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+
+    /* Make sure there's room for every input, so that no stream is
+     * left out of the mix when many are connected. The array only
+     * ever grows, so this allocates at most a few times over the
+     * lifetime of a sink. */
+    n_inputs = pa_hashmap_size(s->thread_info.inputs);
+
+    if (PA_LIKELY(n_inputs <= s->thread_info.mix_info_size))
+        return;
+
+    size = s->thread_info.mix_info_size;
+    while (size < n_inputs)
+        size *= 2;
+
+    pa_xfree(s->thread_info.mix_info);
+    pa_xfree(s->thread_info.peek_inputs);
+    s->thread_info.mix_info = pa_xnew(pa_mix_info, size);
+    s->thread_info.peek_inputs = pa_xnew(pa_sink_input*, size);
+    s->thread_info.mix_info_size = size;
+}
+
+struct peek_job {
+    pa_sink_input **inputs;
+    pa_mix_info *info;
+    size_t length;
+};
+
+/* Called from IO thread context, or a render worker on its behalf */
+static void peek_input_cb(unsigned idx, void *userdata) {
+    struct peek_job *j = userdata;
+
+    /* The others have been peeked by the IO thread already */
+    if (!(j->inputs[idx]->flags & PA_SINK_INPUT_PARALLEL_PEEK))
+        return;
+
+    pa_sink_input_peek(j->inputs[idx], j->length, &j->info[idx].chunk, &j->info[idx].volume);
+}
+
+/* Called from IO thread context. Returns (unsigned) -1 if too few of
+ * the inputs can be peeked in parallel to make it worth it. */
+static unsigned fill_mix_info_parallel(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
+    struct peek_job j;
+    pa_sink_input *i;
+    unsigned n = 0, n_inputs = 0, n_parallel = 0, k;
+    void *state;
+    size_t mixlength = *length;
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+        if (n_inputs >= maxinfo)
+            break;
+
+        pa_sink_input_assert_ref(i);
+        s->thread_info.peek_inputs[n_inputs++] = i;
+
+        if (i->flags & PA_SINK_INPUT_PARALLEL_PEEK)
+            n_parallel++;
+    }
+
+    if (n_parallel < RENDER_WORKERS_MIN_INPUTS)
+        return (unsigned) -1;
+
+    j.inputs = s->thread_info.peek_inputs;
+    j.info = info;
+    j.length = *length;
+
+    /* Inputs whose pop() might touch state shared with other inputs,
+     * like the sink's rewind request or the core's silence cache, are
+     * peeked here one by one */
+    for (k = 0; k < n_inputs; k++)
+        if (!(j.inputs[k]->flags & PA_SINK_INPUT_PARALLEL_PEEK))
+            pa_sink_input_peek(j.inputs[k], j.length, &info[k].chunk, &info[k].volume);
+
+    /* Every other input is peeked into its own slot, independently of
+     * the others, with the same length as in the serial case */
+    pa_worker_pool_run(s->thread_info.render_workers, n_inputs, peek_input_cb, &j);
+
+    /* Now compact the slots in the order of the inputs, so the result
+     * is exactly what the serial loop in fill_mix_info() produces */
+    for (k = 0; k < n_inputs; k++) {
+        pa_mix_info *m = info + k;
+
+        if (mixlength == 0 || m->chunk.length < mixlength)
+            mixlength = m->chunk.length;
+
+        if (pa_memblock_is_silence(m->chunk.memblock)) {
+            pa_memblock_unref(m->chunk.memblock);
+            continue;
+        }
+
+        if (n != k) {
+            info[n].chunk = m->chunk;
+            info[n].volume = m->volume;
+        }
+
+        info[n].userdata = pa_sink_input_ref(j.inputs[k]);
+
+        pa_assert(info[n].chunk.memblock);
+        pa_assert(info[n].chunk.length > 0);
+
+        n++;
+    }
+
+    if (mixlength > 0)
+        *length = mixlength;
+
+    return n;
+}
+
 /* Called from IO thread context */
 static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
     pa_sink_input *i;
@@ -1070,6 +1195,13 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (s->thread_info.render_workers &&
+        pa_hashmap_size(s->thread_info.inputs) >= RENDER_WORKERS_MIN_INPUTS &&
+        (n = fill_mix_info_parallel(s, length, info, maxinfo)) != (unsigned) -1)
+        return n;
+
+    n = 0;
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
         pa_sink_input_assert_ref(i);
 
@@ -1199,7 +1331,7 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
 
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t block_size_max;
 
@@ -1230,7 +1362,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = s->thread_info.mix_info;
+    n = fill_mix_info(s, &length, info, s->thread_info.mix_info_size);
 
     if (n == 0) {
 
@@ -1259,8 +1392,21 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                     &s->sample_spec,
                                     result->length);
         } else if (!pa_cvolume_is_norm(&volume)) {
-            pa_memchunk_make_writable(result, 0);
-            pa_volume_memchunk(result, &s->sample_spec, &volume);
+            void *ptr;
+
+            /* Scale into a new block in a single pass instead of copying
+             * the chunk first and adjusting the volume in place */
+            pa_memblock_unref(result->memblock);
+            result->memblock = pa_memblock_new(s->core->mempool, result->length);
+            result->index = 0;
+
+            ptr = pa_memblock_acquire(result->memblock);
+            pa_mix(info, 1,
+                   ptr, result->length,
+                   &s->sample_spec,
+                   &s->thread_info.soft_volume,
+                   false);
+            pa_memblock_release(result->memblock);
         }
     } else {
         void *ptr;
@@ -1284,7 +1430,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
 /* Called from IO thread context */
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
-    pa_mix_info info[MAX_MIX_CHANNELS];
+    pa_mix_info *info;
     unsigned n;
     size_t length, block_size_max;
 
@@ -1313,7 +1459,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_assert(length > 0);
 
-    n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
+    info = s->thread_info.mix_info;
+    n = fill_mix_info(s, &length, info, s->thread_info.mix_info_size);
 
     if (n == 0) {
         if (target->length > length)
@@ -1330,7 +1477,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&volume))
             pa_silence_memchunk(target, &s->sample_spec);
-        else {
+        else if (pa_cvolume_is_norm(&volume)) {
             pa_memchunk vchunk;
 
             vchunk = info[0].chunk;
@@ -1339,13 +1486,19 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             if (vchunk.length > length)
                 vchunk.length = length;
 
-            if (!pa_cvolume_is_norm(&volume)) {
-                pa_memchunk_make_writable(&vchunk, 0);
-                pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-            }
-
             pa_memchunk_memcpy(target, &vchunk);
             pa_memblock_unref(vchunk.memblock);
+        } else {
+            void *ptr;
+
+            /* Scale straight into the target, no need to copy first */
+            ptr = pa_memblock_acquire(target->memblock);
+            pa_mix(info, 1,
+                   (uint8_t*) ptr + target->index, target->length,
+                   &s->sample_spec,
+                   &s->thread_info.soft_volume,
+                   false);
+            pa_memblock_release(target->memblock);
         }
 
     } else {
@@ -2550,6 +2703,7 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
              * PA_SINK_MESSAGE_FINISH_MOVE, too. */
 
             pa_hashmap_put(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index), pa_sink_input_ref(i));
+            grow_mix_info(s);
 
             /* Since the caller sleeps in pa_sink_input_put(), we can
              * safely access data outside of thread_info even though
@@ -2729,6 +2883,7 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             pa_assert(!i->thread_info.sync_prev);
 
             pa_hashmap_put(s->thread_info.inputs, PA_UINT32_TO_PTR(i->index), pa_sink_input_ref(i));
+            grow_mix_info(s);
 
             pa_sink_input_attach(i);
 
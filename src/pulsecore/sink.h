@@ -33,6 +33,8 @@
 #include <pulsecore/core.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/mix.h>
+#include <pulsecore/worker-pool.h>
 #include <pulsecore/source.h>
 #include <pulsecore/module.h>
 #include <pulsecore/asyncmsgq.h>
@@ -274,6 +276,15 @@ struct pa_sink {
         pa_sink_state_t state;
         pa_hashmap *inputs;
 
+        /* Scratch arrays for pa_sink_render(), grown on demand so that
+         * they can hold one entry per input */
+        pa_mix_info *mix_info;
+        pa_sink_input **peek_inputs;
+        unsigned mix_info_size;
+
+        /* If set, inputs are peeked in parallel on these threads */
+        pa_worker_pool *render_workers;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
@@ -402,7 +402,7 @@ int pa_source_output_new(
 
         if (!pa_source_output_new_data_is_passthrough(data)) /* no resampler for passthrough content */
             if (!(resampler = pa_resampler_new(
-                        core->mempool,
+                        data->mempool ? data->mempool : core->mempool,
                         &data->source->sample_spec, &data->source->channel_map,
                         &data->sample_spec, &data->channel_map,
                         core->lfe_crossover_freq,
@@ -433,6 +433,7 @@ int pa_source_output_new(
     o->client = data->client;
 
     o->requested_resample_method = data->resample_method;
+    o->mempool = pa_mempool_ref(data->mempool ? data->mempool : core->mempool);
     o->actual_resample_method = resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
     o->sample_spec = data->sample_spec;
     o->channel_map = data->channel_map;
@@ -642,6 +643,9 @@ static void source_output_free(pa_object* mo) {
     if (o->thread_info.resampler)
         pa_resampler_free(o->thread_info.resampler);
 
+    if (o->mempool)
+        pa_mempool_unref(o->mempool);
+
     if (o->format)
         pa_format_info_free(o->format);
 
@@ -1744,7 +1748,7 @@ int pa_source_output_update_rate(pa_source_output *o) {
          !pa_sample_spec_equal(&o->sample_spec, &o->source->sample_spec) ||
          !pa_channel_map_equal(&o->channel_map, &o->source->channel_map))) {
 
-        new_resampler = pa_resampler_new(o->core->mempool,
+        new_resampler = pa_resampler_new(o->mempool,
                                      &o->source->sample_spec, &o->source->channel_map,
                                      &o->sample_spec, &o->channel_map,
                                      o->core->lfe_crossover_freq,
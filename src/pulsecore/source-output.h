@@ -114,6 +114,9 @@ struct pa_source_output {
 
     pa_resample_method_t requested_resample_method, actual_resample_method;
 
+    /* The pool the resampler renders into */
+    pa_mempool *mempool;
+
     /* Pushes a new memchunk into the output. Called from IO thread
      * context. */
     void (*push)(pa_source_output *o, const pa_memchunk *chunk); /* may NOT be NULL */
@@ -257,6 +260,10 @@ typedef struct pa_source_output_new_data {
 
     pa_resample_method_t resample_method;
 
+    /* If set, resampled data is rendered into blocks of this pool
+     * instead of the core's, e.g. to share them with a client */
+    pa_mempool *mempool;
+
     pa_sample_spec sample_spec;
     pa_channel_map channel_map;
     pa_format_info *format;
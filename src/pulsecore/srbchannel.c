@@ -69,10 +69,14 @@ static void *pa_ringbuffer_begin_write(pa_ringbuffer *r, int *count) {
     return r->memory + r->writeindex;
 }
 
-static void pa_ringbuffer_end_write(pa_ringbuffer *r, int count) {
-    pa_atomic_add(r->count, count);
+/* Returns the amount of data that was in the buffer before the write. */
+static int pa_ringbuffer_end_write(pa_ringbuffer *r, int count) {
+    int c = pa_atomic_add(r->count, count);
+
     r->writeindex += count;
     r->writeindex %= r->capacity;
+
+    return c;
 }
 
 struct pa_srbchannel {
@@ -86,6 +90,8 @@ struct pa_srbchannel {
     pa_io_event *read_event;
     pa_defer_event *defer_event;
     pa_mainloop_api *mainloop;
+
+    bool batch_wakeups;
 };
 
 /* We always listen to sem_read, and always signal on sem_write.
@@ -95,13 +101,20 @@ struct pa_srbchannel {
  *    side to read it
  * 2) We have read something from our receive buffer that was previously
  *    completely full, and want the other side to continue writing
+ *
+ * With batched wakeups, 1) is only signalled when the send buffer goes
+ * from empty to non-empty or fills past half its capacity. A reader keeps
+ * reading until it finds the buffer empty, so whatever we add to a
+ * non-empty buffer will be picked up without another wakeup.
 */
 
 size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
     size_t written = 0;
+    bool signal = !sr->batch_wakeups;
+    int watermark = sr->rb_write.capacity / 2;
 
     while (l > 0) {
-        int towrite;
+        int towrite, c;
         void *ptr = pa_ringbuffer_begin_write(&sr->rb_write, &towrite);
 
         if ((size_t) towrite > l)
@@ -115,16 +128,22 @@ size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
         }
 
         memcpy(ptr, data, towrite);
-        pa_ringbuffer_end_write(&sr->rb_write, towrite);
+        c = pa_ringbuffer_end_write(&sr->rb_write, towrite);
+        if (c == 0 || (c < watermark && c + towrite >= watermark))
+            signal = true;
+
         written += towrite;
         data = (uint8_t*) data + towrite;
         l -= towrite;
     }
+
+    if (signal) {
 #ifdef DEBUG_SRBCHANNEL
-    pa_log("Wrote %d bytes to srbchannel, signalling fdsem", (int) written);
+        pa_log("Wrote %d bytes to srbchannel, signalling fdsem", (int) written);
 #endif
+        pa_fdsem_post(sr->sem_write);
+    }
 
-    pa_fdsem_post(sr->sem_write);
     return written;
 }
 
@@ -221,14 +240,29 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
     srbchannel_rwloop(sr);
 }
 
-pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p) {
+pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p, size_t size) {
     int capacity;
     int readfd;
+    size_t length = (size_t) -1;
     struct srbheader *srh;
 
     pa_srbchannel* sr = pa_xmalloc0(sizeof(pa_srbchannel));
     sr->mainloop = m;
-    sr->memblock = pa_memblock_new_pool(p, -1);
+
+    /* The ringbuffers have to fit into a single pool block, so anything
+     * larger than that gets us the largest block there is */
+    if (size != (size_t) -1) {
+        pa_assert(size > 0);
+
+        length = pa_srbchannel_block_size(size);
+
+        if (length > pa_mempool_block_size_max(p)) {
+            pa_log_warn("Ringbuffer size of %zu bytes doesn't fit into one pool block, using the largest block instead.", size);
+            length = (size_t) -1;
+        }
+    }
+
+    sr->memblock = pa_memblock_new_pool(p, length);
     if (!sr->memblock)
         goto fail;
 
@@ -278,6 +312,10 @@ fail:
     return NULL;
 }
 
+size_t pa_srbchannel_block_size(size_t size) {
+    return PA_ALIGN(sizeof(struct srbheader)) + 2 * PA_ALIGN(size);
+}
+
 static void pa_srbchannel_swap(pa_srbchannel *sr) {
     pa_srbchannel temp = *sr;
 
@@ -353,6 +391,18 @@ void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback,
     }
 }
 
+void pa_srbchannel_set_batch_wakeups(pa_srbchannel *sr, bool batch) {
+    pa_assert(sr);
+
+    sr->batch_wakeups = batch;
+}
+
+size_t pa_srbchannel_get_capacity(pa_srbchannel *sr) {
+    pa_assert(sr);
+
+    return (size_t) sr->rb_write.capacity;
+}
+
 void pa_srbchannel_free(pa_srbchannel *sr)
 {
 #ifdef DEBUG_SRBCHANNEL
@@ -34,7 +34,16 @@ typedef struct pa_srbchannel_template {
     pa_memblock *memblock;
 } pa_srbchannel_template;
 
-pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p);
+/* Creates a srbchannel with two ringbuffers of the given size each. They
+ * have to fit into one block of the pool, so larger sizes are clamped to
+ * the largest block with a warning. Pools for larger ringbuffers can be
+ * created with pa_mempool_new_with_block_size() and
+ * pa_srbchannel_block_size(). Pass (size_t) -1 to get the largest
+ * ringbuffers the pool allows. The peer picks up the size from the shared
+ * header. */
+pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p, size_t size);
+/* The size of the pool block two ringbuffers of the given size need */
+size_t pa_srbchannel_block_size(size_t size);
 /* Note: this creates a srbchannel with swapped read and write. */
 pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel_template *t);
 
@@ -54,4 +63,11 @@ size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l);
 typedef bool (*pa_srbchannel_cb_t)(pa_srbchannel *sr, void *userdata);
 void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback, void *userdata);
 
+/* Only wake up the other side when the send buffer stops being empty or
+ * gets half full, rather than on every write. This requires the reader to
+ * drain the buffer completely on every callback, as pa_pstream does. */
+void pa_srbchannel_set_batch_wakeups(pa_srbchannel *sr, bool batch);
+
+size_t pa_srbchannel_get_capacity(pa_srbchannel *sr);
+
 #endif
@@ -0,0 +1,297 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "sample-util.h"
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+#include <immintrin.h>
+
+/* The volume factors are loaded as a vector starting at the channel of
+ * the first sample, which works because the volume table is padded with
+ * repetitions of the factors. What is left over at the end is handed to
+ * the function that was installed before, with the volume table moved
+ * to the channel of the first remaining sample. All functions give the
+ * same results as the C implementations in svolume_c.c. */
+
+static pa_do_volume_func_t fallback[PA_SAMPLE_MAX];
+
+#define NEXT_CHANNEL(channel, channels, n) \
+    do {                                   \
+        channel += n;                      \
+        while (channel >= channels)        \
+            channel -= channels;           \
+    } while (0)
+
+__attribute__ ((target ("avx2")))
+static inline __m256i swap16_avx2(__m256i v) {
+    return _mm256_shuffle_epi8(v, _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                                   1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i swap32_avx2(__m256i v) {
+    return _mm256_shuffle_epi8(v, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+/* Same as pa_mult_s16_volume(), for s16 samples in the low half of
+ * 32 bit lanes with the upper half zero */
+__attribute__ ((target ("avx2")))
+static inline __m256i mult_s16_volume_avx2(__m256i s, __m256i v) {
+    __m256i sign, lo;
+
+    sign = _mm256_and_si256(_mm256_cmpgt_epi16(_mm256_setzero_si256(), s), v);
+    lo = _mm256_sub_epi32(_mm256_mulhi_epu16(s, v), sign);
+
+    return _mm256_add_epi32(lo, _mm256_madd_epi16(s, _mm256_srli_epi32(v, 16)));
+}
+
+/* (s * v) >> 16 with 64 bit products, saturated to 32 bit. Clamping the
+ * product to 48 bit before the shift is the same as clamping after. */
+__attribute__ ((target ("avx2")))
+static inline __m256i clamp48_avx2(__m256i p) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x800000000000LL);
+
+    p = _mm256_blendv_epi8(p, max, _mm256_cmpgt_epi64(p, max));
+    return _mm256_blendv_epi8(p, min, _mm256_cmpgt_epi64(min, p));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i mult_s32_volume_avx2(__m256i s, __m256i v) {
+    __m256i even, odd;
+
+    even = clamp48_avx2(_mm256_mul_epi32(s, v));
+    odd = clamp48_avx2(_mm256_mul_epi32(_mm256_srli_epi64(s, 32), _mm256_srli_epi64(v, 32)));
+
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, 16), _mm256_slli_epi64(odd, 16), 0xaa);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i volume_s16_avx2(__m256i s, const int32_t *volumes) {
+    __m256i v0, v1;
+
+    v0 = _mm256_loadu_si256((const __m256i *) volumes);
+    v1 = _mm256_loadu_si256((const __m256i *) (volumes + 8));
+
+    /* unpack works within 128 bit lanes, see pa_mix_s16ne_avx2() */
+    return _mm256_packs_epi32(
+            mult_s16_volume_avx2(_mm256_unpacklo_epi16(s, _mm256_setzero_si256()), _mm256_permute2x128_si256(v0, v1, 0x20)),
+            mult_s16_volume_avx2(_mm256_unpackhi_epi16(s, _mm256_setzero_si256()), _mm256_permute2x128_si256(v0, v1, 0x31)));
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s16ne_avx2(int16_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 16 * sizeof(int16_t); length -= 16 * sizeof(int16_t), samples += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) samples);
+
+        _mm256_storeu_si256((__m256i *) samples, volume_s16_avx2(s, volumes + channel));
+        NEXT_CHANNEL(channel, channels, 16);
+    }
+
+    fallback[PA_SAMPLE_S16NE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s16re_avx2(int16_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 16 * sizeof(int16_t); length -= 16 * sizeof(int16_t), samples += 16) {
+        __m256i s = swap16_avx2(_mm256_loadu_si256((const __m256i *) samples));
+
+        _mm256_storeu_si256((__m256i *) samples, swap16_avx2(volume_s16_avx2(s, volumes + channel)));
+        NEXT_CHANNEL(channel, channels, 16);
+    }
+
+    fallback[PA_SAMPLE_S16RE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_float32ne_avx2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 8 * sizeof(float); length -= 8 * sizeof(float), samples += 8) {
+        _mm256_storeu_ps(samples, _mm256_mul_ps(_mm256_loadu_ps(samples), _mm256_loadu_ps(volumes + channel)));
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+
+    fallback[PA_SAMPLE_FLOAT32NE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_float32re_avx2(float *samples, const float *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 8 * sizeof(float); length -= 8 * sizeof(float), samples += 8) {
+        __m256 s = _mm256_castsi256_ps(swap32_avx2(_mm256_loadu_si256((const __m256i *) samples)));
+
+        s = _mm256_mul_ps(s, _mm256_loadu_ps(volumes + channel));
+        _mm256_storeu_si256((__m256i *) samples, swap32_avx2(_mm256_castps_si256(s)));
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+
+    fallback[PA_SAMPLE_FLOAT32RE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s32ne_avx2(int32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 8 * sizeof(int32_t); length -= 8 * sizeof(int32_t), samples += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) samples);
+
+        s = mult_s32_volume_avx2(s, _mm256_loadu_si256((const __m256i *) (volumes + channel)));
+        _mm256_storeu_si256((__m256i *) samples, s);
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+
+    fallback[PA_SAMPLE_S32NE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s32re_avx2(int32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 8 * sizeof(int32_t); length -= 8 * sizeof(int32_t), samples += 8) {
+        __m256i s = swap32_avx2(_mm256_loadu_si256((const __m256i *) samples));
+
+        s = mult_s32_volume_avx2(s, _mm256_loadu_si256((const __m256i *) (volumes + channel)));
+        _mm256_storeu_si256((__m256i *) samples, swap32_avx2(s));
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+
+    fallback[PA_SAMPLE_S32RE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s24_32ne_avx2(uint32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 8 * sizeof(uint32_t); length -= 8 * sizeof(uint32_t), samples += 8) {
+        __m256i s = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *) samples), 8);
+
+        s = mult_s32_volume_avx2(s, _mm256_loadu_si256((const __m256i *) (volumes + channel)));
+        _mm256_storeu_si256((__m256i *) samples, _mm256_srli_epi32(s, 8));
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+
+    fallback[PA_SAMPLE_S24_32NE](samples, volumes + channel, channels, length);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s24_32re_avx2(uint32_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    unsigned channel = 0;
+
+    for (; length >= 8 * sizeof(uint32_t); length -= 8 * sizeof(uint32_t), samples += 8) {
+        __m256i s = _mm256_slli_epi32(swap32_avx2(_mm256_loadu_si256((const __m256i *) samples)), 8);
+
+        s = mult_s32_volume_avx2(s, _mm256_loadu_si256((const __m256i *) (volumes + channel)));
+        _mm256_storeu_si256((__m256i *) samples, swap32_avx2(_mm256_srli_epi32(s, 8)));
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+
+    fallback[PA_SAMPLE_S24_32RE](samples, volumes + channel, channels, length);
+}
+
+/* Packed 24 bit samples are done eight at a time. The two 128 bit lanes
+ * are loaded 8 bytes apart, so that together they cover exactly the 24
+ * bytes, and the shuffle masks move the bytes of each sample to the top
+ * of a 32 bit lane, in the byte order of the format. */
+__attribute__ ((target ("avx2")))
+static inline void volume_s24_avx2(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned *length,
+                                   __m256i unpack, __m128i pack) {
+    unsigned channel = 0;
+
+    for (; *length >= 24; *length -= 24, samples += 24) {
+        __m256i s;
+        __m128i p0, p1;
+
+        s = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) samples)),
+                                    _mm_loadu_si128((const __m128i *) (samples + 8)), 1);
+        s = mult_s32_volume_avx2(_mm256_shuffle_epi8(s, unpack), _mm256_loadu_si256((const __m256i *) (volumes + channel)));
+
+        p0 = _mm_shuffle_epi8(_mm256_castsi256_si128(s), pack);
+        p1 = _mm_shuffle_epi8(_mm256_extracti128_si256(s, 1), pack);
+
+        _mm_storeu_si128((__m128i *) samples, _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+        _mm_storel_epi64((__m128i *) (samples + 16), _mm_srli_si128(p1, 4));
+        NEXT_CHANNEL(channel, channels, 8);
+    }
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s24ne_avx2(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    const __m256i unpack = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                            -1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15);
+    const __m128i pack = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    unsigned n = length;
+
+    volume_s24_avx2(samples, volumes, channels, &n, unpack, pack);
+    fallback[PA_SAMPLE_S24NE](samples + length - n, volumes + ((length - n) / 3) % channels, channels, n);
+}
+
+__attribute__ ((target ("avx2")))
+static void pa_volume_s24re_avx2(uint8_t *samples, const int32_t *volumes, unsigned channels, unsigned length) {
+    const __m256i unpack = _mm256_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+                                            -1, 6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13);
+    const __m128i pack = _mm_setr_epi8(3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1);
+    unsigned n = length;
+
+    volume_s24_avx2(samples, volumes, channels, &n, unpack, pack);
+    fallback[PA_SAMPLE_S24RE](samples + length - n, volumes + ((length - n) / 3) % channels, channels, n);
+}
+
+static void set_volume_func(pa_sample_format_t f, pa_do_volume_func_t func) {
+    /* Don't end up with ourselves as fallback when initialised twice */
+    if (pa_get_volume_func(f) != func)
+        fallback[f] = pa_get_volume_func(f);
+
+    pa_set_volume_func(f, func);
+}
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+
+void pa_volume_func_init_avx2(pa_cpu_x86_flag_t flags) {
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS)
+
+    if (flags & PA_CPU_X86_AVX2) {
+        pa_log_info("Initialising AVX2 optimized volume functions.");
+
+        set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_avx2);
+        set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_avx2);
+        set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_avx2);
+        set_volume_func(PA_SAMPLE_FLOAT32RE, (pa_do_volume_func_t) pa_volume_float32re_avx2);
+        set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_avx2);
+        set_volume_func(PA_SAMPLE_S32RE, (pa_do_volume_func_t) pa_volume_s32re_avx2);
+        set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_avx2);
+        set_volume_func(PA_SAMPLE_S24RE, (pa_do_volume_func_t) pa_volume_s24re_avx2);
+        set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_avx2);
+        set_volume_func(PA_SAMPLE_S24_32RE, (pa_do_volume_func_t) pa_volume_s24_32re_avx2);
+    }
+
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_X86_INTRINSICS) */
+}
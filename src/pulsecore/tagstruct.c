@@ -36,6 +36,7 @@
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/atomic.h>
 
 #include "tagstruct.h"
 
@@ -43,6 +44,14 @@
 #define MAX_APPENDED_SIZE 128
 #define GROW_TAG_SIZE 100
 
+/* Tagstructs outgrowing the appended buffer first move to a buffer of
+ * this size taken from a free list, which is enough for almost all
+ * replies and events. Only larger ones are malloc()ed individually. */
+#define POOLED_TAG_SIZE 4096
+
+/* At most this many unused buffers are kept around */
+#define POOLED_TAG_MAX 32
+
 struct pa_tagstruct {
     uint8_t *data;
     size_t length, allocated;
@@ -51,7 +60,8 @@ struct pa_tagstruct {
     enum {
         PA_TAGSTRUCT_FIXED, /* The tagstruct does not own the data, buffer was provided by caller. */
         PA_TAGSTRUCT_DYNAMIC, /* Buffer owned by tagstruct, data must be freed. */
-        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to dynamic if needed. */
+        PA_TAGSTRUCT_APPENDED, /* Data points to appended buffer, used for small tagstructs. Will change to pooled or dynamic if needed. */
+        PA_TAGSTRUCT_POOLED, /* Buffer of POOLED_TAG_SIZE owned by tagstruct, goes back to the buffer free list. Will change to dynamic if needed. */
     } type;
     union {
         uint8_t appended[MAX_APPENDED_SIZE];
@@ -59,6 +69,32 @@ struct pa_tagstruct {
 };
 
 PA_STATIC_FLIST_DECLARE(tagstructs, 0, pa_xfree);
+PA_STATIC_FLIST_DECLARE(buffers, POOLED_TAG_MAX, pa_xfree);
+
+static pa_atomic_t n_allocated_buffers = PA_ATOMIC_INIT(0);
+
+static uint8_t *buffer_new(void) {
+    uint8_t *b;
+
+    if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(buffers)))) {
+        b = pa_xmalloc(POOLED_TAG_SIZE);
+        pa_atomic_inc(&n_allocated_buffers);
+    }
+
+    return b;
+}
+
+static void buffer_free(void *b) {
+    if (pa_flist_push(PA_STATIC_FLIST_GET(buffers), b) < 0)
+        pa_xfree(b);
+}
+
+static void release_data(pa_tagstruct *t) {
+    if (t->type == PA_TAGSTRUCT_DYNAMIC)
+        pa_xfree(t->data);
+    else if (t->type == PA_TAGSTRUCT_POOLED)
+        buffer_free(t->data);
+}
 
 pa_tagstruct *pa_tagstruct_new(void) {
     pa_tagstruct*t;
@@ -91,26 +127,74 @@ pa_tagstruct *pa_tagstruct_new_fixed(const uint8_t* data, size_t length) {
 void pa_tagstruct_free(pa_tagstruct*t) {
     pa_assert(t);
 
-    if (t->type == PA_TAGSTRUCT_DYNAMIC)
-        pa_xfree(t->data);
+    release_data(t);
     if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
         pa_xfree(t);
 }
 
+uint8_t* pa_tagstruct_steal_data(pa_tagstruct *t, size_t *l, pa_free_cb_t *free_cb) {
+    uint8_t *data;
+
+    pa_assert(t);
+    pa_assert(l);
+    pa_assert(free_cb);
+
+    if (t->type == PA_TAGSTRUCT_DYNAMIC)
+        *free_cb = pa_xfree;
+    else if (t->type == PA_TAGSTRUCT_POOLED)
+        *free_cb = buffer_free;
+    else
+        return NULL;
+
+    data = t->data;
+    *l = t->length;
+
+    t->data = t->per_type.appended;
+    t->allocated = MAX_APPENDED_SIZE;
+    t->length = t->rindex = 0;
+    t->type = PA_TAGSTRUCT_APPENDED;
+
+    return data;
+}
+
+unsigned pa_tagstruct_get_n_allocated_buffers(void) {
+    return (unsigned) pa_atomic_load(&n_allocated_buffers);
+}
+
 static inline void extend(pa_tagstruct*t, size_t l) {
+    uint8_t *data;
+    size_t allocated;
+
     pa_assert(t);
     pa_assert(t->type != PA_TAGSTRUCT_FIXED);
 
     if (t->length+l <= t->allocated)
         return;
 
+    if (t->type == PA_TAGSTRUCT_APPENDED && t->length + l <= POOLED_TAG_SIZE) {
+        t->type = PA_TAGSTRUCT_POOLED;
+        t->data = buffer_new();
+        t->allocated = POOLED_TAG_SIZE;
+        memcpy(t->data, t->per_type.appended, t->length);
+        return;
+    }
+
+    /* Grow geometrically so that large tagstructs don't realloc() on
+     * every few entries */
+    allocated = PA_MAX(t->length + l + GROW_TAG_SIZE, t->allocated * 2);
+    pa_atomic_inc(&n_allocated_buffers);
+
     if (t->type == PA_TAGSTRUCT_DYNAMIC)
-        t->data = pa_xrealloc(t->data, t->allocated = t->length + l + GROW_TAG_SIZE);
-    else if (t->type == PA_TAGSTRUCT_APPENDED) {
+        t->data = pa_xrealloc(t->data, allocated);
+    else {
+        data = pa_xmalloc(allocated);
+        memcpy(data, t->data, t->length);
+        release_data(t);
+        t->data = data;
         t->type = PA_TAGSTRUCT_DYNAMIC;
-        t->data = pa_xmalloc(t->allocated = t->length + l + GROW_TAG_SIZE);
-        memcpy(t->data, t->per_type.appended, t->length);
     }
+
+    t->allocated = allocated;
 }
 
 static void write_u8(pa_tagstruct *t, uint8_t u) {
@@ -24,6 +24,7 @@
 #include <sys/types.h>
 #include <sys/time.h>
 
+#include <pulse/def.h>
 #include <pulse/sample.h>
 #include <pulse/format.h>
 #include <pulse/channelmap.h>
@@ -67,6 +68,15 @@ void pa_tagstruct_free(pa_tagstruct*t);
 int pa_tagstruct_eof(pa_tagstruct*t);
 const uint8_t* pa_tagstruct_data(pa_tagstruct*t, size_t *l);
 
+/* Take over the buffer of a tagstruct that outgrew its appended
+ * buffer, leaving the tagstruct empty. The buffer must be released
+ * with the returned free_cb. Returns NULL if the data doesn't live in
+ * a buffer of its own, use pa_tagstruct_data() then. */
+uint8_t* pa_tagstruct_steal_data(pa_tagstruct *t, size_t *l, pa_free_cb_t *free_cb);
+
+/* The number of buffers malloc()ed for tagstructs so far, for statistics */
+unsigned pa_tagstruct_get_n_allocated_buffers(void);
+
 void pa_tagstruct_put(pa_tagstruct *t, ...);
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s);
@@ -221,3 +221,7 @@ void pa_thread_mq_install(pa_thread_mq *q) {
 pa_thread_mq *pa_thread_mq_get(void) {
     return PA_STATIC_TLS_GET(thread_mq);
 }
+
+void pa_thread_mq_borrow(pa_thread_mq *q) {
+    PA_STATIC_TLS_SET(thread_mq, q);
+}
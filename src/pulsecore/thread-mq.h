@@ -46,6 +46,11 @@ void pa_thread_mq_install(pa_thread_mq *q);
 /* Return the pa_thread_mq object that is set for the current thread */
 pa_thread_mq *pa_thread_mq_get(void);
 
+/* Temporarily act on behalf of the thread that owns q, e.g. in a helper
+ * thread doing work for an IO thread. Pass NULL when done. Must not be
+ * used in threads that called pa_thread_mq_install(). */
+void pa_thread_mq_borrow(pa_thread_mq *q);
+
 /* Verify that we are in control context (aka 'main context'). */
 #define pa_assert_ctl_context(s) \
     pa_assert(!pa_thread_mq_get())
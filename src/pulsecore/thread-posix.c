@@ -162,6 +162,14 @@ pa_thread* pa_thread_self(void) {
     return t;
 }
 
+/* Whether the calling thread was not started by pa_thread_new(). Unlike
+ * pa_thread_self() this doesn't set anything up for foreign threads. */
+bool pa_thread_self_is_foreign(void) {
+    pa_thread *t;
+
+    return !(t = PA_STATIC_TLS_GET(current_thread)) || !t->thread_func;
+}
+
 void* pa_thread_get_data(pa_thread *t) {
     pa_assert(t);
 
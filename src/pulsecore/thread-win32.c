@@ -128,6 +128,10 @@ pa_thread* pa_thread_self(void) {
     return pa_tls_get(thread_tls);
 }
 
+bool pa_thread_self_is_foreign(void) {
+    return !pa_thread_self();
+}
+
 void* pa_thread_get_data(pa_thread *t) {
     pa_assert(t);
 
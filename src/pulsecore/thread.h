@@ -41,6 +41,7 @@ void pa_thread_free_nojoin(pa_thread *t);
 int pa_thread_join(pa_thread *t);
 int pa_thread_is_running(pa_thread *t);
 pa_thread *pa_thread_self(void);
+bool pa_thread_self_is_foreign(void);
 void pa_thread_yield(void);
 
 void* pa_thread_get_data(pa_thread *t);
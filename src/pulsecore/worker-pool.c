@@ -0,0 +1,188 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#include "worker-pool.h"
+
+typedef struct worker {
+    pa_worker_pool *pool;
+    pa_thread *thread;
+} worker;
+
+struct pa_worker_pool {
+    worker *workers;
+    unsigned n_threads;
+    bool realtime;
+    int rtprio;
+
+    /* Held by the thread running a job */
+    pa_mutex *mutex;
+
+    /* Workers wait on start, the caller waits on done once for each
+     * worker it woke up */
+    pa_semaphore *start, *done;
+
+    /* The current job. Written by the caller before posting start, so
+     * the workers see it. */
+    pa_worker_pool_cb_t cb;
+    void *userdata;
+    unsigned n;
+    pa_thread_mq *thread_mq;
+    bool quit;
+
+    pa_atomic_t next;
+};
+
+static void run_items(pa_worker_pool *p) {
+    int idx;
+
+    while ((idx = pa_atomic_inc(&p->next)) < (int) p->n)
+        p->cb((unsigned) idx, p->userdata);
+}
+
+static void thread_func(void *userdata) {
+    worker *w = userdata;
+    pa_worker_pool *p = w->pool;
+
+    if (p->realtime)
+        pa_make_realtime(p->rtprio);
+
+    for (;;) {
+        pa_semaphore_wait(p->start);
+
+        if (p->quit)
+            break;
+
+        pa_thread_mq_borrow(p->thread_mq);
+        run_items(p);
+        pa_thread_mq_borrow(NULL);
+
+        pa_semaphore_post(p->done);
+    }
+}
+
+pa_worker_pool *pa_worker_pool_new(const char *name, unsigned n_threads, bool realtime, int rtprio) {
+    pa_worker_pool *p;
+    unsigned i;
+
+    pa_assert(name);
+    pa_assert(n_threads > 0);
+
+    p = pa_xnew0(pa_worker_pool, 1);
+    p->realtime = realtime;
+    p->rtprio = rtprio;
+    p->mutex = pa_mutex_new(false, true);
+    p->start = pa_semaphore_new(0);
+    p->done = pa_semaphore_new(0);
+    p->workers = pa_xnew0(worker, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        worker *w = p->workers + i;
+
+        w->pool = p;
+
+        if (!(w->thread = pa_thread_new(name, thread_func, w))) {
+            pa_log_warn("Failed to create worker thread, using %u of %u.", i, n_threads);
+            break;
+        }
+
+        p->n_threads++;
+    }
+
+    if (p->n_threads <= 0) {
+        pa_worker_pool_free(p);
+        return NULL;
+    }
+
+    pa_log_info("Started %u worker threads.", p->n_threads);
+
+    return p;
+}
+
+void pa_worker_pool_free(pa_worker_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    p->quit = true;
+
+    for (i = 0; i < p->n_threads; i++)
+        pa_semaphore_post(p->start);
+
+    for (i = 0; i < p->n_threads; i++)
+        pa_thread_free(p->workers[i].thread);
+
+    pa_xfree(p->workers);
+    pa_semaphore_free(p->start);
+    pa_semaphore_free(p->done);
+    pa_mutex_free(p->mutex);
+    pa_xfree(p);
+}
+
+unsigned pa_worker_pool_get_n_threads(pa_worker_pool *p) {
+    pa_assert(p);
+
+    return p->n_threads;
+}
+
+void pa_worker_pool_run(pa_worker_pool *p, unsigned n, pa_worker_pool_cb_t cb, void *userdata) {
+    unsigned i, n_wakeup;
+
+    pa_assert(p);
+    pa_assert(cb);
+
+    /* Somebody else is using the pool (or we are called from one of
+     * the items), don't wait for it */
+    if (n <= 1 || !pa_mutex_try_lock(p->mutex)) {
+        for (i = 0; i < n; i++)
+            cb(i, userdata);
+        return;
+    }
+
+    p->cb = cb;
+    p->userdata = userdata;
+    p->n = n;
+    p->thread_mq = pa_thread_mq_get();
+    pa_atomic_store(&p->next, 0);
+
+    /* We do our share too */
+    n_wakeup = PA_MIN(p->n_threads, n - 1);
+
+    for (i = 0; i < n_wakeup; i++)
+        pa_semaphore_post(p->start);
+
+    run_items(p);
+
+    for (i = 0; i < n_wakeup; i++)
+        pa_semaphore_wait(p->done);
+
+    pa_mutex_unlock(p->mutex);
+}
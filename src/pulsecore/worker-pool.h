@@ -0,0 +1,46 @@
+#ifndef foopulseworkerpoolhfoo
+#define foopulseworkerpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdbool.h>
+
+/* A fixed set of helper threads an IO thread can hand independent work
+ * items to. The calling thread takes part in the work and
+ * pa_worker_pool_run() only returns when all items are done, so from the
+ * caller's point of view it behaves like a plain loop. While running an
+ * item, the workers borrow the pa_thread_mq of the calling thread.
+ *
+ * Only one thread can use the pool at a time. If it is busy, the caller
+ * simply runs all items itself, which is also what happens when an item
+ * uses the pool again. */
+
+typedef struct pa_worker_pool pa_worker_pool;
+
+typedef void (*pa_worker_pool_cb_t)(unsigned idx, void *userdata);
+
+pa_worker_pool *pa_worker_pool_new(const char *name, unsigned n_threads, bool realtime, int rtprio);
+void pa_worker_pool_free(pa_worker_pool *p);
+
+unsigned pa_worker_pool_get_n_threads(pa_worker_pool *p);
+
+/* Call cb for every idx in 0..n-1, in no particular order and possibly
+ * concurrently. */
+void pa_worker_pool_run(pa_worker_pool *p, unsigned n, pa_worker_pool_cb_t cb, void *userdata);
+
+#endif
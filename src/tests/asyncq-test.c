@@ -26,6 +26,8 @@
 #include <check.h>
 
 #include <pulse/util.h>
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/asyncq.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/log.h>
@@ -87,6 +89,78 @@ START_TEST (asyncq_test) {
 }
 END_TEST
 
+#define ROUND_TRIPS 20000
+
+struct ping_pong {
+    pa_asyncq *ping, *pong;
+};
+
+static void echo(void *_pp) {
+    struct ping_pong *pp = _pp;
+    void *p;
+
+    do {
+        p = pa_asyncq_pop(pp->ping, true);
+        pa_asyncq_push(pp->pong, p, true);
+    } while (p != PA_UINT_TO_PTR(-1));
+}
+
+static int usec_compare(const void *a, const void *b) {
+    const pa_usec_t *x = a, *y = b;
+
+    return *x < *y ? -1 : (*x > *y ? 1 : 0);
+}
+
+/* Bounce a pointer between two threads through a pair of queues, with both
+ * sides sleeping in pa_asyncq_pop(), as an IO thread handing work back and
+ * forth with the main thread would. */
+START_TEST (asyncq_latency_test) {
+    struct ping_pong pp;
+    pa_thread *t;
+    pa_usec_t *rtt;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pp.ping = pa_asyncq_new(0);
+    pp.pong = pa_asyncq_new(0);
+    fail_unless(pp.ping && pp.pong);
+
+    t = pa_thread_new("echo", echo, &pp);
+    fail_unless(t != NULL);
+
+    rtt = pa_xnew(pa_usec_t, ROUND_TRIPS);
+
+    for (i = 0; i < ROUND_TRIPS; i++) {
+        pa_usec_t start = pa_rtclock_now();
+
+        pa_asyncq_push(pp.ping, PA_UINT_TO_PTR(i+1), true);
+        fail_unless(pa_asyncq_pop(pp.pong, true) == PA_UINT_TO_PTR(i+1));
+
+        rtt[i] = pa_rtclock_now() - start;
+    }
+
+    pa_asyncq_push(pp.ping, PA_UINT_TO_PTR(-1), true);
+    fail_unless(pa_asyncq_pop(pp.pong, true) == PA_UINT_TO_PTR(-1));
+    pa_thread_free(t);
+
+    qsort(rtt, ROUND_TRIPS, sizeof(pa_usec_t), usec_compare);
+
+    pa_log_info("Round trip latency over %u runs: 50%% %llu usec, 90%% %llu usec, 99%% %llu usec, 99.9%% %llu usec, max %llu usec",
+                ROUND_TRIPS,
+                (unsigned long long) rtt[ROUND_TRIPS / 2],
+                (unsigned long long) rtt[ROUND_TRIPS * 90 / 100],
+                (unsigned long long) rtt[ROUND_TRIPS * 99 / 100],
+                (unsigned long long) rtt[ROUND_TRIPS * 999 / 1000],
+                (unsigned long long) rtt[ROUND_TRIPS - 1]);
+
+    pa_xfree(rtt);
+    pa_asyncq_free(pp.ping, NULL);
+    pa_asyncq_free(pp.pong, NULL);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -96,6 +170,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("Async Queue");
     tc = tcase_create("asyncq");
     tcase_add_test(tc, asyncq_test);
+    tcase_add_test(tc, asyncq_latency_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -21,8 +21,11 @@
 
 #include <check.h>
 
+#include <pulse/timeval.h>
+
 #include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/mix.h>
@@ -33,6 +36,9 @@
 #define TIMES 1000
 #define TIMES2 100
 
+#define MANY_FRAMES 1024
+#define MANY_TIMES 20
+
 static void acquire_mix_streams(pa_mix_info streams[], unsigned nstreams) {
     unsigned i;
 
@@ -90,17 +96,17 @@ static void run_mix_test(
 
     m[0].chunk = c0;
     m[0].volume.channels = channels;
-    for (i = 0; i < channels; i++) {
+    for (i = 0; i < channels; i++)
         m[0].volume.values[i] = PA_VOLUME_NORM;
+    for (i = 0; i < channels + PA_MIX_LINEAR_PADDING; i++)
         m[0].linear[i].i = 0x5555;
-    }
 
     m[1].chunk = c1;
     m[1].volume.channels = channels;
-    for (i = 0; i < channels; i++) {
+    for (i = 0; i < channels; i++)
         m[1].volume.values[i] = PA_VOLUME_NORM;
+    for (i = 0; i < channels + PA_MIX_LINEAR_PADDING; i++)
         m[1].linear[i].i = 0x6789;
-    }
 
     if (correct) {
         acquire_mix_streams(m, 2);
@@ -168,6 +174,261 @@ START_TEST (mix_special_test) {
 }
 END_TEST
 
+#define FORMAT_STREAMS 3
+
+/* Mixes FORMAT_STREAMS streams of random samples with a different factor
+ * for each stream and channel, some of them above unity to provoke
+ * clipping. The number of samples is chosen to not be a multiple of any
+ * vector size. */
+static void run_mix_format_test(
+        pa_sample_format_t format,
+        pa_do_mix_func_t func,
+        pa_do_mix_func_t orig_func,
+        int align,
+        int channels,
+        bool correct,
+        bool perf) {
+
+    pa_sample_spec ss;
+    pa_mempool *pool;
+    pa_mix_info m[FORMAT_STREAMS];
+    pa_memblock *out, *out_ref;
+    size_t fs, length;
+    void *samples, *samples_ref;
+    unsigned i, j, nsamples;
+
+    ss.format = format;
+    ss.rate = 48000;
+    ss.channels = channels;
+    fs = pa_frame_size(&ss);
+
+    nsamples = (SAMPLES - align) * channels;
+    length = nsamples * pa_sample_size(&ss);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    for (i = 0; i < FORMAT_STREAMS; i++) {
+        void *d;
+
+        /* Start the samples at an odd offset into the block */
+        m[i].chunk.memblock = pa_memblock_new(pool, length + align * fs);
+        m[i].chunk.index = align * fs;
+        m[i].chunk.length = length;
+
+        d = pa_memblock_acquire_chunk(&m[i].chunk);
+        for (j = 0; j < nsamples; j++) {
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ((float *) d)[j] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+            else if (format == PA_SAMPLE_S32NE)
+                ((int32_t *) d)[j] = (int32_t) ((uint32_t) rand() << 16 ^ (uint32_t) rand());
+            else
+                ((int16_t *) d)[j] = (int16_t) rand();
+        }
+        pa_memblock_release(m[i].chunk.memblock);
+
+        for (j = 0; j < (unsigned) channels + PA_MIX_LINEAR_PADDING; j++) {
+            unsigned c = j % channels;
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                m[i].linear[j].f = 0.3f + 0.2f * i + 0.1f * c;
+            else
+                m[i].linear[j].i = 0x4000 + 0x3000 * i + 0x1000 * c;
+        }
+    }
+
+    out = pa_memblock_new(pool, length + align * fs);
+    out_ref = pa_memblock_new(pool, length + align * fs);
+    samples = (uint8_t *) pa_memblock_acquire(out) + align * fs;
+    samples_ref = (uint8_t *) pa_memblock_acquire(out_ref) + align * fs;
+
+    if (correct) {
+        acquire_mix_streams(m, FORMAT_STREAMS);
+        orig_func(m, FORMAT_STREAMS, channels, samples_ref, length);
+        release_mix_streams(m, FORMAT_STREAMS);
+
+        acquire_mix_streams(m, FORMAT_STREAMS);
+        func(m, FORMAT_STREAMS, channels, samples, length);
+        release_mix_streams(m, FORMAT_STREAMS);
+
+        if (memcmp(samples, samples_ref, length) != 0) {
+            pa_log_debug("Correctness test failed: %s, align=%d, channels=%d",
+                         pa_sample_format_to_string(format), align, channels);
+            ck_abort();
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %d-channel %s mixing performance with %d sample alignment",
+                     channels, pa_sample_format_to_string(format), align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            acquire_mix_streams(m, FORMAT_STREAMS);
+            func(m, FORMAT_STREAMS, channels, samples, length);
+            release_mix_streams(m, FORMAT_STREAMS);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            acquire_mix_streams(m, FORMAT_STREAMS);
+            orig_func(m, FORMAT_STREAMS, channels, samples_ref, length);
+            release_mix_streams(m, FORMAT_STREAMS);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_memblock_release(out);
+    pa_memblock_release(out_ref);
+    pa_memblock_unref(out);
+    pa_memblock_unref(out_ref);
+
+    for (i = 0; i < FORMAT_STREAMS; i++)
+        pa_memblock_unref(m[i].chunk.memblock);
+
+    pa_mempool_unref(pool);
+}
+
+#if defined (__i386__) || defined (__amd64__)
+static const pa_sample_format_t x86_formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_S32NE, PA_SAMPLE_FLOAT32NE };
+
+static void run_x86_mix_tests(const char *name, void (*init)(pa_cpu_x86_flag_t flags), pa_cpu_x86_flag_t flags) {
+    pa_do_mix_func_t orig_func[PA_ELEMENTSOF(x86_formats)], func;
+    unsigned i;
+    int channels, align;
+
+    for (i = 0; i < PA_ELEMENTSOF(x86_formats); i++)
+        orig_func[i] = pa_get_mix_func(x86_formats[i]);
+
+    init(flags);
+
+    for (i = 0; i < PA_ELEMENTSOF(x86_formats); i++) {
+        func = pa_get_mix_func(x86_formats[i]);
+
+        if (func == orig_func[i])
+            continue;
+
+        pa_log_debug("Checking %s mix (%s)", name, pa_sample_format_to_string(x86_formats[i]));
+
+        for (channels = 1; channels <= 8; channels++)
+            for (align = 0; align < 4; align++)
+                run_mix_format_test(x86_formats[i], func, orig_func[i], align, channels, true, false);
+
+        run_mix_format_test(x86_formats[i], func, orig_func[i], 3, 2, true, true);
+        run_mix_format_test(x86_formats[i], func, orig_func[i], 3, 8, true, true);
+
+        pa_set_mix_func(x86_formats[i], orig_func[i]);
+    }
+}
+
+START_TEST (mix_sse_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    run_x86_mix_tests("SSE", pa_mix_func_init_sse, flags);
+}
+END_TEST
+
+START_TEST (mix_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    run_x86_mix_tests("AVX2", pa_mix_func_init_avx2, flags);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+static void run_many_streams_test(pa_sample_format_t format, unsigned nstreams) {
+    pa_sample_spec ss;
+    pa_mempool *pool;
+    pa_mix_info *m;
+    pa_memblock *in, *out;
+    size_t length;
+    void *ptr;
+    pa_usec_t start, stop;
+    unsigned i, j;
+
+    ss.format = format;
+    ss.rate = 48000;
+    ss.channels = 2;
+    length = MANY_FRAMES * pa_frame_size(&ss);
+
+    fail_unless((pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL, NULL);
+
+    /* Every stream carries the smallest non-zero sample, so the mix of
+     * n streams at unity volume must yield exactly n times that value */
+    in = pa_memblock_new(pool, length);
+    ptr = pa_memblock_acquire(in);
+    for (i = 0; i < MANY_FRAMES * ss.channels; i++) {
+        if (format == PA_SAMPLE_S16NE)
+            ((int16_t *) ptr)[i] = 1;
+        else
+            ((float *) ptr)[i] = 1.0f / 1024;
+    }
+    pa_memblock_release(in);
+
+    out = pa_memblock_new(pool, length);
+
+    m = pa_xnew(pa_mix_info, nstreams);
+    for (i = 0; i < nstreams; i++) {
+        m[i].chunk.memblock = in;
+        m[i].chunk.index = 0;
+        m[i].chunk.length = length;
+        pa_cvolume_reset(&m[i].volume, ss.channels);
+    }
+
+    ptr = pa_memblock_acquire(out);
+    pa_mix(m, nstreams, ptr, length, &ss, NULL, false);
+
+    for (i = 0; i < MANY_FRAMES * ss.channels; i++) {
+        if (format == PA_SAMPLE_S16NE)
+            ck_assert_int_eq(((int16_t *) ptr)[i], nstreams);
+        else {
+            /* Sums of 1/1024 are exact */
+            float expected = (float) nstreams / 1024;
+
+            fail_unless(memcmp((float *) ptr + i, &expected, sizeof(float)) == 0, NULL);
+        }
+    }
+
+    start = pa_rtclock_now();
+    for (j = 0; j < MANY_TIMES; j++)
+        pa_mix(m, nstreams, ptr, length, &ss, NULL, false);
+    stop = pa_rtclock_now();
+
+    pa_memblock_release(out);
+
+    pa_log_debug("Mixing %u %s streams: %g ns per frame, %g ns per frame and stream", nstreams,
+                 pa_sample_format_to_string(format),
+                 (double) (stop - start) * PA_NSEC_PER_USEC / (MANY_TIMES * MANY_FRAMES),
+                 (double) (stop - start) * PA_NSEC_PER_USEC / (MANY_TIMES * MANY_FRAMES * nstreams));
+
+    pa_xfree(m);
+    pa_memblock_unref(in);
+    pa_memblock_unref(out);
+
+    pa_mempool_unref(pool);
+}
+
+START_TEST (mix_many_streams_test) {
+    static const unsigned nstreams[] = { 8, 64, 256 };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(nstreams); i++) {
+        run_many_streams_test(PA_SAMPLE_S16NE, nstreams[i]);
+        run_many_streams_test(PA_SAMPLE_FLOAT32NE, nstreams[i]);
+    }
+}
+END_TEST
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (mix_neon_test) {
     pa_do_mix_func_t orig_func, neon_func;
@@ -209,6 +470,11 @@ int main(int argc, char *argv[]) {
 
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_special_test);
+    tcase_add_test(tc, mix_many_streams_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, mix_sse_test);
+    tcase_add_test(tc, mix_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, mix_neon_test);
 #endif
@@ -0,0 +1,439 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/timeval.h>
+
+#include <pulsecore/cpu.h>
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sample-util.h>
+
+#include "runtime-test-util.h"
+
+#define TAPS 96
+#define TIMES 10000
+#define TIMES2 100
+
+static void run_dot_test(pa_polyphase_dot_func_t func, pa_polyphase_dot_func_t orig_func, bool correct, bool perf) {
+    PA_DECLARE_ALIGNED(8, float, coeffs[1024 + 1]) = { 0 };
+    PA_DECLARE_ALIGNED(8, float, samples[1024 + 1]) = { 0 };
+    unsigned i, n;
+    float sum = 0;
+
+    pa_random(coeffs, sizeof(coeffs));
+    pa_random(samples, sizeof(samples));
+
+    for (i = 0; i < PA_ELEMENTSOF(coeffs); i++) {
+        coeffs[i] = (float) ((int32_t) ((uint32_t *) coeffs)[i] >> 8) / (1 << 23) / 8.0f;
+        samples[i] = (float) ((int32_t) ((uint32_t *) samples)[i] >> 8) / (1 << 23);
+    }
+
+    if (correct) {
+        for (n = 8; n <= 1024; n += 8) {
+            float a, b;
+
+            /* Unaligned on purpose, rows of the table are at any offset */
+            a = orig_func(coeffs + 1, samples + 1, n);
+            b = func(coeffs + 1, samples + 1, n);
+
+            if (fabsf(a - b) > 1e-5f * n) {
+                pa_log_debug("Correctness test failed: n=%u: %.9f != %.9f", n, a, b);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing polyphase dot product performance with %d taps", TAPS);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            sum += func(coeffs, samples, TAPS);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            sum += orig_func(coeffs, samples, TAPS);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        /* Keep the compiler from dropping the loops */
+        fail_unless(!isnan(sum));
+    }
+}
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (polyphase_sse_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_polyphase_dot_func_t orig_func, sse_func;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE)) {
+        pa_log_info("SSE not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_polyphase_dot_func();
+    pa_polyphase_func_init_sse(flags);
+    sse_func = pa_get_polyphase_dot_func();
+    pa_set_polyphase_dot_func(orig_func);
+
+    pa_log_debug("Checking SSE polyphase dot product");
+    run_dot_test(sse_func, orig_func, true, true);
+}
+END_TEST
+
+START_TEST (polyphase_avx_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_polyphase_dot_func_t orig_func, avx_func;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX)) {
+        pa_log_info("AVX not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_polyphase_dot_func();
+    pa_polyphase_func_init_avx(flags);
+    avx_func = pa_get_polyphase_dot_func();
+    pa_set_polyphase_dot_func(orig_func);
+
+    pa_log_debug("Checking AVX polyphase dot product");
+    run_dot_test(avx_func, orig_func, true, true);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (polyphase_neon_test) {
+    pa_cpu_arm_flag_t flags = 0;
+    pa_polyphase_dot_func_t orig_func, neon_func;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_polyphase_dot_func();
+    pa_polyphase_func_init_neon(flags);
+    neon_func = pa_get_polyphase_dot_func();
+    pa_set_polyphase_dot_func(orig_func);
+
+    pa_log_debug("Checking NEON polyphase dot product");
+    run_dot_test(neon_func, orig_func, true, true);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
+/* Resamples a 1 kHz sine in blocks of 10 ms and returns the SNR of the
+ * result against the ideal sine at the output rate, in dB. If rate_step
+ * is non-zero, the input rate sweeps up and down by that many Hz every
+ * block, and only the largest difference between two output samples is
+ * of interest. */
+
+#define FREQ 1000.0
+#define SECONDS 2
+#define CHANNELS 2
+
+static double resample_sine(pa_resample_method_t method, uint32_t from, uint32_t to, int rate_step, double *max_step) {
+    pa_mempool *pool;
+    pa_resampler *r;
+    pa_sample_spec a, b;
+    pa_memchunk in, out;
+    double phase = 0.0, out_phase = 0.0, signal = 0.0, noise = 0.0, expected = 0.0;
+    unsigned block, frames, out_frames = 0, i;
+    uint32_t rate = from;
+    float last = 0.0f;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = CHANNELS;
+    a.rate = from;
+    b.rate = to;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, rate_step ? PA_RESAMPLER_VARIABLE_RATE : 0));
+    ck_assert_int_eq(pa_resampler_get_method(r), method);
+
+    *max_step = 0.0;
+
+    for (block = 0; block < SECONDS * 100; block++) {
+        float *d;
+
+        frames = rate / 100;
+        expected += (double) frames * to / rate;
+
+        in.memblock = pa_memblock_new(pool, frames * CHANNELS * sizeof(float));
+        in.index = 0;
+        in.length = frames * CHANNELS * sizeof(float);
+
+        d = pa_memblock_acquire(in.memblock);
+        for (i = 0; i < frames; i++) {
+            d[i * CHANNELS] = d[i * CHANNELS + 1] = (float) (0.5 * sin(phase));
+            phase += 2.0 * M_PI * FREQ / rate;
+        }
+        pa_memblock_release(in.memblock);
+
+        pa_resampler_run(r, &in, &out);
+        pa_memblock_unref(in.memblock);
+
+        if (rate_step) {
+            /* Triangle sweep around the nominal rate */
+            rate = (block / 20) % 2 ? rate - rate_step : rate + rate_step;
+            pa_resampler_set_input_rate(r, rate);
+        }
+
+        if (!out.memblock)
+            continue;
+
+        d = pa_memblock_acquire_chunk(&out);
+        for (i = 0; i < out.length / (CHANNELS * sizeof(float)); i++, out_frames++) {
+            double ideal = 0.5 * sin(out_phase), e = d[i * CHANNELS] - ideal;
+
+            /* Both channels go through the same filter */
+            fail_unless(memcmp(&d[i * CHANNELS], &d[i * CHANNELS + 1], sizeof(float)) == 0);
+
+            /* Skip the start, where the filter is still filling */
+            if (out_frames > to / 100) {
+                signal += ideal * ideal;
+                noise += e * e;
+                *max_step = PA_MAX(*max_step, fabs(d[i * CHANNELS] - last));
+            }
+
+            last = d[i * CHANNELS];
+            out_phase += 2.0 * M_PI * FREQ / to;
+        }
+        pa_memblock_release(out.memblock);
+        pa_memblock_unref(out.memblock);
+    }
+
+    /* Nothing is lost or made up, apart from what's still in the filter */
+    fail_unless(fabs(expected - out_frames) < 200);
+
+    pa_resampler_free(r);
+    pa_mempool_unref(pool);
+
+    return 10.0 * log10(signal / noise);
+}
+
+START_TEST (polyphase_quality_test) {
+    static const struct {
+        pa_resample_method_t method;
+        double min_snr;
+    } tests[] = {
+        { PA_RESAMPLER_POLYPHASE_LQ, 50.0 },
+        { PA_RESAMPLER_POLYPHASE_MQ, 70.0 },
+        { PA_RESAMPLER_POLYPHASE_HQ, 90.0 },
+    };
+    static const uint32_t rates[][2] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 48000, 96000 },
+        { 96000, 44100 },
+        { 44100, 22050 },
+        { 48000, 44000 },
+    };
+    unsigned i, j;
+
+    for (i = 0; i < PA_ELEMENTSOF(tests); i++) {
+        for (j = 0; j < PA_ELEMENTSOF(rates); j++) {
+            double max_step, snr = resample_sine(tests[i].method, rates[j][0], rates[j][1], 0, &max_step);
+
+            pa_log_debug("%s %u -> %u: SNR %0.1f dB", pa_resample_method_to_string(tests[i].method),
+                         rates[j][0], rates[j][1], snr);
+            fail_unless(snr >= tests[i].min_snr);
+        }
+    }
+}
+END_TEST
+
+/* Rate updates must not cause glitches. The input is generated at the
+ * rate the resampler is told about, so the output stays a 1 kHz sine and
+ * two samples can't be further apart than its steepest slope allows. */
+START_TEST (polyphase_variable_rate_test) {
+    double slope = 0.5 * 2.0 * M_PI * FREQ / 48000;
+    unsigned i;
+
+    for (i = PA_RESAMPLER_POLYPHASE_LQ; i <= PA_RESAMPLER_POLYPHASE_HQ; i++) {
+        double max_step;
+
+        resample_sine(i, 44100, 48000, 20, &max_step);
+
+        pa_log_debug("%s variable rate: largest step %0.5f, slope %0.5f", pa_resample_method_to_string(i), max_step, slope);
+        fail_unless(max_step < slope * 1.05);
+    }
+}
+END_TEST
+
+/* Resamplers with the same parameters share their filter table */
+START_TEST (polyphase_cache_test) {
+    pa_mempool *pool;
+    pa_sample_spec a, b;
+    pa_resampler *r[4];
+    pa_resampler_cache_stat before, stat;
+    unsigned i;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = CHANNELS;
+    a.rate = 44100;
+    b.rate = 48000;
+
+    pa_resampler_cache_flush();
+    pa_resampler_cache_get_stat(&before);
+
+    for (i = 0; i < 3; i++)
+        pa_assert_se(r[i] = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, PA_RESAMPLER_POLYPHASE_MQ, 0));
+
+    pa_resampler_cache_get_stat(&stat);
+    ck_assert_int_eq(stat.n_entries, before.n_entries + 1);
+    ck_assert_int_eq(stat.n_misses, before.n_misses + 1);
+    ck_assert_int_eq(stat.n_hits, before.n_hits + 2);
+    fail_unless(stat.size > before.size);
+
+    /* A different ratio needs its own table */
+    b.rate = 96000;
+    pa_assert_se(r[3] = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, PA_RESAMPLER_POLYPHASE_MQ, 0));
+
+    pa_resampler_cache_get_stat(&stat);
+    ck_assert_int_eq(stat.n_entries, before.n_entries + 2);
+    ck_assert_int_eq(stat.n_misses, before.n_misses + 2);
+
+    for (i = 0; i < 4; i++)
+        pa_resampler_free(r[i]);
+
+    /* Unused tables stay around for the next stream with the same rates */
+    pa_resampler_cache_get_stat(&stat);
+    ck_assert_int_eq(stat.n_entries, before.n_entries + 2);
+    ck_assert_int_eq(stat.n_unused, 2);
+    ck_assert_int_eq(stat.unused_size, stat.size - before.size);
+
+    pa_assert_se(r[0] = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, PA_RESAMPLER_POLYPHASE_MQ, 0));
+    pa_resampler_cache_get_stat(&stat);
+    ck_assert_int_eq(stat.n_misses, before.n_misses + 2);
+    ck_assert_int_eq(stat.n_unused, 1);
+    pa_resampler_free(r[0]);
+
+    pa_resampler_cache_flush();
+    pa_resampler_cache_get_stat(&stat);
+    ck_assert_int_eq(stat.n_entries, before.n_entries);
+    ck_assert_int_eq(stat.size, before.size);
+    ck_assert_int_eq(stat.n_unused, 0);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+START_TEST (polyphase_performance_test) {
+    pa_mempool *pool;
+    pa_sample_spec a, b;
+    pa_memchunk in, out;
+    pa_resample_method_t methods[] = {
+        PA_RESAMPLER_POLYPHASE_LQ,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+        PA_RESAMPLER_POLYPHASE_MQ,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 3,
+        PA_RESAMPLER_POLYPHASE_HQ,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 6,
+    };
+    unsigned i;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = CHANNELS;
+    a.rate = 44100;
+    b.rate = 48000;
+
+    in.memblock = pa_memblock_new(pool, 441 * CHANNELS * sizeof(float));
+    in.index = 0;
+    in.length = pa_memblock_get_length(in.memblock);
+    pa_silence_memchunk(&in, &a);
+
+    for (i = 0; i < PA_ELEMENTSOF(methods); i++) {
+        pa_resampler *r;
+
+        if (!pa_resample_method_supported(methods[i]))
+            continue;
+
+        pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, methods[i], 0));
+
+        pa_log_debug("Resampling 10 ms, %u -> %u with %s", a.rate, b.rate, pa_resample_method_to_string(methods[i]));
+
+        PA_RUNTIME_TEST_RUN_START(pa_resample_method_to_string(methods[i]), 100, 10) {
+            pa_resampler_run(r, &in, &out);
+            if (out.memblock)
+                pa_memblock_unref(out.memblock);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_resampler_free(r);
+    }
+
+    pa_memblock_unref(in.memblock);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("CPU");
+
+    tc = tcase_create("polyphase");
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, polyphase_sse_test);
+    tcase_add_test(tc, polyphase_avx_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, polyphase_neon_test);
+#endif
+    tcase_add_test(tc, polyphase_quality_test);
+    tcase_add_test(tc, polyphase_variable_rate_test);
+    tcase_add_test(tc, polyphase_cache_test);
+    tcase_add_test(tc, polyphase_performance_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
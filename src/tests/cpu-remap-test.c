@@ -21,6 +21,8 @@
 
 #include <check.h>
 
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu.h>
 #include <pulsecore/random.h>
@@ -33,6 +35,12 @@
 #define TIMES 1000
 #define TIMES2 100
 
+typedef enum remap_matrix_type {
+    REMAP_MIX,          /* all inputs mixed into every output */
+    REMAP_ARRANGE,      /* every output is one of the inputs */
+    REMAP_SURROUND,     /* what up/downmixing between layouts looks like */
+} remap_matrix_type_t;
+
 static void run_remap_test_float(
         pa_remap_t *remap_func,
         pa_remap_t *remap_orig,
@@ -146,15 +154,36 @@ static void setup_remap_channels(
     pa_sample_format_t f,
     unsigned in_channels,
     unsigned out_channels,
-    bool rearrange) {
+    remap_matrix_type_t type) {
 
     unsigned i, o;
 
     m->format = f;
     m->i_ss.channels = in_channels;
     m->o_ss.channels = out_channels;
+    m->do_remap = NULL;
+    m->state = NULL;
+
+    if (type == REMAP_SURROUND) {
+        /* Matching channels are copied. When downmixing, the extra
+         * inputs are mixed into the outputs at -3 dB, when upmixing, the
+         * extra outputs get a -6 dB copy of an input. */
+        for (o = 0; o < out_channels; o++) {
+            for (i = 0; i < in_channels; i++) {
+                float v = 0.0f;
 
-    if (rearrange) {
+                if (i == o)
+                    v = 1.0f;
+                else if (in_channels > out_channels && i >= out_channels && i % out_channels == o)
+                    v = 0.7071f;
+                else if (in_channels < out_channels && o >= in_channels && o % in_channels == i)
+                    v = 0.5f;
+
+                m->map_table_f[o][i] = v;
+                m->map_table_i[o][i] = (int32_t) (v * 0x10000);
+            }
+        }
+    } else if (type == REMAP_ARRANGE) {
         for (o = 0; o < out_channels; o++) {
             for (i = 0; i < in_channels; i++) {
                 m->map_table_f[o][i] = (o == i) ? 1.0f : 0.0f;
@@ -210,77 +239,167 @@ static void remap_init_test_channels(
         pa_sample_format_t f,
         unsigned in_channels,
         unsigned out_channels,
-        bool rearrange) {
+        remap_matrix_type_t type) {
 
     pa_remap_t remap_orig, remap_func;
 
-    setup_remap_channels(&remap_orig, f, in_channels, out_channels, rearrange);
+    setup_remap_channels(&remap_orig, f, in_channels, out_channels, type);
     orig_init_func(&remap_orig);
 
-    setup_remap_channels(&remap_func, f, in_channels, out_channels, rearrange);
+    setup_remap_channels(&remap_func, f, in_channels, out_channels, type);
     init_func(&remap_func);
 
     remap_test_channels(&remap_func, &remap_orig);
+
+    pa_xfree(remap_orig.state);
+    pa_xfree(remap_func.state);
 }
 
 static void remap_init2_test_channels(
         pa_sample_format_t f,
         unsigned in_channels,
         unsigned out_channels,
-        bool rearrange) {
+        remap_matrix_type_t type) {
 
     pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_remap_t remap_orig, remap_func;
 
     cpu_info.force_generic_code = true;
     pa_remap_func_init(&cpu_info);
-    setup_remap_channels(&remap_orig, f, in_channels, out_channels, rearrange);
+    setup_remap_channels(&remap_orig, f, in_channels, out_channels, type);
     pa_init_remap_func(&remap_orig);
 
     cpu_info.force_generic_code = false;
     pa_remap_func_init(&cpu_info);
-    setup_remap_channels(&remap_func, f, in_channels, out_channels, rearrange);
+    setup_remap_channels(&remap_func, f, in_channels, out_channels, type);
     pa_init_remap_func(&remap_func);
 
     remap_test_channels(&remap_func, &remap_orig);
+
+    pa_xfree(remap_orig.state);
+    pa_xfree(remap_func.state);
 }
 
 START_TEST (remap_special_test) {
     pa_log_debug("Checking special remap (float, mono->stereo)");
-    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 1, 2, false);
+    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 1, 2, REMAP_MIX);
     pa_log_debug("Checking special remap (float, mono->4-channel)");
-    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 1, 4, false);
+    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 1, 4, REMAP_MIX);
 
     pa_log_debug("Checking special remap (s16, mono->stereo)");
-    remap_init2_test_channels(PA_SAMPLE_S16NE, 1, 2, false);
+    remap_init2_test_channels(PA_SAMPLE_S16NE, 1, 2, REMAP_MIX);
     pa_log_debug("Checking special remap (s16, mono->4-channel)");
-    remap_init2_test_channels(PA_SAMPLE_S16NE, 1, 4, false);
+    remap_init2_test_channels(PA_SAMPLE_S16NE, 1, 4, REMAP_MIX);
 
     pa_log_debug("Checking special remap (float, stereo->mono)");
-    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 2, 1, false);
+    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 2, 1, REMAP_MIX);
     pa_log_debug("Checking special remap (float, 4-channel->mono)");
-    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 4, 1, false);
+    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 4, 1, REMAP_MIX);
 
     pa_log_debug("Checking special remap (s16, stereo->mono)");
-    remap_init2_test_channels(PA_SAMPLE_S16NE, 2, 1, false);
+    remap_init2_test_channels(PA_SAMPLE_S16NE, 2, 1, REMAP_MIX);
     pa_log_debug("Checking special remap (s16, 4-channel->mono)");
-    remap_init2_test_channels(PA_SAMPLE_S16NE, 4, 1, false);
+    remap_init2_test_channels(PA_SAMPLE_S16NE, 4, 1, REMAP_MIX);
 }
 END_TEST
 
 START_TEST (rearrange_special_test) {
     pa_log_debug("Checking special remap (s16, stereo rearrange)");
-    remap_init2_test_channels(PA_SAMPLE_S16NE, 2, 2, true);
+    remap_init2_test_channels(PA_SAMPLE_S16NE, 2, 2, REMAP_ARRANGE);
     pa_log_debug("Checking special remap (float, stereo rearrange)");
-    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 2, 2, true);
+    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 2, 2, REMAP_ARRANGE);
 
     pa_log_debug("Checking special remap (s16, 4-channel rearrange)");
-    remap_init2_test_channels(PA_SAMPLE_S16NE, 4, 4, true);
+    remap_init2_test_channels(PA_SAMPLE_S16NE, 4, 4, REMAP_ARRANGE);
     pa_log_debug("Checking special remap (float, 4-channel rearrange)");
-    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 4, 4, true);
+    remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, 4, 4, REMAP_ARRANGE);
 }
 END_TEST
 
+/* Up- and downmixing between the common layouts, which is what runs
+ * through the generic matrix code */
+static const unsigned matrix_channels[][2] = {
+    { 6, 2 },
+    { 8, 2 },
+    { 2, 6 },
+    { 8, 6 },
+};
+
+START_TEST (matrix_special_test) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(matrix_channels); i++) {
+        unsigned in = matrix_channels[i][0], out = matrix_channels[i][1];
+
+        pa_log_debug("Checking special remap (float, %u->%u surround)", in, out);
+        remap_init2_test_channels(PA_SAMPLE_FLOAT32NE, in, out, REMAP_SURROUND);
+        pa_log_debug("Checking special remap (s16, %u->%u surround)", in, out);
+        remap_init2_test_channels(PA_SAMPLE_S16NE, in, out, REMAP_SURROUND);
+    }
+}
+END_TEST
+
+/* Sparse matrices, like these upmixes, have to be left to the C version,
+ * which only looks at the non-zero factors */
+static const unsigned sparse_channels[][2] = {
+    { 2, 6 },
+    { 8, 6 },
+};
+
+static void remap_init_sparse_test_channels(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels) {
+
+    pa_remap_t remap_orig, remap_func;
+
+    setup_remap_channels(&remap_orig, f, in_channels, out_channels, REMAP_SURROUND);
+    orig_init_func(&remap_orig);
+
+    setup_remap_channels(&remap_func, f, in_channels, out_channels, REMAP_SURROUND);
+    init_func(&remap_func);
+    if (!remap_func.do_remap)
+        orig_init_func(&remap_func);
+
+    fail_unless(remap_func.do_remap == remap_orig.do_remap);
+
+    pa_xfree(remap_orig.state);
+    pa_xfree(remap_func.state);
+}
+
+static void matrix_test_channels(
+        const char *name,
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func) {
+
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(matrix_channels); i++) {
+        unsigned in = matrix_channels[i][0], out = matrix_channels[i][1];
+
+        pa_log_debug("Checking %s remap (float, %u->%u)", name, in, out);
+        remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, in, out, REMAP_MIX);
+        pa_log_debug("Checking %s remap (s16, %u->%u)", name, in, out);
+        remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, in, out, REMAP_MIX);
+
+        pa_log_debug("Checking %s remap (float, %u->%u surround)", name, in, out);
+        remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, in, out, REMAP_SURROUND);
+        pa_log_debug("Checking %s remap (s16, %u->%u surround)", name, in, out);
+        remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, in, out, REMAP_SURROUND);
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(sparse_channels); i++) {
+        unsigned in = sparse_channels[i][0], out = sparse_channels[i][1];
+
+        pa_log_debug("Checking %s remap is not used (float, %u->%u sparse)", name, in, out);
+        remap_init_sparse_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, in, out);
+        pa_log_debug("Checking %s remap is not used (s16, %u->%u sparse)", name, in, out);
+        remap_init_sparse_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, in, out);
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (remap_mmx_test) {
     pa_cpu_x86_flag_t flags = 0;
@@ -296,10 +415,10 @@ START_TEST (remap_mmx_test) {
     orig_init_func = pa_get_init_remap_func();
     pa_remap_func_init_mmx(flags);
     init_func = pa_get_init_remap_func();
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, REMAP_MIX);
 
     pa_log_debug("Checking MMX remap (s16, mono->stereo)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, REMAP_MIX);
 }
 END_TEST
 
@@ -317,10 +436,46 @@ START_TEST (remap_sse2_test) {
     orig_init_func = pa_get_init_remap_func();
     pa_remap_func_init_sse(flags);
     init_func = pa_get_init_remap_func();
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, REMAP_MIX);
 
     pa_log_debug("Checking SSE2 remap (s16, mono->stereo)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, REMAP_MIX);
+}
+END_TEST
+
+START_TEST (matrix_sse2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_sse(flags);
+    init_func = pa_get_init_remap_func();
+
+    matrix_test_channels("SSE2", init_func, orig_init_func);
+}
+END_TEST
+
+START_TEST (matrix_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_avx2(flags);
+    init_func = pa_get_init_remap_func();
+
+    matrix_test_channels("AVX2", init_func, orig_init_func);
 }
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -341,29 +496,29 @@ START_TEST (remap_neon_test) {
     init_func = pa_get_init_remap_func();
 
     pa_log_debug("Checking NEON remap (float, mono->stereo)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 2, REMAP_MIX);
     pa_log_debug("Checking NEON remap (float, mono->4-channel)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 4, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 1, 4, REMAP_MIX);
 
     pa_log_debug("Checking NEON remap (s16, mono->stereo)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, REMAP_MIX);
     pa_log_debug("Checking NEON remap (s16, mono->4-channel)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 4, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 4, REMAP_MIX);
 
     pa_log_debug("Checking NEON remap (float, stereo->mono)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 1, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 1, REMAP_MIX);
     pa_log_debug("Checking NEON remap (float, 4-channel->mono)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 4, 1, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 4, 1, REMAP_MIX);
 
     pa_log_debug("Checking NEON remap (s16, stereo->mono)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 1, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 1, REMAP_MIX);
     pa_log_debug("Checking NEON remap (s16, 4-channel->mono)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 1, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 1, REMAP_MIX);
 
     pa_log_debug("Checking NEON remap (float, 4-channel->4-channel)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 4, 4, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 4, 4, REMAP_MIX);
     pa_log_debug("Checking NEON remap (s16, 4-channel->4-channel)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 4, false);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 4, REMAP_MIX);
 }
 END_TEST
 
@@ -382,14 +537,14 @@ START_TEST (rearrange_neon_test) {
     init_func = pa_get_init_remap_func();
 
     pa_log_debug("Checking NEON remap (float, stereo rearrange)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 2, true);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 2, REMAP_ARRANGE);
     pa_log_debug("Checking NEON remap (s16, stereo rearrange)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 2, true);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 2, REMAP_ARRANGE);
 
     pa_log_debug("Checking NEON remap (float, 4-channel rearrange)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 4, 4, true);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 4, 4, REMAP_ARRANGE);
     pa_log_debug("Checking NEON remap (s16, 4-channel rearrange)");
-    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 4, true);
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 4, 4, REMAP_ARRANGE);
 }
 END_TEST
 #endif
@@ -425,6 +580,15 @@ int main(int argc, char *argv[]) {
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("matrix");
+    tcase_add_test(tc, matrix_special_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, matrix_sse2_test);
+    tcase_add_test(tc, matrix_avx2_test);
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
     failed = srunner_ntests_failed(sr);
@@ -19,9 +19,13 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <check.h>
 
 #include <pulsecore/cpu-arm.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
@@ -134,7 +138,228 @@ static void run_conv_test_s16_to_float(
 }
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+/* The 24 and 32 bit formats are tested through their left-aligned 32 bit
+ * value, so that a tolerance can be given in LSBs of the format */
+static int32_t read_s32(pa_sample_format_t f, const uint8_t *p) {
+    uint32_t u;
+
+    switch (f) {
+        case PA_SAMPLE_S24LE:
+            return (int32_t) (PA_READ24LE(p) << 8);
+        case PA_SAMPLE_S24BE:
+            return (int32_t) (PA_READ24BE(p) << 8);
+        default:
+            break;
+    }
+
+    memcpy(&u, p, sizeof(u));
+
+    switch (f) {
+        case PA_SAMPLE_S32LE:
+            return (int32_t) PA_UINT32_FROM_LE(u);
+        case PA_SAMPLE_S32BE:
+            return (int32_t) PA_UINT32_FROM_BE(u);
+        case PA_SAMPLE_S24_32LE:
+            return (int32_t) (PA_UINT32_FROM_LE(u) << 8);
+        case PA_SAMPLE_S24_32BE:
+            return (int32_t) (PA_UINT32_FROM_BE(u) << 8);
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void run_conv_test_float_to_s32(
+        pa_sample_format_t format,
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        unsigned max_lsb,
+        int align,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, s[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_ref[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, float, f[SAMPLES]);
+    size_t bps = pa_sample_size_of_format(format);
+    int64_t lsb = format == PA_SAMPLE_S32LE || format == PA_SAMPLE_S32BE ? 1 : 1 << 8;
+    uint8_t *samples, *samples_ref;
+    float *floats;
+    int i, nsamples;
+
+    /* Force sample alignment as requested */
+    samples = s + (8 - align) * bps;
+    samples_ref = s_ref + (8 - align) * bps;
+    floats = f + (8 - align);
+    nsamples = SAMPLES - (8 - align);
+
+    for (i = 0; i < nsamples; i++) {
+        floats[i] = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+    }
+
+    /* Full scale on both ends */
+    floats[0] = 1.0f;
+    floats[1] = -1.0f;
+
+    if (correct) {
+        orig_func(nsamples, floats, samples_ref);
+        func(nsamples, floats, samples);
+
+        for (i = 0; i < nsamples; i++) {
+            int32_t v = read_s32(format, samples + i * bps), v_ref = read_s32(format, samples_ref + i * bps);
+
+            if (llabs((int64_t) v - v_ref) > max_lsb * lsb) {
+                pa_log_debug("Correctness test failed: align=%d", align);
+                pa_log_debug("%d: %08x != %08x (%.24f)\n", i, v, v_ref, floats[i]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing sconv performance with %d sample alignment", align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, floats, samples);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, floats, samples_ref);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+static void run_conv_test_s32_to_float(
+        pa_sample_format_t format,
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        int align,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, float, f[SAMPLES]) = { 0.0f };
+    PA_DECLARE_ALIGNED(8, float, f_ref[SAMPLES]) = { 0.0f };
+    PA_DECLARE_ALIGNED(8, uint8_t, s[SAMPLES * 4]);
+    size_t bps = pa_sample_size_of_format(format);
+    float *floats, *floats_ref;
+    uint8_t *samples;
+    int i, nsamples;
+
+    /* Force sample alignment as requested */
+    floats = f + (8 - align);
+    floats_ref = f_ref + (8 - align);
+    samples = s + (8 - align) * bps;
+    nsamples = SAMPLES - (8 - align);
+
+    pa_random(samples, nsamples * bps);
+
+    if (correct) {
+        orig_func(nsamples, samples, floats_ref);
+        func(nsamples, samples, floats);
+
+        /* Converting to float is exact */
+        for (i = 0; i < nsamples; i++) {
+            if (memcmp(floats + i, floats_ref + i, sizeof(float)) != 0) {
+                pa_log_debug("Correctness test failed: align=%d", align);
+                pa_log_debug("%d: %.24f != %.24f (%08x)\n", i, floats[i], floats_ref[i], read_s32(format, samples + i * bps));
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing sconv performance with %d sample alignment", align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(nsamples, samples, floats);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(nsamples, samples, floats_ref);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+static const pa_sample_format_t s32_formats[] = {
+    PA_SAMPLE_S32LE,
+    PA_SAMPLE_S32BE,
+    PA_SAMPLE_S24_32LE,
+    PA_SAMPLE_S24_32BE,
+    PA_SAMPLE_S24LE,
+    PA_SAMPLE_S24BE,
+};
+
+/* Checks all 24 and 32 bit conversions from and to float that init_func
+ * replaces. max_lsb is how far off the conversion from float may be. */
+static void s32_conv_test(const char *name, void (*init_func)(void), unsigned max_lsb) {
+    pa_convert_func_t orig_to[PA_ELEMENTSOF(s32_formats)], orig_from[PA_ELEMENTSOF(s32_formats)];
+    unsigned i;
+    int align;
+
+    for (i = 0; i < PA_ELEMENTSOF(s32_formats); i++) {
+        orig_to[i] = pa_get_convert_to_float32ne_function(s32_formats[i]);
+        orig_from[i] = pa_get_convert_from_float32ne_function(s32_formats[i]);
+    }
+
+    init_func();
+
+    for (i = 0; i < PA_ELEMENTSOF(s32_formats); i++) {
+        pa_convert_func_t to = pa_get_convert_to_float32ne_function(s32_formats[i]);
+        pa_convert_func_t from = pa_get_convert_from_float32ne_function(s32_formats[i]);
+        const char *f = pa_sample_format_to_string(s32_formats[i]);
+
+        if (from != orig_from[i]) {
+            pa_log_debug("Checking %s sconv (float -> %s)", name, f);
+            for (align = 0; align < 8; align++)
+                run_conv_test_float_to_s32(s32_formats[i], from, orig_from[i], max_lsb, align, true, align == 7);
+        }
+
+        if (to != orig_to[i]) {
+            pa_log_debug("Checking %s sconv (%s -> float)", name, f);
+            for (align = 0; align < 8; align++)
+                run_conv_test_s32_to_float(s32_formats[i], to, orig_to[i], align, true, align == 7);
+        }
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
+static void init_sse2(void) {
+    pa_convert_func_init_sse(PA_CPU_X86_SSE2);
+}
+
+static void init_ssse3(void) {
+    pa_convert_func_init_sse(PA_CPU_X86_SSE2 | PA_CPU_X86_SSSE3);
+}
+
+START_TEST (sconv_s32_sse2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    s32_conv_test("SSE2", init_sse2, 0);
+}
+END_TEST
+
+START_TEST (sconv_s24_ssse3_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSSE3)) {
+        pa_log_info("SSSE3 not supported. Skipping");
+        return;
+    }
+
+    /* Only the packed 24 bit formats are new here */
+    pa_convert_func_init_sse(PA_CPU_X86_SSE2);
+    s32_conv_test("SSSE3", init_ssse3, 0);
+}
+END_TEST
+
 START_TEST (sconv_sse2_test) {
     pa_cpu_x86_flag_t flags = 0;
     pa_convert_func_t orig_func, sse2_func;
@@ -230,6 +455,28 @@ START_TEST (sconv_neon_test) {
     run_conv_test_s16_to_float(neon_to_func, orig_to_func, 7, true, true);
 }
 END_TEST
+
+static void init_neon(void) {
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+    pa_convert_func_init_neon(flags);
+}
+
+START_TEST (sconv_s32_neon_test) {
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    /* NEON truncates when converting from float */
+    s32_conv_test("NEON", init_neon, 1);
+}
+END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
 int main(int argc, char *argv[]) {
@@ -247,9 +494,12 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, sconv_sse2_test);
     tcase_add_test(tc, sconv_sse_test);
+    tcase_add_test(tc, sconv_s32_sse2_test);
+    tcase_add_test(tc, sconv_s24_ssse3_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, sconv_neon_test);
+    tcase_add_test(tc, sconv_s32_neon_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
@@ -24,6 +24,7 @@
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
 #include <pulsecore/cpu-orc.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/sample-util.h>
@@ -100,6 +101,92 @@ static void run_volume_test(
     }
 }
 
+/* Like run_volume_test(), for any format. Integer volumes go up to 4.0 so
+ * that clipping is covered as well. */
+static void run_volume_format_test(
+        pa_sample_format_t format,
+        pa_do_volume_func_t func,
+        pa_do_volume_func_t orig_func,
+        int align,
+        int channels,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, s[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_ref[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_orig[SAMPLES * 4]) = { 0 };
+    int32_t volumes[channels + PADDING];
+    float volumes_f[channels + PADDING];
+    size_t bps = pa_sample_size_of_format(format);
+    bool is_float = format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_FLOAT32RE;
+    uint8_t *samples, *samples_ref, *samples_orig;
+    int i, padding, nsamples, size;
+
+    /* Force sample alignment as requested */
+    samples = s + (8 - align) * bps;
+    samples_ref = s_ref + (8 - align) * bps;
+    samples_orig = s_orig + (8 - align) * bps;
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    size = nsamples * bps;
+
+    if (is_float) {
+        for (i = 0; i < nsamples; i++) {
+            float v = 2.0f * (rand()/(float) RAND_MAX - 0.5f);
+
+            if (format == PA_SAMPLE_FLOAT32RE)
+                PA_WRITE_FLOAT32RE((float *) samples + i, v);
+            else
+                ((float *) samples)[i] = v;
+        }
+    } else
+        pa_random(samples, size);
+
+    memcpy(samples_ref, samples, size);
+    memcpy(samples_orig, samples, size);
+
+    for (i = 0; i < channels; i++) {
+        volumes[i] = (int32_t) (rand() % 0x40000);
+        volumes_f[i] = volumes[i] / (float) 0x10000;
+    }
+    for (padding = 0; padding < PADDING; padding++, i++) {
+        volumes[i] = volumes[padding];
+        volumes_f[i] = volumes_f[padding];
+    }
+
+    if (correct) {
+        orig_func(samples_ref, is_float ? (void *) volumes_f : (void *) volumes, channels, size);
+        func(samples, is_float ? (void *) volumes_f : (void *) volumes, channels, size);
+
+        for (i = 0; i < size; i += bps) {
+            if (memcmp(samples + i, samples_ref + i, bps) != 0) {
+                pa_log_debug("Correctness test failed: %s, align=%d, channels=%d", pa_sample_format_to_string(format),
+                             align, channels);
+                pa_log_debug("%d: sample %d, volume %08x", i, i / (int) bps, volumes[(i / bps) % channels]);
+                ck_abort();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s svolume %dch performance with %d sample alignment", pa_sample_format_to_string(format),
+                     channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            func(samples, is_float ? (void *) volumes_f : (void *) volumes, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            orig_func(samples_ref, is_float ? (void *) volumes_f : (void *) volumes, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(memcmp(samples_ref, samples, size) == 0);
+    }
+}
+
 #if defined (__i386__) || defined (__amd64__)
 START_TEST (svolume_mmx_test) {
     pa_do_volume_func_t orig_func, mmx_func;
@@ -154,6 +241,49 @@ START_TEST (svolume_sse_test) {
     run_volume_test(sse_func, orig_func, 7, 3, true, true);
 }
 END_TEST
+
+START_TEST (svolume_avx2_test) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_S16NE,
+        PA_SAMPLE_S16RE,
+        PA_SAMPLE_FLOAT32NE,
+        PA_SAMPLE_FLOAT32RE,
+        PA_SAMPLE_S32NE,
+        PA_SAMPLE_S32RE,
+        PA_SAMPLE_S24NE,
+        PA_SAMPLE_S24RE,
+        PA_SAMPLE_S24_32NE,
+        PA_SAMPLE_S24_32RE,
+    };
+    static const int channels[] = { 1, 2, 3, 6, 8 };
+    pa_do_volume_func_t orig_funcs[PA_ELEMENTSOF(formats)];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned i, j, k;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++)
+        orig_funcs[i] = pa_get_volume_func(formats[i]);
+    pa_volume_func_init_avx2(flags);
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        pa_do_volume_func_t avx2_func = pa_get_volume_func(formats[i]);
+
+        pa_log_debug("Checking AVX2 svolume (%s)", pa_sample_format_to_string(formats[i]));
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            for (k = 0; k < 7; k++)
+                run_volume_format_test(formats[i], avx2_func, orig_funcs[i], k, channels[j], true, false);
+        }
+        run_volume_format_test(formats[i], avx2_func, orig_funcs[i], 7, 2, true, true);
+        run_volume_format_test(formats[i], avx2_func, orig_funcs[i], 7, 8, true, true);
+    }
+}
+END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 #if defined (__arm__) && defined (__linux__)
@@ -230,6 +360,7 @@ int main(int argc, char *argv[]) {
 #if defined (__i386__) || defined (__amd64__)
     tcase_add_test(tc, svolume_mmx_test);
     tcase_add_test(tc, svolume_sse_test);
+    tcase_add_test(tc, svolume_avx2_test);
 #endif
 #if defined (__arm__) && defined (__linux__)
     tcase_add_test(tc, svolume_arm_test);
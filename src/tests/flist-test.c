@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/util.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/flist.h>
@@ -32,9 +33,76 @@
 
 #define THREADS_MAX 20
 
+/* For measuring the throughput, every thread takes a batch of entries
+ * and gives them back, over and over again */
+#define BENCH_THREADS 4
+#define BENCH_ITERATIONS 200000
+#define BENCH_BATCH 16
+
 static pa_flist *flist;
 static int quit = 0;
 
+PA_STATIC_FLIST_DECLARE(cached, 0, pa_xfree);
+
+static void bench_thread_func(void *data) {
+    bool use_cache = PA_PTR_TO_UINT(data);
+    void *items[BENCH_BATCH];
+    int i, j;
+
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        for (j = 0; j < BENCH_BATCH; j++)
+            if (!(items[j] = use_cache ? PA_STATIC_FLIST_POP(cached) : pa_flist_pop(flist)))
+                items[j] = pa_xmalloc(64);
+
+        for (j = 0; j < BENCH_BATCH; j++)
+            if ((use_cache ? PA_STATIC_FLIST_PUSH(cached, items[j]) : pa_flist_push(flist, items[j])) < 0)
+                pa_xfree(items[j]);
+    }
+}
+
+static void cache_thread_func(void *data) {
+    pa_assert_se(PA_STATIC_FLIST_PUSH(cached, data) == 0);
+
+    /* Our own threads keep the entry until they exit */
+    pa_assert_se(!pa_flist_pop(PA_STATIC_FLIST_GET(cached)));
+}
+
+static void cache_test(void) {
+    pa_thread *t;
+    void *p = pa_xmalloc(64);
+
+    /* Threads we didn't start don't get a cache */
+    pa_assert_se(PA_STATIC_FLIST_PUSH(cached, p) == 0);
+    pa_assert_se(pa_flist_pop(PA_STATIC_FLIST_GET(cached)) == p);
+
+    pa_assert_se(t = pa_thread_new("cache", cache_thread_func, p));
+    pa_thread_free(t);
+    pa_assert_se(pa_flist_pop(PA_STATIC_FLIST_GET(cached)) == p);
+
+    pa_xfree(p);
+}
+
+static void bench(bool use_cache) {
+    pa_thread *threads[BENCH_THREADS];
+    pa_usec_t start, stop;
+    int i;
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < BENCH_THREADS; i++)
+        pa_assert_se(threads[i] = pa_thread_new("bench", bench_thread_func, PA_UINT_TO_PTR(use_cache)));
+
+    for (i = 0; i < BENCH_THREADS; i++)
+        pa_thread_free(threads[i]);
+
+    stop = pa_rtclock_now();
+
+    pa_log("%s: %u threads did %u pops and pushes each in %llu usec (%.1f ns per entry overall).",
+           use_cache ? "Per-thread cache" : "Shared free list",
+           BENCH_THREADS, BENCH_ITERATIONS * BENCH_BATCH, (unsigned long long) (stop - start),
+           (double) (stop - start) * 1000 / ((double) BENCH_THREADS * BENCH_ITERATIONS * BENCH_BATCH));
+}
+
 static void spin(void) {
     int k;
 
@@ -84,6 +152,11 @@ int main(int argc, char* argv[]) {
 
     flist = pa_flist_new(0);
 
+    cache_test();
+
+    bench(false);
+    bench(true);
+
     for (i = 0; i < THREADS_MAX; i++) {
         threads[i] = pa_thread_new("test", thread_func, pa_sprintf_malloc("Thread #%i", i+1));
         pa_assert(threads[i]);
@@ -0,0 +1,102 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/pulseaudio.h>
+#include <pulse/sample.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/memblock.h>
+
+#include <pulsecore/filter/lfe-filter.h>
+
+#include "runtime-test-util.h"
+
+/* Streams silence through the LFE filter in small blocks, which is the
+   common case, so the cost of keeping the state for rewinds is included,
+   and logs how long that takes. */
+
+#define PERF_SECONDS 1
+#define PERF_TIMES 10
+#define BLOCK_SAMPLES 256
+
+/* 7.1, with the LFE channel where the SIMD implementation has it in a
+   vector together with three other channels */
+static const pa_channel_map chmap71 = {8, {
+    PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT,
+    PA_CHANNEL_POSITION_FRONT_CENTER, PA_CHANNEL_POSITION_LFE,
+    PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT,
+    PA_CHANNEL_POSITION_SIDE_LEFT, PA_CHANNEL_POSITION_SIDE_RIGHT }};
+
+static void throughput_test(pa_sample_format_t format, const pa_channel_map *cm) {
+    pa_mempool *pool;
+    pa_lfe_filter_t *lf;
+    pa_sample_spec ss;
+    pa_memchunk mc;
+    uint8_t *data;
+    size_t length, block_size, n;
+    char t[PA_CHANNEL_MAP_SNPRINT_MAX], label[PA_CHANNEL_MAP_SNPRINT_MAX + 64];
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    ss.format = format;
+    ss.rate = 48000;
+    ss.channels = cm->channels;
+
+    length = pa_frame_size(&ss) * ss.rate * PERF_SECONDS;
+    block_size = pa_frame_size(&ss) * BLOCK_SAMPLES;
+    data = pa_xmalloc0(length);
+
+    pa_assert_se(lf = pa_lfe_filter_new(&ss, cm, 120, ss.rate * 3));
+
+    pa_snprintf(label, sizeof(label), "%s %s, %u seconds", pa_sample_format_to_string(format),
+                pa_channel_map_snprint(t, sizeof(t), cm), PERF_SECONDS);
+    PA_RUNTIME_TEST_RUN_START(label, 1, PERF_TIMES) {
+        size_t i;
+
+        for (i = 0; i < length; i += n) {
+            n = PA_MIN(length - i, block_size);
+
+            mc.memblock = pa_memblock_new_fixed(pool, data + i, n, false);
+            mc.index = 0;
+            mc.length = n;
+            pa_lfe_filter_process(lf, &mc);
+            pa_memblock_unref_fixed(mc.memblock);
+        }
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_lfe_filter_free(lf);
+    pa_xfree(data);
+    pa_mempool_unref(pool);
+}
+
+int main(int argc, char *argv[]) {
+    pa_channel_map cm;
+
+    pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pa_channel_map_init_auto(&cm, 6, PA_CHANNEL_MAP_ALSA));
+    throughput_test(PA_SAMPLE_FLOAT32NE, &cm);
+    throughput_test(PA_SAMPLE_S16NE, &cm);
+    throughput_test(PA_SAMPLE_FLOAT32NE, &chmap71);
+    throughput_test(PA_SAMPLE_S16NE, &chmap71);
+
+    return 0;
+}
@@ -19,10 +19,13 @@
 #include <config.h>
 #endif
 
+#include <math.h>
+
 #include <check.h>
 
 #include <pulse/pulseaudio.h>
 #include <pulse/sample.h>
+#include <pulsecore/core-util.h>
 #include <pulsecore/memblock.h>
 
 #include <pulsecore/filter/lfe-filter.h>
@@ -172,6 +175,185 @@ START_TEST (lfe_filter_test) {
 }
 END_TEST
 
+/* 7.1, with the LFE channel where the SIMD implementation has it in a
+   vector together with three other channels */
+static const pa_channel_map chmap71 = {8, {
+    PA_CHANNEL_POSITION_FRONT_LEFT, PA_CHANNEL_POSITION_FRONT_RIGHT,
+    PA_CHANNEL_POSITION_FRONT_CENTER, PA_CHANNEL_POSITION_LFE,
+    PA_CHANNEL_POSITION_REAR_LEFT, PA_CHANNEL_POSITION_REAR_RIGHT,
+    PA_CHANNEL_POSITION_SIDE_LEFT, PA_CHANNEL_POSITION_SIDE_RIGHT }};
+
+#define MULTI_SAMPLES 4096
+#define MULTI_BLOCK_SAMPLES 256
+
+static void run_filter(pa_lfe_filter_t *lf, pa_mempool *pool, void *data, size_t length, size_t block_size) {
+    pa_memchunk mc;
+    size_t n;
+
+    for (; length > 0; length -= n, data = (uint8_t *) data + n) {
+        n = PA_MIN(length, block_size);
+
+        mc.memblock = pa_memblock_new_fixed(pool, data, n, false);
+        mc.index = 0;
+        mc.length = n;
+        pa_lfe_filter_process(lf, &mc);
+        pa_memblock_unref_fixed(mc.memblock);
+    }
+}
+
+static float get_sample(pa_sample_format_t format, const void *data, unsigned i) {
+    return format == PA_SAMPLE_FLOAT32NE ? ((const float *) data)[i] : ((const short *) data)[i];
+}
+
+/* All channels filtered at once must give the same as each channel
+   filtered on its own */
+static void multichannel_test(pa_sample_format_t format, float tolerance) {
+    pa_mempool *pool;
+    pa_lfe_filter_t *lf;
+    pa_sample_spec ss, mono;
+    void *input, *multi, *single;
+    size_t length;
+    unsigned c, i;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    ss.format = mono.format = format;
+    ss.rate = mono.rate = 48000;
+    ss.channels = chmap71.channels;
+    mono.channels = 1;
+
+    length = pa_frame_size(&ss) * MULTI_SAMPLES;
+    input = pa_xmalloc(length);
+    single = pa_xmalloc(pa_frame_size(&mono) * MULTI_SAMPLES);
+
+    for (i = 0; i < ss.channels * MULTI_SAMPLES; i++) {
+        if (format == PA_SAMPLE_FLOAT32NE)
+            ((float *) input)[i] = (float) random() / RAND_MAX - 0.5f;
+        else
+            ((short *) input)[i] = random();
+    }
+
+    multi = pa_xmemdup(input, length);
+    pa_assert_se(lf = pa_lfe_filter_new(&ss, &chmap71, 120, ss.rate));
+    run_filter(lf, pool, multi, length, pa_frame_size(&ss) * MULTI_BLOCK_SAMPLES);
+    pa_lfe_filter_free(lf);
+
+    for (c = 0; c < ss.channels; c++) {
+        pa_channel_map cm;
+
+        pa_channel_map_init(&cm);
+        cm.channels = 1;
+        cm.map[0] = chmap71.map[c];
+
+        for (i = 0; i < MULTI_SAMPLES; i++) {
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ((float *) single)[i] = ((float *) input)[i * ss.channels + c];
+            else
+                ((short *) single)[i] = ((short *) input)[i * ss.channels + c];
+        }
+
+        pa_assert_se(lf = pa_lfe_filter_new(&mono, &cm, 120, mono.rate));
+        run_filter(lf, pool, single, pa_frame_size(&mono) * MULTI_SAMPLES, pa_frame_size(&mono) * MULTI_BLOCK_SAMPLES);
+        pa_lfe_filter_free(lf);
+
+        for (i = 0; i < MULTI_SAMPLES; i++) {
+            float a = get_sample(format, multi, i * ss.channels + c);
+            float b = get_sample(format, single, i);
+
+            if (fabsf(a - b) > tolerance) {
+                pa_log_error("Channel %u, sample %u: %g != %g", c, i, a, b);
+                ck_abort();
+            }
+        }
+    }
+
+    pa_xfree(multi);
+    pa_xfree(single);
+    pa_xfree(input);
+    pa_mempool_unref(pool);
+}
+
+START_TEST (lfe_filter_multichannel_test) {
+    multichannel_test(PA_SAMPLE_FLOAT32NE, 1e-6f);
+    multichannel_test(PA_SAMPLE_S16NE, TOLERANT_VARIATION);
+}
+END_TEST
+
+#define WRAP_RATE 48000
+#define WRAP_SECONDS 20
+#define WRAP_BLOCK_SAMPLES 1200
+
+/* Rewind a filter that has been running for longer than it keeps
+   snapshots and history for, back across several snapshots, so that the
+   fast forward has to read the input from where the history ring wraps.
+   The result must be the same, bit for bit, as if nothing had been
+   rewound. */
+static void rewind_wrap_test(pa_sample_format_t format, size_t rewind_samples) {
+    pa_mempool *pool;
+    pa_lfe_filter_t *lf;
+    pa_sample_spec ss;
+    pa_channel_map cm;
+    uint8_t *input, *expected, *output;
+    size_t fs, length, pos;
+    unsigned i;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+    pa_assert_se(pa_channel_map_init_auto(&cm, 6, PA_CHANNEL_MAP_ALSA));
+
+    ss.format = format;
+    ss.rate = WRAP_RATE;
+    ss.channels = cm.channels;
+
+    fs = pa_frame_size(&ss);
+    length = fs * ss.rate * WRAP_SECONDS;
+    input = pa_xmalloc(length);
+
+    for (i = 0; i < ss.channels * ss.rate * WRAP_SECONDS; i++) {
+        if (format == PA_SAMPLE_FLOAT32NE)
+            ((float *) input)[i] = (float) random() / RAND_MAX - 0.5f;
+        else
+            ((short *) input)[i] = random();
+    }
+
+    expected = pa_xmemdup(input, length);
+    pa_assert_se(lf = pa_lfe_filter_new(&ss, &cm, 120, ss.rate * 10));
+    run_filter(lf, pool, expected, length, fs * WRAP_BLOCK_SAMPLES);
+    pa_lfe_filter_free(lf);
+
+    /* With maxrewind at ten seconds snapshots are taken at the first block
+       16000 frames after the previous one, i.e. every 16800 frames. The
+       history ring ends up with 614400 frames, and by now both the
+       snapshots and the history have wrapped */
+    output = pa_xmemdup(input, length);
+    pa_assert_se(lf = pa_lfe_filter_new(&ss, &cm, 120, ss.rate * 10));
+    run_filter(lf, pool, output, length, fs * WRAP_BLOCK_SAMPLES);
+
+    pos = length - rewind_samples * fs;
+    memcpy(output + pos, input + pos, length - pos);
+    pa_lfe_filter_rewind(lf, rewind_samples * fs);
+    run_filter(lf, pool, output + pos, length - pos, fs * WRAP_BLOCK_SAMPLES);
+    pa_lfe_filter_free(lf);
+
+    fail_unless(memcmp(output, expected, length) == 0);
+
+    pa_xfree(output);
+    pa_xfree(expected);
+    pa_xfree(input);
+    pa_mempool_unref(pool);
+}
+
+START_TEST (lfe_filter_rewind_wrap_test) {
+    /* Back across twenty snapshots, to 620000, where the fast forward from
+       the snapshot at 604800 crosses the end of the history ring */
+    rewind_wrap_test(PA_SAMPLE_FLOAT32NE, WRAP_RATE * WRAP_SECONDS - 620000);
+    rewind_wrap_test(PA_SAMPLE_S16NE, WRAP_RATE * WRAP_SECONDS - 620000);
+
+    /* All the way */
+    rewind_wrap_test(PA_SAMPLE_FLOAT32NE, WRAP_RATE * 10);
+    rewind_wrap_test(PA_SAMPLE_S16NE, WRAP_RATE * 10);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -184,7 +366,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("lfe-filter");
     tc = tcase_create("lfe-filter");
     tcase_add_test(tc, lfe_filter_test);
-    tcase_set_timeout(tc, 10);
+    tcase_add_test(tc, lfe_filter_multichannel_test);
+    tcase_add_test(tc, lfe_filter_rewind_wrap_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -20,12 +20,16 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 #include <check.h>
 
+#include <pulse/mainloop.h>
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/macro.h>
@@ -176,6 +180,256 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+/* Small blocks take slots of the small classes, so many more of them fit
+ * than the pool has slots of the largest class. When a class is full,
+ * the next larger one is used. */
+START_TEST (memblock_class_test) {
+    pa_mempool *pool;
+    const pa_mempool_stat *s;
+    pa_memblock **blocks;
+    size_t slot_size, total = 0, bytes = 0;
+    unsigned n_slots[PA_MEMPOOL_CLASSES_MAX], n_classes, n = 0, i, c;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(pool != NULL);
+    pa_mempool_set_max_segments(pool, 1);
+    s = pa_mempool_get_stat(pool);
+
+    for (n_classes = 0; pa_mempool_get_class(pool, n_classes, &slot_size, &n_slots[n_classes]) == 0; n_classes++) {
+        pa_log_debug("Class %u: %u slots of %lu bytes", n_classes, n_slots[n_classes], (unsigned long) slot_size);
+        total += n_slots[n_classes];
+        bytes += n_slots[n_classes] * slot_size;
+    }
+    fail_unless(n_classes >= 1);
+    fail_unless(pa_mempool_get_class(pool, PA_MEMPOOL_CLASSES_MAX, NULL, NULL) < 0);
+
+    /* The classes share the default pool size, and the largest one keeps
+     * most of it */
+    fail_unless(bytes <= 64 * 1024 * 1024);
+    fail_unless(n_slots[n_classes - 1] * slot_size >= 62 * 1024 * 1024);
+
+    blocks = pa_xnew(pa_memblock *, total + 1);
+
+    /* Fill the whole pool with small blocks, and tag each so overlapping
+     * slots would show */
+    while ((blocks[n] = pa_memblock_new_pool(pool, 2048))) {
+        unsigned *d = pa_memblock_acquire(blocks[n]);
+        d[0] = d[511] = n;
+        pa_memblock_release(blocks[n]);
+        n++;
+    }
+
+    fail_unless(n == total);
+    fail_unless(pa_atomic_load(&s->n_pool_full) == 1);
+
+    /* Every allocation after a class filled up counts for it */
+    for (c = 0, i = total + 1; c < n_classes; i -= n_slots[c], c++) {
+        fail_unless((unsigned) pa_atomic_load(&s->n_allocated_by_class[c]) == n_slots[c]);
+        fail_unless((unsigned) pa_atomic_load(&s->n_class_full[c]) == i - n_slots[c]);
+    }
+
+    /* Freeing a small block makes room in the smallest class only */
+    pa_memblock_unref(blocks[0]);
+    fail_unless(pa_memblock_new_pool(pool, 16384) == NULL);
+    fail_unless((blocks[0] = pa_memblock_new_pool(pool, 2048)) != NULL);
+
+    for (i = 1; i < n; i++) {
+        unsigned *d = pa_memblock_acquire(blocks[i]);
+        fail_unless(d[0] == i && d[511] == i);
+        pa_memblock_release(blocks[i]);
+    }
+
+    for (i = 0; i < n; i++)
+        pa_memblock_unref(blocks[i]);
+
+    for (c = 0; c < n_classes; c++)
+        fail_unless(pa_atomic_load(&s->n_allocated_by_class[c]) == 0);
+
+    /* The largest blocks still fit */
+    fail_unless((blocks[0] = pa_memblock_new_pool(pool, (size_t) -1)) != NULL);
+    fail_unless(pa_memblock_get_length(blocks[0]) == pa_mempool_block_size_max(pool));
+    fail_unless(pa_atomic_load(&s->n_allocated_by_class[n_classes - 1]) == 1);
+    pa_memblock_unref(blocks[0]);
+
+    pa_xfree(blocks);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* A full pool grows by further segments of the same size, until the
+ * limit is reached. After that, blocks come from malloc(). */
+#define GROW_SLOTS 2
+#define GROW_SEGMENTS 3
+
+START_TEST (memblock_grow_test) {
+    pa_mempool *pool;
+    const pa_mempool_stat *s;
+    pa_memblock *blocks[GROW_SEGMENTS * GROW_SLOTS], *b;
+    pa_mainloop *ml;
+    uint32_t shm_id;
+    size_t size;
+    unsigned i;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, GROW_SLOTS * 64 * 1024, true);
+    fail_unless(pool != NULL);
+    size = pa_mempool_block_size_max(pool);
+    pa_mempool_set_max_segments(pool, GROW_SEGMENTS);
+    s = pa_mempool_get_stat(pool);
+
+    fail_unless(pa_mempool_get_n_segments(pool) == 1);
+    fail_unless(pa_mempool_get_segment_shm_id(pool, 1, &shm_id) < 0);
+
+    ml = pa_mainloop_new();
+
+    for (i = 0; i < GROW_SEGMENTS * GROW_SLOTS; i++) {
+        unsigned *d;
+
+        if (i == GROW_SLOTS) {
+            /* Allocating never grows the pool by itself */
+            fail_unless(pa_memblock_new_pool(pool, size) == NULL);
+            fail_unless(pa_mempool_get_n_segments(pool) == 1);
+
+            /* Requests made before the main loop was set are handled
+             * right away */
+            pa_mempool_set_grow_mainloop(pool, pa_mainloop_get_api(ml));
+            fail_unless(pa_mempool_get_n_segments(pool) == 2);
+        }
+
+        fail_unless((blocks[i] = pa_memblock_new_pool(pool, size)) != NULL);
+
+        /* From then on, the next segment is there before the newest one
+         * is full */
+        if (i >= GROW_SLOTS) {
+            unsigned n_segments = i / GROW_SLOTS + 2;
+
+            if (n_segments > GROW_SEGMENTS)
+                n_segments = GROW_SEGMENTS;
+
+            while (pa_mainloop_iterate(ml, 0, NULL) > 0)
+                ;
+            fail_unless(pa_mempool_get_n_segments(pool) == n_segments);
+        }
+
+        d = pa_memblock_acquire(blocks[i]);
+        d[0] = i;
+        pa_memblock_release(blocks[i]);
+    }
+
+    fail_unless(pa_memblock_new_pool(pool, size) == NULL);
+    fail_unless(pa_atomic_load(&s->n_segments) == GROW_SEGMENTS);
+    fail_unless(pa_atomic_load(&s->n_malloc_fallback) == 0);
+
+    /* Every segment has its own shared memory */
+    for (i = 0; i < GROW_SEGMENTS; i++) {
+        unsigned j;
+
+        fail_unless(pa_mempool_get_segment_shm_id(pool, i, &shm_id) == 0);
+        for (j = 0; j < i; j++) {
+            uint32_t other;
+
+            fail_unless(pa_mempool_get_segment_shm_id(pool, j, &other) == 0);
+            fail_unless(shm_id != other);
+        }
+    }
+
+    b = pa_memblock_new(pool, size);
+    fail_unless(b != NULL);
+    fail_unless(pa_atomic_load(&s->n_malloc_fallback) == 1);
+    pa_memblock_unref(b);
+
+    /* Slots of later segments are reused as well */
+    pa_memblock_unref(blocks[GROW_SEGMENTS * GROW_SLOTS - 1]);
+    fail_unless((blocks[GROW_SEGMENTS * GROW_SLOTS - 1] = pa_memblock_new_pool(pool, size)) != NULL);
+
+    for (i = 0; i < GROW_SEGMENTS * GROW_SLOTS - 1; i++) {
+        unsigned *d = pa_memblock_acquire(blocks[i]);
+        fail_unless(d[0] == i);
+        pa_memblock_release(blocks[i]);
+    }
+
+    for (i = 0; i < GROW_SEGMENTS * GROW_SLOTS; i++)
+        pa_memblock_unref(blocks[i]);
+
+    fail_unless(pa_atomic_load(&s->n_allocated) == 0);
+    fail_unless(pa_mempool_get_n_segments(pool) == GROW_SEGMENTS);
+
+    pa_mempool_set_grow_mainloop(pool, NULL);
+    pa_mainloop_free(ml);
+
+    pa_mempool_vacuum(pool);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* Whether huge pages can be had for private memory only depends on the
+ * global setting */
+static bool private_huge_pages_enabled(void) {
+#ifdef MADV_HUGEPAGE
+    char *line;
+    bool enabled;
+
+    if (!(line = pa_read_line_from_file("/sys/kernel/mm/transparent_hugepage/enabled")))
+        return false;
+
+    enabled = !strstr(line, "[never]");
+    pa_xfree(line);
+
+    return enabled;
+#else
+    return false;
+#endif
+}
+
+/* Huge pages are not necessarily available, but the pool has to work
+ * either way. They are requested for all segments of a pool or none,
+ * including the ones it grows later, and only once per segment. */
+START_TEST (memblock_huge_pages_test) {
+    pa_mem_type_t types[] = { PA_MEM_TYPE_PRIVATE, PA_MEM_TYPE_SHARED_POSIX };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(types); i++) {
+        pa_mempool *pool;
+        const pa_mempool_stat *s;
+        pa_memblock *b;
+        uint8_t *d;
+        size_t size;
+        unsigned n_requested;
+
+        pool = pa_mempool_new(types[i], 4 * 1024 * 1024, true);
+        fail_unless(pool != NULL);
+        s = pa_mempool_get_stat(pool);
+
+        pa_mempool_set_huge_pages(pool, true);
+        n_requested = (unsigned) pa_atomic_load(&s->n_huge_pages_requested);
+        fail_unless(n_requested == 0 || n_requested == 1);
+        if (types[i] == PA_MEM_TYPE_PRIVATE)
+            fail_unless(n_requested == (private_huge_pages_enabled() ? 1u : 0u));
+
+        pa_mempool_set_huge_pages(pool, true);
+        fail_unless((unsigned) pa_atomic_load(&s->n_huge_pages_requested) == n_requested);
+
+        fail_unless(pa_mempool_grow(pool) == 0);
+        fail_unless(pa_mempool_get_n_segments(pool) == 2);
+        fail_unless((unsigned) pa_atomic_load(&s->n_huge_pages_requested) == 2 * n_requested);
+
+        pa_mempool_prefault(pool);
+
+        size = pa_mempool_block_size_max(pool);
+        fail_unless((b = pa_memblock_new_pool(pool, size)) != NULL);
+
+        d = pa_memblock_acquire(b);
+        memset(d, 'x', size);
+        fail_unless(d[0] == 'x' && d[size - 1] == 'x');
+        pa_memblock_release(b);
+
+        pa_memblock_unref(b);
+
+        pa_mempool_vacuum(pool);
+        pa_mempool_unref(pool);
+    }
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -188,6 +442,9 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, memblock_class_test);
+    tcase_add_test(tc, memblock_grow_test);
+    tcase_add_test(tc, memblock_huge_pages_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
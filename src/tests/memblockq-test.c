@@ -30,9 +30,12 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/sample-util.h>
 
 #include <pulse/xmalloc.h>
 
+#include "runtime-test-util.h"
+
 static const char *fixed[] = {
     "1122444411441144__22__11______3333______________________________",
     "__________________3333__________________________________________"
@@ -632,6 +635,203 @@ START_TEST (memblockq_test_tlength_change) {
 }
 END_TEST
 
+START_TEST (memblockq_test_coalesce) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_memchunk chunk;
+    char buffer[64];
+    unsigned i, n;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+
+    bq = pa_memblockq_new("test memblockq", 0, 65536, 65536, &ss, 0, 4, 0, NULL);
+    fail_unless(bq != NULL);
+
+    pa_memblockq_set_coalesce(bq, true);
+
+    /* Every write comes in its own block */
+    for (i = 0; i < 100; i++) {
+        memset(buffer, 'a' + i % 26, sizeof(buffer));
+
+        chunk.memblock = pa_memblock_new_fixed(p, buffer, sizeof(buffer), true);
+        chunk.index = 0;
+        chunk.length = sizeof(buffer);
+
+        fail_unless(pa_memblockq_push(bq, &chunk) == 0);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    /* The writes were copied, so the queue has just a few entries */
+    fail_unless(pa_memblockq_get_nblocks(bq) < 10);
+    fail_unless(pa_memblockq_get_length(bq) == 100 * sizeof(buffer));
+
+    for (n = 0; pa_memblockq_peek(bq, &chunk) == 0; n += chunk.length) {
+        const char *d;
+
+        fail_unless(chunk.length >= sizeof(buffer));
+
+        d = pa_memblock_acquire_chunk(&chunk);
+        for (i = 0; i < chunk.length; i++) {
+            char expected = (char) ('a' + ((n + i) / sizeof(buffer)) % 26);
+
+            fail_unless(d[i] == expected);
+        }
+        pa_memblock_release(chunk.memblock);
+
+        pa_memblockq_drop(bq, chunk.length);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    fail_unless(n == 100 * sizeof(buffer));
+
+    pa_memblockq_free(bq);
+    pa_mempool_unref(p);
+}
+END_TEST
+
+/* Writing into the middle of a queued block splits it, and what is left
+ * after the write has to still be the end of that block */
+START_TEST (memblockq_test_split) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_memchunk chunk;
+    char block[64], middle[16];
+    char *str;
+    pa_strbuf *buf;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+    unsigned i;
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+
+    bq = pa_memblockq_new("test memblockq", 0, 65536, 65536, &ss, 0, 4, 0, NULL);
+    fail_unless(bq != NULL);
+
+    for (i = 0; i < sizeof(block); i++)
+        block[i] = 'a' + i % 26;
+    memset(middle, '_', sizeof(middle));
+
+    chunk.memblock = pa_memblock_new_fixed(p, block, sizeof(block), true);
+    chunk.index = 0;
+    chunk.length = sizeof(block);
+    fail_unless(pa_memblockq_push(bq, &chunk) == 0);
+    pa_memblock_unref(chunk.memblock);
+
+    pa_memblockq_seek(bq, 16, PA_SEEK_ABSOLUTE, true);
+
+    chunk.memblock = pa_memblock_new_fixed(p, middle, sizeof(middle), true);
+    chunk.index = 0;
+    chunk.length = sizeof(middle);
+    fail_unless(pa_memblockq_push(bq, &chunk) == 0);
+    pa_memblock_unref(chunk.memblock);
+
+    fail_unless(pa_memblockq_get_nblocks(bq) == 3);
+
+    pa_memblockq_seek(bq, sizeof(block), PA_SEEK_ABSOLUTE, true);
+    fail_unless(pa_memblockq_get_length(bq) == sizeof(block));
+
+    buf = pa_strbuf_new();
+    while (pa_memblockq_peek(bq, &chunk) == 0) {
+        dump_chunk(&chunk, buf);
+        pa_memblockq_drop(bq, chunk.length);
+        pa_memblock_unref(chunk.memblock);
+    }
+    fprintf(stderr, "\n");
+
+    str = pa_strbuf_to_string_free(buf);
+    fail_unless(pa_streq(str, "abcdefghijklmnop________________ghijklmnopqrstuvwxyzabcdefghijkl"));
+    pa_xfree(str);
+
+    pa_memblockq_free(bq);
+    pa_mempool_unref(p);
+}
+END_TEST
+
+/* Keeps about 1k blocks queued, half of them as rewind history, and
+ * measures how long pushing, peeking, dropping and rewinding takes */
+#define BENCH_BLOCKS 1024
+#define BENCH_BLOCK_SIZE 64
+#define BENCH_TIMES 1000
+#define BENCH_TIMES2 50
+
+START_TEST (memblockq_test_benchmark) {
+    pa_mempool *p;
+    pa_memblockq *bq;
+    pa_memchunk chunk, silence;
+    unsigned i;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+
+    p = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+
+    silence.memblock = pa_memblock_new(p, BENCH_BLOCK_SIZE);
+    silence.index = 0;
+    silence.length = BENCH_BLOCK_SIZE;
+    pa_silence_memchunk(&silence, &ss);
+
+    /* Pushing the same chunk again and again, the entries can't be
+     * merged, so every push adds a block to the queue */
+    chunk.memblock = pa_memblock_new(p, BENCH_BLOCK_SIZE);
+    chunk.index = 0;
+    chunk.length = BENCH_BLOCK_SIZE;
+    pa_silence_memchunk(&chunk, &ss);
+
+    bq = pa_memblockq_new("test memblockq", 0, BENCH_BLOCKS * BENCH_BLOCK_SIZE, BENCH_BLOCKS * BENCH_BLOCK_SIZE / 2,
+                          &ss, 0, BENCH_BLOCK_SIZE, BENCH_BLOCKS * BENCH_BLOCK_SIZE / 2, &silence);
+    fail_unless(bq != NULL);
+
+    for (i = 0; i < BENCH_BLOCKS; i++)
+        fail_unless(pa_memblockq_push(bq, &chunk) == 0);
+    pa_memblockq_drop(bq, BENCH_BLOCKS * BENCH_BLOCK_SIZE / 2);
+
+    fail_unless(pa_memblockq_get_nblocks(bq) == BENCH_BLOCKS);
+
+    PA_RUNTIME_TEST_RUN_START("memblockq push/peek/drop", BENCH_TIMES, BENCH_TIMES2) {
+        pa_memchunk out;
+
+        pa_memblockq_push(bq, &chunk);
+        pa_memblockq_peek(bq, &out);
+        pa_memblock_unref(out.memblock);
+        pa_memblockq_drop(bq, BENCH_BLOCK_SIZE);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    fail_unless(pa_memblockq_get_nblocks(bq) == BENCH_BLOCKS);
+
+    PA_RUNTIME_TEST_RUN_START("memblockq rewind/peek/drop", BENCH_TIMES, BENCH_TIMES2) {
+        pa_memchunk out;
+
+        pa_memblockq_rewind(bq, BENCH_BLOCKS * BENCH_BLOCK_SIZE / 2);
+        pa_memblockq_peek(bq, &out);
+        pa_memblock_unref(out.memblock);
+        pa_memblockq_drop(bq, BENCH_BLOCKS * BENCH_BLOCK_SIZE / 2);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("memblockq seek/push", BENCH_TIMES, BENCH_TIMES2) {
+        pa_memblockq_seek(bq, -BENCH_BLOCKS * BENCH_BLOCK_SIZE / 4, PA_SEEK_RELATIVE, true);
+        pa_memblockq_push(bq, &chunk);
+        pa_memblockq_seek(bq, BENCH_BLOCKS * BENCH_BLOCK_SIZE / 4 - BENCH_BLOCK_SIZE, PA_SEEK_RELATIVE, true);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    fail_unless(pa_memblockq_get_nblocks(bq) == BENCH_BLOCKS);
+
+    pa_memblockq_free(bq);
+    pa_memblock_unref(chunk.memblock);
+    pa_memblock_unref(silence.memblock);
+    pa_mempool_unref(p);
+}
+END_TEST
+
 
 int main(int argc, char *argv[]) {
     int failed = 0;
@@ -650,6 +850,9 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, memblockq_test_length_changes);
     tcase_add_test(tc, memblockq_test_pop_missing);
     tcase_add_test(tc, memblockq_test_tlength_change);
+    tcase_add_test(tc, memblockq_test_coalesce);
+    tcase_add_test(tc, memblockq_test_split);
+    tcase_add_test(tc, memblockq_test_benchmark);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,655 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <getopt.h>
+#include <locale.h>
+#include <math.h>
+
+#include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
+
+#include <pulsecore/i18n.h>
+#include <pulsecore/log.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sconv.h>
+#include <pulsecore/cpu.h>
+#include <pulsecore/core-util.h>
+
+/* Runs every supported resample method over a matrix of sample formats,
+ * channel counts and rate pairs, and prints one line of results per
+ * combination:
+ *
+ *   frames_per_sec     input frames resampled per second of CPU time,
+ *                      in blocks of 10 ms
+ *   delay_usec         group delay, from the phase of a low tone
+ *   held_usec          input the resampler keeps back, i.e. the output
+ *                      that pa_resampler_result() promises for the
+ *                      input so far but that didn't come out yet
+ *   thd_n_db           worst THD+N over a sweep of tones up to 40% of
+ *                      the lower rate
+ *   snr_db             worst SNR against the ideal tone over the same
+ *                      sweep, so gain errors in the pass band count too
+ *   rate_change_usec   extra time a block takes when the input rate was
+ *                      changed before it, empty if the method can't do
+ *                      variable rate
+ *
+ * The output is CSV or JSON, so that it can be compared between builds. */
+
+#define BLOCK_USEC (10 * PA_USEC_PER_MSEC)
+#define AMPLITUDE 0.5
+
+/* Output skipped before analysis, so that the filters have settled */
+#define SETTLE_USEC (100 * PA_USEC_PER_MSEC)
+
+/* Low enough that the delay of any method is below one period */
+#define DELAY_FREQ 40.0
+
+/* Tones of the sweep, relative to the lower of the two rates */
+static const double sweep[] = { 0.005, 0.05, 0.2, 0.35, 0.4 };
+
+#define RATE_CHANGES 200
+
+typedef enum output_format {
+    OUTPUT_CSV,
+    OUTPUT_JSON
+} output_format_t;
+
+typedef struct result {
+    double frames_per_sec;
+    double delay_usec;
+    double held_usec;
+    double thd_n_db;
+    double snr_db;
+    double rate_change_usec; /* NAN if not supported */
+} result;
+
+static pa_mempool *pool;
+static pa_usec_t duration = 200 * PA_USEC_PER_MSEC;
+static bool first_row = true;
+
+static pa_resampler *resampler_new(pa_resample_method_t method, const pa_sample_spec *a, const pa_sample_spec *b, pa_resample_flags_t flags) {
+    pa_channel_map am, bm;
+    pa_resampler *r;
+
+    /* The default mapping only goes up to 6 channels */
+    pa_channel_map_init_extend(&am, a->channels, PA_CHANNEL_MAP_ALSA);
+    pa_channel_map_init_extend(&bm, b->channels, PA_CHANNEL_MAP_ALSA);
+
+    if (!(r = pa_resampler_new(pool, a, &am, b, &bm, 0, method, flags)))
+        return NULL;
+
+    /* Don't measure a fallback under the wrong name */
+    if (pa_resampler_get_method(r) != method) {
+        pa_resampler_free(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+/* A tone on all channels, phase continuous from frame offset on */
+static pa_memchunk tone_chunk(const pa_sample_spec *ss, double freq, unsigned offset, unsigned n_frames) {
+    pa_memchunk c;
+    float *f;
+    void *d;
+    unsigned i, ch;
+
+    f = pa_xnew(float, n_frames * ss->channels);
+
+    for (i = 0; i < n_frames; i++) {
+        float v = (float) (AMPLITUDE * sin(2.0 * M_PI * freq * (offset + i) / ss->rate));
+
+        for (ch = 0; ch < ss->channels; ch++)
+            f[i * ss->channels + ch] = v;
+    }
+
+    c.length = n_frames * pa_frame_size(ss);
+    c.index = 0;
+    c.memblock = pa_memblock_new(pool, c.length);
+
+    d = pa_memblock_acquire(c.memblock);
+    pa_get_convert_from_float32ne_function(ss->format)(n_frames * ss->channels, f, d);
+    pa_memblock_release(c.memblock);
+
+    pa_xfree(f);
+
+    return c;
+}
+
+/* Appends the first channel of out to the buffer as float */
+static void append_channel(const pa_sample_spec *ss, pa_memchunk *out, float **buf, unsigned *n_frames) {
+    unsigned n, i;
+    float *f;
+    void *d;
+
+    if (!out->memblock)
+        return;
+
+    n = (unsigned) (out->length / pa_frame_size(ss));
+    f = pa_xnew(float, n * ss->channels);
+
+    d = pa_memblock_acquire_chunk(out);
+    pa_get_convert_to_float32ne_function(ss->format)(n * ss->channels, d, f);
+    pa_memblock_release(out->memblock);
+
+    *buf = pa_xrenew(float, *buf, *n_frames + n);
+    for (i = 0; i < n; i++)
+        (*buf)[*n_frames + i] = f[i * ss->channels];
+
+    *n_frames += n;
+
+    pa_xfree(f);
+    pa_memblock_unref(out->memblock);
+}
+
+/* Least squares fit of a sin(wk) + b cos(wk) + c. Returns the power of
+ * the residual. */
+static double fit_tone(const float *y, unsigned n, double w, double *a, double *b, double *c) {
+    double m[3][4] = { { 0 } }, x[3], res = 0.0;
+    unsigned k, i, j;
+
+    for (k = 0; k < n; k++) {
+        double v[3] = { sin(w * k), cos(w * k), 1.0 };
+
+        for (i = 0; i < 3; i++) {
+            for (j = 0; j < 3; j++)
+                m[i][j] += v[i] * v[j];
+            m[i][3] += v[i] * y[k];
+        }
+    }
+
+    /* Gaussian elimination, the system is well conditioned */
+    for (i = 0; i < 3; i++)
+        for (j = i + 1; j < 3; j++) {
+            double f = m[j][i] / m[i][i];
+            for (k = i; k < 4; k++)
+                m[j][k] -= f * m[i][k];
+        }
+
+    for (i = 3; i-- > 0;) {
+        x[i] = m[i][3];
+        for (j = i + 1; j < 3; j++)
+            x[i] -= m[i][j] * x[j];
+        x[i] /= m[i][i];
+    }
+
+    for (k = 0; k < n; k++) {
+        double e = y[k] - (x[0] * sin(w * k) + x[1] * cos(w * k) + x[2]);
+        res += e * e;
+    }
+
+    *a = x[0];
+    *b = x[1];
+    *c = x[2];
+
+    return res / n;
+}
+
+/* Resamples one second of a tone in blocks and returns the first channel
+ * of the output, optionally with how much output is still held back */
+static float *resample_tone(pa_resample_method_t method, const pa_sample_spec *a, const pa_sample_spec *b,
+                            double freq, unsigned *n_out, double *held_usec) {
+    pa_resampler *r;
+    pa_memchunk in, out;
+    unsigned block = (unsigned) pa_usec_to_bytes(BLOCK_USEC, a) / pa_frame_size(a);
+    unsigned n_in = a->rate, offset;
+    float *buf = NULL;
+
+    pa_assert_se(r = resampler_new(method, a, b, 0));
+
+    *n_out = 0;
+    in = tone_chunk(a, freq, 0, n_in);
+
+    for (offset = 0; offset < n_in; offset += block) {
+        pa_memchunk c = in;
+
+        c.index = offset * pa_frame_size(a);
+        c.length = PA_MIN(block, n_in - offset) * pa_frame_size(a);
+
+        pa_resampler_run(r, &c, &out);
+        append_channel(b, &out, &buf, n_out);
+    }
+
+    if (held_usec)
+        *held_usec = ((double) n_in * b->rate / a->rate - *n_out) * PA_USEC_PER_SEC / b->rate;
+
+    pa_memblock_unref(in.memblock);
+    pa_resampler_free(r);
+
+    return buf;
+}
+
+static void measure_quality(pa_resample_method_t method, const pa_sample_spec *a, const pa_sample_spec *b, result *res) {
+    unsigned n, skip, i;
+    double fa, fb, fc, phase;
+    float *buf;
+
+    skip = (unsigned) (SETTLE_USEC * b->rate / PA_USEC_PER_SEC);
+
+    /* The output of frame k is the input at k / rate - delay */
+    buf = resample_tone(method, a, b, DELAY_FREQ, &n, &res->held_usec);
+    pa_assert(n > skip);
+    fit_tone(buf, n, 2.0 * M_PI * DELAY_FREQ / b->rate, &fa, &fb, &fc);
+    phase = -atan2(fb, fa);
+
+    /* Rounding makes a zero delay come out slightly negative */
+    if (phase < -0.1 * M_PI)
+        phase += 2.0 * M_PI;
+    res->delay_usec = phase / (2.0 * M_PI * DELAY_FREQ) * PA_USEC_PER_SEC;
+    pa_xfree(buf);
+
+    res->thd_n_db = -INFINITY;
+    res->snr_db = INFINITY;
+
+    for (i = 0; i < PA_ELEMENTSOF(sweep); i++) {
+        double freq = sweep[i] * PA_MIN(a->rate, b->rate), resid, fund, amp, err;
+
+        buf = resample_tone(method, a, b, freq, &n, NULL);
+        resid = fit_tone(buf + skip, n - skip, 2.0 * M_PI * freq / b->rate, &fa, &fb, &fc);
+        pa_xfree(buf);
+
+        amp = sqrt(fa * fa + fb * fb);
+        fund = amp * amp / 2.0;
+        err = resid + fc * fc + (amp - AMPLITUDE) * (amp - AMPLITUDE) / 2.0;
+
+        /* Limit to something printable for perfect results */
+        resid = PA_MAX(resid, 1e-30);
+        err = PA_MAX(err, 1e-30);
+
+        res->thd_n_db = PA_MAX(res->thd_n_db, 10.0 * log10(resid / fund));
+        res->snr_db = PA_MIN(res->snr_db, 10.0 * log10(AMPLITUDE * AMPLITUDE / 2.0 / err));
+    }
+}
+
+static void measure_throughput(pa_resample_method_t method, const pa_sample_spec *a, const pa_sample_spec *b, result *res) {
+    pa_resampler *r;
+    pa_memchunk in, out;
+    unsigned block = (unsigned) pa_usec_to_bytes(BLOCK_USEC, a) / pa_frame_size(a);
+    uint64_t frames = 0;
+    pa_usec_t start, elapsed;
+
+    pa_assert_se(r = resampler_new(method, a, b, 0));
+    in = tone_chunk(a, sweep[1] * PA_MIN(a->rate, b->rate), 0, block);
+
+    start = pa_rtclock_now();
+    do {
+        pa_resampler_run(r, &in, &out);
+        if (out.memblock)
+            pa_memblock_unref(out.memblock);
+        frames += block;
+    } while ((elapsed = pa_rtclock_now() - start) < duration);
+
+    res->frames_per_sec = (double) frames * PA_USEC_PER_SEC / elapsed;
+
+    pa_memblock_unref(in.memblock);
+    pa_resampler_free(r);
+}
+
+static pa_usec_t time_blocks(pa_resampler *r, const pa_memchunk *in, uint32_t rate, bool change) {
+    pa_memchunk out;
+    pa_usec_t start;
+    unsigned i;
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < RATE_CHANGES; i++) {
+        /* What an adjusting stream does: small steps around the nominal
+         * rate */
+        if (change)
+            pa_resampler_set_input_rate(r, i % 2 ? rate + 10 : rate - 10);
+
+        pa_resampler_run(r, in, &out);
+        if (out.memblock)
+            pa_memblock_unref(out.memblock);
+    }
+
+    return pa_rtclock_now() - start;
+}
+
+static void measure_rate_change(pa_resample_method_t method, const pa_sample_spec *a, const pa_sample_spec *b, result *res) {
+    pa_resampler *r;
+    pa_memchunk in;
+    unsigned block = (unsigned) pa_usec_to_bytes(BLOCK_USEC, a) / pa_frame_size(a);
+    pa_usec_t fixed, changing;
+
+    res->rate_change_usec = NAN;
+
+    if (!(r = resampler_new(method, a, b, PA_RESAMPLER_VARIABLE_RATE)))
+        return;
+
+    if (!r->impl.update_rates) {
+        pa_resampler_free(r);
+        return;
+    }
+
+    in = tone_chunk(a, sweep[1] * PA_MIN(a->rate, b->rate), 0, block);
+
+    /* Warm up, then alternate so that caches affect both the same way */
+    time_blocks(r, &in, a->rate, true);
+    fixed = time_blocks(r, &in, a->rate, false);
+    changing = time_blocks(r, &in, a->rate, true);
+    fixed = PA_MIN(fixed, time_blocks(r, &in, a->rate, false));
+    changing = PA_MIN(changing, time_blocks(r, &in, a->rate, true));
+
+    res->rate_change_usec = ((double) changing - (double) fixed) / RATE_CHANGES;
+
+    pa_memblock_unref(in.memblock);
+    pa_resampler_free(r);
+}
+
+static void print_number(double v, output_format_t output) {
+    if (isnan(v)) {
+        if (output == OUTPUT_JSON)
+            printf("null");
+    } else if (isinf(v))
+        printf("%s", output == OUTPUT_JSON ? "null" : v > 0 ? "inf" : "-inf");
+    else
+        printf("%.2f", v);
+}
+
+static void print_result(pa_resample_method_t method, const pa_sample_spec *a, const pa_sample_spec *b,
+                         const result *res, output_format_t output) {
+    static const char * const fields[] = {
+        "frames_per_sec", "delay_usec", "held_usec", "thd_n_db", "snr_db", "rate_change_usec"
+    };
+    const double values[] = {
+        res->frames_per_sec, res->delay_usec, res->held_usec, res->thd_n_db, res->snr_db, res->rate_change_usec
+    };
+    unsigned i;
+
+    if (output == OUTPUT_CSV) {
+        if (first_row) {
+            printf("method,format,channels,from_rate,to_rate");
+            for (i = 0; i < PA_ELEMENTSOF(fields); i++)
+                printf(",%s", fields[i]);
+            printf("\n");
+        }
+
+        printf("%s,%s,%u,%u,%u", pa_resample_method_to_string(method), pa_sample_format_to_string(a->format),
+               a->channels, a->rate, b->rate);
+        for (i = 0; i < PA_ELEMENTSOF(fields); i++) {
+            printf(",");
+            print_number(values[i], output);
+        }
+        printf("\n");
+    } else {
+        printf("%s\n  {\"method\": \"%s\", \"format\": \"%s\", \"channels\": %u, \"from_rate\": %u, \"to_rate\": %u",
+               first_row ? "[" : ",", pa_resample_method_to_string(method), pa_sample_format_to_string(a->format),
+               a->channels, a->rate, b->rate);
+        for (i = 0; i < PA_ELEMENTSOF(fields); i++) {
+            printf(", \"%s\": ", fields[i]);
+            print_number(values[i], output);
+        }
+        printf("}");
+    }
+
+    first_row = false;
+    fflush(stdout);
+}
+
+static void bench(pa_resample_method_t method, pa_sample_format_t format, unsigned channels,
+                  uint32_t from_rate, uint32_t to_rate, output_format_t output) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+    result res;
+
+    a.format = b.format = format;
+    a.channels = b.channels = (uint8_t) channels;
+    a.rate = from_rate;
+    b.rate = to_rate;
+
+    /* Not compiled in, or not for these rates (peaks, copy) */
+    if (!(r = resampler_new(method, &a, &b, 0))) {
+        pa_log_info("Skipping %s for %u -> %u Hz.", pa_resample_method_to_string(method), from_rate, to_rate);
+        return;
+    }
+    pa_resampler_free(r);
+
+    pa_log_info("=== %s, %u ch %s, %u -> %u Hz", pa_resample_method_to_string(method), channels,
+                pa_sample_format_to_string(format), from_rate, to_rate);
+
+    measure_throughput(method, &a, &b, &res);
+    measure_quality(method, &a, &b, &res);
+    measure_rate_change(method, &a, &b, &res);
+
+    print_result(method, &a, &b, &res, output);
+}
+
+/* Parses a list with parse(), returns the number of
+ * items or -1 on error */
+static int parse_list(const char *s, const char *delimiters, int (*parse)(const char *item), int *list, int max) {
+    const char *state = NULL;
+    char *item;
+    int n = 0;
+
+    while ((item = pa_split(s, delimiters, &state))) {
+        if (n >= max || (list[n] = parse(item)) < 0) {
+            pa_log("Invalid value or too many values: %s", item);
+            pa_xfree(item);
+            return -1;
+        }
+
+        pa_xfree(item);
+        n++;
+    }
+
+    return n;
+}
+
+static int parse_method(const char *s) {
+    return pa_parse_resample_method(s);
+}
+
+static int parse_format(const char *s) {
+    return pa_parse_sample_format(s);
+}
+
+static int parse_channels(const char *s) {
+    uint32_t c;
+
+    if (pa_atou(s, &c) < 0 || c == 0 || c > PA_CHANNELS_MAX)
+        return -1;
+
+    return (int) c;
+}
+
+static int parse_rate(const char *s) {
+    uint32_t r;
+
+    if (pa_atou(s, &r) < 0 || !pa_sample_rate_valid(r))
+        return -1;
+
+    return (int) r;
+}
+
+static void help(const char *argv0) {
+    printf("%s [options]\n\n"
+           "-h, --help                            Show this help\n"
+           "-v, --verbose                         Print debug messages\n"
+           "      --methods=METHOD,...            Resample methods (defaults to all supported)\n"
+           "      --formats=SAMPLEFORMAT,...      Sample types (defaults to s16le,s32le,float32le)\n"
+           "      --channels=CHANNELS,...         Numbers of channels (defaults to 1,2,6,8)\n"
+           "      --rates=FROM:TO,...             Rate pairs in Hz (defaults to 44100:48000,48000:44100)\n"
+           "      --duration=MSEC                 Time spent measuring the throughput of\n"
+           "                                      each combination (defaults to 200)\n"
+           "      --json                          Print JSON instead of CSV\n"
+           "\n"
+           "See resampler-test --dump-resample-methods for possible values of resample methods.\n",
+           argv0);
+}
+
+enum {
+    ARG_VERSION = 256,
+    ARG_METHODS,
+    ARG_FORMATS,
+    ARG_CHANNELS,
+    ARG_RATES,
+    ARG_DURATION,
+    ARG_JSON
+};
+
+int main(int argc, char *argv[]) {
+    int methods[PA_RESAMPLER_MAX], formats[PA_SAMPLE_MAX], channels[PA_CHANNELS_MAX], rates[32];
+    int n_methods = 0, n_formats = 3, n_channels = 4, n_rates = 4;
+    output_format_t output = OUTPUT_CSV;
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    int ret = 1, c, m, f, ch, i;
+
+    static const struct option long_options[] = {
+        {"help",                  0, NULL, 'h'},
+        {"verbose",               0, NULL, 'v'},
+        {"version",               0, NULL, ARG_VERSION},
+        {"methods",               1, NULL, ARG_METHODS},
+        {"formats",               1, NULL, ARG_FORMATS},
+        {"channels",              1, NULL, ARG_CHANNELS},
+        {"rates",                 1, NULL, ARG_RATES},
+        {"duration",              1, NULL, ARG_DURATION},
+        {"json",                  0, NULL, ARG_JSON},
+        {NULL,                    0, NULL, 0}
+    };
+
+    setlocale(LC_ALL, "");
+#ifdef ENABLE_NLS
+    bindtextdomain(GETTEXT_PACKAGE, PULSE_LOCALEDIR);
+#endif
+
+    pa_log_set_level(PA_LOG_WARN);
+
+    formats[0] = PA_SAMPLE_S16LE;
+    formats[1] = PA_SAMPLE_S32LE;
+    formats[2] = PA_SAMPLE_FLOAT32LE;
+
+    channels[0] = 1;
+    channels[1] = 2;
+    channels[2] = 6;
+    channels[3] = 8;
+
+    rates[0] = 44100;
+    rates[1] = 48000;
+    rates[2] = 48000;
+    rates[3] = 44100;
+
+    while ((c = getopt_long(argc, argv, "hv", long_options, NULL)) != -1) {
+
+        switch (c) {
+            case 'h' :
+                help(argv[0]);
+                ret = 0;
+                goto quit;
+
+            case 'v':
+                pa_log_set_level(PA_LOG_INFO);
+                break;
+
+            case ARG_VERSION:
+                printf("%s %s\n", argv[0], PACKAGE_VERSION);
+                ret = 0;
+                goto quit;
+
+            case ARG_METHODS:
+                if ((n_methods = parse_list(optarg, ",", parse_method, methods, PA_ELEMENTSOF(methods))) <= 0)
+                    goto quit;
+                break;
+
+            case ARG_FORMATS:
+                if ((n_formats = parse_list(optarg, ",", parse_format, formats, PA_ELEMENTSOF(formats))) <= 0)
+                    goto quit;
+                break;
+
+            case ARG_CHANNELS:
+                if ((n_channels = parse_list(optarg, ",", parse_channels, channels, PA_ELEMENTSOF(channels))) <= 0)
+                    goto quit;
+                break;
+
+            case ARG_RATES: {
+                const char *state = NULL;
+                char *pair;
+
+                n_rates = 0;
+
+                while ((pair = pa_split(optarg, ",", &state))) {
+                    int n = parse_list(pair, ":", parse_rate, rates + n_rates, PA_MIN(2, (int) PA_ELEMENTSOF(rates) - n_rates));
+
+                    pa_xfree(pair);
+
+                    if (n != 2) {
+                        pa_log("Rates must be given as FROM:TO.");
+                        goto quit;
+                    }
+
+                    n_rates += 2;
+                }
+
+                if (n_rates <= 0)
+                    goto quit;
+                break;
+            }
+
+            case ARG_DURATION: {
+                uint32_t msec;
+
+                if (pa_atou(optarg, &msec) < 0 || msec <= 0) {
+                    pa_log("Invalid duration: %s", optarg);
+                    goto quit;
+                }
+
+                duration = msec * PA_USEC_PER_MSEC;
+                break;
+            }
+
+            case ARG_JSON:
+                output = OUTPUT_JSON;
+                break;
+
+            default:
+                goto quit;
+        }
+    }
+
+    /* All the methods from the table, except the aliases */
+    if (n_methods == 0)
+        for (m = 0; m < PA_RESAMPLER_MAX; m++)
+            if (m != PA_RESAMPLER_AUTO && pa_resample_method_supported(m))
+                methods[n_methods++] = m;
+
+    /* Measure what the daemon would run */
+    pa_cpu_init(&cpu_info);
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    for (m = 0; m < n_methods; m++)
+        for (f = 0; f < n_formats; f++)
+            for (ch = 0; ch < n_channels; ch++)
+                for (i = 0; i < n_rates; i += 2)
+                    bench(methods[m], formats[f], channels[ch], rates[i], rates[i + 1], output);
+
+    if (output == OUTPUT_JSON)
+        printf("%s\n", first_row ? "[]" : "\n]");
+
+    pa_mempool_unref(pool);
+    ret = 0;
+
+ quit:
+    return ret;
+}
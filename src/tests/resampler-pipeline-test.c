@@ -0,0 +1,260 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/channelmap.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/cpu.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sample-util.h>
+
+#include "runtime-test-util.h"
+
+/* The tiled pipeline must give exactly the same result as running every
+ * stage on the whole block, for any block size. */
+
+#define BLOCKS 50
+
+static pa_mempool *pool;
+
+static pa_memchunk random_chunk(const pa_sample_spec *ss, unsigned n_frames) {
+    pa_memchunk c;
+    void *d;
+
+    c.memblock = pa_memblock_new(pool, n_frames * pa_frame_size(ss));
+    c.index = 0;
+    c.length = n_frames * pa_frame_size(ss);
+
+    d = pa_memblock_acquire(c.memblock);
+    pa_random(d, c.length);
+
+    /* Random bits aren't necessarily valid floats */
+    if (ss->format == PA_SAMPLE_FLOAT32NE) {
+        float *f = d;
+        unsigned i;
+
+        for (i = 0; i < c.length / sizeof(float); i++)
+            f[i] = (float) ((int32_t) ((uint32_t *) d)[i] >> 8) / (1 << 23);
+    }
+
+    pa_memblock_release(c.memblock);
+
+    return c;
+}
+
+static void append(pa_memchunk *out, uint8_t **data, size_t *length) {
+    void *d;
+
+    if (!out->memblock)
+        return;
+
+    *data = pa_xrealloc(*data, *length + out->length);
+
+    d = pa_memblock_acquire_chunk(out);
+    memcpy(*data + *length, d, out->length);
+    pa_memblock_release(out->memblock);
+
+    *length += out->length;
+
+    pa_memblock_unref(out->memblock);
+}
+
+static void compare_pipelines(pa_resample_method_t method, pa_sample_format_t from_format, pa_sample_format_t to_format,
+                              unsigned from_channels, unsigned to_channels, uint32_t from_rate, uint32_t to_rate) {
+    pa_sample_spec a, b;
+    pa_channel_map am, bm;
+    pa_resampler *tiled, *whole;
+    uint8_t *tiled_data = NULL, *whole_data = NULL;
+    size_t tiled_length = 0, whole_length = 0;
+    unsigned i;
+
+    a.format = from_format;
+    a.channels = from_channels;
+    a.rate = from_rate;
+    b.format = to_format;
+    b.channels = to_channels;
+    b.rate = to_rate;
+
+    /* The default mapping only goes up to 6 channels */
+    pa_channel_map_init_extend(&am, from_channels, PA_CHANNEL_MAP_ALSA);
+    pa_channel_map_init_extend(&bm, to_channels, PA_CHANNEL_MAP_ALSA);
+
+    pa_assert_se(tiled = pa_resampler_new(pool, &a, &am, &b, &bm, 0, method, PA_RESAMPLER_TILED));
+    pa_assert_se(whole = pa_resampler_new(pool, &a, &am, &b, &bm, 0, method, 0));
+
+    /* Small tiles, so every block spans several */
+    tiled->tile_frames = 61;
+
+    for (i = 0; i < BLOCKS; i++) {
+        pa_memchunk in, out;
+
+        in = random_chunk(&a, 1 + (i * 193) % 1500);
+
+        pa_resampler_run(tiled, &in, &out);
+        append(&out, &tiled_data, &tiled_length);
+
+        pa_resampler_run(whole, &in, &out);
+        append(&out, &whole_data, &whole_length);
+
+        pa_memblock_unref(in.memblock);
+    }
+
+    pa_log_debug("%s, %s %u ch %u Hz -> %s %u ch %u Hz: %zu bytes", pa_resample_method_to_string(method),
+                 pa_sample_format_to_string(from_format), from_channels, from_rate,
+                 pa_sample_format_to_string(to_format), to_channels, to_rate, tiled_length);
+
+    ck_assert_int_eq(tiled_length, whole_length);
+    fail_unless(memcmp(tiled_data, whole_data, tiled_length) == 0);
+
+    pa_xfree(tiled_data);
+    pa_xfree(whole_data);
+    pa_resampler_free(tiled);
+    pa_resampler_free(whole);
+}
+
+START_TEST (pipeline_test) {
+    static const pa_resample_method_t methods[] = {
+        PA_RESAMPLER_POLYPHASE_LQ,
+        PA_RESAMPLER_TRIVIAL,
+        PA_RESAMPLER_FFMPEG,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+        PA_RESAMPLER_SRC_SINC_FASTEST,
+    };
+    static const unsigned channels[][2] = {
+        { 8, 8 },
+        { 8, 2 },
+        { 2, 6 },
+        { 1, 1 },
+    };
+    unsigned i, j;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    for (i = 0; i < PA_ELEMENTSOF(methods); i++) {
+        if (!pa_resample_method_supported(methods[i]))
+            continue;
+
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            compare_pipelines(methods[i], PA_SAMPLE_S16LE, PA_SAMPLE_S16LE, channels[j][0], channels[j][1], 44100, 48000);
+            compare_pipelines(methods[i], PA_SAMPLE_S16LE, PA_SAMPLE_S32LE, channels[j][0], channels[j][1], 48000, 44100);
+            compare_pipelines(methods[i], PA_SAMPLE_FLOAT32NE, PA_SAMPLE_FLOAT32NE, channels[j][0], channels[j][1], 44100, 48000);
+            compare_pipelines(methods[i], PA_SAMPLE_S24LE, PA_SAMPLE_FLOAT32NE, channels[j][0], channels[j][1], 96000, 44100);
+        }
+    }
+
+    compare_pipelines(PA_RESAMPLER_PEAKS, PA_SAMPLE_S16LE, PA_SAMPLE_S16LE, 8, 2, 48000, 8000);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+#define TIMES 30
+#define TIMES2 10
+
+/* 8 channels, 44.1 -> 48 kHz, in blocks of 20 and 200 ms */
+START_TEST (pipeline_performance_test) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16LE, PA_SAMPLE_S24LE, PA_SAMPLE_S32LE };
+    pa_resample_method_t method;
+    pa_sample_spec a, b;
+    pa_channel_map map;
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    unsigned i;
+
+    /* With the optimized functions, the resampler doesn't hide the cost
+     * of the other stages */
+    pa_cpu_init(&cpu_info);
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    pa_channel_map_init_extend(&map, 8, PA_CHANNEL_MAP_ALSA);
+
+    method = pa_resample_method_supported(PA_RESAMPLER_SPEEX_FLOAT_BASE + 1) ?
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 1 : PA_RESAMPLER_POLYPHASE_LQ;
+
+    for (i = 0; i < PA_ELEMENTSOF(formats) * 2; i++) {
+        pa_resampler *tiled, *whole;
+        pa_memchunk in, out;
+        unsigned n_frames = i % 2 ? 8820 : 882;
+
+        a.format = b.format = formats[i / 2];
+        a.channels = b.channels = 8;
+        a.rate = 44100;
+        b.rate = 48000;
+
+        pa_assert_se(tiled = pa_resampler_new(pool, &a, &map, &b, &map, 0, method, PA_RESAMPLER_TILED));
+        pa_assert_se(whole = pa_resampler_new(pool, &a, &map, &b, &map, 0, method, 0));
+
+        in = random_chunk(&a, n_frames);
+
+        pa_log_debug("Resampling %u frames of 8 channel %s, 44100 -> 48000 Hz with %s, %u frames per tile",
+                     n_frames, pa_sample_format_to_string(a.format), pa_resample_method_to_string(method), tiled->tile_frames);
+
+        PA_RUNTIME_TEST_RUN_START("tiled", TIMES, TIMES2) {
+            pa_resampler_run(tiled, &in, &out);
+            pa_memblock_unref(out.memblock);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("whole", TIMES, TIMES2) {
+            pa_resampler_run(whole, &in, &out);
+            pa_memblock_unref(out.memblock);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_memblock_unref(in.memblock);
+        pa_resampler_free(tiled);
+        pa_resampler_free(whole);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Resampler pipeline");
+    tc = tcase_create("resampler-pipeline");
+    tcase_add_test(tc, pipeline_test);
+    tcase_add_test(tc, pipeline_performance_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,216 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/resampler.h>
+
+/* Variable rate resamplers get a new input rate every 10 ms, like a
+ * stream that is adjusted as fast as possible. The input is generated at
+ * the rate the resampler is told about, so the output must stay a clean
+ * sine: any reset or skip of the filter state shows up as a jump
+ * between two samples that is larger than the slope of the sine allows. */
+
+#define CHANNELS 2
+#define FREQ 1000.0
+#define AMPLITUDE 0.5
+#define SECONDS 2
+#define RATE_STEP 20
+
+/* Filtering can overshoot the slope of the ideal sine a little */
+#define MAX_OVERSHOOT 1.05
+
+static void sweep_rate(pa_resample_method_t method, pa_sample_format_t format, uint32_t from, uint32_t to) {
+    pa_mempool *pool;
+    pa_resampler *r;
+    pa_sample_spec a, b;
+    pa_memchunk in, out;
+    double phase = 0.0, expected = 0.0, max_step = 0.0, slope;
+    unsigned block, frames, out_frames = 0, i;
+    uint32_t rate = from;
+    float last = 0.0f;
+    pa_usec_t elapsed = 0;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    /* The input format decides the work format of the resampler */
+    a.format = format;
+    b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = CHANNELS;
+    a.rate = from;
+    b.rate = to;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, PA_RESAMPLER_VARIABLE_RATE));
+    ck_assert_int_eq(pa_resampler_get_method(r), method);
+
+    for (block = 0; block < SECONDS * 100; block++) {
+        pa_usec_t start;
+        float *d;
+
+        frames = rate / 100;
+        expected += (double) frames * to / rate;
+
+        in.memblock = pa_memblock_new(pool, frames * pa_frame_size(&a));
+        in.index = 0;
+        in.length = frames * pa_frame_size(&a);
+
+        d = pa_memblock_acquire(in.memblock);
+        for (i = 0; i < frames; i++) {
+            float v = (float) (AMPLITUDE * sin(phase));
+            unsigned c;
+
+            if (format == PA_SAMPLE_S16NE)
+                for (c = 0; c < CHANNELS; c++)
+                    ((int16_t *) d)[i * CHANNELS + c] = (int16_t) lrintf(v * 0x7FFF);
+            else
+                for (c = 0; c < CHANNELS; c++)
+                    d[i * CHANNELS + c] = v;
+
+            phase += 2.0 * M_PI * FREQ / rate;
+        }
+        pa_memblock_release(in.memblock);
+
+        start = pa_rtclock_now();
+
+        pa_resampler_run(r, &in, &out);
+        pa_memblock_unref(in.memblock);
+
+        /* Triangle sweep around the nominal rate */
+        rate = (block / 20) % 2 ? rate - RATE_STEP : rate + RATE_STEP;
+        pa_resampler_set_input_rate(r, rate);
+
+        elapsed += pa_rtclock_now() - start;
+
+        if (!out.memblock)
+            continue;
+
+        d = pa_memblock_acquire_chunk(&out);
+        for (i = 0; i < out.length / pa_frame_size(&b); i++, out_frames++) {
+            /* Skip the start, where the filter is still filling */
+            if (out_frames > to / 100)
+                max_step = PA_MAX(max_step, fabs(d[i * CHANNELS] - last));
+
+            last = d[i * CHANNELS];
+        }
+        pa_memblock_release(out.memblock);
+        pa_memblock_unref(out.memblock);
+    }
+
+    slope = AMPLITUDE * 2.0 * M_PI * FREQ / to;
+
+    pa_log_debug("%s, %s %u -> %u Hz: largest step %0.5f, slope %0.5f, %0.1f usec per block",
+                 pa_resample_method_to_string(method), pa_sample_format_to_string(format), from, to,
+                 max_step, slope, (double) elapsed / (SECONDS * 100));
+
+    fail_unless(max_step < slope * MAX_OVERSHOOT);
+
+    /* Nothing is lost or made up, apart from what's still in the filter */
+    fail_unless(fabs(expected - out_frames) < 200);
+
+    pa_resampler_free(r);
+    pa_mempool_unref(pool);
+}
+
+START_TEST (rate_sweep_test) {
+    /* All methods that support variable rate, except those that hold
+     * samples and so have steps by design */
+    static const pa_resample_method_t methods[] = {
+        PA_RESAMPLER_SRC_SINC_BEST_QUALITY,
+        PA_RESAMPLER_SRC_SINC_FASTEST,
+        PA_RESAMPLER_SRC_LINEAR,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 5,
+        PA_RESAMPLER_SPEEX_FIXED_BASE + 3,
+        PA_RESAMPLER_SOXR_MQ,
+        PA_RESAMPLER_SOXR_HQ,
+        PA_RESAMPLER_SOXR_VHQ,
+        PA_RESAMPLER_POLYPHASE_LQ,
+        PA_RESAMPLER_POLYPHASE_MQ,
+        PA_RESAMPLER_POLYPHASE_HQ,
+    };
+    pa_resampler *r;
+    pa_mempool *pool;
+    pa_sample_spec ss;
+    unsigned i;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    ss.format = PA_SAMPLE_FLOAT32NE;
+    ss.channels = CHANNELS;
+    ss.rate = 44100;
+
+    for (i = 0; i < PA_ELEMENTSOF(methods); i++) {
+        pa_sample_format_t format;
+
+        if (!pa_resample_method_supported(methods[i]))
+            continue;
+
+        /* Some libraries can only do variable rate from some version on */
+        pa_assert_se(r = pa_resampler_new(pool, &ss, NULL, &ss, NULL, 0, methods[i], PA_RESAMPLER_VARIABLE_RATE));
+        if (pa_resampler_get_method(r) != methods[i]) {
+            pa_resampler_free(r);
+            continue;
+        }
+        pa_resampler_free(r);
+
+        /* Fixed point speex works on s16 */
+        format = methods[i] >= PA_RESAMPLER_SPEEX_FIXED_BASE && methods[i] <= PA_RESAMPLER_SPEEX_FIXED_MAX ?
+            PA_SAMPLE_S16NE : PA_SAMPLE_FLOAT32NE;
+
+        sweep_rate(methods[i], format, 44100, 48000);
+        sweep_rate(methods[i], format, 48000, 44100);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Resampler rate");
+    tc = tcase_create("resampler-rate");
+    tcase_add_test(tc, rate_sweep_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
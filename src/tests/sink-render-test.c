@@ -0,0 +1,348 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sconv.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#include "runtime-test-util.h"
+
+/* More than the 32 inputs the sink used to mix at most */
+#define N_INPUTS 40
+#define SAMPLE_VALUE 100
+#define RENDER_LENGTH 4096
+
+/* Enough inputs at enough volume to clip. The s16 mix truncates every
+ * input after applying the volume, so it can be up to an LSB per input
+ * lower, plus one for the rounding of the float to s16 conversion. */
+#define FLOAT_INPUTS 4
+#define FLOAT_VOLUME 0.3
+#define FLOAT_TOLERANCE (FLOAT_INPUTS + 1)
+
+#define TIMES 100
+#define TIMES2 10
+
+enum {
+    SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    SINK_MESSAGE_BENCHMARK
+};
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = 44100,
+    .channels = 2
+};
+
+static pa_rtpoll *rtpoll;
+static pa_thread_mq thread_mq;
+static pa_memchunk input_chunk;
+
+static void thread_func(void *userdata) {
+    pa_thread_mq_install(&thread_mq);
+
+    /* Returns 0 once we got PA_MESSAGE_SHUTDOWN */
+    while (pa_rtpoll_run(rtpoll) > 0)
+        ;
+}
+
+/* Called from IO thread context */
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    if (code == SINK_MESSAGE_RENDER || code == SINK_MESSAGE_BENCHMARK) {
+        pa_sink *s = PA_SINK(o);
+
+        /* Setting up the volumes asks for a rewind, and a real sink
+         * would have done it before rendering */
+        if (s->thread_info.rewind_requested)
+            pa_sink_process_rewind(s, 0);
+
+        if (code == SINK_MESSAGE_BENCHMARK) {
+            pa_memchunk result;
+
+            PA_RUNTIME_TEST_RUN_START(data, TIMES, TIMES2) {
+                pa_sink_render(s, (size_t) offset, &result);
+                pa_memblock_unref(result.memblock);
+            } PA_RUNTIME_TEST_RUN_STOP
+
+            return 0;
+        }
+
+        pa_sink_render(s, (size_t) offset, data);
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+/* Called from IO thread context, or a render worker on its behalf */
+static int input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk) {
+    *chunk = input_chunk;
+    chunk->length = PA_MIN(length, chunk->length);
+    pa_memblock_ref(chunk->memblock);
+
+    return 0;
+}
+
+static void input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+static void input_kill_cb(pa_sink_input *i) {
+}
+
+/* Renders length bytes from a sink with the given format and n_inputs
+ * inputs that all play input_chunk at the given volume. If a benchmark
+ * label is given, rendering is timed before. */
+static void render_inputs(pa_core *core, pa_sample_format_t format, unsigned n_inputs,
+                          const pa_cvolume *volume, size_t length, const char *benchmark,
+                          pa_memchunk *result) {
+    pa_sink_new_data data;
+    pa_sample_spec sink_ss = ss;
+    pa_sink *sink;
+    pa_sink_input **inputs;
+    pa_thread *thread;
+    unsigned i;
+
+    rtpoll = pa_rtpoll_new();
+    fail_unless(pa_thread_mq_init(&thread_mq, core->mainloop, rtpoll) == 0);
+
+    sink_ss.format = format;
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, "render-test");
+    pa_sink_new_data_set_sample_spec(&data, &sink_ss);
+    sink = pa_sink_new(core, &data, 0);
+    pa_sink_new_data_done(&data);
+    fail_unless(sink != NULL);
+
+    sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(sink, thread_mq.inq);
+    pa_sink_set_rtpoll(sink, rtpoll);
+
+    pa_assert_se(thread = pa_thread_new("render-test", thread_func, NULL));
+    pa_sink_put(sink);
+
+    inputs = pa_xnew(pa_sink_input *, n_inputs);
+
+    for (i = 0; i < n_inputs; i++) {
+        pa_sink_input_new_data input_data;
+
+        pa_sink_input_new_data_init(&input_data);
+        input_data.driver = __FILE__;
+        pa_sink_input_new_data_set_sink(&input_data, sink, false, true);
+        pa_sink_input_new_data_set_sample_spec(&input_data, &ss);
+        if (volume) {
+            pa_channel_map map;
+
+            pa_channel_map_init_extend(&map, ss.channels, PA_CHANNEL_MAP_DEFAULT);
+            pa_sink_input_new_data_set_channel_map(&input_data, &map);
+            pa_sink_input_new_data_set_volume(&input_data, volume);
+        }
+        input_data.flags = PA_SINK_INPUT_PARALLEL_PEEK;
+        fail_unless(pa_sink_input_new(&inputs[i], core, &input_data) == 0);
+        pa_sink_input_new_data_done(&input_data);
+
+        inputs[i]->pop = input_pop_cb;
+        inputs[i]->process_rewind = input_process_rewind_cb;
+        inputs[i]->kill = input_kill_cb;
+        pa_sink_input_put(inputs[i]);
+    }
+
+    if (benchmark)
+        fail_unless(pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), SINK_MESSAGE_BENCHMARK, (void *) benchmark, (int64_t) length, NULL) == 0);
+
+    fail_unless(pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), SINK_MESSAGE_RENDER, result, (int64_t) length, NULL) == 0);
+    fail_unless(result->length > 0);
+
+    for (i = 0; i < n_inputs; i++) {
+        pa_sink_input_unlink(inputs[i]);
+        pa_sink_input_unref(inputs[i]);
+    }
+
+    pa_xfree(inputs);
+
+    pa_sink_unlink(sink);
+    pa_sink_unref(sink);
+
+    pa_asyncmsgq_send(thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(thread);
+    pa_thread_mq_done(&thread_mq);
+    pa_rtpoll_free(rtpoll);
+}
+
+static void input_chunk_new(pa_core *core) {
+    input_chunk.memblock = pa_memblock_new(core->mempool, RENDER_LENGTH);
+    input_chunk.index = 0;
+    input_chunk.length = RENDER_LENGTH;
+}
+
+/* Every input has to end up in the mix, whether the inputs are peeked by
+ * the IO thread or by render workers */
+static void render_many_inputs(unsigned n_workers, unsigned n_inputs, const char *benchmark) {
+    pa_mainloop *ml;
+    pa_core *core;
+    pa_memchunk result;
+    const int16_t *d;
+    int16_t *s;
+    unsigned i;
+
+    pa_assert_se(ml = pa_mainloop_new());
+    pa_assert_se(core = pa_core_new(pa_mainloop_get_api(ml), false, false, 0));
+    core->render_worker_threads = n_workers;
+
+    input_chunk_new(core);
+    s = pa_memblock_acquire(input_chunk.memblock);
+    for (i = 0; i < RENDER_LENGTH / sizeof(int16_t); i++)
+        s[i] = SAMPLE_VALUE;
+    pa_memblock_release(input_chunk.memblock);
+
+    render_inputs(core, PA_SAMPLE_S16NE, n_inputs, NULL, RENDER_LENGTH, benchmark, &result);
+
+    d = (const int16_t *) ((const uint8_t *) pa_memblock_acquire(result.memblock) + result.index);
+    for (i = 0; i < result.length / sizeof(int16_t); i++)
+        fail_unless(d[i] == (int16_t) (n_inputs * SAMPLE_VALUE));
+    pa_memblock_release(result.memblock);
+    pa_memblock_unref(result.memblock);
+
+    pa_memblock_unref(input_chunk.memblock);
+    pa_core_unref(core);
+    pa_mainloop_free(ml);
+}
+
+START_TEST (sink_render_test) {
+    render_many_inputs(0, N_INPUTS, NULL);
+}
+END_TEST
+
+START_TEST (sink_render_parallel_test) {
+    render_many_inputs(2, N_INPUTS, NULL);
+}
+END_TEST
+
+/* Times all of pa_sink_render(), not just the mixing: peeking every
+ * input, setting up the mix info and dropping the rendered data */
+START_TEST (sink_render_performance_test) {
+    static const unsigned n_inputs[] = { 8, 64, PA_MAX_INPUTS_PER_SINK };
+    unsigned i, n_workers;
+
+    for (i = 0; i < PA_ELEMENTSOF(n_inputs); i++)
+        for (n_workers = 0; n_workers <= 2; n_workers += 2) {
+            char label[64];
+
+            pa_snprintf(label, sizeof(label), "%u inputs, %u workers", n_inputs[i], n_workers);
+            render_many_inputs(n_workers, n_inputs[i], label);
+        }
+}
+END_TEST
+
+/* With float mixing, the ALSA sink mixes s16 streams in float and converts
+ * the mix to s16 once for the device. Apart from rounding, that has to
+ * give the same as mixing in s16, also where the mix clips. */
+START_TEST (sink_render_float_test) {
+    pa_mainloop *ml;
+    pa_core *core;
+    pa_cvolume volume;
+    pa_memchunk result_s16, result_float;
+    pa_convert_func_t convert;
+    int16_t converted[RENDER_LENGTH / sizeof(int16_t)];
+    const int16_t *d;
+    int16_t *s;
+    unsigned i, n;
+    int max_diff = 0;
+
+    pa_assert_se(ml = pa_mainloop_new());
+    pa_assert_se(core = pa_core_new(pa_mainloop_get_api(ml), false, false, 0));
+
+    /* A ramp over the whole s16 range, so that the loudest part of the
+     * mix clips */
+    input_chunk_new(core);
+    s = pa_memblock_acquire(input_chunk.memblock);
+    for (i = 0; i < RENDER_LENGTH / sizeof(int16_t); i++)
+        s[i] = (int16_t) ((int32_t) i * 65536 / (RENDER_LENGTH / sizeof(int16_t)) - 32768);
+    pa_memblock_release(input_chunk.memblock);
+
+    pa_cvolume_set(&volume, ss.channels, pa_sw_volume_from_linear(FLOAT_VOLUME));
+
+    render_inputs(core, PA_SAMPLE_S16NE, FLOAT_INPUTS, &volume, RENDER_LENGTH, NULL, &result_s16);
+    render_inputs(core, PA_SAMPLE_FLOAT32NE, FLOAT_INPUTS, &volume, RENDER_LENGTH * 2, NULL, &result_float);
+
+    /* What the ALSA sink does before writing to the device */
+    n = (unsigned) PA_MIN(result_s16.length / sizeof(int16_t), result_float.length / sizeof(float));
+    fail_unless(n == RENDER_LENGTH / sizeof(int16_t));
+    pa_assert_se(convert = pa_get_convert_from_float32ne_function(PA_SAMPLE_S16NE));
+    convert(n, pa_memblock_acquire_chunk(&result_float), converted);
+    pa_memblock_release(result_float.memblock);
+
+    d = pa_memblock_acquire_chunk(&result_s16);
+    for (i = 0; i < n; i++)
+        max_diff = PA_MAX(max_diff, abs(d[i] - converted[i]));
+    fail_unless(d[n - 1] == INT16_MAX && converted[n - 1] == INT16_MAX);
+    fail_unless(d[0] == INT16_MIN && converted[0] == INT16_MIN);
+    /* The ramp is at -0.5 there, which must not clip */
+    fail_unless(abs(d[n / 4] - (int) (-16384 * FLOAT_INPUTS * FLOAT_VOLUME)) <= FLOAT_TOLERANCE);
+    pa_memblock_release(result_s16.memblock);
+
+    pa_log_info("Float and s16 mixing differ by up to %d", max_diff);
+    fail_unless(max_diff <= FLOAT_TOLERANCE);
+
+    pa_memblock_unref(result_s16.memblock);
+    pa_memblock_unref(result_float.memblock);
+
+    pa_memblock_unref(input_chunk.memblock);
+    pa_core_unref(core);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Sink render");
+    tc = tcase_create("sink-render");
+    tcase_add_test(tc, sink_render_test);
+    tcase_add_test(tc, sink_render_parallel_test);
+    tcase_add_test(tc, sink_render_float_test);
+    tcase_add_test(tc, sink_render_performance_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
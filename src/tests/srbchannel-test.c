@@ -25,10 +25,20 @@
 #include <check.h>
 
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulsecore/socket.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/srbchannel.h>
 #include <pulsecore/packet.h>
 #include <pulsecore/pstream.h>
 #include <pulsecore/iochannel.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/pdispatch.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/tagstruct.h>
 
 static unsigned packets_received;
 static unsigned packets_checksum;
@@ -80,6 +90,131 @@ static void packet_test(unsigned npackets, size_t plength, pa_mainloop *ml, pa_p
     pa_packet_unref(packet);
 }
 
+#define BATCH_PACKETS 2000
+#define BATCH_FD_PACKET_LENGTH 77
+
+static unsigned batch_fds_received;
+
+static void batch_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint8_t *pdata;
+    size_t plen;
+
+    pdata = pa_packet_data(packet, &plen);
+
+    /* Packets are numbered, so this catches reordering as well */
+    fail_unless(plen > 0);
+    fail_unless(pdata[0] == (uint8_t) packets_received);
+
+    packets_received++;
+    packets_checksum += plen;
+
+#ifdef HAVE_CREDS
+    if (plen == BATCH_FD_PACKET_LENGTH) {
+        fail_unless(ancil_data->nfd == 1);
+        pa_close(ancil_data->fds[0]);
+        batch_fds_received++;
+    } else
+        fail_unless(ancil_data->nfd == 0);
+#endif
+}
+
+/* Queue up lots of packets of varying size before the main loop gets
+ * to run, so that they leave in batches, and check that they arrive
+ * intact, in order and with their fds attached. */
+START_TEST (pstream_batch_test) {
+    int fds[2];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    unsigned i, totalsum = 0, fds_sent = 0;
+    pa_usec_t start, stop;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[0]);
+    pa_make_fd_nonblock(fds[1]);
+
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    packets_received = 0;
+    packets_checksum = 0;
+    batch_fds_received = 0;
+    pa_pstream_set_receive_packet_callback(p2, batch_packet_received, NULL);
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < BATCH_PACKETS; i++) {
+        size_t plength;
+        pa_packet *packet;
+        uint8_t *pdata;
+        size_t plen;
+#ifdef HAVE_CREDS
+        pa_cmsg_ancil_data ancil, *a = NULL;
+#endif
+
+        /* Mostly small packets, as for subscription events and latency
+         * replies, with the occasional large one in between */
+        if (i % 100 == 50)
+            plength = 100000 + i;
+        else
+            plength = 10 + i % 40;
+
+#ifdef HAVE_CREDS
+        if (i % 100 == 25) {
+            int pipefd[2];
+
+            fail_unless(pipe(pipefd) == 0);
+            pa_close(pipefd[1]);
+
+            pa_zero(ancil);
+            ancil.nfd = 1;
+            ancil.fds[0] = pipefd[0];
+            ancil.close_fds_on_cleanup = true;
+            a = &ancil;
+
+            plength = BATCH_FD_PACKET_LENGTH;
+            fds_sent++;
+        }
+#endif
+
+        packet = pa_packet_new(plength);
+        pdata = (uint8_t *) pa_packet_data(packet, &plen);
+        memset(pdata, 0, plen);
+        pdata[0] = (uint8_t) i;
+
+#ifdef HAVE_CREDS
+        pa_pstream_send_packet(p1, packet, a);
+#else
+        pa_pstream_send_packet(p1, packet, NULL);
+#endif
+        pa_packet_unref(packet);
+        totalsum += plength;
+    }
+
+    while (packets_received < BATCH_PACKETS)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    stop = pa_rtclock_now();
+
+    fail_unless(packets_checksum == totalsum);
+    fail_unless(batch_fds_received == fds_sent);
+    pa_log_info("Transferred %u packets in %llu usec with %u writes", BATCH_PACKETS,
+                (unsigned long long) (stop - start), pa_pstream_get_n_writes(p1));
+
+    /* Large packets and the ones carrying fds start a new batch, the rest
+     * go out many at a time */
+    fail_unless(pa_pstream_get_n_writes(p1) < BATCH_PACKETS / 4);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
 START_TEST (srbchannel_test) {
 
     int pipefd[4];
@@ -105,7 +240,7 @@ START_TEST (srbchannel_test) {
 
     pa_log_debug("And now the same thing with srbchannel...");
 
-    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp);
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, (size_t) -1);
     pa_srbchannel_export(sr1, &srt);
     pa_pstream_set_srbchannel(p1, sr1);
     sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
@@ -122,6 +257,507 @@ START_TEST (srbchannel_test) {
 END_TEST
 
 
+#define WAKEUP_MESSAGES 200000
+#define WAKEUP_MESSAGE_SIZE 32
+
+struct wakeup_test {
+    pa_srbchannel *writer, *reader;
+    size_t received;
+    unsigned wakeups;
+};
+
+static void wakeup_writer(void *userdata) {
+    struct wakeup_test *w = userdata;
+    uint8_t msg[WAKEUP_MESSAGE_SIZE];
+    unsigned i, j;
+
+    for (i = 0; i < WAKEUP_MESSAGES; i++) {
+        size_t done = 0;
+
+        for (j = 0; j < sizeof(msg); j++)
+            msg[j] = (uint8_t) (i * sizeof(msg) + j);
+
+        while (done < sizeof(msg)) {
+            done += pa_srbchannel_write(w->writer, msg + done, sizeof(msg) - done);
+            if (done < sizeof(msg))
+                pa_thread_yield();
+        }
+    }
+}
+
+static bool wakeup_reader(pa_srbchannel *sr, void *userdata) {
+    struct wakeup_test *w = userdata;
+    uint8_t buf[4096];
+    size_t l, i;
+
+    w->wakeups++;
+
+    /* Drain the ringbuffer completely, like pa_pstream does */
+    while ((l = pa_srbchannel_read(sr, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < l; i++)
+            fail_unless(buf[i] == (uint8_t) (w->received + i));
+        w->received += l;
+    }
+
+    return true;
+}
+
+static void wakeup_run(bool batch, size_t size) {
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_srbchannel_template srt;
+    struct wakeup_test w;
+    pa_thread *thread;
+    pa_usec_t start, stop;
+    double secs;
+
+    pa_zero(w);
+    w.writer = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, size);
+    fail_unless(w.writer != NULL);
+    pa_srbchannel_export(w.writer, &srt);
+    w.reader = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    fail_unless(w.reader != NULL);
+
+    pa_srbchannel_set_batch_wakeups(w.writer, batch);
+    pa_srbchannel_set_callback(w.reader, wakeup_reader, &w);
+
+    start = pa_rtclock_now();
+    thread = pa_thread_new("srb-writer", wakeup_writer, &w);
+
+    while (w.received < WAKEUP_MESSAGES * WAKEUP_MESSAGE_SIZE)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    stop = pa_rtclock_now();
+    pa_thread_free(thread);
+
+    secs = (double) (stop - start) / PA_USEC_PER_SEC;
+    pa_log_info("%s wakeups, ringbuffer 2 * %zu bytes: %.0f messages/s, %.0f wakeups/s (%u wakeups in total)",
+                batch ? "Batched" : "Unbatched", pa_srbchannel_get_capacity(w.writer),
+                WAKEUP_MESSAGES / secs, w.wakeups / secs, w.wakeups);
+
+    pa_srbchannel_free(w.reader);
+    pa_srbchannel_free(w.writer);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+
+/* Stream lots of small messages from a writer thread through a srbchannel
+ * and report how often the reading side had to be woken up. */
+START_TEST (srbchannel_wakeup_test) {
+    wakeup_run(false, (size_t) -1);
+    wakeup_run(true, (size_t) -1);
+    wakeup_run(false, 4096);
+    wakeup_run(true, 4096);
+}
+END_TEST
+
+/* In a regular pool, sizes can only make the ringbuffers smaller:
+ * anything that doesn't fit into one pool block gets the default. */
+START_TEST (srbchannel_size_test) {
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_srbchannel *sr;
+    size_t capacity;
+
+    fail_unless(mp != NULL);
+
+    sr = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, (size_t) -1);
+    capacity = pa_srbchannel_get_capacity(sr);
+    pa_srbchannel_free(sr);
+
+    sr = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, 4096);
+    fail_unless(pa_srbchannel_get_capacity(sr) >= 4096);
+    fail_unless(pa_srbchannel_get_capacity(sr) < capacity);
+    pa_srbchannel_free(sr);
+
+    sr = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, 4 * pa_mempool_block_size_max(mp));
+    fail_unless(pa_srbchannel_get_capacity(sr) == capacity);
+    pa_srbchannel_free(sr);
+
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+#define LARGE_SRB_SIZE (1024*1024)
+
+/* Ringbuffers larger than a regular pool block need a pool made for
+ * them. The other end picks up their size, and packets go through. */
+START_TEST (srbchannel_large_test) {
+    int pipefd[4];
+    size_t block_size = pa_srbchannel_block_size(LARGE_SRB_SIZE);
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new_with_block_size(PA_MEM_TYPE_SHARED_POSIX, block_size, block_size, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+
+    fail_unless(mp != NULL);
+    fail_unless(pa_mempool_block_size_max(mp) >= block_size);
+
+    fail_unless(pipe(pipefd) == 0);
+    fail_unless(pipe(&pipefd[2]) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[2], pipefd[1]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[0], pipefd[3]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, LARGE_SRB_SIZE);
+    fail_unless(sr1 != NULL);
+    fail_unless(pa_srbchannel_get_capacity(sr1) >= LARGE_SRB_SIZE);
+
+    pa_srbchannel_export(sr1, &srt);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    fail_unless(pa_srbchannel_get_capacity(sr2) == pa_srbchannel_get_capacity(sr1));
+
+    pa_pstream_set_srbchannel(p1, sr1);
+    pa_pstream_set_srbchannel(p2, sr2);
+
+    packet_test(250, 5, ml, p1, p2);
+    packet_test(10, 1234567, ml, p1, p2);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+#define FOREIGN_BLOCKS 16
+#define FOREIGN_BLOCK_SIZE 1024
+
+static pa_memchunk foreign_chunks[FOREIGN_BLOCKS];
+static unsigned foreign_blocks_received;
+static size_t foreign_shared_bytes, foreign_copied_bytes;
+
+static void foreign_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek,
+                                      const pa_memchunk *chunk, void *userdata) {
+    const unsigned *d;
+
+    fail_unless(foreign_blocks_received < FOREIGN_BLOCKS);
+    fail_unless(channel == 7);
+    fail_unless(chunk->length == FOREIGN_BLOCK_SIZE);
+
+    d = (const unsigned *) ((const uint8_t *) pa_memblock_acquire(chunk->memblock) + chunk->index);
+    fail_unless(d[0] == foreign_blocks_received);
+    pa_memblock_release(chunk->memblock);
+
+    foreign_chunks[foreign_blocks_received] = *chunk;
+    pa_memblock_ref(chunk->memblock);
+    foreign_blocks_received++;
+}
+
+static void foreign_memblock_sent(pa_pstream *p, uint32_t channel, size_t length, bool shared, void *userdata) {
+    fail_unless(channel == 7);
+
+    if (shared)
+        foreign_shared_bytes += length;
+    else
+        foreign_copied_bytes += length;
+}
+
+/* Blocks from a pool other than the pstream's own, like record data
+ * rendered into a per-client pool, are shared too. They must stay
+ * around until the other end released them, even if the sender
+ * dropped its references long before. */
+START_TEST (pstream_foreign_pool_test) {
+    int fds[2];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_mempool *fp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_mempool *rmp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    const pa_mempool_stat *stat = pa_mempool_get_stat(fp);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    unsigned i;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[0]);
+    pa_make_fd_nonblock(fds[1]);
+
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, rmp);
+    pa_pstream_enable_shm(p1, true);
+    pa_pstream_enable_shm(p2, true);
+
+    foreign_blocks_received = 0;
+    foreign_shared_bytes = foreign_copied_bytes = 0;
+    pa_pstream_set_memblock_sent_callback(p1, foreign_memblock_sent, NULL);
+    pa_pstream_set_receive_memblock_callback(p2, foreign_memblock_received, NULL);
+
+    for (i = 0; i < FOREIGN_BLOCKS; i++) {
+        pa_memchunk chunk;
+        unsigned *d;
+
+        fail_unless((chunk.memblock = pa_memblock_new_pool(fp, FOREIGN_BLOCK_SIZE)) != NULL);
+        chunk.index = 0;
+        chunk.length = FOREIGN_BLOCK_SIZE;
+
+        d = pa_memblock_acquire(chunk.memblock);
+        d[0] = i;
+        pa_memblock_release(chunk.memblock);
+
+        pa_pstream_send_memblock(p1, 7, 0, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    while (foreign_blocks_received < FOREIGN_BLOCKS)
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    fail_unless(foreign_shared_bytes == FOREIGN_BLOCKS * FOREIGN_BLOCK_SIZE);
+    fail_unless(foreign_copied_bytes == 0);
+
+    /* Only the export keeps the blocks around now */
+    fail_unless(pa_atomic_load(&stat->n_allocated) == FOREIGN_BLOCKS);
+
+    for (i = 0; i < FOREIGN_BLOCKS; i++) {
+        pa_memblock_unref(foreign_chunks[i].memblock);
+
+        /* The block is released once the SHMRELEASE arrived */
+        while (pa_atomic_load(&stat->n_allocated) > (int) (FOREIGN_BLOCKS - i - 1))
+            pa_mainloop_iterate(ml, 1, NULL);
+    }
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(fp);
+    pa_mempool_unref(mp);
+    pa_mempool_unref(rmp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+#define UNSENT_BLOCKS 256
+#define UNSENT_BLOCK_SIZE 4096
+
+static size_t unsent_sent_bytes, unsent_received_bytes;
+static bool unsent_died;
+
+static void unsent_memblock_sent(pa_pstream *p, uint32_t channel, size_t length, bool shared, void *userdata) {
+    unsent_sent_bytes += length;
+}
+
+static void unsent_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek,
+                                     const pa_memchunk *chunk, void *userdata) {
+    unsent_received_bytes += chunk->length;
+}
+
+static void unsent_die(pa_pstream *p, void *userdata) {
+    unsent_died = true;
+}
+
+/* Blocks that were already lined up for a batched write when the
+ * connection went away never reached the other end, and so must not be
+ * reported as sent */
+START_TEST (pstream_unsent_test) {
+    int fds[2];
+    pa_mainloop *ml1 = pa_mainloop_new(), *ml2 = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    unsigned i;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[0]);
+    pa_make_fd_nonblock(fds[1]);
+
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml1), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml2), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml1), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml2), io2, mp);
+
+    pa_pstream_set_memblock_sent_callback(p1, unsent_memblock_sent, NULL);
+    pa_pstream_set_receive_memblock_callback(p2, unsent_memblock_received, NULL);
+    pa_pstream_set_die_callback(p2, unsent_die, NULL);
+
+    for (i = 0; i < UNSENT_BLOCKS; i++) {
+        pa_memchunk chunk;
+
+        fail_unless((chunk.memblock = pa_memblock_new(mp, UNSENT_BLOCK_SIZE)) != NULL);
+        chunk.index = 0;
+        chunk.length = UNSENT_BLOCK_SIZE;
+
+        pa_pstream_send_memblock(p1, 7, 0, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    /* Write until the socket buffer is full, without reading anything */
+    while (pa_mainloop_iterate(ml1, 0, NULL) > 0)
+        ;
+
+    fail_unless(pa_pstream_is_pending(p1));
+    fail_unless(unsent_sent_bytes < UNSENT_BLOCKS * UNSENT_BLOCK_SIZE);
+
+    pa_pstream_unlink(p1);
+    pa_pstream_unref(p1);
+
+    while (!unsent_died)
+        pa_mainloop_iterate(ml2, 1, NULL);
+
+    fail_unless(unsent_received_bytes == unsent_sent_bytes);
+
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml1);
+    pa_mainloop_free(ml2);
+}
+END_TEST
+
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+
+#define GROW_SLOTS 4
+#define GROW_BLOCKS 20
+
+static unsigned grow_blocks_received, grow_blocks_shared;
+static uint32_t grow_version;
+
+static void register_memfd_shmid(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    fail_unless(pa_common_command_register_memfd_shmid(userdata, pd, grow_version, command, tag, t) == 0);
+}
+
+static const pa_pdispatch_cb_t grow_command_table[PA_COMMAND_MAX] = {
+    [PA_COMMAND_REGISTER_MEMFD_SHMID] = register_memfd_shmid,
+};
+
+static void grow_packet_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    fail_unless(pa_pdispatch_run(userdata, packet, ancil_data, p) == 0);
+}
+
+static void grow_memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek,
+                                   const pa_memchunk *chunk, void *userdata) {
+    unsigned *d;
+
+    d = pa_memblock_acquire_chunk(chunk);
+    fail_unless(d[0] == grow_blocks_received);
+    pa_memblock_release(chunk->memblock);
+
+    if (pa_memblock_is_read_only(chunk->memblock))
+        grow_blocks_shared++;
+
+    grow_blocks_received++;
+}
+
+/* Blocks in a segment the memfd pool grew by after the srbchannel was
+ * set up must neither overtake the segment's registration nor be lost.
+ * Returns how many of them were shared. */
+static unsigned memfd_grow(uint32_t version) {
+    int fds[2];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_SHARED_MEMFD, GROW_SLOTS * 64 * 1024, true);
+    pa_mempool *srbmp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+    pa_mempool *rmp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_memblock *filler[GROW_SLOTS];
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    pa_pdispatch *pd;
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+    const char *reason;
+    uint32_t shm_id;
+    size_t size;
+    unsigned i;
+
+    fail_unless(mp != NULL);
+    size = pa_mempool_block_size_max(mp);
+    pa_mempool_set_max_segments(mp, 2);
+    grow_version = version;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[0]);
+    pa_make_fd_nonblock(fds[1]);
+
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, rmp);
+
+    pd = pa_pdispatch_new(pa_mainloop_get_api(ml), true, grow_command_table, PA_COMMAND_MAX);
+    pa_pstream_set_receive_packet_callback(p2, grow_packet_received, pd);
+    pa_pstream_set_receive_memblock_callback(p2, grow_memblock_received, NULL);
+
+    pa_pstream_enable_shm(p1, true);
+    pa_pstream_enable_shm(p2, true);
+    pa_pstream_enable_memfd(p1);
+    pa_pstream_enable_memfd(p2);
+    if (version >= 33) {
+        pa_pstream_enable_memfd_shmid_ack(p1);
+        pa_pstream_enable_memfd_shmid_ack(p2);
+    }
+    fail_unless(pa_pstream_register_memfd_mempool(p1, mp, &reason) == 0);
+
+    /* Let the registration go through, so that the srbchannel is
+     * switched to right away */
+    fail_unless(pa_mempool_get_shm_id(mp, &shm_id) == 0);
+    while (!pa_pstream_memfd_shmid_is_registered(p2, shm_id))
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), srbmp, (size_t) -1);
+    pa_srbchannel_export(sr1, &srt);
+    pa_pstream_set_srbchannel(p1, sr1);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    pa_pstream_set_srbchannel(p2, sr2);
+
+    /* Fill the first segment and add a second one, so that the blocks
+     * sent come from that */
+    for (i = 0; i < GROW_SLOTS; i++)
+        fail_unless((filler[i] = pa_memblock_new_pool(mp, size)) != NULL);
+    fail_unless(pa_mempool_grow(mp) == 0);
+
+    grow_blocks_received = grow_blocks_shared = 0;
+
+    for (i = 0; i < GROW_BLOCKS; i++) {
+        pa_memchunk chunk;
+        unsigned *d;
+
+        fail_unless((chunk.memblock = pa_memblock_new_pool(mp, size)) != NULL);
+        fail_unless(pa_mempool_get_n_segments(mp) == 2);
+        chunk.index = 0;
+        chunk.length = size;
+
+        d = pa_memblock_acquire(chunk.memblock);
+        d[0] = i;
+        pa_memblock_release(chunk.memblock);
+
+        pa_pstream_send_memblock(p1, 0, 0, PA_SEEK_RELATIVE, &chunk);
+        pa_memblock_unref(chunk.memblock);
+
+        while (grow_blocks_received <= i)
+            pa_mainloop_iterate(ml, 1, NULL);
+    }
+
+    pa_log_info("Received %u blocks from a grown segment, %u of them shared", grow_blocks_received, grow_blocks_shared);
+
+    for (i = 0; i < GROW_SLOTS; i++)
+        pa_memblock_unref(filler[i]);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_pdispatch_unref(pd);
+    pa_mempool_unref(mp);
+    pa_mempool_unref(srbmp);
+    pa_mempool_unref(rmp);
+    pa_mainloop_free(ml);
+
+    return grow_blocks_shared;
+}
+
+START_TEST (srbchannel_memfd_grow_test) {
+    /* Once the segment is acknowledged, its blocks are shared */
+    fail_unless(memfd_grow(PA_PROTOCOL_VERSION) > 0);
+}
+END_TEST
+
+START_TEST (srbchannel_memfd_grow_v32_test) {
+    /* Peers older than v33 don't acknowledge, so they get copies only */
+    fail_unless(memfd_grow(32) == 0);
+}
+END_TEST
+
+#endif
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -134,6 +770,16 @@ int main(int argc, char *argv[]) {
     s = suite_create("srbchannel");
     tc = tcase_create("srbchannel");
     tcase_add_test(tc, srbchannel_test);
+    tcase_add_test(tc, pstream_batch_test);
+    tcase_add_test(tc, srbchannel_wakeup_test);
+    tcase_add_test(tc, srbchannel_size_test);
+    tcase_add_test(tc, srbchannel_large_test);
+    tcase_add_test(tc, pstream_foreign_pool_test);
+    tcase_add_test(tc, pstream_unsent_test);
+#if defined(HAVE_CREDS) && defined(HAVE_MEMFD)
+    tcase_add_test(tc, srbchannel_memfd_grow_test);
+    tcase_add_test(tc, srbchannel_memfd_grow_v32_test);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
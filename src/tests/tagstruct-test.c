@@ -0,0 +1,228 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+#include <pulsecore/socket.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+#include <pulsecore/pstream-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/native-common.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/tagstruct.h>
+
+#define N_REPLIES 1000
+#define N_WARMUP 10
+#define N_PARKED 256
+
+/* Roughly the size of a sink info reply */
+#define REPLY_STRINGS 40
+
+static unsigned replies_received;
+
+static void fill_reply(pa_tagstruct *t, uint32_t tag, unsigned n_strings) {
+    unsigned i;
+
+    pa_tagstruct_putu32(t, PA_COMMAND_REPLY);
+    pa_tagstruct_putu32(t, tag);
+
+    for (i = 0; i < n_strings; i++)
+        pa_tagstruct_puts(t, "alsa_output.pci-0000_00_1f.3.analog-stereo");
+}
+
+static void check_reply(pa_tagstruct *t, uint32_t tag, unsigned n_strings) {
+    uint32_t command, u;
+    const char *s;
+    unsigned i;
+
+    fail_unless(pa_tagstruct_getu32(t, &command) == 0);
+    fail_unless(command == PA_COMMAND_REPLY);
+    fail_unless(pa_tagstruct_getu32(t, &u) == 0);
+    fail_unless(u == tag);
+
+    for (i = 0; i < n_strings; i++) {
+        fail_unless(pa_tagstruct_gets(t, &s) == 0);
+        fail_unless(pa_streq(s, "alsa_output.pci-0000_00_1f.3.analog-stereo"));
+    }
+
+    fail_unless(pa_tagstruct_eof(t));
+}
+
+static void reply_received(pa_pstream *p, pa_packet *packet, pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint8_t *pdata;
+    size_t plen;
+    pa_tagstruct *t;
+
+    pdata = pa_packet_data(packet, &plen);
+    t = pa_tagstruct_new_fixed(pdata, plen);
+    check_reply(t, replies_received, REPLY_STRINGS);
+    pa_tagstruct_free(t);
+
+    replies_received++;
+}
+
+/* Small, pooled and individually allocated tagstructs all have to
+ * survive having their data taken over */
+START_TEST (tagstruct_steal_test) {
+    unsigned sizes[] = { 0, REPLY_STRINGS, 10 * REPLY_STRINGS };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++) {
+        pa_tagstruct *t = pa_tagstruct_new(), *r;
+        pa_free_cb_t free_cb;
+        uint8_t *data;
+        size_t length;
+
+        fill_reply(t, i, sizes[i]);
+        data = pa_tagstruct_steal_data(t, &length, &free_cb);
+
+        if (sizes[i] == 0) {
+            const uint8_t *d;
+
+            fail_unless(data == NULL);
+            d = pa_tagstruct_data(t, &length);
+            r = pa_tagstruct_new_fixed(d, length);
+            check_reply(r, i, sizes[i]);
+            pa_tagstruct_free(r);
+        } else {
+            fail_unless(data != NULL);
+            r = pa_tagstruct_new_fixed(data, length);
+            check_reply(r, i, sizes[i]);
+            pa_tagstruct_free(r);
+            free_cb(data);
+
+            /* The tagstruct is left empty and usable */
+            pa_tagstruct_data(t, &length);
+            fail_unless(length == 0);
+            fill_reply(t, i, sizes[i]);
+        }
+
+        pa_tagstruct_free(t);
+    }
+}
+END_TEST
+
+/* Send replies too large for the appended buffer back to back, and
+ * check that once the buffer free list is warm sending them does not
+ * allocate any more buffers. */
+START_TEST (tagstruct_pool_test) {
+    int fds[2];
+    pa_mainloop *ml = pa_mainloop_new();
+    pa_mempool *mp = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    unsigned i, n_allocated = 0;
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    pa_make_fd_nonblock(fds[0]);
+    pa_make_fd_nonblock(fds[1]);
+
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+    replies_received = 0;
+    pa_pstream_set_receive_packet_callback(p2, reply_received, NULL);
+
+    for (i = 0; i < N_REPLIES; i++) {
+        pa_tagstruct *t;
+
+        if (i == N_WARMUP)
+            n_allocated = pa_tagstruct_get_n_allocated_buffers();
+
+        t = pa_tagstruct_new();
+        fill_reply(t, i, REPLY_STRINGS);
+        pa_pstream_send_tagstruct(p1, t);
+
+        while (replies_received <= i)
+            pa_mainloop_iterate(ml, 1, NULL);
+    }
+
+    n_allocated = pa_tagstruct_get_n_allocated_buffers() - n_allocated;
+    pa_log_info("Sent %u replies, %u tagstruct buffers allocated after the first %u",
+                N_REPLIES, n_allocated, N_WARMUP);
+    fail_unless(n_allocated == 0);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+/* Freeing many tagstructs at once must not keep all their buffers
+ * around */
+START_TEST (tagstruct_pool_cap_test) {
+    pa_tagstruct *t[N_PARKED];
+    unsigned i, n_allocated;
+
+    for (i = 0; i < N_PARKED; i++) {
+        t[i] = pa_tagstruct_new();
+        fill_reply(t[i], i, REPLY_STRINGS);
+    }
+
+    for (i = 0; i < N_PARKED; i++)
+        pa_tagstruct_free(t[i]);
+
+    n_allocated = pa_tagstruct_get_n_allocated_buffers();
+
+    for (i = 0; i < N_PARKED; i++) {
+        t[i] = pa_tagstruct_new();
+        fill_reply(t[i], i, REPLY_STRINGS);
+    }
+
+    n_allocated = pa_tagstruct_get_n_allocated_buffers() - n_allocated;
+    pa_log_info("%u of %u tagstruct buffers had to be allocated again", n_allocated, N_PARKED);
+    fail_unless(n_allocated > 0);
+
+    for (i = 0; i < N_PARKED; i++)
+        pa_tagstruct_free(t[i]);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Tagstruct");
+    tc = tcase_create("tagstruct");
+    tcase_add_test(tc, tagstruct_steal_test);
+    tcase_add_test(tc, tagstruct_pool_test);
+    tcase_add_test(tc, tagstruct_pool_cap_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
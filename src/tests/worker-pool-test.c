@@ -0,0 +1,234 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/worker-pool.h>
+
+#include "runtime-test-util.h"
+
+#define N_ITEMS 1000
+
+static pa_worker_pool *pool;
+static pa_thread_mq fake_mq;
+static pa_atomic_t calls[N_ITEMS];
+static pa_atomic_t wrong_mq;
+
+static void count_cb(unsigned idx, void *userdata) {
+    fail_unless(idx < N_ITEMS);
+
+    pa_atomic_inc(&calls[idx]);
+
+    /* Items run in the context of the caller */
+    if (pa_thread_mq_get() != &fake_mq)
+        pa_atomic_inc(&wrong_mq);
+}
+
+static void nested_cb(unsigned idx, void *userdata) {
+    /* Using the pool from within an item must not deadlock */
+    pa_worker_pool_run(pool, 10, count_cb, NULL);
+    count_cb(idx, NULL);
+}
+
+START_TEST (worker_pool_test) {
+    unsigned i, round;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_thread_mq_install(&fake_mq);
+
+    fail_unless((pool = pa_worker_pool_new("test-worker", 4, false, 0)) != NULL);
+    ck_assert_int_eq(pa_worker_pool_get_n_threads(pool), 4);
+
+    for (round = 0; round < 100; round++) {
+        unsigned n = round % 2 ? N_ITEMS : round;
+
+        for (i = 0; i < N_ITEMS; i++)
+            pa_atomic_store(&calls[i], 0);
+
+        pa_worker_pool_run(pool, n, count_cb, NULL);
+
+        for (i = 0; i < N_ITEMS; i++)
+            ck_assert_int_eq(pa_atomic_load(&calls[i]), i < n ? 1 : 0);
+    }
+
+    for (i = 0; i < N_ITEMS; i++)
+        pa_atomic_store(&calls[i], 0);
+
+    pa_worker_pool_run(pool, 20, nested_cb, NULL);
+
+    for (i = 0; i < 10; i++)
+        ck_assert_int_eq(pa_atomic_load(&calls[i]), 21);
+    for (i = 10; i < 20; i++)
+        ck_assert_int_eq(pa_atomic_load(&calls[i]), 1);
+
+    ck_assert_int_eq(pa_atomic_load(&wrong_mq), 0);
+
+    pa_worker_pool_free(pool);
+}
+END_TEST
+
+/* A stand-in for what a sink does with its inputs: every stream gets
+ * resampled on its own, the results are used in a fixed order. */
+
+#define STREAMS 64
+#define TIMES 20
+#define TIMES2 5
+
+struct stream {
+    pa_resampler *resampler;
+    pa_memchunk out;
+};
+
+struct streams {
+    pa_memchunk in;
+    struct stream s[STREAMS];
+};
+
+static void resample_cb(unsigned idx, void *userdata) {
+    struct streams *st = userdata;
+    struct stream *s = st->s + idx;
+
+    if (s->out.memblock)
+        pa_memblock_unref(s->out.memblock);
+
+    pa_resampler_run(s->resampler, &st->in, &s->out);
+}
+
+static void streams_init(struct streams *st, pa_mempool *mempool) {
+    pa_sample_spec a, b;
+    float *d;
+    unsigned i;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = 2;
+    a.rate = 44100;
+    b.rate = 48000;
+
+    st->in.memblock = pa_memblock_new(mempool, pa_usec_to_bytes(10 * PA_USEC_PER_MSEC, &a));
+    st->in.index = 0;
+    st->in.length = pa_memblock_get_length(st->in.memblock);
+
+    d = pa_memblock_acquire(st->in.memblock);
+    for (i = 0; i < st->in.length / sizeof(float); i++)
+        d[i] = (float) ((i * 7919) % 2000) / 1000.0f - 1.0f;
+    pa_memblock_release(st->in.memblock);
+
+    for (i = 0; i < STREAMS; i++) {
+        pa_assert_se(st->s[i].resampler = pa_resampler_new(mempool, &a, NULL, &b, NULL, 0, PA_RESAMPLER_FFMPEG, 0));
+        pa_memchunk_reset(&st->s[i].out);
+    }
+}
+
+static void streams_done(struct streams *st) {
+    unsigned i;
+
+    for (i = 0; i < STREAMS; i++) {
+        if (st->s[i].out.memblock)
+            pa_memblock_unref(st->s[i].out.memblock);
+        pa_resampler_free(st->s[i].resampler);
+    }
+
+    pa_memblock_unref(st->in.memblock);
+}
+
+START_TEST (worker_pool_resample_test) {
+    pa_mempool *mempool;
+    struct streams serial, parallel;
+    unsigned i, n_threads;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fail_unless((mempool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true)) != NULL);
+
+    n_threads = PA_CLAMP(pa_ncpus() - 1, 1U, 15U);
+    fail_unless((pool = pa_worker_pool_new("test-worker", n_threads, false, 0)) != NULL);
+
+    streams_init(&serial, mempool);
+    streams_init(&parallel, mempool);
+
+    pa_log_debug("Resampling %u streams, %u worker threads", STREAMS, n_threads);
+
+    PA_RUNTIME_TEST_RUN_START("serial", TIMES, TIMES2) {
+        for (i = 0; i < STREAMS; i++)
+            resample_cb(i, &serial);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("workers", TIMES, TIMES2) {
+        pa_worker_pool_run(pool, STREAMS, resample_cb, &parallel);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    /* Same input, same state, so the output must be bit identical */
+    for (i = 0; i < STREAMS; i++) {
+        void *a, *b;
+
+        ck_assert_int_eq(serial.s[i].out.length, parallel.s[i].out.length);
+
+        a = pa_memblock_acquire_chunk(&serial.s[i].out);
+        b = pa_memblock_acquire_chunk(&parallel.s[i].out);
+        fail_unless(memcmp(a, b, serial.s[i].out.length) == 0);
+        pa_memblock_release(serial.s[i].out.memblock);
+        pa_memblock_release(parallel.s[i].out.memblock);
+    }
+
+    streams_done(&serial);
+    streams_done(&parallel);
+
+    pa_worker_pool_free(pool);
+    pa_mempool_unref(mempool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    s = suite_create("Worker pool");
+    tc = tcase_create("workerpool");
+    tcase_add_test(tc, worker_pool_test);
+    tcase_add_test(tc, worker_pool_resample_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}